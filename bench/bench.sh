@@ -0,0 +1,124 @@
+#!/bin/sh
+# Macro benchmark suite for the process scheduler.
+#
+# Runs every scheduling policy over synthetic workloads of increasing size and
+# contention and writes one CSV row per run. Results are stored per commit in
+# bench/results/ so two runs can be compared with bench/compare.sh.
+#
+# Usage: make bench            (or: sh bench/bench.sh)
+#
+# Environment:
+#   BENCH_SIZES       process counts to run       (100 ... 10000000)
+#   BENCH_CONTENTION  resource contention levels  (high skewed low)
+#   BENCH_QUANTA      round robin quanta          (1 4 16)
+#   BENCH_TIMEOUT     seconds before a run is abandoned (300)
+#   BENCH_OUT         output CSV (bench/results/<commit>.csv)
+
+set -eu
+
+cd "$(dirname "$0")/.."
+
+EXECUTABLE=./my_executable
+SHIM=bench/libmalloc_count.so
+WORKLOADS=bench/workloads
+
+SIZES=${BENCH_SIZES:-"100 1000 10000 100000 1000000 10000000"}
+CONTENTION=${BENCH_CONTENTION:-"high skewed low"}
+QUANTA=${BENCH_QUANTA:-"1 4 16"}
+TIMEOUT=${BENCH_TIMEOUT:-300}
+INSTRUCTIONS=4
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git diff --quiet HEAD -- src 2>/dev/null; then
+  COMMIT="$COMMIT-dirty"
+fi
+
+mkdir -p bench/results "$WORKLOADS"
+OUT=${BENCH_OUT:-bench/results/$COMMIT.csv}
+
+# Generator options for a contention level: a handful of resources shared by
+# every process, many resources with requests skewed towards a few of them,
+# or enough resources that most requests find their resource free.
+contention_options() {
+  case $1 in
+  high) echo "-r 4" ;;
+  skewed) echo "-r 256 -z 1.2" ;;
+  *) echo "-r 256" ;;
+  esac
+}
+
+# Writes a workload of $1 processes at contention level $2. Each process
+# requests two resources in increasing order and releases them, so the
+# workload never deadlocks (see data/dp_sol.list).
+generate_workload() {
+  # shellcheck disable=SC2046
+  tools/procsched-gen -n "$1" -i "$INSTRUCTIONS" -d -s "$1" \
+    $(contention_options "$2")
+}
+
+# Extracts the value of key $1 from the key=value pairs in file $2.
+stat_value() {
+  tr ' ' '\n' <"$2" | sed -n "s/^$1=//p" | tail -n 1
+}
+
+# Runs one configuration and appends a row to the results file.
+run_case() {
+  workload=$1 size=$2 resources=$3 policy=$4 alg=$5 quantum=$6
+  err=$(mktemp)
+
+  start=$(date +%s.%N)
+  set +e
+  LD_PRELOAD=$PWD/$SHIM timeout "$TIMEOUT" \
+    "$EXECUTABLE" -q -s "$WORKLOADS/$workload" "$alg" "$quantum" \
+    >/dev/null 2>"$err"
+  rc=$?
+  set -e
+  end=$(date +%s.%N)
+
+  case $rc in
+  0) status=ok ;;
+  124) status=timeout ;;
+  *) status=error ;;
+  esac
+
+  instructions=$(stat_value instructions "$err")
+  allocs=$(stat_value allocs "$err")
+
+  echo "$COMMIT,$workload,$size,$resources,$INSTRUCTIONS,$policy,$quantum,$status,$(
+    awk -v s="$start" -v e="$end" 'BEGIN { printf "%.6f", e - s }'),$(
+    stat_value schedule_s "$err"),$instructions,$(
+    stat_value instr_per_s "$err"),$(stat_value peak_rss_kb "$err"),$allocs,$(
+    awk -v a="$allocs" -v i="$instructions" \
+      'BEGIN { if (i > 0) printf "%.3f", a / i }')" >>"$OUT"
+
+  echo "  $policy q=$quantum: $status" >&2
+  rm -f "$err"
+}
+
+echo "commit,workload,processes,resources,instructions_per_process,policy,quantum,status,wall_s,schedule_s,instructions,instr_per_s,peak_rss_kb,allocs,allocs_per_instr" >"$OUT"
+
+for size in $SIZES; do
+  for level in $CONTENTION; do
+    resources=$(contention_options "$level" | cut -d' ' -f2)
+    workload="synthetic-$size-$level.list"
+
+    if [ ! -f "$WORKLOADS/$workload" ]; then
+      echo "generating $workload" >&2
+      generate_workload "$size" "$level" >"$WORKLOADS/$workload"
+    fi
+
+    echo "$workload" >&2
+    run_case "$workload" "$size" "$resources" fcfs 0 0
+    for quantum in $QUANTA; do
+      run_case "$workload" "$size" "$resources" rr 1 "$quantum"
+    done
+    # The generated processes have no priorities, periods or deadlines, so
+    # these runs measure the cost of the ready queues of the policies on
+    # equally urgent processes rather than a realistic real time workload.
+    run_case "$workload" "$size" "$resources" priority 2 0
+    run_case "$workload" "$size" "$resources" edf 3 0
+    run_case "$workload" "$size" "$resources" rm 4 0
+  done
+done
+
+echo "results written to $OUT" >&2
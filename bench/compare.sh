@@ -0,0 +1,55 @@
+#!/bin/sh
+# Compares two result files written by bench.sh.
+#
+# Usage: sh bench/compare.sh base.csv new.csv [threshold_percent]
+#
+# Prints the instructions/sec of every configuration present in both files
+# and exits with status 1 if any configuration got slower by more than the
+# threshold (default 10%), so it can gate a commit in a script. A
+# configuration of the base file that failed, timed out or is missing in the
+# new file counts as a failure too.
+
+set -eu
+
+if [ $# -lt 2 ]; then
+  echo "usage: $0 base.csv new.csv [threshold_percent]" >&2
+  exit 2
+fi
+
+awk -F, -v threshold="${3:-10}" '
+  FNR == 1 {
+    file++;
+    for (i = 1; i <= NF; i++) column[$i] = i;
+    next;
+  }
+  {
+    key = $column["workload"] " " $column["policy"] " q=" $column["quantum"];
+    rate = $column["instr_per_s"];
+  }
+  file == 1 { base[key] = rate; next; }
+  key in base {
+    seen[key] = 1;
+    status = $column["status"];
+    if (status != "ok" || rate == "") {
+      regressions++;
+      printf "%-40s %14s %14s %8s  FAILED\n", key, base[key], status, "n/a";
+      next;
+    }
+    if (base[key] == "") {
+      printf "%-40s %14s %14.0f %8s\n", key, base[key], rate, "n/a";
+      next;
+    }
+    change = (rate - base[key]) * 100 / base[key];
+    flag = change < -threshold ? "  REGRESSION" : "";
+    if (flag != "") regressions++;
+    printf "%-40s %14.0f %14.0f %+7.1f%%%s\n", key, base[key], rate, change, flag;
+  }
+  END {
+    for (key in base) {
+      if (key in seen) continue;
+      regressions++;
+      printf "%-40s %14s %14s %8s  MISSING\n", key, base[key], "", "n/a";
+    }
+    exit regressions > 0;
+  }
+' "$1" "$2"
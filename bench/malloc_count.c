@@ -0,0 +1,39 @@
+/**
+ * @file malloc_count.c
+ * @description A small LD_PRELOAD shim used by the benchmark suite to count
+ *              heap allocations made by the simulator.
+ *
+ * Every call to malloc, calloc and realloc is counted. When the process exits
+ * the total is written to stderr as "allocs=N" so that bench.sh can divide it
+ * by the number of executed instructions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long long allocations = 0;
+
+void *malloc(size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(ptr, size);
+}
+
+/**
+ * @brief Reports the number of allocations once the simulator exits.
+ */
+__attribute__((destructor)) static void report_allocations(void) {
+  fprintf(stderr, "allocs=%llu\n", allocations);
+}
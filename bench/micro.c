@@ -0,0 +1,575 @@
+/**
+ * @file micro.c
+ * @description Micro-benchmarks for the queue, resource, mailbox, topic and
+ *              parser primitives of the simulator.
+ *
+ * Every benchmark runs a number of warmup repetitions followed by measured
+ * repetitions. Each repetition performs a fixed number of operations and the
+ * report gives the mean time per operation with a 95% confidence interval
+ * over the repetitions.
+ *
+ * Usage: bench/micro [-w warmup] [-r repetitions] [-c cpu] [-f filter] [-o csv]
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/loader.h"
+#include "../src/manager.h"
+#include "../src/parser.h"
+#include "../src/queue.h"
+#include "../src/simulator.h"
+#include "../src/table.h"
+#include "../src/topic.h"
+
+int read_string(FILE *fptr, char *line);
+
+/**
+ * A single micro-benchmark. setup prepares the state for the given size
+ * parameter, run performs the operations of one repetition and returns how
+ * many were performed, teardown frees the state again.
+ */
+struct benchmark {
+  /** The name of the primitive being measured */
+  const char *name;
+  /** The size parameter, e.g. the length of the resource list */
+  long param;
+  /** What one operation is, used in the report */
+  const char *unit;
+  void (*setup)(long param);
+  long (*run)(long param);
+  void (*teardown)(void);
+};
+
+static struct processControlBlock benchPCB;
+static struct page benchPage;
+static struct simulator benchSim;
+static struct processTable benchTable;
+static struct queue benchQueue;
+static struct resourceList *benchResources = NULL;
+static struct resourceList *benchPool = NULL;
+static long benchPoolSize = 0;
+static struct mailbox *benchMailboxes = NULL;
+static struct mailbox benchRing;
+static struct mailbox benchTopic;
+static struct message *benchMessage = NULL;
+static char *benchLastMailbox = NULL;
+static char benchFile[64] = "";
+static char *benchBuffer = NULL;
+static size_t benchBufferSize = 0;
+static volatile long benchSink = 0;
+
+/**
+ * @brief Returns the current time of the monotonic clock in nanoseconds.
+ */
+static double now_ns() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * @brief Returns an allocated copy of "<prefix><number>".
+ */
+static char *make_name(const char *prefix, long number) {
+  char buffer[32];
+  char *name;
+
+  snprintf(buffer, sizeof(buffer), "%s%ld", prefix, number);
+  name = malloc(strlen(buffer) + 1);
+  strcpy(name, buffer);
+  return name;
+}
+
+static void setup_process(long param) {
+  (void)param;
+  benchPage.number = 0;
+  benchPage.name = "P1";
+  benchPage.firstInstruction = NULL;
+  benchPage.program = NULL;
+  benchPCB.pagePtr = &benchPage;
+  benchPCB.resourceListPtr = NULL;
+  benchPCB.spareResources = NULL;
+  benchPCB.next = NULL;
+}
+
+/* Queue: dequeue followed by enqueue on a queue holding param + 1 processes
+ * of a process table. */
+
+static void setup_queue(long param) {
+  long i;
+
+  setup_process(param);
+  table_init(&benchTable, param + 1);
+  queue_init(&benchQueue);
+  for (i = 0; i <= param; i++) {
+    enqueue(&benchTable, &benchQueue, table_add(&benchTable, &benchPCB));
+  }
+}
+
+static long run_queue(long param) {
+  long i;
+  const long ops = 100000;
+
+  (void)param;
+  for (i = 0; i < ops; i++) {
+    enqueue(&benchTable, &benchQueue, dequeue(&benchTable, &benchQueue));
+  }
+  return ops;
+}
+
+static void teardown_queue() {
+  table_free(&benchTable);
+}
+
+/* Resources: a counted resource with a pool of param instances. */
+
+static void init_resource(struct resourceList *r, long number,
+                          long capacity) {
+  r->name = make_name("R", number + 1);
+  r->number = number;
+  r->available = r->capacity = capacity;
+  r->protocol = 0;
+  r->ceiling = 0;
+  r->readers = r->wokenReaders = 0;
+  r->holder = -1;
+  r->resource = NULL;
+  r->holders = r->nextHolder = r->prevHolder = NULL;
+  r->holderIndex = NULL;
+  r->holderSlots = r->holderCount = 0;
+  r->next = NULL;
+}
+
+static void setup_resources(long param) {
+  /* Zeroed, so every field added to the struct starts out cleared */
+  struct resourceList *r = calloc(1, sizeof(struct resourceList));
+
+  setup_process(param);
+  init_resource(r, 0, param);
+  benchResources = r;
+}
+
+static long run_is_resource_available(long param) {
+  long i;
+  const long ops = 1000000;
+
+  (void)param;
+  for (i = 0; i < ops; i++) {
+    benchSink += is_resource_available(benchResources);
+  }
+  return ops;
+}
+
+/* Acquires every instance of the pool, then releases them all. */
+static long run_acquire_release(long param) {
+  long i;
+  long n;
+  const long rounds = 1000000 / param + 1;
+
+  for (i = 0; i < rounds; i++) {
+    for (n = 0; n < param; n++) {
+      benchSink += acquire_resource(benchResources, &benchPCB);
+    }
+    for (n = 0; n < param; n++) {
+      benchSink += release_resource(benchResources, &benchPCB);
+    }
+  }
+  return rounds * param;
+}
+
+static void free_spare_resources() {
+  struct resourceList *spare;
+
+  while ((spare = benchPCB.spareResources) != NULL) {
+    benchPCB.spareResources = spare->next;
+    free(spare);
+  }
+}
+
+static void teardown_resources() {
+  free_spare_resources();
+  free(benchResources->name);
+  free(benchResources->holderIndex);
+  free(benchResources);
+  benchResources = NULL;
+}
+
+/* Resources released out of order: param single instance resources are
+ * acquired and then released in the order they were acquired, the oldest
+ * instance of the process first. */
+
+static void setup_pool(long param) {
+  long i;
+
+  setup_process(param);
+  benchPool = calloc(param, sizeof(struct resourceList));
+  benchPoolSize = param;
+  for (i = 0; i < param; i++) {
+    init_resource(&benchPool[i], i, 1);
+  }
+}
+
+static long run_acquire_release_fifo(long param) {
+  long i;
+  long n;
+  const long rounds = 100000 / param + 1;
+
+  for (i = 0; i < rounds; i++) {
+    for (n = 0; n < param; n++) {
+      benchSink += acquire_resource(&benchPool[n], &benchPCB);
+    }
+    for (n = 0; n < param; n++) {
+      benchSink += release_resource(&benchPool[n], &benchPCB);
+    }
+  }
+  return rounds * param;
+}
+
+static void teardown_pool() {
+  long i;
+
+  free_spare_resources();
+  for (i = 0; i < benchPoolSize; i++) {
+    free(benchPool[i].name);
+    free(benchPool[i].holderIndex);
+  }
+  free(benchPool);
+  benchPool = NULL;
+}
+
+/* Mailboxes: lookups of the last mailbox in a list of param mailboxes. */
+
+static void setup_mailboxes(long param) {
+  long i;
+  struct mailbox *m;
+
+  benchMailboxes = NULL;
+  for (i = param; i > 0; i--) {
+    m = malloc(sizeof(struct mailbox));
+    init_mailbox(m, make_name("M", i), 1);
+    m->next = benchMailboxes;
+    benchMailboxes = m;
+  }
+  benchLastMailbox = make_name("M", param);
+}
+
+static long run_find_mailbox(long param) {
+  long i;
+  const long ops = 1000000 / param + 1;
+
+  for (i = 0; i < ops; i++) {
+    benchSink += find_mailbox(benchLastMailbox, benchMailboxes) != NULL;
+  }
+  return ops;
+}
+
+static void teardown_mailboxes() {
+  struct mailbox *next;
+
+  while (benchMailboxes != NULL) {
+    next = benchMailboxes->next;
+    free(benchMailboxes->name);
+    free(benchMailboxes);
+    benchMailboxes = next;
+  }
+  free(benchLastMailbox);
+}
+
+/* Mailbox rings: param sends of one message into a counted mailbox holding
+ * param messages, which is then drained at once. */
+
+static void setup_ring(long param) {
+  init_mailbox(&benchRing, NULL, param);
+  benchRing.counted = 1;
+  benchMessage = create_message("hello", 5);
+}
+
+static long run_ring(long param) {
+  long i;
+  long r;
+  const long rounds = 1000000 / param + 1;
+
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < param; i++) {
+      mailbox_put(&benchRing, benchMessage);
+    }
+    benchSink += benchRing.count;
+    mailbox_drop(&benchRing, benchRing.count);
+  }
+  return rounds * param;
+}
+
+static void teardown_ring() {
+  free_mailbox(&benchRing);
+  release_message(benchMessage);
+}
+
+/* Topics: one message published to param subscribers, each of which then
+ * receives it. Reports time per delivery. */
+
+static void setup_topic(long param) {
+  long s;
+
+  init_mailbox(&benchTopic, NULL, 64);
+  benchTopic.counted = 1;
+  topic_init(&benchTopic, TOPIC_BLOCK);
+  for (s = 0; s < param; s++) {
+    topic_subscribe(&benchTopic, s);
+  }
+  benchMessage = create_message("hello", 5);
+}
+
+static long run_topic(long param) {
+  long i;
+  long s;
+  const long rounds = 1000000 / param + 1;
+
+  for (i = 0; i < rounds; i++) {
+    topic_publish(&benchTopic, benchMessage);
+    for (s = 0; s < param; s++) {
+      benchSink += topic_receive(&benchTopic, s, topic_unread(&benchTopic, s));
+    }
+  }
+  return rounds * param;
+}
+
+static void teardown_topic() {
+  free_mailbox(&benchTopic);
+  release_message(benchMessage);
+}
+
+/* Parser: read_string over param words and parse_process_file over a file of
+ * param processes. Both report time per input byte. */
+
+static void setup_words(long param) {
+  long i;
+  FILE *f;
+
+  f = open_memstream(&benchBuffer, &benchBufferSize);
+  for (i = 1; i <= param; i++) {
+    fprintf(f, "req R%ld%c", i, i % 8 == 0 ? '\n' : ' ');
+  }
+  fclose(f);
+}
+
+static long run_read_string(long param) {
+  char line[1024];
+  FILE *f = fmemopen(benchBuffer, benchBufferSize, "r");
+
+  (void)param;
+  while (read_string(f, line) != 2) {
+    benchSink += line[0];
+  }
+  fclose(f);
+  return benchBufferSize;
+}
+
+static void teardown_words() {
+  free(benchBuffer);
+  benchBuffer = NULL;
+}
+
+static void setup_process_file(long param) {
+  long i;
+  int fd;
+  FILE *f;
+
+  strcpy(benchFile, "/tmp/procsched-micro-XXXXXX");
+  fd = mkstemp(benchFile);
+  f = fdopen(fd, "w");
+
+  fprintf(f, "Processes");
+  for (i = 1; i <= param; i++) {
+    fprintf(f, " P%ld", i);
+  }
+  fprintf(f, "\nResources R1 R2 R3 R4\nMailboxes M1 M2\n");
+  for (i = 1; i <= param; i++) {
+    fprintf(f, "\nProcess P%ld\nreq R%ld\nreq R4\nsend (M1, hello)\n"
+               "rel R4\nrecv (M1, msg)\nrel R%ld\n",
+            i, i % 3 + 1, i % 3 + 1);
+  }
+  benchBufferSize = ftell(f);
+  fclose(f);
+}
+
+static long run_parse_process_file(long param) {
+  (void)param;
+  simulator_init(&benchSim);
+  parse_process_file(&benchSim, benchFile);
+  simulator_free(&benchSim);
+  return benchBufferSize;
+}
+
+static void teardown_process_file() {
+  unlink(benchFile);
+}
+
+static struct benchmark benchmarks[] = {
+    {"enqueue+dequeue", 1, "op", setup_queue, run_queue, teardown_queue},
+    {"enqueue+dequeue", 1000, "op", setup_queue, run_queue, teardown_queue},
+    {"is_resource_available", 4, "op", setup_resources,
+     run_is_resource_available, teardown_resources},
+    {"is_resource_available", 64, "op", setup_resources,
+     run_is_resource_available, teardown_resources},
+    {"is_resource_available", 1024, "op", setup_resources,
+     run_is_resource_available, teardown_resources},
+    {"acquire+release_resource", 4, "op", setup_resources,
+     run_acquire_release, teardown_resources},
+    {"acquire+release_resource", 64, "op", setup_resources,
+     run_acquire_release, teardown_resources},
+    {"acquire+release_resource", 1024, "op", setup_resources,
+     run_acquire_release, teardown_resources},
+    {"acquire+release_resource", 100000, "op", setup_resources,
+     run_acquire_release, teardown_resources},
+    {"acquire+release_fifo", 4, "op", setup_pool, run_acquire_release_fifo,
+     teardown_pool},
+    {"acquire+release_fifo", 64, "op", setup_pool, run_acquire_release_fifo,
+     teardown_pool},
+    {"acquire+release_fifo", 1024, "op", setup_pool,
+     run_acquire_release_fifo, teardown_pool},
+    {"find_mailbox", 4, "op", setup_mailboxes, run_find_mailbox,
+     teardown_mailboxes},
+    {"find_mailbox", 64, "op", setup_mailboxes, run_find_mailbox,
+     teardown_mailboxes},
+    {"find_mailbox", 1024, "op", setup_mailboxes, run_find_mailbox,
+     teardown_mailboxes},
+    {"mailbox_put+drain", 1, "op", setup_ring, run_ring, teardown_ring},
+    {"mailbox_put+drain", 1024, "op", setup_ring, run_ring, teardown_ring},
+    {"topic_publish+receive", 1, "delivery", setup_topic, run_topic,
+     teardown_topic},
+    {"topic_publish+receive", 64, "delivery", setup_topic, run_topic,
+     teardown_topic},
+    {"read_string", 1000, "byte", setup_words, run_read_string,
+     teardown_words},
+    {"read_string", 100000, "byte", setup_words, run_read_string,
+     teardown_words},
+    {"parse_process_file", 10, "byte", setup_process_file,
+     run_parse_process_file, teardown_process_file},
+    {"parse_process_file", 1000, "byte", setup_process_file,
+     run_parse_process_file, teardown_process_file},
+};
+
+/**
+ * @brief Returns the two sided 95% Student t value for n - 1 degrees of
+ * freedom.
+ */
+static double t_value(int n) {
+  static const double table[] = {0,     12.706, 4.303, 3.182, 2.776, 2.571,
+                                 2.447, 2.365,  2.306, 2.262, 2.228, 2.201,
+                                 2.179, 2.160,  2.145, 2.131, 2.120, 2.110,
+                                 2.101, 2.093,  2.086, 2.080, 2.074, 2.069,
+                                 2.064, 2.060,  2.056, 2.052, 2.048, 2.045};
+
+  if (n - 1 < (int)(sizeof(table) / sizeof(table[0]))) {
+    return table[n - 1];
+  }
+  return 1.96;
+}
+
+/**
+ * @brief Runs one benchmark and prints its mean time per operation.
+ */
+static void run_benchmark(struct benchmark *b, int warmup, int repetitions,
+                          FILE *csv) {
+  double *samples = malloc(sizeof(double) * repetitions);
+  double mean = 0, variance = 0, ci, start;
+  long ops;
+  int i;
+
+  b->setup(b->param);
+
+  for (i = 0; i < warmup; i++) {
+    b->run(b->param);
+  }
+
+  for (i = 0; i < repetitions; i++) {
+    start = now_ns();
+    ops = b->run(b->param);
+    samples[i] = (now_ns() - start) / ops;
+    mean += samples[i];
+  }
+  mean /= repetitions;
+
+  for (i = 0; i < repetitions; i++) {
+    variance += (samples[i] - mean) * (samples[i] - mean);
+  }
+  variance = repetitions > 1 ? variance / (repetitions - 1) : 0;
+  ci = repetitions > 1 ? t_value(repetitions) * sqrt(variance / repetitions)
+                       : 0;
+
+  b->teardown();
+
+  printf("%-26s %8ld %12.3f ns/%-4s +- %.3f\n", b->name, b->param, mean,
+         b->unit, ci);
+  if (csv != NULL) {
+    fprintf(csv, "%s,%ld,%s,%.3f,%.3f,%d\n", b->name, b->param, b->unit, mean,
+            ci, repetitions);
+  }
+  free(samples);
+}
+
+int main(int argc, char **argv) {
+  int warmup = 3;
+  int repetitions = 20;
+  int cpu = -1;
+  char *filter = NULL;
+  FILE *csv = NULL;
+  cpu_set_t set;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w:r:c:f:o:")) != -1) {
+    switch (opt) {
+    case 'w':
+      warmup = atoi(optarg);
+      break;
+    case 'r':
+      repetitions = atoi(optarg) > 0 ? atoi(optarg) : 1;
+      break;
+    case 'c':
+      cpu = atoi(optarg);
+      break;
+    case 'f':
+      filter = optarg;
+      break;
+    case 'o':
+      csv = fopen(optarg, "w");
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-w warmup] [-r repetitions] [-c cpu] "
+                      "[-f filter] [-o csv]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (cpu >= 0) {
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      perror("sched_setaffinity");
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (csv != NULL) {
+    fprintf(csv, "benchmark,param,unit,ns_per_op,ci95,repetitions\n");
+  }
+
+  printf("%d warmup, %d measured repetitions, cpu %d\n", warmup, repetitions,
+         cpu);
+  for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    if (filter == NULL || strstr(benchmarks[i].name, filter) != NULL) {
+      run_benchmark(&benchmarks[i], warmup, repetitions, csv);
+    }
+  }
+
+  if (csv != NULL) {
+    fclose(csv);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+/**
+ * @file batch.c
+ */
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "batch.h"
+#include "pool.h"
+#include "procsched.h"
+
+/**
+ * The configuration shared by the jobs of one batch_run.
+ */
+struct batchRun {
+  struct batch *batch;
+  int scheduleAlg;
+  int quantum;
+};
+
+static void add_file(struct batch *b, const char *filename);
+static int add_list(struct batch *b, const char *listname);
+static void run_file(int i, int worker, void *arg);
+
+/**
+ * @brief Initialises an empty batch.
+ *
+ * @param b The batch to initialise.
+ */
+void batch_init(struct batch *b) {
+  b->results = NULL;
+  b->count = 0;
+  b->capacity = 0;
+}
+
+/**
+ * @brief Adds the files named by a command line argument.
+ *
+ * An argument starting with @ names a file listing one path per line. An
+ * argument containing a glob character is expanded with glob(3), which lets
+ * a pattern select more files than fit on a command line. Anything else is a
+ * path.
+ *
+ * @param b The batch.
+ * @param arg The argument.
+ *
+ * @return The number of files added.
+ */
+int batch_add(struct batch *b, const char *arg) {
+  glob_t matches;
+  size_t i;
+  int added;
+
+  if (arg[0] == '@') {
+    return add_list(b, arg + 1);
+  }
+
+  if (strpbrk(arg, "*?[") == NULL) {
+    add_file(b, arg);
+    return 1;
+  }
+
+  if (glob(arg, 0, NULL, &matches) != 0) {
+    return 0;
+  }
+  for (i = 0; i < matches.gl_pathc; i++) {
+    add_file(b, matches.gl_pathv[i]);
+  }
+  added = (int)matches.gl_pathc;
+  globfree(&matches);
+
+  return added;
+}
+
+/**
+ * @brief Schedules every file of the batch.
+ *
+ * Every file is loaded into its own simulator, so the runs share no state
+ * and the trace is suppressed. The results are stored in the batch in the
+ * order the files were added, whichever thread ran them.
+ *
+ * @param b The batch.
+ * @param threads The number of threads.
+ * @param schedule_alg PROCSCHED_FCFS, PROCSCHED_RR, PROCSCHED_PRIORITY,
+ * PROCSCHED_EDF or PROCSCHED_RM.
+ * @param quantum The round robin time slice.
+ */
+void batch_run(struct batch *b, int threads, int schedule_alg, int quantum) {
+  struct batchRun run;
+
+  run.batch = b;
+  run.scheduleAlg = schedule_alg;
+  run.quantum = quantum;
+
+  pool_run(b->count, threads, run_file, &run);
+}
+
+/**
+ * @brief Writes the results as a CSV table with a header line.
+ *
+ * @param out The stream to write to.
+ * @param b The batch.
+ */
+void batch_print(FILE *out, struct batch *b) {
+  struct batchResult *r;
+  int i;
+
+  fprintf(out, "file,status,processes,terminated,deadlock_victims,"
+               "instructions,waits,slices,schedule_s,jobs,deadline_misses\n");
+  for (i = 0; i < b->count; i++) {
+    r = &b->results[i];
+    if (r->status != 0) {
+      fprintf(out, "%s,load_error,,,,,,,,,\n", r->filename);
+      continue;
+    }
+    fprintf(out, "%s,ok,%d,%d,%d,%lld,%lld,%lld,%.6f,%lld,%lld\n",
+            r->filename, r->stats.processes, r->stats.terminated,
+            r->stats.deadlockVictims, r->stats.instructions, r->stats.waits,
+            r->stats.slices, r->seconds, r->stats.jobs,
+            r->stats.deadlineMisses);
+  }
+}
+
+/**
+ * @brief Frees the batch and leaves it empty.
+ *
+ * @param b The batch.
+ */
+void batch_free(struct batch *b) {
+  int i;
+
+  for (i = 0; i < b->count; i++) {
+    free(b->results[i].filename);
+  }
+  free(b->results);
+  batch_init(b);
+}
+
+/**
+ * @brief Appends a file to the batch.
+ */
+static void add_file(struct batch *b, const char *filename) {
+  struct batchResult *r;
+
+  if (b->count == b->capacity) {
+    b->capacity = b->capacity == 0 ? 64 : 2 * b->capacity;
+    b->results = realloc(b->results, sizeof(struct batchResult) * b->capacity);
+  }
+
+  r = &b->results[b->count++];
+  r->filename = malloc(strlen(filename) + 1);
+  strcpy(r->filename, filename);
+  r->status = -1;
+  memset(&r->stats, 0, sizeof(r->stats));
+  r->seconds = 0;
+}
+
+/**
+ * @brief Appends the files listed one per line in listname.
+ *
+ * @return The number of files added.
+ */
+static int add_list(struct batch *b, const char *listname) {
+  FILE *list = strcmp(listname, "-") == 0 ? stdin : fopen(listname, "r");
+  char line[4096];
+  size_t length;
+  int added = 0;
+
+  if (list == NULL) {
+    return 0;
+  }
+
+  while (fgets(line, sizeof(line), list) != NULL) {
+    length = strcspn(line, "\r\n");
+    line[length] = '\0';
+    if (length > 0) {
+      add_file(b, line);
+      ++added;
+    }
+  }
+
+  if (list != stdin) {
+    fclose(list);
+  }
+  return added;
+}
+
+/**
+ * @brief Loads and schedules the i-th file of the batch.
+ *
+ * @param i The number of the file.
+ * @param worker The thread running the job, unused.
+ * @param arg The batchRun.
+ */
+static void run_file(int i, int worker, void *arg) {
+  struct batchRun *run = arg;
+  struct batchResult *r = &run->batch->results[i];
+  struct simulator *sim = procsched_create();
+  struct timespec start, end;
+
+  (void)worker;
+  if (sim == NULL) {
+    return;
+  }
+  procsched_set_trace(sim, NULL);
+
+  if (procsched_load_file(sim, r->filename) == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    procsched_run(sim, run->scheduleAlg, run->quantum);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    procsched_get_stats(sim, &r->stats);
+    r->seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    r->status = 0;
+  }
+
+  procsched_destroy(sim);
+}
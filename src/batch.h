@@ -0,0 +1,67 @@
+/**
+  * @file batch.h
+  * @description A definition of the batch mode, which schedules many process
+  *              list files in parallel and collects the results in one
+  *              table.
+  */
+
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stdio.h>
+
+#include "procsched.h"
+
+/**
+ * The outcome of scheduling one file.
+ */
+struct batchResult {
+  /** The path of the process list */
+  char *filename;
+  /** 0 if the file was scheduled, -1 if it could not be loaded */
+  int status;
+  /** The statistics of the simulation */
+  struct procschedStats stats;
+  /** The wall time spent scheduling */
+  double seconds;
+};
+
+/**
+ * The files of a batch and, after batch_run, their results.
+ */
+struct batch {
+  /** One result per file, in the order the files were added */
+  struct batchResult *results;
+  /** The number of files */
+  int count;
+  /** The number of results there is room for */
+  int capacity;
+};
+
+/*
+ * Initialises an empty batch.
+ */
+void batch_init(struct batch *b);
+
+/*
+ * Adds the files named by arg: a path, a glob pattern, or @list for a file
+ * holding one path per line. Returns the number of files added.
+ */
+int batch_add(struct batch *b, const char *arg);
+
+/*
+ * Schedules every file on threads threads.
+ */
+void batch_run(struct batch *b, int threads, int schedule_alg, int quantum);
+
+/*
+ * Writes the results as a CSV table.
+ */
+void batch_print(FILE *out, struct batch *b);
+
+/*
+ * Frees the batch.
+ */
+void batch_free(struct batch *b);
+
+#endif
@@ -0,0 +1,797 @@
+/**
+ * @file checkpoint.c
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "loader.h"
+#include "manager.h"
+#include "names.h"
+#include "pager.h"
+#include "procsched.h"
+#include "queue.h"
+#include "simulator.h"
+#include "table.h"
+#include "topic.h"
+
+static void write_queue(FILE *fptr, struct processTable *t, struct queue *q);
+static int read_queue(FILE *fptr, struct processTable *t, struct queue *q,
+                      unsigned char state, unsigned char *queued);
+static int read_messages(FILE *fptr, struct simulator *sim);
+static int read_subscribers(FILE *fptr, struct simulator *sim,
+                            struct mailbox *mail);
+static int read_u32(FILE *fptr, uint32_t *value);
+
+/**
+ * @brief Writes the state of a simulator to a checkpoint.
+ *
+ * The checkpoint is written to a temporary file next to filename that then
+ * replaces filename, so a crash while writing leaves the previous
+ * checkpoint intact.
+ *
+ * @param sim A simulator with loaded processes, between time slices.
+ * @param filename The path of the checkpoint.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int checkpoint_write(struct simulator *sim, const char *filename) {
+  char *temporary;
+  FILE *fptr;
+  int status;
+
+  if (!sim->compiled) {
+    return -1;
+  }
+
+  temporary = malloc(strlen(filename) + sizeof(".tmp"));
+  if (temporary == NULL) {
+    return -1;
+  }
+  strcpy(temporary, filename);
+  strcat(temporary, ".tmp");
+
+  fptr = fopen(temporary, "wb");
+  if (fptr == NULL) {
+    free(temporary);
+    return -1;
+  }
+
+  status = checkpoint_save(sim, fptr);
+  if (fclose(fptr) != 0) {
+    status = -1;
+  }
+  if (status == 0 && rename(temporary, filename) != 0) {
+    status = -1;
+  }
+  if (status != 0) {
+    remove(temporary);
+  }
+  free(temporary);
+
+  return status;
+}
+
+/**
+ * @brief Writes the state of a simulator to a stream.
+ *
+ * Between time slices no process is running and every process is in exactly
+ * one queue, so the queues are saved as lists and the links of the process
+ * table are rebuilt from them on restore.
+ *
+ * @param sim A simulator with loaded processes, between time slices.
+ * @param fptr The stream, which is left open.
+ *
+ * @return 0 on success, -1 if writing failed.
+ */
+int checkpoint_save(struct simulator *sim, FILE *fptr) {
+  struct processTable *t = &sim->table;
+  struct checkpointHeader header;
+  struct nameTable resourceNames;
+  struct resourceList *held;
+  struct mailbox *mail;
+  uint32_t value;
+  uint32_t hold[3];
+  int32_t priority;
+  int64_t stats[6];
+  int p;
+  int i;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.scheduleAlg = sim->scheduleAlg;
+  header.quantum = sim->quantum;
+  header.processes = t->count;
+  header.resources = sim->resourceCount;
+  header.mailboxes = sim->mailboxCount;
+  header.fingerprint = checkpoint_fingerprint(sim);
+  header.instructionsExecuted = sim->instructionsExecuted;
+  header.deadlockVictims = sim->deadlockVictims;
+  header.rwPolicy = sim->rwPolicy;
+  header.idle = sim->idle;
+  header.horizon = sim->horizon;
+  fwrite(&header, sizeof(header), 1, fptr);
+
+  fwrite(t->state, sizeof(unsigned char), t->count, fptr);
+  for (p = 0; p < t->count; p++) {
+    value = pager_index(sim, p);
+    fwrite(&value, sizeof(value), 1, fptr);
+  }
+  for (p = 0; p < t->count; p++) {
+    priority = t->priority[p];
+    fwrite(&priority, sizeof(priority), 1, fptr);
+  }
+  for (p = 0; p < t->count; p++) {
+    stats[0] = t->pcb[p]->stats.executed;
+    stats[1] = t->pcb[p]->stats.waits;
+    stats[2] = t->pcb[p]->stats.slices;
+    stats[3] = t->pcb[p]->stats.jobs;
+    stats[4] = t->pcb[p]->stats.missed;
+    stats[5] = t->pcb[p]->stats.worstResponse;
+    fwrite(stats, sizeof(stats), 1, fptr);
+  }
+  for (p = 0; t->timed && p < t->count; p++) {
+    stats[0] = t->release[p];
+    stats[1] = t->deadline[p];
+    fwrite(stats, sizeof(int64_t), 2, fptr);
+  }
+  for (p = 0; p < t->count; p++) {
+    value = t->loops[p].depth;
+    fwrite(&value, sizeof(value), 1, fptr);
+    fwrite(t->loops[p].counters, sizeof(int32_t), t->loops[p].depth, fptr);
+  }
+
+  write_queue(fptr, t, &t->readyQueue);
+  write_queue(fptr, t, &t->terminatedQueue);
+  for (i = 0; i <= t->waitQueueCount; i++) {
+    write_queue(fptr, t, &t->waitQueues[i]);
+  }
+  for (i = 0; i < t->barrierCount; i++) {
+    write_queue(fptr, t, &t->syncQueues[i]);
+  }
+  if (t->timed) {
+    value = t->timerCount;
+    fwrite(&value, sizeof(value), 1, fptr);
+    for (i = 0; i < t->timerCount; i++) {
+      value = t->timers[i];
+      fwrite(&value, sizeof(value), 1, fptr);
+    }
+  }
+  for (i = 0; i < t->barrierCount; i++) {
+    stats[0] = t->generations[i];
+    fwrite(stats, sizeof(int64_t), 1, fptr);
+  }
+  fwrite(t->released, sizeof(unsigned char), t->count, fptr);
+
+  for (i = 0; i < sim->resourceCount; i++) {
+    hold[0] = sim->resourceTable[i]->available;
+    hold[1] = sim->resourceTable[i]->readers;
+    hold[2] = sim->resourceTable[i]->wokenReaders;
+    fwrite(hold, sizeof(hold), 1, fptr);
+  }
+
+  /* An acquired instance is saved as the number of its resource, whose name
+   * is unique once the tables are compiled */
+  names_init(&resourceNames, sim->resourceCount);
+  for (i = 0; i < sim->resourceCount; i++) {
+    names_insert(&resourceNames, sim->resourceTable[i]->name, i);
+  }
+  value = 0;
+  for (p = 0; p < t->count; p++) {
+    for (held = t->pcb[p]->resourceListPtr; held != NULL; held = held->next) {
+      ++value;
+    }
+  }
+  fwrite(&value, sizeof(value), 1, fptr);
+  for (p = 0; p < t->count; p++) {
+    for (held = t->pcb[p]->resourceListPtr; held != NULL; held = held->next) {
+      hold[0] = p;
+      hold[1] = names_find(&resourceNames, held->name);
+      hold[2] = held->readers;
+      fwrite(hold, sizeof(hold), 1, fptr);
+    }
+  }
+  names_free(&resourceNames);
+
+  for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+    value = mail->count;
+    fwrite(&value, sizeof(value), 1, fptr);
+    for (i = 0; i < mail->count; i++) {
+      value = mailbox_message(mail, i)->length;
+      fwrite(&value, sizeof(value), 1, fptr);
+      fwrite(mailbox_message(mail, i)->text, 1, value, fptr);
+    }
+    if (mail->topic != NULL) {
+      stats[0] = mail->topic->published;
+      fwrite(stats, sizeof(int64_t), 1, fptr);
+      value = mail->topic->count;
+      fwrite(&value, sizeof(value), 1, fptr);
+      for (i = 0; i < mail->topic->count; i++) {
+        hold[0] = mail->topic->subscribers[i].process;
+        hold[1] = topic_unread(mail, i);
+        fwrite(hold, sizeof(uint32_t), 2, fptr);
+      }
+    }
+  }
+
+  return ferror(fptr) ? -1 : 0;
+}
+
+/**
+ * @brief Restores the state saved in a checkpoint.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the checkpoint.
+ * @param schedule_alg Set to the scheduling algorithm of the saved run.
+ * @param quantum Set to the time slice of the saved run.
+ *
+ * @return 0 on success, -1 on failure. The simulator is reset on failure.
+ */
+int checkpoint_restore(struct simulator *sim, const char *filename,
+                       int *schedule_alg, int *quantum) {
+  FILE *fptr;
+  int status;
+
+  fptr = fopen(filename, "rb");
+  if (fptr == NULL) {
+    return -1;
+  }
+  status = checkpoint_load(sim, fptr, schedule_alg, quantum);
+  fclose(fptr);
+
+  return status;
+}
+
+/**
+ * @brief Restores the state saved in a checkpoint from a stream.
+ *
+ * The simulator must hold the workload the checkpoint was taken of, loaded
+ * from the same process list or an image of it; this is checked with a
+ * fingerprint of the compiled programs. Every process number, op index and
+ * resource number is checked, and every process must be in the queue its
+ * state belongs to, so the scheduler can continue exactly where the saved
+ * run stopped. A message in a mailbox is restored to the message of a send
+ * op with the same text.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param fptr The stream, positioned at the checkpoint and left open after
+ * it.
+ * @param schedule_alg Set to the scheduling algorithm of the saved run.
+ * @param quantum Set to the time slice of the saved run.
+ *
+ * @return 0 on success, -1 if the checkpoint could not be read, is corrupt
+ * or belongs to a different workload. The simulator is reset on failure.
+ */
+int checkpoint_load(struct simulator *sim, FILE *fptr, int *schedule_alg,
+                    int *quantum) {
+  struct processTable *t = &sim->table;
+  struct checkpointHeader header;
+  struct resourceList *resource;
+  uint32_t(*holds)[3] = NULL;
+  void *grown;
+  uint32_t holdCapacity = 0;
+  struct resourceList *held;
+  unsigned char *queued = NULL;
+  struct op *op;
+  uint32_t value;
+  uint32_t hold[3];
+  uint32_t count;
+  int32_t priority;
+  int64_t stats[6];
+  int status = -1;
+  int p;
+  int i;
+
+  if (procsched_reset(sim) != 0) {
+    return -1;
+  }
+
+  if (fread(&header, sizeof(header), 1, fptr) != 1 ||
+      memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != CHECKPOINT_VERSION ||
+      header.processes != (uint32_t)t->count ||
+      header.resources != (uint32_t)sim->resourceCount ||
+      header.mailboxes != (uint32_t)sim->mailboxCount ||
+      header.fingerprint != checkpoint_fingerprint(sim) ||
+      (header.rwPolicy != PROCSCHED_WRITER_PREFERRING &&
+       header.rwPolicy != PROCSCHED_FAIR) ||
+      header.idle < 0 || header.horizon < 0 ||
+      (t->timed && header.horizon == 0)) {
+    goto done;
+  }
+
+  if (fread(t->state, sizeof(unsigned char), t->count, fptr) !=
+      (size_t)t->count) {
+    goto done;
+  }
+  for (p = 0; p < t->count; p++) {
+    /* A sleeping process starts its next job at its first op */
+    if (!read_u32(fptr, &value) || t->state[p] < READY ||
+        t->state[p] > SLEEPING || t->state[p] == RUNNING ||
+        (t->state[p] == SLEEPING &&
+         (value != 0 || t->pcb[p]->pagePtr->period == 0))) {
+      goto done;
+    }
+    /* The index must lie inside the program, at its END_V op at most. The
+     * loops opened before the op are the loops the process is inside of */
+    for (i = 0; (uint32_t)i < value; i++) {
+      op = pager_op(sim, p, i);
+      if (op->type == END_V) {
+        goto done;
+      }
+      t->loops[p].depth += op->type == REPEAT_V;
+      t->loops[p].depth -= op->type == LOOP_V;
+    }
+    t->nextOp[p] = pager_op(sim, p, i);
+  }
+  for (p = 0; p < t->count; p++) {
+    /* A resource can only raise a process above its base priority */
+    if (fread(&priority, sizeof(priority), 1, fptr) != 1 ||
+        priority < t->pcb[p]->pagePtr->priority) {
+      goto done;
+    }
+    t->priority[p] = priority;
+  }
+  for (p = 0; p < t->count; p++) {
+    if (fread(stats, sizeof(stats), 1, fptr) != 1) {
+      goto done;
+    }
+    t->pcb[p]->stats.executed = stats[0];
+    t->pcb[p]->stats.waits = stats[1];
+    t->pcb[p]->stats.slices = stats[2];
+    t->pcb[p]->stats.jobs = stats[3];
+    t->pcb[p]->stats.missed = stats[4];
+    t->pcb[p]->stats.worstResponse = stats[5];
+    if (stats[4] < 0 || stats[4] > stats[3] || stats[5] < 0) {
+      goto done;
+    }
+  }
+  for (p = 0; t->timed && p < t->count; p++) {
+    if (fread(stats, sizeof(int64_t), 2, fptr) != 2 || stats[0] < 0) {
+      goto done;
+    }
+    t->release[p] = stats[0];
+    t->deadline[p] = stats[1];
+  }
+  for (p = 0; p < t->count; p++) {
+    if (!read_u32(fptr, &value) || value != (uint32_t)t->loops[p].depth ||
+        fread(t->loops[p].counters, sizeof(int32_t), value, fptr) != value) {
+      goto done;
+    }
+    for (i = 0; i < t->loops[p].depth; i++) {
+      if (t->loops[p].counters[i] < 1) {
+        goto done;
+      }
+    }
+  }
+
+  queued = calloc(t->count, sizeof(unsigned char));
+  if (queued == NULL) {
+    goto done;
+  }
+  if (read_queue(fptr, t, &t->readyQueue, READY, queued) != 0 ||
+      read_queue(fptr, t, &t->terminatedQueue, TERMINATED, queued) != 0) {
+    goto done;
+  }
+  for (i = 0; i <= t->waitQueueCount; i++) {
+    if (read_queue(fptr, t, &t->waitQueues[i], WAITING, queued) != 0) {
+      goto done;
+    }
+    /* A process waits in the queue of the resource or mailbox of its next
+     * op */
+    for (p = t->waitQueues[i].head; p != -1; p = t->next[p]) {
+      op = pager_next_op(sim, p);
+      if ((op->type != REQ_V && op->type != REQS_V &&
+           op->type != REQSET_V && op->type != SEND_V &&
+           op->type != RECV_V && op->type != DRAIN_V) ||
+          wait_queue_of(t, op) != &t->waitQueues[i]) {
+        goto done;
+      }
+      t->waitSet[p] = op->operand;
+    }
+    t->waiting += t->waitQueues[i].n;
+  }
+  /* A barrier releases its processes as soon as the last party arrives */
+  for (i = 0; i < t->barrierCount; i++) {
+    if (read_queue(fptr, t, &t->syncQueues[i], WAITING, queued) != 0 ||
+        t->syncQueues[i].n >= sim->barriers[i].parties) {
+      goto done;
+    }
+    for (p = t->syncQueues[i].head; p != -1; p = t->next[p]) {
+      op = pager_next_op(sim, p);
+      if (op->type != SYNC_V || op->operand != i) {
+        goto done;
+      }
+    }
+    t->waiting += t->syncQueues[i].n;
+  }
+  /* The timers are rebuilt from the sleeping processes, in any order */
+  t->timerCount = 0;
+  if (t->timed && (!read_u32(fptr, &count) || count > (uint32_t)t->count)) {
+    goto done;
+  }
+  for (; t->timed && count > 0; count--) {
+    if (!read_u32(fptr, &value) || value >= (uint32_t)t->count ||
+        queued[value] || t->state[value] != SLEEPING) {
+      goto done;
+    }
+    queued[value] = 1;
+    table_timer_push(t, value);
+  }
+  for (p = 0; p < t->count; p++) {
+    if (!queued[p]) {
+      goto done;
+    }
+  }
+  for (i = 0; i < t->barrierCount; i++) {
+    if (fread(stats, sizeof(int64_t), 1, fptr) != 1 || stats[0] < 0) {
+      goto done;
+    }
+    t->generations[i] = stats[0];
+  }
+  if (fread(t->released, sizeof(unsigned char), t->count, fptr) !=
+      (size_t)t->count) {
+    goto done;
+  }
+  /* Only a ready process about to pass its barrier can be released */
+  for (p = 0; p < t->count; p++) {
+    if (t->released[p] == 0) {
+      continue;
+    }
+    op = pager_next_op(sim, p);
+    if (t->released[p] > 1 || t->state[p] != READY || op->type != SYNC_V ||
+        op->operand < 0) {
+      goto done;
+    }
+  }
+
+  for (i = 0; i < sim->resourceCount; i++) {
+    if (fread(hold, sizeof(hold), 1, fptr) != 1 ||
+        hold[0] > (uint32_t)sim->resourceTable[i]->capacity ||
+        hold[1] > INT_MAX || hold[2] > (uint32_t)t->count) {
+      goto done;
+    }
+    sim->resourceTable[i]->available = hold[0];
+    sim->resourceTable[i]->readers = hold[1];
+    sim->resourceTable[i]->wokenReaders = hold[2];
+  }
+  refresh_available_bits(sim);
+
+  if (!read_u32(fptr, &count)) {
+    goto done;
+  }
+  for (value = 0; value < count; value++) {
+    if (value == holdCapacity) {
+      holdCapacity = holdCapacity == 0 ? 64 : 2 * holdCapacity;
+      if ((grown = realloc(holds, sizeof(hold) * holdCapacity)) == NULL) {
+        goto done;
+      }
+      holds = grown;
+    }
+    if (fread(holds[value], sizeof(hold), 1, fptr) != 1 ||
+        holds[value][0] >= (uint32_t)t->count ||
+        holds[value][1] >= (uint32_t)sim->resourceCount ||
+        holds[value][2] > 1) {
+      goto done;
+    }
+  }
+  /* The instances of each process were saved newest first and link_holder
+   * makes every instance the newest, so they are linked oldest first */
+  while (value > 0) {
+    --value;
+    resource = sim->resourceTable[holds[value][1]];
+    held = link_holder(t->pcb[holds[value][0]], resource);
+    held->readers = holds[value][2];
+  }
+
+  if (read_messages(fptr, sim) != 0) {
+    goto done;
+  }
+
+  sim->instructionsExecuted = header.instructionsExecuted;
+  sim->idle = header.idle;
+  sim->horizon = header.horizon;
+  sim->deadlockVictims = header.deadlockVictims;
+  sim->scheduleAlg = header.scheduleAlg;
+  sim->quantum = header.quantum;
+  sim->rwPolicy = header.rwPolicy;
+  sim->nextCheckpoint = sim->instructionsExecuted + sim->checkpointEvery;
+  *schedule_alg = header.scheduleAlg;
+  *quantum = header.quantum;
+  status = 0;
+
+done:
+  free(queued);
+  free(holds);
+  if (status != 0) {
+    procsched_reset(sim);
+  }
+
+  return status;
+}
+
+/**
+ * @brief Writes a checkpoint if one is due.
+ *
+ * A checkpoint is due when checkpointEvery instructions have completed since
+ * the last one or when the request flag, e.g. set by a signal handler, is
+ * set. The scheduler only calls this between time slices, so a checkpoint
+ * is taken at the end of the slice in which it fell due.
+ *
+ * @param sim The running simulator.
+ */
+void checkpoint_poll(struct simulator *sim) {
+  int requested = sim->checkpointRequest != NULL && *sim->checkpointRequest;
+
+  if (!requested && (sim->checkpointEvery <= 0 ||
+                     sim->instructionsExecuted < sim->nextCheckpoint)) {
+    return;
+  }
+  if (requested) {
+    *sim->checkpointRequest = 0;
+  }
+
+  if (checkpoint_write(sim, sim->checkpointFile) != 0) {
+    fprintf(stderr, "Could not write checkpoint %s\n", sim->checkpointFile);
+  }
+  sim->nextCheckpoint = sim->instructionsExecuted + sim->checkpointEvery;
+}
+
+/**
+ * @brief Returns the fingerprint of the compiled programs.
+ *
+ * Hashes the number of processes, resources and mailboxes, the number of
+ * instances, protocol and ceiling of every resource, the capacity of every
+ * mailbox, the members of every resource set, the parties of every barrier
+ * and the base priority and timing of every process and the type and
+ * operand of every op with 64 bit FNV-1a. It is computed once per
+ * simulator.
+ *
+ * @param sim A simulator with loaded processes.
+ *
+ * @return The fingerprint, never 0.
+ */
+uint64_t checkpoint_fingerprint(struct simulator *sim) {
+  struct op *op;
+  uint64_t hash = 14695981039346656037ull;
+  int index;
+  int p;
+
+  if (sim->fingerprint != 0) {
+    return sim->fingerprint;
+  }
+
+#define MIX(value)                                                             \
+  do {                                                                         \
+    hash ^= (uint64_t)(uint32_t)(value);                                       \
+    hash *= 1099511628211ull;                                                  \
+  } while (0)
+
+  MIX(sim->table.count);
+  MIX(sim->resourceCount);
+  MIX(sim->mailboxCount);
+  for (index = 0; index < sim->resourceCount; index++) {
+    MIX(sim->resourceTable[index]->capacity);
+    MIX(sim->resourceTable[index]->protocol);
+    MIX(sim->resourceTable[index]->ceiling);
+  }
+  for (index = 0; index < sim->mailboxCount; index++) {
+    MIX(sim->mailboxTable[index]->capacity);
+    if (sim->mailboxTable[index]->topic != NULL) {
+      MIX(sim->mailboxTable[index]->topic->policy);
+    }
+  }
+  MIX(sim->resourceSetCount);
+  for (index = 0; index < sim->resourceSetCount; index++) {
+    for (p = 0; p < sim->resourceSets[index].count; p++) {
+      MIX(sim->resourceSets[index].members[p]);
+    }
+    MIX(-1);
+  }
+  MIX(sim->barrierCount);
+  for (index = 0; index < sim->barrierCount; index++) {
+    MIX(sim->barriers[index].parties);
+  }
+  for (p = 0; p < sim->table.count; p++) {
+    MIX(sim->table.pcb[p]->pagePtr->priority);
+    MIX(sim->table.pcb[p]->pagePtr->period);
+    MIX(sim->table.pcb[p]->pagePtr->deadline);
+    MIX(sim->table.pcb[p]->pagePtr->jitter);
+    index = 0;
+    do {
+      op = pager_op(sim, p, index++);
+      MIX(op->type);
+      MIX(op->operand);
+    } while (op->type != END_V);
+  }
+
+#undef MIX
+
+  sim->fingerprint = hash != 0 ? hash : 1;
+  return sim->fingerprint;
+}
+
+/**
+ * @brief Writes a queue as its length and its processes from head to tail.
+ */
+static void write_queue(FILE *fptr, struct processTable *t, struct queue *q) {
+  uint32_t value = q->n;
+  int p;
+
+  fwrite(&value, sizeof(value), 1, fptr);
+  for (p = q->head; p != -1; p = t->next[p]) {
+    value = p;
+    fwrite(&value, sizeof(value), 1, fptr);
+  }
+}
+
+/**
+ * @brief Reads a queue written by write_queue into an empty queue.
+ *
+ * @param state The state every process in the queue must have.
+ * @param queued Marks the processes already in a queue.
+ *
+ * @return 0 on success, -1 if a process is unknown, in the wrong state or in
+ * more than one queue.
+ */
+static int read_queue(FILE *fptr, struct processTable *t, struct queue *q,
+                      unsigned char state, unsigned char *queued) {
+  uint32_t count;
+  uint32_t p;
+
+  queue_init(q);
+  if (!read_u32(fptr, &count) || count > (uint32_t)t->count) {
+    return -1;
+  }
+  for (; count > 0; count--) {
+    if (!read_u32(fptr, &p) || p >= (uint32_t)t->count || queued[p] ||
+        t->state[p] != state) {
+      return -1;
+    }
+    queued[p] = 1;
+    enqueue(t, q, p);
+  }
+  return 0;
+}
+
+/**
+ * @brief Reads the messages of every mailbox.
+ *
+ * A saved text is replaced by the message of a send op with that text, so the
+ * restored mailboxes share the messages of the program as they would after
+ * sending them. The messages of the send ops are hashed once, when the first
+ * message is read.
+ *
+ * @return 0 on success, -1 if a mailbox holds more messages than it can or
+ * no send op has the message.
+ */
+static int read_messages(FILE *fptr, struct simulator *sim) {
+  struct processTable *t = &sim->table;
+  struct nameTable texts;
+  struct mailbox *mail;
+  struct op *op;
+  struct message **sent = NULL;
+  char *text = NULL;
+  uint32_t length;
+  uint32_t count;
+  int sends = -1;
+  int status = -1;
+  int found;
+  int p;
+  int i;
+
+  for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+    if (!read_u32(fptr, &count) || count > (uint32_t)mail->capacity) {
+      goto done;
+    }
+    for (; count > 0; count--) {
+      if (sends < 0) {
+        sends = 0;
+        for (p = 0; p < t->count; p++) {
+          for (i = 0; (op = pager_op(sim, p, i))->type != END_V; i++) {
+            sends += op->type == SEND_V && op->msg != NULL;
+          }
+        }
+        names_init(&texts, sends);
+        sent = malloc(sizeof(struct message *) * (sends + 1));
+        if (sent == NULL) {
+          goto done;
+        }
+        sends = 0;
+        for (p = 0; p < t->count; p++) {
+          for (i = 0; (op = pager_op(sim, p, i))->type != END_V; i++) {
+            if (op->type == SEND_V && op->msg != NULL) {
+              sent[sends] = op->msg;
+              names_insert(&texts, op->msg->text, sends++);
+            }
+          }
+        }
+      }
+
+      if (!read_u32(fptr, &length) || length == UINT32_MAX ||
+          (text = malloc(length + 1)) == NULL ||
+          fread(text, 1, length, fptr) != length) {
+        goto done;
+      }
+      text[length] = '\0';
+      found = names_find(&texts, text);
+      free(text);
+      text = NULL;
+      if (found < 0) {
+        goto done;
+      }
+      mailbox_put(mail, sent[found]);
+    }
+    if (mail->topic != NULL && read_subscribers(fptr, sim, mail) != 0) {
+      goto done;
+    }
+  }
+  status = 0;
+
+done:
+  free(text);
+  free(sent);
+  if (sends >= 0) {
+    names_free(&texts);
+  }
+  return status;
+}
+
+/**
+ * @brief Reads the subscribers of a topic whose messages were read.
+ *
+ * The pending count of each message is rebuilt from the cursors, so the
+ * subscribers keep their order and the topic its exact state.
+ *
+ * @return 0 on success, -1 if a subscriber is not a process, is listed
+ * twice or has not received more messages than the topic holds, or the
+ * oldest message is not pending for any subscriber.
+ */
+static int read_subscribers(FILE *fptr, struct simulator *sim,
+                            struct mailbox *mail) {
+  struct topic *topic = mail->topic;
+  int64_t published;
+  uint32_t hold[2];
+  uint32_t count;
+  uint32_t oldest = 0;
+  int s;
+  int i;
+
+  if (fread(&published, sizeof(published), 1, fptr) != 1 ||
+      published < mail->count || !read_u32(fptr, &count)) {
+    return -1;
+  }
+  topic->published = published;
+  if (mail->slots > 0) {
+    topic->pending = realloc(topic->pending, sizeof(int) * mail->slots);
+    for (i = 0; i < mail->count; i++) {
+      topic->pending[(mail->head + i) & (mail->slots - 1)] = 0;
+    }
+  }
+  for (; count > 0; count--) {
+    if (fread(hold, sizeof(hold), 1, fptr) != 1 ||
+        hold[0] >= (uint32_t)sim->table.count ||
+        hold[1] > (uint32_t)mail->count ||
+        (s = topic_subscribe(mail, hold[0])) < 0) {
+      return -1;
+    }
+    topic->subscribers[s].cursor -= hold[1];
+    for (i = mail->count - hold[1]; i < mail->count; i++) {
+      ++topic->pending[(mail->head + i) & (mail->slots - 1)];
+    }
+    oldest = hold[1] > oldest ? hold[1] : oldest;
+  }
+  return oldest == (uint32_t)mail->count ? 0 : -1;
+}
+
+/**
+ * @brief Reads one uint32_t.
+ *
+ * @return 1 on success, 0 at the end of the file.
+ */
+static int read_u32(FILE *fptr, uint32_t *value) {
+  return fread(value, sizeof(*value), 1, fptr) == 1;
+}
@@ -0,0 +1,115 @@
+/**
+  * @file checkpoint.h
+  * @description A definition of checkpoints, which save the complete state of
+  *              a running simulation so that it can be continued later.
+  */
+
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct simulator;
+
+/** The first bytes of every checkpoint */
+#define CHECKPOINT_MAGIC "PSCHDCKP"
+/** The version of the layout below, bumped on every incompatible change */
+#define CHECKPOINT_VERSION 10
+
+/**
+ * The header at the start of a checkpoint. It is followed by:
+ *
+ * - the state of every process (uint8_t), the index of its next op in its
+ *   program (uint32_t), its effective priority (int32_t) and its statistics
+ *   (six int64_t), each as one array indexed by the process number;
+ * - if a process is periodic, the release time and deadline of the job of
+ *   every process (two int64_t), indexed by the process number;
+ * - the loop stack of every process as a uint32_t depth followed by the
+ *   iterations left of each loop (int32_t), outermost first;
+ * - the ready queue, the terminated queue, every wait queue and the queue of
+ *   every barrier, each as a uint32_t length followed by the process numbers
+ *   from head to tail, and if a process is periodic the sleeping processes
+ *   in the same format;
+ * - the number of phases every barrier has completed (int64_t) and, for
+ *   every process, 1 if a barrier released it and it has not passed its
+ *   sync op yet, otherwise 0 (uint8_t);
+ * - the number of available instances, readers and woken readers of every
+ *   resource (three uint32_t);
+ * - the number of acquired resources (uint32_t) followed by a process
+ *   number, a resource number and 1 for a shared or 0 for an exclusive
+ *   hold (three uint32_t) for each, in the order of the process's list;
+ * - the messages of every mailbox as a uint32_t count followed by each
+ *   message from the oldest on, as a uint32_t length and the text, and for
+ *   a topic the number of messages sent to it (int64_t) and the number of
+ *   subscribers (uint32_t) followed by a process number and the number of
+ *   messages it has not received (two uint32_t) for each subscriber.
+ */
+struct checkpointHeader {
+  /** CHECKPOINT_MAGIC without the terminating 0 */
+  char magic[8];
+  /** CHECKPOINT_VERSION */
+  uint32_t version;
+  /** The scheduling algorithm of the run */
+  int32_t scheduleAlg;
+  /** The time slice of the run */
+  int32_t quantum;
+  /** The number of processes */
+  uint32_t processes;
+  /** The number of resources */
+  uint32_t resources;
+  /** The number of mailboxes */
+  uint32_t mailboxes;
+  /** Identifies the compiled workload the checkpoint belongs to */
+  uint64_t fingerprint;
+  /** The number of completed instructions */
+  int64_t instructionsExecuted;
+  /** The number of processes terminated to recover from a deadlock */
+  int32_t deadlockVictims;
+  /** The read-write policy of the run */
+  int32_t rwPolicy;
+  /** The ticks the scheduler was idle */
+  int64_t idle;
+  /** The horizon of the periodic processes */
+  int64_t horizon;
+};
+
+/*
+ * Writes the state of sim to filename, replacing it atomically. Returns 0 on
+ * success or -1 on failure.
+ */
+int checkpoint_write(struct simulator *sim, const char *filename);
+
+/*
+ * Restores the state saved in filename into sim, which must hold the same
+ * workload, and stores the algorithm and time slice of the saved run.
+ * Returns 0 on success or -1 on failure.
+ */
+int checkpoint_restore(struct simulator *sim, const char *filename,
+                       int *schedule_alg, int *quantum);
+
+/*
+ * Writes the state of sim to the stream fptr. Returns 0 on success or -1 on
+ * failure.
+ */
+int checkpoint_save(struct simulator *sim, FILE *fptr);
+
+/*
+ * Restores the state saved in the stream fptr, see checkpoint_restore.
+ */
+int checkpoint_load(struct simulator *sim, FILE *fptr, int *schedule_alg,
+                    int *quantum);
+
+/*
+ * Returns a hash of the compiled programs of sim, which identifies the
+ * workload a checkpoint or recording belongs to.
+ */
+uint64_t checkpoint_fingerprint(struct simulator *sim);
+
+/*
+ * Writes a checkpoint if one is due. Called by the scheduler between time
+ * slices.
+ */
+void checkpoint_poll(struct simulator *sim);
+
+#endif
@@ -0,0 +1,643 @@
+/**
+ * @file daemon.c
+ */
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "loader.h"
+#include "manager.h"
+#include "monitor.h"
+#include "names.h"
+#include "parser.h"
+#include "procsched.h"
+#include "program.h"
+#include "queue.h"
+#include "simulator.h"
+#include "syntax.h"
+#include "table.h"
+
+/* The kinds of input lines */
+#define LINE_EMPTY 0
+#define LINE_HEADER 1
+#define LINE_SECTION 2
+#define LINE_OTHER 3
+
+static void admit_sections(struct daemon *d);
+static size_t section_length(const char *text, size_t length, int eof);
+static int line_kind(const char *text, size_t length);
+static int line_depth(const char *text, size_t length);
+static size_t next_word(const char *text, size_t length, size_t *i);
+static void load_section(struct daemon *d, char *text, size_t length);
+static void load_header(struct daemon *d, char *text, size_t length);
+static void start(struct daemon *d);
+static void admit_process(struct daemon *d, struct simulator *staging);
+static void define_subroutines(struct daemon *d, struct simulator *staging);
+static void retire_terminated(struct daemon *d);
+static void retire(struct daemon *d, struct processControlBlock *pcb);
+static void report_live(struct daemon *d);
+static int read_input(struct daemon *d, int wait);
+static char *copy_word(const char *word, size_t length);
+
+/**
+ * @brief Initialises a daemon.
+ *
+ * @param d The daemon.
+ * @param sim The empty simulator to admit the processes to.
+ * @param path The path of the Unix domain socket to listen on, NULL to
+ * read stdin. A file at the path is replaced.
+ * @param limit The maximum number of live processes.
+ *
+ * @return 0 on success, -1 if the socket could not be created.
+ */
+int daemon_init(struct daemon *d, struct simulator *sim, const char *path,
+                int limit) {
+  struct sockaddr_un address;
+
+  d->sim = sim;
+  d->fd = STDIN_FILENO;
+  d->listenFd = -1;
+  d->path = path;
+  d->buffer = NULL;
+  d->length = 0;
+  d->capacity = 0;
+  d->eof = 0;
+  d->started = 0;
+  d->limit = limit > 0 ? limit : 1;
+  d->live = 0;
+  d->admitted = 0;
+  d->retired = 0;
+  d->stop = NULL;
+
+  if (path == NULL) {
+    return 0;
+  }
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    return -1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+
+  d->fd = -1;
+  d->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (d->listenFd == -1 ||
+      bind(d->listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(d->listenFd, 8) != 0) {
+    if (d->listenFd != -1) {
+      close(d->listenFd);
+    }
+    d->listenFd = -1;
+    d->path = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Admits and schedules processes as they arrive.
+ *
+ * Between time slices complete sections are admitted and terminated
+ * processes retired. The input is looked at every DAEMON_POLL_SLICES time
+ * slices while there is room for more live processes, and waited for when
+ * no process is ready. Input is only read once every complete section in
+ * the buffer was admitted, so the buffer holds at most one read more than a
+ * section. The trace is flushed and the counters published before waiting,
+ * so a reader of the trace or the monitor sees every time slice that ran.
+ * Connections to the socket are served one after the other. At the end of
+ * stdin processes still waiting are recovered from as a deadlock until
+ * every process terminated; processes still live when the stop flag ends
+ * the run are listed to stderr.
+ *
+ * @param d The daemon.
+ * @param schedule_alg PROCSCHED_FCFS, PROCSCHED_RR or PROCSCHED_PRIORITY.
+ * @param quantum The time slice.
+ *
+ * @return 0 when stdin ended or the stop flag was set, -1 if reading the
+ * input failed.
+ */
+int daemon_run(struct daemon *d, int schedule_alg, int quantum) {
+  struct simulator *sim = d->sim;
+  struct processTable *t = &sim->table;
+  int budget = INT_MAX;
+  int slices = 0;
+  int hungry;
+
+  if (schedule_alg == PROCSCHED_RR) {
+    budget = quantum > 0 ? quantum : 1;
+  } else if (schedule_alg == PROCSCHED_PRIORITY && quantum > 0) {
+    budget = quantum;
+  }
+  table_prioritize(t, schedule_alg == PROCSCHED_PRIORITY ? TABLE_BY_PRIORITY
+                                                        : 0);
+  sim->scheduleAlg = schedule_alg;
+  sim->quantum = quantum;
+
+  while (d->stop == NULL || !*d->stop) {
+    admit_sections(d);
+    /* Below the bound every complete section was admitted */
+    hungry = !d->eof && d->live < d->limit;
+
+    if (t->readyQueue.head != -1) {
+      schedule_slice(sim, budget);
+      if (t->terminatedQueue.head != -1) {
+        retire_terminated(d);
+      }
+      if (++slices == DAEMON_POLL_SLICES) {
+        slices = 0;
+        if (hungry && read_input(d, 0) != 0) {
+          return -1;
+        }
+      }
+      continue;
+    }
+
+    /* Nothing is ready and no process can arrive to release the waiting
+     * ones, so they are recovered from like at the end of a single run */
+    if (d->eof && d->listenFd == -1) {
+      if (t->waiting == 0) {
+        break;
+      }
+      recover_from_deadlock(sim);
+      retire_terminated(d);
+      continue;
+    }
+    if (sim->trace != NULL) {
+      fflush(sim->trace);
+    }
+    if (sim->monitor != NULL) {
+      monitor_publish(sim);
+    }
+    if (read_input(d, 1) != 0) {
+      return -1;
+    }
+  }
+
+  if (sim->trace != NULL) {
+    fflush(sim->trace);
+  }
+  retire_terminated(d);
+  if (d->live > 0) {
+    report_live(d);
+  }
+  sim->finished = 1;
+  if (sim->monitor != NULL) {
+    monitor_publish(sim);
+  }
+  return 0;
+}
+
+/**
+ * @brief Closes the input and frees the daemon.
+ *
+ * The processes that are still live are freed as well.
+ *
+ * @param d The daemon.
+ */
+void daemon_free(struct daemon *d) {
+  struct simulator *sim = d->sim;
+  struct processTable *t = &sim->table;
+  struct processControlBlock *pcb;
+  int i;
+
+  for (i = 0; i < t->count; i++) {
+    if ((pcb = t->pcb[i]) != NULL) {
+      table_remove(t, i);
+      dealloc_process(pcb);
+    }
+  }
+
+  if (d->started) {
+    names_free(&d->resourceNames);
+    names_free(&d->mailboxNames);
+  }
+  free(d->buffer);
+
+  if (d->listenFd != -1) {
+    if (d->fd != -1) {
+      close(d->fd);
+    }
+    close(d->listenFd);
+    unlink(d->path);
+  }
+}
+
+/**
+ * @brief Loads every complete section in the buffer while there is room
+ * for more live processes and removes it from the buffer.
+ */
+static void admit_sections(struct daemon *d) {
+  size_t start = 0;
+  size_t n;
+
+  while (d->live < d->limit &&
+         (n = section_length(d->buffer + start, d->length - start,
+                             d->eof)) > 0) {
+    load_section(d, d->buffer + start, n);
+    start += n;
+  }
+  if (start > 0) {
+    memmove(d->buffer, d->buffer + start, d->length - start);
+    d->length -= start;
+  }
+
+  /* The next connection starts a new stream */
+  if (d->eof && d->length == 0 && d->listenFd != -1) {
+    d->eof = 0;
+  }
+}
+
+/**
+ * @brief Returns the length of the complete header line or section at the
+ * start of the text.
+ *
+ * A section ends before the first empty line that is not inside a repeat
+ * block and before the next header line or section. At the end of the
+ * input the text ends the section as well.
+ *
+ * @param text The input.
+ * @param length The length of the input.
+ * @param eof Set if no input follows the text.
+ *
+ * @return The length, 0 if the section is not complete yet.
+ */
+static size_t section_length(const char *text, size_t length, int eof) {
+  size_t i = 0;
+  size_t end;
+  int started = 0;
+  int depth = 0;
+  int kind;
+
+  while (i < length) {
+    for (end = i; end < length && text[end] != '\n'; end++) {
+    }
+    if (end == length && !eof) {
+      /* Leading empty lines need not wait for the rest */
+      return started ? 0 : i;
+    }
+    kind = line_kind(text + i, end - i);
+
+    if (!started) {
+      if (kind == LINE_HEADER) {
+        return end < length ? end + 1 : end;
+      }
+      started = kind != LINE_EMPTY;
+    } else if ((kind == LINE_EMPTY && depth <= 0) || kind == LINE_HEADER ||
+               kind == LINE_SECTION) {
+      return i;
+    }
+    depth += line_depth(text + i, end - i);
+    i = end < length ? end + 1 : end;
+  }
+  return eof ? length : 0;
+}
+
+/**
+ * @brief Classifies a line by its first word.
+ *
+ * @return LINE_EMPTY, LINE_HEADER for a Processes, Resources or Mailboxes
+ * line, LINE_SECTION for the start of a Process or Subroutine section or
+ * LINE_OTHER.
+ */
+static int line_kind(const char *text, size_t length) {
+  size_t i = 0;
+  size_t n = next_word(text, length, &i);
+  const char *word = text + i - n;
+
+  if (n == 0) {
+    return LINE_EMPTY;
+  }
+  if ((n == strlen(PROCESSES) && strncmp(word, PROCESSES, n) == 0) ||
+      (n == strlen(RESOURCES) && strncmp(word, RESOURCES, n) == 0) ||
+      (n == strlen(MAILBOXES) && strncmp(word, MAILBOXES, n) == 0)) {
+    return LINE_HEADER;
+  }
+  if ((n == strlen(PROCESS) && strncmp(word, PROCESS, n) == 0) ||
+      (n == strlen(SUBROUTINE) && strncmp(word, SUBROUTINE, n) == 0)) {
+    return LINE_SECTION;
+  }
+  return LINE_OTHER;
+}
+
+/**
+ * @brief Returns the number of repeat blocks a line opens minus the number
+ * it closes. Messages in brackets are skipped.
+ */
+static int line_depth(const char *text, size_t length) {
+  size_t i = 0;
+  size_t n;
+  int depth = 0;
+
+  while ((n = next_word(text, length, &i)) > 0) {
+    if (text[i - n] == LEFTBRACKET) {
+      while (i < length && text[i - 1] != RIGHTBRACKET) {
+        ++i;
+      }
+    } else if (n == 1 && text[i - 1] == BLOCKEND[0]) {
+      --depth;
+    } else if (text[i - 1] == BLOCKSTART[0]) {
+      ++depth;
+    }
+  }
+  return depth;
+}
+
+/**
+ * @brief Finds the next word of a line.
+ *
+ * @param text The line.
+ * @param length The length of the line.
+ * @param i The position to start at, set to the end of the word.
+ *
+ * @return The length of the word, 0 at the end of the line.
+ */
+static size_t next_word(const char *text, size_t length, size_t *i) {
+  size_t start;
+
+  while (*i < length && (text[*i] == ' ' || text[*i] == '\t' ||
+                         text[*i] == '\r' || text[*i] == '\n')) {
+    ++*i;
+  }
+  start = *i;
+  while (*i < length && text[*i] != ' ' && text[*i] != '\t' &&
+         text[*i] != '\r' && text[*i] != '\n') {
+    ++*i;
+  }
+  return *i - start;
+}
+
+/**
+ * @brief Loads a complete header line or section.
+ *
+ * A section is parsed into a simulator of its own, which holds nothing but
+ * the process of the section, so a process is found by its name even
+ * while an earlier process with the same name is live. The parsed process
+ * and subroutines are then moved to the daemon's simulator, unless the
+ * parser met an instruction outside a named Process section.
+ */
+static void load_section(struct daemon *d, char *text, size_t length) {
+  struct simulator staging;
+  FILE *fptr;
+  size_t i = 0;
+  size_t n;
+  int kind = line_kind(text, length);
+
+  if (kind == LINE_EMPTY) {
+    return;
+  }
+  if (kind == LINE_HEADER) {
+    load_header(d, text, length);
+    return;
+  }
+  if (kind == LINE_OTHER) {
+    fprintf(stderr, "Ignoring input outside a %s or %s section\n", PROCESS,
+            SUBROUTINE);
+    return;
+  }
+
+  simulator_init(&staging);
+  n = next_word(text, length, &i);
+  if (n == strlen(PROCESS) && strncmp(text + i - n, PROCESS, n) == 0) {
+    /* The parser reads the name up to the next space */
+    ++i;
+    for (n = 0; i + n < length && text[i + n] != ' ' && text[i + n] != '\n';
+         n++) {
+    }
+    load_process(&staging, copy_word(text + i, n));
+  }
+
+  fptr = fmemopen(text, length, "r");
+  if (fptr != NULL) {
+    if (parse_process_sections(&staging, fptr) != 0) {
+      fprintf(stderr, "Ignoring a malformed %s section\n", PROCESS);
+    }
+    fclose(fptr);
+  }
+
+  if (staging.firstPCB != NULL && staging.loadErrors == 0) {
+    admit_process(d, &staging);
+  }
+  define_subroutines(d, &staging);
+  dealloc_processes(&staging);
+}
+
+/**
+ * @brief Loads the resources or mailboxes of a header line.
+ *
+ * The resource and mailbox tables are fixed once the first process is
+ * admitted, later header lines are reported and ignored. The processes of
+ * a Processes line are declared by their sections instead.
+ */
+static void load_header(struct daemon *d, char *text, size_t length) {
+  size_t i = 0;
+  size_t n = next_word(text, length, &i);
+  const char *word = text + i - n;
+  int resources = strncmp(word, RESOURCES, n) == 0;
+
+  if (strncmp(word, PROCESSES, n) == 0) {
+    return;
+  }
+  if (d->started) {
+    fprintf(stderr, "Ignoring %s after the first process\n",
+            resources ? RESOURCES : MAILBOXES);
+    return;
+  }
+  while ((n = next_word(text, length, &i)) > 0) {
+    if (resources) {
+      load_resource(d->sim, copy_word(text + i - n, n));
+    } else {
+      load_mailbox(d->sim, copy_word(text + i - n, n));
+    }
+  }
+}
+
+/**
+ * @brief Compiles the resource and mailbox tables before the first process
+ * is admitted.
+ */
+static void start(struct daemon *d) {
+  struct simulator *sim = d->sim;
+
+  compile_tables(sim, &d->resourceNames, &d->mailboxNames);
+  table_init_wait_queues(&sim->table, sim->resourceCount,
+                         sim->mailboxCount);
+  table_init_loops(&sim->table);
+  refresh_available_bits(sim);
+  sim->compiled = 1;
+  d->started = 1;
+}
+
+/**
+ * @brief Moves the parsed process of a section to the daemon's simulator,
+ * compiles it and puts it in the readyQueue.
+ */
+static void admit_process(struct daemon *d, struct simulator *staging) {
+  struct page *staged = staging->firstPCB->pagePtr;
+  struct processControlBlock *pcb;
+
+  if (!d->started) {
+    start(d);
+  }
+
+  load_process(d->sim, staged->name);
+  staged->name = NULL;
+  pcb = d->sim->currentPCB;
+  pcb->pagePtr->priority = staged->priority;
+  table_set_priority(&d->sim->table, pcb->pagePtr->number, staged->priority);
+  pcb->pagePtr->firstInstruction = staged->firstInstruction;
+  staged->firstInstruction = NULL;
+
+  /* Admitted processes are only found through the process table, so
+   * retiring one does not search the list of loaded processes */
+  d->sim->firstPCB = d->sim->currentPCB = NULL;
+
+  compile_process(d->sim, pcb, &d->resourceNames, &d->mailboxNames);
+  table_init_barriers(&d->sim->table, d->sim->barrierCount);
+  table_add_loop_stack(&d->sim->table, pcb->pagePtr->number,
+                       pcb->pagePtr->loopNesting);
+  ++d->live;
+  ++d->admitted;
+}
+
+/**
+ * @brief Moves the parsed subroutines of a section to the daemon's
+ * simulator.
+ *
+ * A subroutine replaces an earlier one with the same name, so redefining
+ * subroutines does not use more memory. Processes admitted earlier were
+ * compiled with the old definition.
+ */
+static void define_subroutines(struct daemon *d, struct simulator *staging) {
+  struct subroutine *sub;
+  struct subroutine **link;
+  struct subroutine *old;
+
+  while ((sub = staging->firstSubroutine) != NULL) {
+    staging->firstSubroutine = sub->next;
+    for (link = &d->sim->firstSubroutine; *link != NULL;
+         link = &(*link)->next) {
+      if (strcmp((*link)->name, sub->name) == 0) {
+        old = *link;
+        *link = old->next;
+        dealloc_subroutine(old);
+        break;
+      }
+    }
+    sub->next = d->sim->firstSubroutine;
+    d->sim->firstSubroutine = sub;
+  }
+}
+
+/**
+ * @brief Retires every terminated process.
+ */
+static void retire_terminated(struct daemon *d) {
+  struct processTable *t = &d->sim->table;
+  int p;
+
+  while ((p = dequeue(t, &t->terminatedQueue)) != -1) {
+    retire(d, t->pcb[p]);
+  }
+}
+
+/**
+ * @brief Lists the processes still live when the daemon stops to stderr.
+ */
+static void report_live(struct daemon *d) {
+  struct processTable *t = &d->sim->table;
+  int p;
+
+  fprintf(stderr, "Stopped with %d live processes:", d->live);
+  for (p = 0; p < t->count; p++) {
+    if (t->pcb[p] != NULL && t->state[p] != TERMINATED) {
+      fprintf(stderr, " %s (%s)", t->pcb[p]->pagePtr->name,
+              t->state[p] == WAITING ? "waiting" : "ready");
+    }
+  }
+  fprintf(stderr, "\n");
+}
+
+/**
+ * @brief Frees a terminated process and its number.
+ *
+ * Resources it still holds stay unavailable, as they would for a process
+ * that terminated in a process list. The messages it sent that are still in
+ * a mailbox stay there, the mailbox holds a reference to each of them.
+ */
+static void retire(struct daemon *d, struct processControlBlock *pcb) {
+  struct simulator *sim = d->sim;
+
+  table_remove(&sim->table, pcb->pagePtr->number);
+  dealloc_process(pcb);
+  --d->live;
+  ++d->retired;
+}
+
+/**
+ * @brief Reads what the input has available.
+ *
+ * Accepts the next connection when there is none. When the input ends the
+ * connection is closed and eof set until the buffer is admitted.
+ *
+ * @param d The daemon.
+ * @param wait Wait for input if set, otherwise return at once.
+ *
+ * @return 0 on success, also when a signal interrupted the wait, -1 if the
+ * input failed.
+ */
+static int read_input(struct daemon *d, int wait) {
+  struct pollfd input;
+  ssize_t n;
+
+  input.fd = d->fd != -1 ? d->fd : d->listenFd;
+  input.events = POLLIN;
+  n = poll(&input, 1, wait ? -1 : 0);
+  if (n <= 0) {
+    return n == 0 || errno == EINTR ? 0 : -1;
+  }
+
+  if (d->fd == -1) {
+    d->fd = accept(d->listenFd, NULL, NULL);
+    return d->fd != -1 || errno == EINTR || errno == ECONNABORTED ? 0 : -1;
+  }
+
+  if (d->capacity - d->length < DAEMON_READ_SIZE) {
+    d->capacity = d->length + DAEMON_READ_SIZE > 2 * d->capacity
+                      ? d->length + DAEMON_READ_SIZE
+                      : 2 * d->capacity;
+    d->buffer = realloc(d->buffer, d->capacity);
+  }
+  n = read(d->fd, d->buffer + d->length, DAEMON_READ_SIZE);
+  if (n > 0) {
+    d->length += n;
+  } else if (n == 0) {
+    d->eof = 1;
+    if (d->listenFd != -1) {
+      close(d->fd);
+      d->fd = -1;
+    }
+  } else if (errno != EINTR && errno != EAGAIN) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Copies a word of the input into its own allocation.
+ */
+static char *copy_word(const char *word, size_t length) {
+  char *copy = malloc(length + 1);
+
+  memcpy(copy, word, length);
+  copy[length] = '\0';
+  return copy;
+}
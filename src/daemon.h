@@ -0,0 +1,98 @@
+/**
+  * @file daemon.h
+  * @description A definition of the daemon, which reads process definitions
+  *              from stdin or a Unix domain socket while it schedules them,
+  *              so a simulation can be fed by another program for as long
+  *              as it runs.
+  */
+
+#ifndef _DAEMON_H
+#define _DAEMON_H
+
+#include <signal.h>
+
+#include "names.h"
+
+struct simulator;
+
+/** The number of bytes read from the input at a time */
+#define DAEMON_READ_SIZE 65536
+/** The number of time slices between two looks at the input */
+#define DAEMON_POLL_SLICES 64
+/** The default bound on the number of live processes */
+#define DAEMON_LIMIT 1024
+
+/**
+ * A daemon feeding one simulator.
+ *
+ * The input is the process list syntax without the Processes line:
+ * Resources and Mailboxes lines, which must come before the first process,
+ * followed by Process and Subroutine sections. A section is complete at the
+ * first empty line outside a repeat block, at the next section or at the
+ * end of the input, and a complete process is admitted to the readyQueue
+ * right away.
+ *
+ * While limit processes are live the input is not read, so a writer that
+ * submits faster than the processes terminate blocks on the full pipe or
+ * socket. Terminated processes are retired: they are freed and their
+ * numbers reused, so memory stays bounded however long the daemon runs.
+ */
+struct daemon {
+  /** The simulator the processes are admitted to */
+  struct simulator *sim;
+  /** The input, stdin or a connection, -1 while waiting for a connection */
+  int fd;
+  /** The listening socket, -1 when reading stdin */
+  int listenFd;
+  /** The path the socket is bound to, NULL when reading stdin */
+  const char *path;
+  /** The input read but not admitted yet */
+  char *buffer;
+  /** The number of bytes in the buffer */
+  size_t length;
+  /** The size of the buffer */
+  size_t capacity;
+  /** Set when the input ended, the buffer then ends the last section */
+  int eof;
+  /** Set once the resource and mailbox tables are compiled */
+  int started;
+  /** Maps resource names to resource table indices once started */
+  struct nameTable resourceNames;
+  /** Maps mailbox names to mailbox table indices once started */
+  struct nameTable mailboxNames;
+  /** The maximum number of live processes */
+  int limit;
+  /** The number of admitted processes that were not retired yet */
+  int live;
+  /** The number of admitted processes */
+  long long admitted;
+  /** The number of retired processes */
+  long long retired;
+  /** Stop as soon as this flag is set, e.g. by a signal handler, NULL for
+   * never */
+  volatile sig_atomic_t *stop;
+};
+
+/*
+ * Initialises a daemon that admits at most limit live processes into the
+ * empty simulator sim, reading stdin or, if path is not NULL, the
+ * connections to a Unix domain socket bound to path. Returns 0 on success
+ * or -1 if the socket could not be created.
+ */
+int daemon_init(struct daemon *d, struct simulator *sim, const char *path,
+                int limit);
+
+/*
+ * Admits and schedules processes until stdin ends and every process is
+ * retired, or until the stop flag is set. Returns 0 on success or -1 if
+ * the input failed.
+ */
+int daemon_run(struct daemon *d, int schedule_alg, int quantum);
+
+/*
+ * Closes the input and frees the daemon and the processes that are still
+ * live, but not the simulator.
+ */
+void daemon_free(struct daemon *d);
+
+#endif
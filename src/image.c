@@ -0,0 +1,885 @@
+/**
+ * @file image.c
+ */
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "loader.h"
+#include "manager.h"
+#include "names.h"
+#include "pager.h"
+#include "program.h"
+#include "realtime.h"
+#include "simulator.h"
+#include "table.h"
+#include "topic.h"
+
+/**
+ * The interned strings of an image being saved.
+ */
+struct stringArea {
+  /** Maps each string to its number */
+  struct nameTable names;
+  /** The offset of each string in the area, indexed by its number */
+  uint64_t *offsets;
+  /** Maps the text of each message to its number */
+  struct nameTable messageNames;
+  /** The strings in the order they were interned */
+  char **strings;
+  /** The message of each number, NULL for a name */
+  struct message **messages;
+  /** The number of strings */
+  int count;
+  /** The number of strings there is room for */
+  int capacity;
+  /** The size of the area so far, it starts with the 0 of no string */
+  uint64_t size;
+};
+
+/* A loaded op is the relocated record, so both must have the same layout */
+_Static_assert(sizeof(struct op) == sizeof(struct imageOp),
+               "struct op and struct imageOp differ");
+_Static_assert(offsetof(struct op, type) == offsetof(struct imageOp, type) &&
+                   offsetof(struct op, name) ==
+                       offsetof(struct imageOp, name) &&
+                   offsetof(struct op, msg) == offsetof(struct imageOp, msg),
+               "struct op and struct imageOp differ");
+/* A loaded message is the record in the string area */
+_Static_assert(sizeof(struct message) == 2 * sizeof(int32_t) &&
+                   sizeof(int) == sizeof(int32_t),
+               "struct message differs from a message record");
+
+static void intern(struct stringArea *area, char *string);
+static void intern_message(struct stringArea *area, struct message *msg);
+static uint64_t add_entry(struct stringArea *area, char *string,
+                          struct message *msg, uint64_t size);
+static uint64_t string_offset(struct stringArea *area, const char *string);
+static uint64_t message_offset(struct stringArea *area,
+                               const struct message *msg);
+static int check_header(const struct imageHeader *header, uint64_t size);
+static int load_resource_sets(struct simulator *sim, const char *base,
+                              const struct imageHeader *header);
+static int load_barriers(struct simulator *sim, const char *base,
+                         const struct imageHeader *header, char *strings);
+static int relocate_ops(struct imageOp *records,
+                        const struct imageHeader *header, char *strings,
+                        const void *const *handlers);
+static char *image_string(char *strings, uint64_t size, uint64_t offset,
+                          int *valid);
+static struct message *image_message(char *strings, uint64_t size,
+                                     uint64_t offset, int *valid);
+
+/**
+ * @brief Writes the compiled workload of a simulator to an image.
+ *
+ * The names and messages are interned, so a resource named by a thousand
+ * requests or a message sent by a thousand ops is stored once. The image holds
+ * the compiled ops, so loading it gives exactly the resource and mailbox
+ * numbers the simulator has.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the image.
+ *
+ * @return 0 on success, -1 if nothing was loaded, the programs are paged or
+ * the file could not be written.
+ */
+int image_save(struct simulator *sim, const char *filename) {
+  struct imageHeader header;
+  struct imageProcess process;
+  struct imageOp record;
+  struct imageResource entry;
+  struct stringArea area;
+  struct processControlBlock *pcb;
+  struct resourceList *resource;
+  struct mailbox *mail;
+  struct message record_msg;
+  struct op *op;
+  uint64_t offset;
+  uint64_t ops = 0;
+  uint64_t setSize = 0;
+  uint32_t value;
+  FILE *fptr;
+  int i;
+  int status = 0;
+
+  if (!sim->compiled || sim->pager != NULL) {
+    return -1;
+  }
+
+  names_init(&area.names, 1024);
+  names_init(&area.messageNames, 64);
+  area.offsets = NULL;
+  area.strings = NULL;
+  area.messages = NULL;
+  area.count = 0;
+  area.capacity = 0;
+  area.size = 1;
+
+  for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+    intern(&area, pcb->pagePtr->name);
+    for (op = pcb->pagePtr->program; op->type != END_V; op++) {
+      intern(&area, op->name);
+      intern_message(&area, op->msg);
+      ++ops;
+    }
+    ++ops;
+  }
+  for (resource = sim->firstResource; resource != NULL;
+       resource = resource->next) {
+    intern(&area, resource->name);
+  }
+  for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+    intern(&area, mail->name);
+  }
+  for (i = 0; i < sim->barrierCount; i++) {
+    intern(&area, sim->barriers[i].name);
+  }
+  for (i = 0; i < sim->resourceSetCount; i++) {
+    setSize += sizeof(uint32_t) * (1 + sim->resourceSets[i].count);
+  }
+  setSize = (setSize + 7) & ~(uint64_t)7;
+
+  memset(&header, 0, sizeof(header));
+  memset(&process, 0, sizeof(process));
+  memset(&entry, 0, sizeof(entry));
+  memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+  header.version = IMAGE_VERSION;
+  header.opSize = sizeof(struct imageOp);
+  header.processes = sim->table.count;
+  header.resources = sim->resourceCount;
+  header.mailboxes = sim->mailboxCount;
+  header.sets = sim->resourceSetCount;
+  header.barriers = sim->barrierCount;
+  header.ops = ops;
+  header.processOffset = sizeof(struct imageHeader);
+  header.resourceOffset =
+      header.processOffset +
+      (uint64_t)header.processes * sizeof(struct imageProcess);
+  header.mailboxOffset =
+      header.resourceOffset +
+      (uint64_t)header.resources * sizeof(struct imageResource);
+  header.barrierOffset =
+      header.mailboxOffset +
+      (uint64_t)header.mailboxes * sizeof(struct imageResource);
+  header.setOffset =
+      header.barrierOffset +
+      (uint64_t)header.barriers * sizeof(struct imageResource);
+  header.opOffset = header.setOffset + setSize;
+  header.stringOffset = header.opOffset + ops * sizeof(struct imageOp);
+  header.stringSize = area.size;
+
+  fptr = fopen(filename, "wb");
+  if (fptr == NULL) {
+    status = -1;
+  } else {
+    fwrite(&header, sizeof(header), 1, fptr);
+
+    ops = 0;
+    for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+      process.name = string_offset(&area, pcb->pagePtr->name);
+      process.firstOp = ops;
+      process.cost = pcb->pagePtr->cost;
+      process.priority = pcb->pagePtr->priority;
+      process.period = pcb->pagePtr->period;
+      process.deadline = pcb->pagePtr->deadline;
+      process.jitter = pcb->pagePtr->jitter;
+      fwrite(&process, sizeof(process), 1, fptr);
+      for (op = pcb->pagePtr->program; op->type != END_V; op++) {
+        ++ops;
+      }
+      ++ops;
+    }
+    for (resource = sim->firstResource; resource != NULL;
+         resource = resource->next) {
+      entry.name = string_offset(&area, resource->name);
+      entry.capacity = resource->capacity;
+      entry.policy = resource->protocol;
+      entry.ceiling = resource->ceiling;
+      fwrite(&entry, sizeof(entry), 1, fptr);
+    }
+    entry.ceiling = 0;
+    for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+      entry.name = string_offset(&area, mail->name);
+      entry.capacity = mail->capacity;
+      entry.policy = mail->topic != NULL ? mail->topic->policy : 0;
+      fwrite(&entry, sizeof(entry), 1, fptr);
+    }
+    for (i = 0; i < sim->barrierCount; i++) {
+      entry.name = string_offset(&area, sim->barriers[i].name);
+      entry.capacity = sim->barriers[i].parties;
+      entry.policy = 0;
+      fwrite(&entry, sizeof(entry), 1, fptr);
+    }
+    offset = 0;
+    for (i = 0; i < sim->resourceSetCount; i++) {
+      value = sim->resourceSets[i].count;
+      fwrite(&value, sizeof(value), 1, fptr);
+      fwrite(sim->resourceSets[i].members, sizeof(uint32_t), value, fptr);
+      offset += sizeof(uint32_t) * (1 + value);
+    }
+    for (; offset < setSize; offset += sizeof(uint32_t)) {
+      value = 0;
+      fwrite(&value, sizeof(value), 1, fptr);
+    }
+
+    for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+      op = pcb->pagePtr->program;
+      do {
+        record.code = 0;
+        record.type = op->type;
+        record.operand = op->operand;
+        record.name = string_offset(&area, op->name);
+        record.msg = message_offset(&area, op->msg);
+        fwrite(&record, sizeof(record), 1, fptr);
+      } while ((op++)->type != END_V);
+    }
+
+    fputc('\0', fptr);
+    offset = 1;
+    for (i = 0; i < area.count; i++) {
+      for (; offset < area.offsets[i]; offset++) {
+        fputc('\0', fptr);
+      }
+      if (area.messages[i] != NULL) {
+        record_msg.length = area.messages[i]->length;
+        record_msg.refs = 0;
+        fwrite(&record_msg, sizeof(record_msg), 1, fptr);
+        offset += sizeof(record_msg);
+      }
+      value = strlen(area.strings[i]) + 1;
+      fwrite(area.strings[i], 1, value, fptr);
+      offset += value;
+    }
+
+    if (ferror(fptr)) {
+      status = -1;
+    }
+    if (fclose(fptr) != 0) {
+      status = -1;
+    }
+  }
+
+  names_free(&area.names);
+  names_free(&area.messageNames);
+  free(area.offsets);
+  free(area.strings);
+  free(area.messages);
+
+  return status;
+}
+
+/**
+ * @brief Checks whether a file is an image.
+ *
+ * @param filename The path of the file.
+ *
+ * @return 1 if the file starts with IMAGE_MAGIC, otherwise 0.
+ */
+int image_detect(const char *filename) {
+  char magic[sizeof(IMAGE_MAGIC) - 1];
+  FILE *fptr;
+  int found;
+
+  fptr = fopen(filename, "rb");
+  if (fptr == NULL) {
+    return 0;
+  }
+  found = fread(magic, sizeof(magic), 1, fptr) == 1 &&
+          memcmp(magic, IMAGE_MAGIC, sizeof(magic)) == 0;
+  fclose(fptr);
+
+  return found;
+}
+
+/**
+ * @brief Maps an image and loads it into a simulator.
+ *
+ * The file is mapped privately and its op records are turned into ops in place
+ * in one pass, so the programs are neither parsed, copied nor allocated. The
+ * names and messages point into the string area of the mapping. The processes,
+ * resources and mailboxes live in one array each, like the ones of a view.
+ *
+ * Every offset, op type and operand is checked before it is used, so a
+ * truncated or corrupt image is rejected instead of crashing the scheduler.
+ *
+ * With a memory budget the mapping is only read: the records are checked
+ * here but the programs are paged in by the pager as the processes run.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param filename The path of the image.
+ *
+ * @return 0 on success, -1 if the file could not be mapped or is not a valid
+ * image of this version.
+ */
+int image_load(struct simulator *sim, const char *filename) {
+  struct imageHeader header;
+  struct imageProcess *records;
+  struct processControlBlock *pcbs;
+  struct page *pages;
+  struct resourceList *resources;
+  struct mailbox *mailboxes;
+  struct imageResource *entries;
+  struct stat info;
+  char *base;
+  char *strings;
+  uint64_t firstOp;
+  int valid = 1;
+  int fd;
+  uint32_t i;
+
+  if (sim->firstPCB != NULL) {
+    return -1;
+  }
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fstat(fd, &info) != 0 || (uint64_t)info.st_size < sizeof(header)) {
+    close(fd);
+    return -1;
+  }
+  /* A paged image is only read, a block at a time */
+  base = sim->memoryBudget > 0
+             ? mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+             : mmap(NULL, info.st_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+
+  memcpy(&header, base, sizeof(header));
+  if (check_header(&header, info.st_size) != 0) {
+    munmap(base, info.st_size);
+    return -1;
+  }
+  strings = base + header.stringOffset;
+  if (sim->memoryBudget == 0 &&
+      relocate_ops((struct imageOp *)(base + header.opOffset), &header,
+                   strings, get_op_handlers()) != 0) {
+    munmap(base, info.st_size);
+    return -1;
+  }
+
+  pcbs = malloc(sizeof(struct processControlBlock) * header.processes);
+  pages = malloc(sizeof(struct page) * header.processes);
+  resources = header.resources > 0
+                  ? malloc(sizeof(struct resourceList) * header.resources)
+                  : NULL;
+  mailboxes = header.mailboxes > 0
+                  ? malloc(sizeof(struct mailbox) * header.mailboxes)
+                  : NULL;
+  sim->resourceTable =
+      malloc(sizeof(struct resourceList *) * (header.resources + 1));
+  sim->mailboxTable = malloc(sizeof(struct mailbox *) * (header.mailboxes + 1));
+  if (pcbs == NULL || pages == NULL ||
+      (resources == NULL && header.resources > 0) ||
+      (mailboxes == NULL && header.mailboxes > 0) ||
+      sim->resourceTable == NULL || sim->mailboxTable == NULL) {
+    free(pcbs);
+    free(pages);
+    free(resources);
+    free(mailboxes);
+    free(sim->resourceTable);
+    free(sim->mailboxTable);
+    sim->resourceTable = NULL;
+    sim->mailboxTable = NULL;
+    munmap(base, info.st_size);
+    return -1;
+  }
+
+  entries = (struct imageResource *)(base + header.resourceOffset);
+  for (i = 0; i < header.resources; i++) {
+    resources[i].name =
+        image_string(strings, header.stringSize, entries[i].name, &valid);
+    if (entries[i].capacity > INT_MAX ||
+        entries[i].policy > RESOURCE_CEILING || entries[i].ceiling < 0) {
+      valid = 0;
+    }
+    resources[i].number = i;
+    resources[i].available = resources[i].capacity = entries[i].capacity;
+    resources[i].protocol = entries[i].policy;
+    resources[i].ceiling = entries[i].ceiling;
+    resources[i].readers = resources[i].wokenReaders = 0;
+    resources[i].holder = -1;
+    resources[i].resource = NULL;
+    resources[i].holders = NULL;
+    resources[i].holderIndex = NULL;
+    resources[i].holderSlots = resources[i].holderCount = 0;
+    resources[i].next = i + 1 < header.resources ? &resources[i + 1] : NULL;
+    sim->resourceTable[i] = &resources[i];
+  }
+
+  entries = (struct imageResource *)(base + header.mailboxOffset);
+  for (i = 0; i < header.mailboxes; i++) {
+    if (entries[i].capacity < 1 ||
+        entries[i].capacity > MAILBOX_MAX_CAPACITY ||
+        entries[i].policy > TOPIC_DISCONNECT) {
+      valid = 0;
+    }
+    init_mailbox(&mailboxes[i],
+                 image_string(strings, header.stringSize, entries[i].name,
+                              &valid),
+                 entries[i].capacity);
+    if (entries[i].policy != 0) {
+      topic_init(&mailboxes[i], entries[i].policy);
+      ++sim->topicCount;
+    }
+    mailboxes[i].next = i + 1 < header.mailboxes ? &mailboxes[i + 1] : NULL;
+    sim->mailboxTable[i] = &mailboxes[i];
+  }
+
+  if (load_resource_sets(sim, base, &header) != 0 ||
+      load_barriers(sim, base, &header, strings) != 0) {
+    valid = 0;
+  }
+
+  records = (struct imageProcess *)(base + header.processOffset);
+  table_init(&sim->table, header.processes);
+  for (i = 0; i < header.processes; i++) {
+    firstOp = records[i].firstOp;
+    if (firstOp >= header.ops) {
+      valid = 0;
+      firstOp = header.ops - 1;
+    }
+    pages[i].name =
+        image_string(strings, header.stringSize, records[i].name, &valid);
+    if (records[i].priority < 0 || records[i].period < 0 ||
+        (records[i].period > 0 &&
+         (records[i].deadline < 1 || records[i].deadline > records[i].period ||
+          records[i].jitter < 0 || records[i].cost < 0))) {
+      valid = 0;
+    }
+    pages[i].priority = records[i].priority;
+    pages[i].period = records[i].period > 0 ? records[i].period : 0;
+    pages[i].deadline = pages[i].period > 0 ? records[i].deadline : 0;
+    pages[i].jitter = pages[i].period > 0 ? records[i].jitter : 0;
+    pages[i].cost = pages[i].period > 0 ? records[i].cost : 0;
+    pages[i].firstInstruction = NULL;
+    pages[i].program = NULL;
+    pages[i].loopNesting = 0;
+    pages[i].frames = NULL;
+    if (sim->memoryBudget == 0) {
+      pages[i].program = (struct op *)(base + header.opOffset) + firstOp;
+      pages[i].loopNesting = program_loop_nesting(pages[i].program);
+      if (pages[i].loopNesting < 0) {
+        valid = 0;
+        pages[i].loopNesting = 0;
+      }
+    }
+    pages[i].number = table_add(&sim->table, &pcbs[i]);
+
+    pcbs[i].pagePtr = &pages[i];
+    pcbs[i].resourceListPtr = NULL;
+    pcbs[i].spareResources = NULL;
+    pcbs[i].stats.executed = 0;
+    pcbs[i].stats.waits = 0;
+    pcbs[i].stats.slices = 0;
+    pcbs[i].stats.jobs = 0;
+    pcbs[i].stats.missed = 0;
+    pcbs[i].stats.worstResponse = 0;
+    pcbs[i].next = i + 1 < header.processes ? &pcbs[i + 1] : NULL;
+  }
+  if (valid && sim->memoryBudget > 0 &&
+      pager_create(sim, base, &header, pages, sim->memoryBudget) != 0) {
+    valid = 0;
+  }
+  table_init_wait_queues(&sim->table, header.resources, header.mailboxes);
+  table_init_barriers(&sim->table, sim->barrierCount);
+  table_init_loops(&sim->table);
+  table_init_timers(&sim->table);
+  table_reset(&sim->table);
+
+  /* The arrays are freed through the heads of the lists */
+  sim->firstPCB = pcbs;
+  sim->currentPCB = &pcbs[header.processes - 1];
+  sim->firstResource = resources;
+  sim->currentResource =
+      header.resources > 0 ? &resources[header.resources - 1] : NULL;
+  sim->firstMailbox = mailboxes;
+  sim->currentMailbox =
+      header.mailboxes > 0 ? &mailboxes[header.mailboxes - 1] : NULL;
+  sim->resourceCount = header.resources;
+  sim->mailboxCount = header.mailboxes;
+  sim->mapping = base;
+  sim->mappingSize = info.st_size;
+  sim->compiled = 1;
+
+  if (!valid) {
+    simulator_free(sim);
+    return -1;
+  }
+  refresh_available_bits(sim);
+  realtime_reset(sim);
+
+  return 0;
+}
+
+/**
+ * @brief Frees a simulator loaded from an image.
+ *
+ * @param sim The simulator.
+ */
+void image_unload(struct simulator *sim) {
+  struct processControlBlock *pcb;
+  struct resourceList *resource;
+  struct mailbox *mail;
+
+  for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+    dealloc_resourceList(pcb->resourceListPtr);
+    dealloc_resourceList(pcb->spareResources);
+  }
+  for (resource = sim->firstResource; resource != NULL;
+       resource = resource->next) {
+    free(resource->holderIndex);
+  }
+  if (sim->firstPCB != NULL) {
+    free(sim->firstPCB->pagePtr);
+  }
+  free(sim->firstPCB);
+  free(sim->firstResource);
+  for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+    free_mailbox(mail);
+  }
+  free(sim->firstMailbox);
+  table_free(&sim->table);
+  pager_free(sim);
+  munmap(sim->mapping, sim->mappingSize);
+
+  sim->firstPCB = sim->currentPCB = NULL;
+  sim->firstResource = sim->currentResource = NULL;
+  sim->firstMailbox = sim->currentMailbox = NULL;
+  sim->mapping = NULL;
+  sim->mappingSize = 0;
+}
+
+/**
+ * @brief Adds a string to the area unless it is NULL or already there.
+ */
+static void intern(struct stringArea *area, char *string) {
+  if (string == NULL || names_find(&area->names, string) >= 0) {
+    return;
+  }
+  names_insert(&area->names, string,
+               add_entry(area, string, NULL, area->size));
+  area->size += strlen(string) + 1;
+}
+
+/**
+ * @brief Adds a message to the area unless it is NULL or a message with the
+ * same text is already there.
+ *
+ * The record is aligned for struct message, which it is once mapped.
+ */
+static void intern_message(struct stringArea *area, struct message *msg) {
+  uint64_t offset;
+
+  if (msg == NULL || names_find(&area->messageNames, msg->text) >= 0) {
+    return;
+  }
+  offset = (area->size + sizeof(int32_t) - 1) &
+           ~(uint64_t)(sizeof(int32_t) - 1);
+  names_insert(&area->messageNames, msg->text,
+               add_entry(area, msg->text, msg, offset));
+  area->size = offset + sizeof(struct message) + msg->length + 1;
+}
+
+/**
+ * @brief Appends an entry at an offset of the area.
+ *
+ * @return The number of the entry.
+ */
+static uint64_t add_entry(struct stringArea *area, char *string,
+                          struct message *msg, uint64_t offset) {
+  if (area->count == area->capacity) {
+    area->capacity = area->capacity == 0 ? 1024 : 2 * area->capacity;
+    area->offsets =
+        realloc(area->offsets, sizeof(uint64_t) * area->capacity);
+    area->strings = realloc(area->strings, sizeof(char *) * area->capacity);
+    area->messages =
+        realloc(area->messages, sizeof(struct message *) * area->capacity);
+  }
+  area->offsets[area->count] = offset;
+  area->strings[area->count] = string;
+  area->messages[area->count] = msg;
+  return area->count++;
+}
+
+/**
+ * @brief Returns the offset of an interned string, 0 for NULL.
+ */
+static uint64_t string_offset(struct stringArea *area, const char *string) {
+  return string == NULL ? 0 : area->offsets[names_find(&area->names, string)];
+}
+
+/**
+ * @brief Returns the offset of an interned message, 0 for NULL.
+ */
+static uint64_t message_offset(struct stringArea *area,
+                               const struct message *msg) {
+  return msg == NULL
+             ? 0
+             : area->offsets[names_find(&area->messageNames, msg->text)];
+}
+
+/**
+ * @brief Checks that the header belongs to an image of this version and
+ * that every section lies inside the file.
+ *
+ * @return 0 if the header is valid, otherwise -1.
+ */
+static int check_header(const struct imageHeader *header, uint64_t size) {
+  if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != IMAGE_VERSION ||
+      header->opSize != sizeof(struct imageOp) || header->processes == 0 ||
+      header->processes > INT_MAX || header->resources > INT_MAX ||
+      header->mailboxes > INT_MAX || header->sets > INT_MAX ||
+      header->barriers > INT_MAX || header->ops == 0) {
+    return -1;
+  }
+
+  /* The sections follow each other in this order, so checking each against
+   * the start of the next one keeps the sizes from overflowing */
+  if (header->processOffset != sizeof(struct imageHeader) ||
+      header->resourceOffset - header->processOffset !=
+          (uint64_t)header->processes * sizeof(struct imageProcess) ||
+      header->mailboxOffset - header->resourceOffset !=
+          (uint64_t)header->resources * sizeof(struct imageResource) ||
+      header->barrierOffset - header->mailboxOffset !=
+          (uint64_t)header->mailboxes * sizeof(struct imageResource) ||
+      header->setOffset - header->barrierOffset !=
+          (uint64_t)header->barriers * sizeof(struct imageResource) ||
+      header->setOffset > size || header->opOffset < header->setOffset ||
+      (header->opOffset - header->setOffset) % 8 != 0 ||
+      header->opOffset > size || header->stringOffset < header->opOffset ||
+      header->stringOffset > size ||
+      (header->stringOffset - header->opOffset) / sizeof(struct imageOp) !=
+          header->ops ||
+      (header->stringOffset - header->opOffset) % sizeof(struct imageOp) !=
+          0 ||
+      header->stringSize == 0 ||
+      header->stringSize != size - header->stringOffset) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Adds the resource sets of an image to the resource set table.
+ *
+ * Every set must have members, list them in increasing order and only name
+ * resources of the image, and the section must end with the padding of the
+ * last set, so the sets get the numbers the ops of the image refer to.
+ *
+ * @return 0 if every set is valid, otherwise -1.
+ */
+static int load_resource_sets(struct simulator *sim, const char *base,
+                              const struct imageHeader *header) {
+  const uint32_t *words = (const uint32_t *)(base + header->setOffset);
+  uint64_t size = (header->opOffset - header->setOffset) / sizeof(uint32_t);
+  uint64_t i = 0;
+  uint32_t count;
+  uint32_t set;
+  uint32_t m;
+
+  for (set = 0; set < header->sets; set++) {
+    if (i >= size || (count = words[i]) == 0 || count > size - i - 1) {
+      return -1;
+    }
+    for (m = 0; m < count; m++) {
+      if (words[i + 1 + m] >= header->resources ||
+          (m > 0 && words[i + 1 + m] <= words[i + m])) {
+        return -1;
+      }
+    }
+    if (program_resource_set(sim, (const int *)&words[i + 1], count) !=
+        (int)set) {
+      return -1;
+    }
+    i += 1 + count;
+  }
+
+  return ((i * sizeof(uint32_t) + 7) & ~(uint64_t)7) ==
+                 size * sizeof(uint32_t)
+             ? 0
+             : -1;
+}
+
+/**
+ * @brief Adds the barriers of an image to the barrier table.
+ *
+ * Every barrier must have a name of its own and at least one party, so the
+ * barriers get the numbers the ops of the image refer to.
+ *
+ * @return 0 if every barrier is valid, otherwise -1.
+ */
+static int load_barriers(struct simulator *sim, const char *base,
+                         const struct imageHeader *header, char *strings) {
+  const struct imageResource *entries =
+      (const struct imageResource *)(base + header->barrierOffset);
+  const char *name;
+  int valid = 1;
+  uint32_t i;
+
+  /* The names are copied, so they must end inside the area */
+  if (header->barriers > 0 && strings[header->stringSize - 1] != '\0') {
+    return -1;
+  }
+  for (i = 0; i < header->barriers; i++) {
+    name = image_string(strings, header->stringSize, entries[i].name, &valid);
+    if (!valid || name == NULL || entries[i].capacity < 1 ||
+        entries[i].capacity > INT_MAX ||
+        program_barrier(sim, name, entries[i].capacity) != (int)i) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Turns the op records of an image into ops.
+ *
+ * Each record is read whole before the op is written over it. The last op
+ * must be an END_V op, so every program ends inside the array. The loops of
+ * each program are checked by image_load.
+ *
+ * @return 0 if every record is valid, otherwise -1.
+ */
+static int relocate_ops(struct imageOp *records,
+                        const struct imageHeader *header, char *strings,
+                        const void *const *handlers) {
+  struct imageOp record;
+  struct op op;
+  uint64_t i;
+
+  /* Every string ends inside the area if the area ends with a 0 */
+  if (strings[header->stringSize - 1] != '\0' ||
+      records[header->ops - 1].type != END_V) {
+    return -1;
+  }
+
+  for (i = 0; i < header->ops; i++) {
+    memcpy(&record, &records[i], sizeof(record));
+    if (image_op(&record, header, strings, handlers, &op) != 0) {
+      return -1;
+    }
+    memcpy(&records[i], &op, sizeof(op));
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Turns one op record of an image into an op.
+ *
+ * @param record The record.
+ * @param header The header of the image.
+ * @param strings The string area, which must end with a 0.
+ * @param handlers The code address of each op type, or NULL.
+ * @param op Filled with the op.
+ *
+ * @return 0 if the record is valid, otherwise -1.
+ */
+int image_op(const struct imageOp *record, const struct imageHeader *header,
+             char *strings, const void *const *handlers, struct op *op) {
+  int valid = 1;
+
+  if (((record->type < REQ_V || record->type > LOOP_V) &&
+       record->type != REQS_V && record->type != REQSET_V &&
+       record->type != DRAIN_V && record->type != SUBSCRIBE_V &&
+       record->type != UNSUBSCRIBE_V && record->type != SYNC_V) ||
+      record->operand < -1 ||
+      ((record->type == REPEAT_V || record->type == LOOP_V) &&
+       record->operand < 1) ||
+      ((record->type == REQ_V || record->type == REQS_V ||
+        record->type == REL_V) &&
+       record->operand >= (int32_t)header->resources) ||
+      ((record->type == SEND_V || record->type == RECV_V ||
+        record->type == DRAIN_V || record->type == SUBSCRIBE_V ||
+        record->type == UNSUBSCRIBE_V) &&
+       record->operand >= (int32_t)header->mailboxes) ||
+      (record->type == REQSET_V &&
+       record->operand >= (int32_t)header->sets) ||
+      (record->type == SYNC_V &&
+       record->operand >= (int32_t)header->barriers)) {
+    return -1;
+  }
+
+  op->code = handlers != NULL ? handlers[record->type] : NULL;
+  op->type = record->type;
+  op->operand = record->operand;
+  op->name = image_string(strings, header->stringSize, record->name, &valid);
+  op->msg = image_message(strings, header->stringSize, record->msg, &valid);
+  if ((op->type == SEND_V) != (op->msg != NULL)) {
+    return -1;
+  }
+
+  return valid ? 0 : -1;
+}
+
+/**
+ * @brief Returns the string at an offset of the string area.
+ *
+ * @param strings The string area.
+ * @param size The size of the string area.
+ * @param offset The offset of the string, 0 for no string.
+ * @param valid Cleared if the offset lies outside the area.
+ *
+ * @return The string or NULL.
+ */
+static char *image_string(char *strings, uint64_t size, uint64_t offset,
+                          int *valid) {
+  if (offset == 0) {
+    return NULL;
+  }
+  if (offset >= size) {
+    *valid = 0;
+    return NULL;
+  }
+  return strings + offset;
+}
+
+/**
+ * @brief Returns the message record at an offset of the string area.
+ *
+ * @param strings The string area.
+ * @param size The size of the string area.
+ * @param offset The offset of the record, 0 for no message.
+ * @param valid Cleared if the record is misaligned, does not lie inside the
+ * area or its text does not end where its length says.
+ *
+ * @return The message or NULL.
+ */
+static struct message *image_message(char *strings, uint64_t size,
+                                     uint64_t offset, int *valid) {
+  struct message *msg;
+
+  if (offset == 0) {
+    return NULL;
+  }
+  /* The record is only addressed once it is known to lie in the area */
+  if (offset >= size || size - offset <= sizeof(struct message) ||
+      ((uintptr_t)strings + offset) % sizeof(int32_t) != 0) {
+    *valid = 0;
+    return NULL;
+  }
+  msg = (struct message *)(strings + offset);
+  if (msg->length < 0 ||
+      (uint64_t)msg->length >= size - offset - sizeof(struct message) ||
+      msg->text[msg->length] != '\0') {
+    *valid = 0;
+    return NULL;
+  }
+  return msg;
+}
@@ -0,0 +1,157 @@
+/**
+  * @file image.h
+  * @description A definition of the binary workload image, a compiled
+  *              workload saved to a file that can be mapped and scheduled
+  *              without parsing it again.
+  */
+
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <stdint.h>
+
+struct op;
+struct simulator;
+
+/** The first bytes of every image */
+#define IMAGE_MAGIC "PSCHDIMG"
+/** The version of the layout below, bumped on every incompatible change */
+#define IMAGE_VERSION 8
+
+/**
+ * The header at the start of an image. Every offset is in bytes from the
+ * start of the file and every name or message is an offset into the string
+ * area, where 0 stands for no string. A message is stored there with the
+ * layout of struct message, an int32_t length and an int32_t 0 followed by
+ * the text and its 0, at an offset that is a multiple of 4, so the loaded
+ * ops point into the mapping. An image only holds offsets, so it can be
+ * mapped at any address.
+ */
+struct imageHeader {
+  /** IMAGE_MAGIC without the terminating 0 */
+  char magic[8];
+  /** IMAGE_VERSION */
+  uint32_t version;
+  /** The size of an op record, which also catches a different word size */
+  uint32_t opSize;
+  /** The number of processes */
+  uint32_t processes;
+  /** The number of resources */
+  uint32_t resources;
+  /** The number of mailboxes */
+  uint32_t mailboxes;
+  /** The number of resource sets */
+  uint32_t sets;
+  /** The number of barriers */
+  uint32_t barriers;
+  /** 0, keeps the offsets below 8 byte aligned */
+  uint32_t padding;
+  /** The number of op records, including the END_V op of every process */
+  uint64_t ops;
+  /** The offset of the process records */
+  uint64_t processOffset;
+  /** The offset of the resource records */
+  uint64_t resourceOffset;
+  /** The offset of the mailbox records */
+  uint64_t mailboxOffset;
+  /** The offset of the barrier records */
+  uint64_t barrierOffset;
+  /** The offset of the resource sets, each a uint32_t number of members
+   * followed by the uint32_t resource numbers of the members in increasing
+   * order, padded with zeros to a multiple of 8 bytes */
+  uint64_t setOffset;
+  /** The offset of the op records */
+  uint64_t opOffset;
+  /** The offset of the string area */
+  uint64_t stringOffset;
+  /** The size of the string area */
+  uint64_t stringSize;
+};
+
+/**
+ * A process in an image.
+ */
+struct imageProcess {
+  /** The name of the process */
+  uint64_t name;
+  /** The index of the first op of the process in the op records */
+  uint64_t firstOp;
+  /** The number of instructions one job executes, 0 unless periodic */
+  int64_t cost;
+  /** The base priority of the process */
+  int32_t priority;
+  /** The period of the process, 0 unless periodic */
+  int32_t period;
+  /** The relative deadline of its jobs */
+  int32_t deadline;
+  /** The release jitter of its jobs */
+  int32_t jitter;
+};
+
+/**
+ * A resource, a mailbox or a barrier in an image.
+ */
+struct imageResource {
+  /** The name of the resource, mailbox or barrier */
+  uint64_t name;
+  /** The number of instances of the resource, the number of messages the
+   * mailbox holds, the number of parties of the barrier */
+  uint32_t capacity;
+  /** The overflow policy of a topic, see topic.h, the priority inversion
+   * protocol of a resource, see loader.h, 0 for a plain mailbox or a
+   * barrier */
+  uint32_t policy;
+  /** The priority ceiling of a resource, 0 for a mailbox or a barrier */
+  int32_t ceiling;
+  /** 0, keeps the records 8 byte aligned */
+  uint32_t padding;
+};
+
+/**
+ * An op in an image. It has the layout of struct op with offsets in place
+ * of the pointers, so loading turns the records into ops where they are.
+ */
+struct imageOp {
+  /** 0, the code address is only known once the image is loaded */
+  uint64_t code;
+  /** The type of instruction */
+  int32_t type;
+  /** The index of the resource, mailbox, resource set or barrier, -1 if the
+   * name is unknown */
+  int32_t operand;
+  /** The resource or mailbox name */
+  uint64_t name;
+  /** The message of a send instruction, 0 for any other */
+  uint64_t msg;
+};
+
+/*
+ * Writes the compiled workload of sim to filename. Returns 0 on success or
+ * -1 on failure.
+ */
+int image_save(struct simulator *sim, const char *filename);
+
+/*
+ * Returns 1 if the file starts with IMAGE_MAGIC, otherwise 0.
+ */
+int image_detect(const char *filename);
+
+/*
+ * Maps the image in filename and loads it into the empty simulator sim.
+ * Returns 0 on success or -1 if the file is not a valid image.
+ */
+int image_load(struct simulator *sim, const char *filename);
+
+/*
+ * Frees a simulator loaded with image_load and unmaps its image.
+ */
+void image_unload(struct simulator *sim);
+
+/*
+ * Turns the op record of an image with the given header and string area
+ * into op. Returns 0 on success or -1 if the record is not valid.
+ */
+int image_op(const struct imageOp *record, const struct imageHeader *header,
+             char *strings, const void *const *handlers, struct op *op);
+
+#endif
@@ -5,46 +5,32 @@
 #include "loader.h"
 #include "manager.h"
 #include "queue.h"
+#include "simulator.h"
 #include "syntax.h"
+#include "table.h"
+#include "topic.h"
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-struct queue *ready_queue();
-struct queue *waiting_queue();
-struct queue *terminated_queue();
-
 void dealloc_page(struct page *p);
-void dealloc_cpuSchedule(struct cpuSchedule *s);
 void dealloc_resourceList(struct resourceList *r);
-void dealloc_mailboxes();
-void dealloc_queues();
-
-void debug_process_memory();
-void debug_resources();
-
-struct processControlBlock *firstPCB = NULL;
-struct processControlBlock *currentPCB = NULL;
-struct processControlBlock *pcb = NULL;
-
-static struct queue *readyQueue = NULL;
-static struct queue *waitingQueue = NULL;
-static struct queue *terminatedQueue = NULL;
-
-struct resourceList *firstResource = NULL;
-struct resourceList *currentResource = NULL;
-struct resourceList *resource = NULL;
+void dealloc_mailboxes(struct simulator *sim);
 
-struct instruction *firstInstruction = NULL;
-struct instruction *currentInstruction = NULL;
-struct instruction *instruct = NULL;
+struct processControlBlock *find_process(struct simulator *sim,
+                                         char *process_name);
 
-struct mailbox *firstMailbox = NULL;
-struct mailbox *currentMailbox = NULL;
-struct mailbox *mail = NULL;
+static void set_instruction(struct instruction *instruct, char *instruction,
+                            char *resource_name, char *msg);
+static unsigned int holder_home(const struct resourceList *resource,
+                                int holder);
+static int holder_slot(const struct resourceList *resource, int holder);
+static void grow_holder_index(struct resourceList *resource);
+static void remove_holder_slot(struct resourceList *resource, int slot);
 
-char *currentProcessName = "";
-int processNumber = 0;
+void debug_process_memory(struct simulator *sim);
+void debug_resources(struct simulator *sim);
 
 /**
  * \brief Initialises and loads the processes specified in the process.list
@@ -52,106 +38,260 @@ int processNumber = 0;
  *
  * This function initialises a new process control block for the process being
  * loaded from the process.list file. It initialises a number of pointers to
- * NULL as well as setting the processState to NEW. Furthermore the process is
- * indicated to be ready by using bit test and set to set the corresponding
- * bit to 1 in the ready queue.
+ * NULL and adds the process to the process table, where its state starts out
+ * as NEW. Furthermore the process is added to the ready queue. A name ending
+ * in a colon and a number, e.g. P1:3, is a process with that base priority
+ * and a name ending in @ and a period, e.g. P1@20 or P1:3@20/15~2, a
+ * periodic process, see cut_timing; the suffixes are cut off the name.
  *
+ * \param sim The simulator to load the process into.
  * \param process_name The name of the new process to load
  */
-void load_process(char *process_name) {
+void load_process(struct simulator *sim, char *process_name) {
   struct page *newPage;
-  struct cpuSchedule *schedule;
+  struct processControlBlock *newPCB;
+  struct processTable *table = &sim->table;
+  int priority;
+  int period;
+  int deadline;
+  int jitter;
+
+  cut_timing(process_name, &period, &deadline, &jitter);
+  priority = cut_priority(process_name);
 
   newPage = malloc(sizeof(struct page));
-  schedule = malloc(sizeof(struct cpuSchedule));
-
-  if (firstPCB == NULL) {
-    firstPCB = malloc(sizeof(struct processControlBlock));
-    firstPCB->pagePtr = newPage;
-    firstPCB->processState = NEW;
-    firstPCB->nextInstruction = NULL;
-    firstPCB->cpuSchedulePtr = schedule;
-    firstPCB->resourceListPtr = NULL;
-    firstPCB->next = NULL;
-
-    currentPCB = firstPCB;
-  } else {
-    pcb = malloc(sizeof(struct processControlBlock));
-    pcb->pagePtr = newPage;
-    pcb->processState = NEW;
-    pcb->nextInstruction = NULL;
-    pcb->cpuSchedulePtr = schedule;
-    pcb->resourceListPtr = NULL;
-    pcb->next = NULL;
+  newPCB = malloc(sizeof(struct processControlBlock));
+
+  newPage->name = process_name;
+  newPage->priority = priority;
+  newPage->period = period;
+  newPage->deadline = deadline;
+  newPage->jitter = jitter;
+  newPage->cost = 0;
+  newPage->number = table_add(table, newPCB);
+  table->priority[newPage->number] = priority;
+  newPage->firstInstruction = NULL;
+  newPage->program = NULL;
+  newPage->loopNesting = 0;
+
+  newPCB->pagePtr = newPage;
+  newPCB->resourceListPtr = NULL;
+  newPCB->spareResources = NULL;
+  newPCB->stats.executed = 0;
+  newPCB->stats.waits = 0;
+  newPCB->stats.slices = 0;
+  newPCB->stats.jobs = 0;
+  newPCB->stats.missed = 0;
+  newPCB->stats.worstResponse = 0;
+  newPCB->next = NULL;
 
-    currentPCB->next = pcb;
-    currentPCB = pcb;
+  if (sim->firstPCB == NULL) {
+    sim->firstPCB = newPCB;
+  } else {
+    sim->currentPCB->next = newPCB;
   }
-  currentPCB->pagePtr->name = process_name;
-  currentPCB->pagePtr->number = processNumber;
-  currentPCB->cpuSchedulePtr->readyQueue = ready_queue();
-  currentPCB->cpuSchedulePtr->waitingQueue = waiting_queue();
-  currentPCB->cpuSchedulePtr->terminatedQueue = terminated_queue();
+  sim->currentPCB = newPCB;
 
-  process_to_readyq(currentPCB->cpuSchedulePtr, currentPCB);
+  process_to_readyq(table, newPage->number);
 
 #ifdef DEBUG
-  printf("Added Process %d to the readyQueue\n", currentPCB->pagePtr->number);
+  printf("Added Process %d to the readyQueue\n", newPage->number);
 #endif
 
-  processNumber++;
-
 #ifdef DEBUG
-  debug_process_memory();
+  debug_process_memory(sim);
 #endif
 }
 
+/**
+ * @brief Cuts the priority off a process name.
+ *
+ * @param process_name The name, e.g. P1:3 for a process with priority 3.
+ *
+ * @return The priority, 0 if the name does not end in a colon and a number
+ * from 0 to INT_MAX.
+ */
+int cut_priority(char *process_name) {
+  char *suffix = strrchr(process_name, ':');
+  char *end;
+  long priority;
+
+  if (suffix == NULL || suffix[1] == '\0') {
+    return 0;
+  }
+  priority = strtol(suffix + 1, &end, 10);
+  if (*end != '\0' || priority < 0 || priority > INT_MAX) {
+    return 0;
+  }
+  *suffix = '\0';
+  return priority;
+}
+
+/**
+ * @brief Cuts the timing off the name of a periodic process.
+ *
+ * A periodic process runs its program once per job, and a job arrives every
+ * period ticks. It is released up to jitter ticks after it arrives and must
+ * complete deadline ticks after it arrives.
+ *
+ * @param process_name The name, e.g. P1@20 for a period of 20, P1@20/15 for
+ * a deadline of 15 and P1@20/15~2 or P1@20~2 for a jitter of 2.
+ * @param period Set to the period, 0 if the name does not end in a valid
+ * timing: a period from 1 to INT_MAX, a deadline from 1 to the period and a
+ * jitter from 0 to INT_MAX.
+ * @param deadline Set to the deadline, the period unless given.
+ * @param jitter Set to the jitter, 0 unless given.
+ */
+void cut_timing(char *process_name, int *period, int *deadline,
+                int *jitter) {
+  char *suffix = strrchr(process_name, '@');
+  char *start;
+  char *end;
+  long value[3] = {0, 0, 0};
+  int i = 0;
+
+  *period = *deadline = *jitter = 0;
+  if (suffix == NULL) {
+    return;
+  }
+  /* Each number must have digits and be followed by the next separator */
+  for (end = suffix; i < 3; i++) {
+    if (*end != "@/~"[i]) {
+      continue;
+    }
+    start = end + 1;
+    value[i] = strtol(start, &end, 10);
+    if (end == start || value[i] < (i == 2 ? 0 : 1) || value[i] > INT_MAX) {
+      return;
+    }
+    if (i == 0) {
+      value[1] = value[0];
+    }
+  }
+  if (*end != '\0' || value[1] > value[0]) {
+    return;
+  }
+  *suffix = '\0';
+  *period = value[0];
+  *deadline = value[1];
+  *jitter = value[2];
+}
+
 /**
  * @brief Loads the mailbox from the process.list file.
  *
- * Initialises and loads the mailboxes list.
+ * Initialises and loads the mailboxes list. A name ending in a colon and a
+ * number, e.g. M1:64, is a mailbox holding that many messages. A name
+ * ending in a colon and an overflow policy, e.g. T1:64:drop-oldest or
+ * T2:block, is a topic. The suffixes are cut off the name.
  *
+ * @param sim The simulator to load the mailbox into.
  * @param mailboxName The name of the mailbox to load.
  */
-void load_mailbox(char *mailboxName) {
+void load_mailbox(struct simulator *sim, char *mailboxName) {
+  struct mailbox *mail = malloc(sizeof(struct mailbox));
+  char *count = strrchr(mailboxName, ':');
+  char *end;
+  long capacity = 1;
+  int policy = 0;
 
-  if (firstMailbox == NULL) {
-    firstMailbox = malloc(sizeof(struct mailbox));
-    firstMailbox->next = NULL;
-    currentMailbox = firstMailbox;
+  if (count != NULL) {
+    if (strcmp(count + 1, BLOCK) == 0) {
+      policy = TOPIC_BLOCK;
+    } else if (strcmp(count + 1, DROP_OLDEST) == 0) {
+      policy = TOPIC_DROP_OLDEST;
+    } else if (strcmp(count + 1, DISCONNECT) == 0) {
+      policy = TOPIC_DISCONNECT;
+    }
+    if (policy != 0) {
+      *count = '\0';
+      count = strrchr(mailboxName, ':');
+    }
+  }
+  if (count != NULL && count[1] != '\0') {
+    capacity = strtol(count + 1, &end, 10);
+    if (*end == '\0' && capacity >= 1 && capacity <= MAILBOX_MAX_CAPACITY) {
+      *count = '\0';
+    } else {
+      capacity = 1;
+    }
+  }
+
+  if (sim->firstMailbox == NULL) {
+    sim->firstMailbox = mail;
   } else {
-    mail = malloc(sizeof(struct mailbox));
-    currentMailbox->next = mail;
-    currentMailbox = mail;
+    sim->currentMailbox->next = mail;
+  }
+  sim->currentMailbox = mail;
+  init_mailbox(mail, mailboxName, capacity);
+  mail->counted = 1;
+  if (policy != 0) {
+    topic_init(mail, policy);
   }
-  currentMailbox->name = mailboxName;
-  currentMailbox->next = NULL;
 }
 
 /**
  * @brief Load the resource from the process.list file.
  *
  * Initialises and loads the resource to create a resource list. The resource
- * is indicated as available and the resource name is stored.
+ * is indicated as available and the resource name is stored. A name ending
+ * in a colon and a number, e.g. R1:8, is a counted resource with that many
+ * instances. A name ending in a colon and a protocol, e.g. R1:inherit or
+ * R1:8:ceiling, protects the processes waiting for it from priority
+ * inversion. The suffixes are cut off the name.
  *
+ * @param sim The simulator to load the resource into.
  * @param resource_name The name of the resource which is loaded.
  */
-void load_resource(char *resource_name) {
-  if (firstResource == NULL) {
-    firstResource = malloc(sizeof(struct resourceList));
-    currentResource = firstResource;
+void load_resource(struct simulator *sim, char *resource_name) {
+  struct resourceList *resource = malloc(sizeof(struct resourceList));
+  char *count = strrchr(resource_name, ':');
+  char *end;
+  long capacity = 1;
+  int protocol = 0;
+
+  if (count != NULL) {
+    if (strcmp(count + 1, INHERIT) == 0) {
+      protocol = RESOURCE_INHERIT;
+    } else if (strcmp(count + 1, CEILING) == 0) {
+      protocol = RESOURCE_CEILING;
+    }
+    if (protocol != 0) {
+      *count = '\0';
+      count = strrchr(resource_name, ':');
+    }
+  }
+  if (count != NULL && count[1] != '\0') {
+    capacity = strtol(count + 1, &end, 10);
+    if (*end == '\0' && capacity >= 0 && capacity <= INT_MAX) {
+      *count = '\0';
+    } else {
+      capacity = 1;
+    }
+  }
+
+  if (sim->firstResource == NULL) {
+    sim->firstResource = resource;
   } else {
-    resource = malloc(sizeof(struct resourceList));
-    currentResource->next = resource;
-    currentResource = resource;
+    sim->currentResource->next = resource;
   }
-  currentResource->name = resource_name;
-  /* 1 = Available, 0 = Unavailable */
-  currentResource->available = 1;
-  currentResource->next = NULL;
+  sim->currentResource = resource;
+  resource->name = resource_name;
+  resource->number = -1;
+  resource->available = resource->capacity = capacity;
+  resource->protocol = protocol;
+  resource->ceiling = 0;
+  resource->readers = resource->wokenReaders = 0;
+  resource->holder = -1;
+  resource->resource = NULL;
+  resource->holders = resource->nextHolder = resource->prevHolder = NULL;
+  resource->holderIndex = NULL;
+  resource->holderSlots = resource->holderCount = 0;
+  resource->prevHeld = resource->olderHeld = NULL;
+  resource->next = NULL;
 
 #ifdef DEBUG
-  debug_resources();
+  debug_resources(sim);
 #endif
 }
 
@@ -162,61 +302,212 @@ void load_resource(char *resource_name) {
  * which the instruction should be loaded as well as the resource
  * on which the action is performed.
  *
+ * @param sim The simulator holding the process.
  * @param process_name The name of the process for which to load the
  * instruction.
  * @param resource_name The name of the resource used in the instruction.
  * @param instruction Indicates the next request, release or message to send.
+ *
+ * @return 0 on success, also if the process is not declared and the
+ * instruction is dropped, or -1 if the instruction is not in a named Process
+ * section, which leaves no process to append it to.
  */
-void load_process_instruction(char *process_name, char *instruction,
-                              char *resource_name, char *msg) {
+int load_process_instruction(struct simulator *sim, char *process_name,
+                             char *instruction, char *resource_name,
+                             char *msg) {
+  struct instruction *instruct;
+  struct processControlBlock *pcb;
 
 #ifdef DEBUG
   printf("In load_process_instruction for %s: %s -> %s\n", process_name,
          instruction, resource_name);
 #endif
 
-  if (strcmp(currentProcessName, process_name) != 0) {
-    firstInstruction = malloc(sizeof(struct instruction));
-    firstInstruction->next = NULL;
-    currentInstruction = firstInstruction;
+  if (process_name[0] == '\0') {
+    free(resource_name);
+    free(msg);
+    return -1;
+  }
+
+  if (sim->currentInstruction == NULL ||
+      strcmp(sim->currentProcessName, process_name) != 0) {
+    pcb = find_process(sim, process_name);
+    if (pcb == NULL) {
+      printf("Process %s is not declared in Processes\n", process_name);
+      free(resource_name);
+      free(msg);
+      return 0;
+    }
+    sim->currentPCB = pcb;
+    sim->currentProcessName = pcb->pagePtr->name;
+    instruct = malloc(sizeof(struct instruction));
+    pcb->pagePtr->firstInstruction = instruct;
+#ifdef DEBUG
+    printf("Store a pointer to the first instruction of the process in it's "
+           "page.\n");
+#endif
   } else {
     instruct = malloc(sizeof(struct instruction));
-    instruct->next = NULL;
-    currentInstruction->next = instruct;
-    currentInstruction = instruct;
+    sim->currentInstruction->next = instruct;
   }
+  instruct->next = NULL;
+  sim->currentInstruction = instruct;
+  set_instruction(instruct, instruction, resource_name, msg);
+  return 0;
+}
+
+/**
+ * @brief Starts a subroutine.
+ *
+ * The instructions loaded with load_subroutine_instruction are appended to
+ * the subroutine loaded last.
+ *
+ * @param sim The simulator to load the subroutine into.
+ * @param subroutine_name The name of the subroutine.
+ */
+void load_subroutine(struct simulator *sim, char *subroutine_name) {
+  struct subroutine *sub = malloc(sizeof(struct subroutine));
 
-  currentInstruction->resource = resource_name;
+  sub->name = subroutine_name;
+  sub->firstInstruction = NULL;
+  sub->lastInstruction = NULL;
+  sub->expanding = 0;
+  sub->next = sim->firstSubroutine;
+  sim->firstSubroutine = sub;
+}
+
+/**
+ * @brief Loads an instruction of the subroutine loaded last.
+ *
+ * @param sim The simulator holding the subroutine.
+ * @param instruction Indicates the next request, release, message, loop or
+ * call.
+ * @param resource_name The name of the resource used in the instruction.
+ * @param msg The message of a send or receive instruction.
+ */
+void load_subroutine_instruction(struct simulator *sim, char *instruction,
+                                 char *resource_name, char *msg) {
+  struct subroutine *sub = sim->firstSubroutine;
+  struct instruction *instruct;
+
+  if (sub == NULL) {
+    free(resource_name);
+    free(msg);
+    return;
+  }
+
+  instruct = malloc(sizeof(struct instruction));
+  instruct->next = NULL;
+  if (sub->firstInstruction == NULL) {
+    sub->firstInstruction = instruct;
+  } else {
+    sub->lastInstruction->next = instruct;
+  }
+  sub->lastInstruction = instruct;
+  set_instruction(instruct, instruction, resource_name, msg);
+}
+
+/**
+ * @brief Returns the subroutine with the given name.
+ *
+ * A subroutine defined more than once resolves to its last definition.
+ *
+ * @param sim The simulator holding the subroutines.
+ * @param subroutine_name The name to look for.
+ *
+ * @return The subroutine or NULL if there is no such subroutine.
+ */
+struct subroutine *find_subroutine(struct simulator *sim,
+                                   const char *subroutine_name) {
+  struct subroutine *sub;
+
+  for (sub = sim->firstSubroutine; sub != NULL; sub = sub->next) {
+    if (strcmp(sub->name, subroutine_name) == 0) {
+      return sub;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Decodes the keyword of an instruction into its type.
+ *
+ * The instruction takes over the resource name and, for a send or receive
+ * instruction, the message; other instructions free the message.
+ */
+static void set_instruction(struct instruction *instruct, char *instruction,
+                            char *resource_name, char *msg) {
+  instruct->resource = resource_name;
+  instruct->msg = NULL;
   if (strcmp(instruction, REQ) == 0) {
-    currentInstruction->type = REQ_V;
-    currentInstruction->msg = NULL;
+    /* A bracketed list of resources is requested all at once */
+    instruct->type = resource_name != NULL && resource_name[0] == LEFTBRACKET
+                         ? REQSET_V
+                         : REQ_V;
+  } else if (strcmp(instruction, REQS) == 0) {
+    instruct->type = REQS_V;
   } else if (strcmp(instruction, REL) == 0) {
-    currentInstruction->type = REL_V;
-    currentInstruction->msg = NULL;
+    instruct->type = REL_V;
   } else if (strcmp(instruction, SEND) == 0) {
-    currentInstruction->type = SEND_V;
-    currentInstruction->msg = msg;
+    instruct->type = SEND_V;
+    instruct->msg = msg;
   } else if (strcmp(instruction, RECV) == 0) {
-    currentInstruction->type = RECV_V;
-    currentInstruction->msg = msg;
+    instruct->type = RECV_V;
+    instruct->msg = msg;
+  } else if (strcmp(instruction, DRAIN) == 0) {
+    instruct->type = DRAIN_V;
+    instruct->msg = msg;
+  } else if (strcmp(instruction, SUBSCRIBE) == 0) {
+    instruct->type = SUBSCRIBE_V;
+  } else if (strcmp(instruction, UNSUBSCRIBE) == 0) {
+    instruct->type = UNSUBSCRIBE_V;
+  } else if (strcmp(instruction, SYNC) == 0) {
+    instruct->type = SYNC_V;
+    instruct->msg = msg;
+  } else if (strcmp(instruction, REPEAT) == 0) {
+    instruct->type = REPEAT_V;
+  } else if (strcmp(instruction, BLOCKEND) == 0) {
+    instruct->type = LOOP_V;
+  } else if (strcmp(instruction, CALL) == 0) {
+    instruct->type = CALL_V;
+  }
+  if (instruct->msg != msg) {
+    free(msg);
   }
+}
 
-  if (strcmp(currentPCB->pagePtr->name, process_name) != 0) {
-    currentPCB = firstPCB;
-    do {
-      if (strcmp(currentPCB->pagePtr->name, process_name) == 0) {
-        break;
-      }
-      currentPCB = currentPCB->next;
-    } while (currentPCB != NULL);
-    currentPCB->nextInstruction = firstInstruction;
-    currentPCB->pagePtr->firstInstruction = firstInstruction;
-#ifdef DEBUG
-    printf("Store a pointer to the first instruction of the process in it's "
-           "page.\n");
-#endif
+/**
+ * @brief Finds the loaded process with the given name.
+ *
+ * Process sections usually follow the order of the Processes line, so the
+ * search starts after the process that was loaded last and wraps around.
+ *
+ * @param sim The simulator holding the processes.
+ * @param process_name The name of the process to find.
+ *
+ * @return The process control block or NULL if there is no such process.
+ */
+struct processControlBlock *find_process(struct simulator *sim,
+                                         char *process_name) {
+  struct processControlBlock *start;
+  struct processControlBlock *p;
+
+  if (sim->firstPCB == NULL) {
+    return NULL;
   }
-  currentProcessName = process_name;
+
+  start = (sim->currentPCB != NULL && sim->currentPCB->next != NULL)
+              ? sim->currentPCB->next
+              : sim->firstPCB;
+  p = start;
+  do {
+    if (strcmp(p->pagePtr->name, process_name) == 0) {
+      return p;
+    }
+    p = p->next != NULL ? p->next : sim->firstPCB;
+  } while (p != start);
+
+  return NULL;
 }
 
 /**
@@ -226,10 +517,12 @@ void load_process_instruction(char *process_name, char *instruction,
  * Returns a pointer to the first process in the list
  * of loaded processes.
  *
+ * @param sim The simulator holding the processes.
+ *
  * @return firstPCB Pointer to the first process control block.
  */
-struct processControlBlock *get_loaded_processes() {
-  return firstPCB;
+struct processControlBlock *get_loaded_processes(struct simulator *sim) {
+  return sim->firstPCB;
 }
 
 /**
@@ -237,10 +530,12 @@ struct processControlBlock *get_loaded_processes() {
  *
  * Returns the first pointer to the available resources.
  *
+ * @param sim The simulator holding the resources.
+ *
  * @return firstResource Pointer to the resource list.
  */
-struct resourceList *get_available_resources() {
-  return firstResource;
+struct resourceList *get_available_resources(struct simulator *sim) {
+  return sim->firstResource;
 }
 
 /**
@@ -248,165 +543,523 @@ struct resourceList *get_available_resources() {
  *
  * Returns the first pointer to the available mailboxes.
  *
+ * @param sim The simulator holding the mailboxes.
+ *
  * @return firstMailbox Pointer to the mailbox list.
  */
-struct mailbox *get_mailboxes() {
-  return firstMailbox;
+struct mailbox *get_mailboxes(struct simulator *sim) {
+  return sim->firstMailbox;
+}
+
+/**
+ * @brief Returns the process table of the loaded processes.
+ *
+ * @param sim The simulator holding the processes.
+ *
+ * @return processTable Pointer to the process table.
+ */
+struct processTable *get_process_table(struct simulator *sim) {
+  return &sim->table;
 }
 
 /**
- * @brief Returns the readyQueue for the CPU scheduler.
+ * @brief Creates an acquired instance of a resource.
+ *
+ * The instance becomes the first in the list of the process and of the
+ * holders of the resource, and the newest instance of the process in the
+ * holder index of the resource. Its node is taken from the instances the
+ * process released before, so a process that keeps acquiring and releasing
+ * resources allocates no memory once it held as many as it ever holds at a
+ * time. The caller counts it.
  *
- * Initialises and returns the readyQueue for the CPU scheduler. If the queue
- * has been initialised it just returns the pointer to the queue.
+ * @param pcb The process that acquires the instance.
+ * @param resource The system resource.
  *
- * @return readyQueue Pointer to the readyQueue for the CPU scheduler.
+ * @return The acquired instance.
  */
+struct resourceList *link_holder(struct processControlBlock *pcb,
+                                 struct resourceList *resource) {
+  struct resourceList *held = pcb->spareResources;
+  int slot;
 
-struct queue *ready_queue() {
-  if (readyQueue == NULL) {
-    struct queue *readyq = malloc(sizeof(struct queue));
-    readyQueue = readyq;
-    return readyq;
+  if (held != NULL) {
+    pcb->spareResources = held->next;
+  } else {
+    held = malloc(sizeof(struct resourceList));
+  }
+  held->name = resource->name;
+  held->number = resource->number;
+  held->available = held->capacity = 0;
+  held->protocol = held->ceiling = 0;
+  held->readers = held->wokenReaders = 0;
+  held->holder = pcb->pagePtr->number;
+  held->resource = resource;
+  held->holders = NULL;
+  held->holderIndex = NULL;
+  held->holderSlots = held->holderCount = 0;
+  held->prevHolder = NULL;
+  held->nextHolder = resource->holders;
+  if (resource->holders != NULL) {
+    resource->holders->prevHolder = held;
+  }
+  resource->holders = held;
+
+  held->prevHeld = NULL;
+  held->next = pcb->resourceListPtr;
+  if (held->next != NULL) {
+    held->next->prevHeld = held;
+  }
+  pcb->resourceListPtr = held;
+
+  /* Keep the index at most half full */
+  if (2 * (resource->holderCount + 1) > resource->holderSlots) {
+    grow_holder_index(resource);
+  }
+  slot = holder_slot(resource, held->holder);
+  held->olderHeld = resource->holderIndex[slot];
+  if (held->olderHeld == NULL) {
+    ++resource->holderCount;
+  }
+  resource->holderIndex[slot] = held;
+  return held;
+}
+
+/**
+ * @brief Returns the newest instance of a resource a process holds.
+ *
+ * @param resource The system resource.
+ * @param holder The number of the process.
+ *
+ * @return The instance, NULL if the process holds none.
+ */
+struct resourceList *find_holder(struct resourceList *resource, int holder) {
+  if (resource->holderCount == 0) {
+    return NULL;
   }
-  return readyQueue;
+  return resource->holderIndex[holder_slot(resource, holder)];
 }
 
 /**
- * @brief Returns the waitingQueue for the CPU scheduler.
+ * @brief Removes an acquired instance from the list of the process and the
+ * holders of its resource and keeps it for the next acquire of the process.
  *
- * Initialises and returns the waitingQueue for the CPU scheduler. If the queue
- * has been initialised it just returns the pointer to the queue.
+ * The instance must be the newest of its resource the process holds, as
+ * find_holder and the head of the list of the process are. Its older
+ * instance, if any, takes its place in the holder index.
  *
- * @return waitingQueue Pointer to the readyQueue for the CPU scheduler.
+ * @param pcb The process that held the instance.
+ * @param held The acquired instance.
  */
+void unlink_holder(struct processControlBlock *pcb,
+                   struct resourceList *held) {
+  struct resourceList *resource = held->resource;
+  int slot = holder_slot(resource, held->holder);
 
-struct queue *waiting_queue() {
-  if (waitingQueue == NULL) {
-    struct queue *waitingq = malloc(sizeof(struct queue));
-    waitingQueue = waitingq;
-    return waitingq;
+  if (held->olderHeld != NULL) {
+    resource->holderIndex[slot] = held->olderHeld;
+  } else {
+    remove_holder_slot(resource, slot);
   }
-  return waitingQueue;
+
+  if (held->prevHolder != NULL) {
+    held->prevHolder->nextHolder = held->nextHolder;
+  } else {
+    resource->holders = held->nextHolder;
+  }
+  if (held->nextHolder != NULL) {
+    held->nextHolder->prevHolder = held->prevHolder;
+  }
+
+  if (held->prevHeld != NULL) {
+    held->prevHeld->next = held->next;
+  } else {
+    pcb->resourceListPtr = held->next;
+  }
+  if (held->next != NULL) {
+    held->next->prevHeld = held->prevHeld;
+  }
+
+  held->next = pcb->spareResources;
+  pcb->spareResources = held;
+}
+
+/**
+ * @brief Forgets every holder of a system resource.
+ *
+ * The instances stay in the lists of their processes, the caller takes
+ * care of them.
+ *
+ * @param resource The system resource.
+ */
+void clear_holders(struct resourceList *resource) {
+  int i;
+
+  resource->holders = NULL;
+  for (i = 0; i < resource->holderSlots; i++) {
+    resource->holderIndex[i] = NULL;
+  }
+  resource->holderCount = 0;
+}
+
+/**
+ * @brief Finds the slot of a process in the holder index of a resource.
+ *
+ * The index is probed linearly from the hash of the process.
+ *
+ * @return The slot holding the newest instance of the process or, if the
+ * process holds none, the empty slot where it belongs.
+ */
+static int holder_slot(const struct resourceList *resource, int holder) {
+  unsigned int mask = resource->holderSlots - 1;
+  unsigned int slot = holder_home(resource, holder);
+
+  while (resource->holderIndex[slot] != NULL &&
+         resource->holderIndex[slot]->holder != holder) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/**
+ * @brief Returns the slot of the holder index a process hashes to.
+ */
+static unsigned int holder_home(const struct resourceList *resource,
+                                int holder) {
+  /* Fibonacci hashing spreads consecutive process numbers */
+  return ((unsigned int)holder * 2654435761u) & (resource->holderSlots - 1);
+}
+
+/**
+ * @brief Doubles the holder index of a resource, 8 slots at first.
+ */
+static void grow_holder_index(struct resourceList *resource) {
+  struct resourceList **old = resource->holderIndex;
+  int slots = resource->holderSlots;
+  int i;
+
+  resource->holderSlots = slots == 0 ? 8 : 2 * slots;
+  resource->holderIndex =
+      calloc(resource->holderSlots, sizeof(struct resourceList *));
+  for (i = 0; i < slots; i++) {
+    if (old[i] != NULL) {
+      resource->holderIndex[holder_slot(resource, old[i]->holder)] = old[i];
+    }
+  }
+  free(old);
+}
+
+/**
+ * @brief Empties a slot of the holder index of a resource.
+ *
+ * The entries probed past the slot are moved back into it where their hash
+ * allows, so every entry stays reachable without tombstones.
+ */
+static void remove_holder_slot(struct resourceList *resource, int slot) {
+  unsigned int mask = resource->holderSlots - 1;
+  unsigned int hole = slot;
+  unsigned int next = slot;
+  unsigned int home;
+
+  resource->holderIndex[hole] = NULL;
+  for (;;) {
+    next = (next + 1) & mask;
+    if (resource->holderIndex[next] == NULL) {
+      break;
+    }
+    home = holder_home(resource, resource->holderIndex[next]->holder);
+    /* The entry may move into the hole unless its home lies cyclically
+     * between the hole and the entry */
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      resource->holderIndex[hole] = resource->holderIndex[next];
+      resource->holderIndex[next] = NULL;
+      hole = next;
+    }
+  }
+  --resource->holderCount;
+}
+
+/**
+ * @brief Creates a message.
+ *
+ * The text is copied behind the header of the message, so the message is a
+ * single allocation that is never copied again.
+ *
+ * @param text The text, which needs not end with a 0.
+ * @param length The length of the text.
+ *
+ * @return The message, with one reference for the caller.
+ */
+struct message *create_message(const char *text, int length) {
+  struct message *msg = malloc(sizeof(struct message) + length + 1);
+
+  msg->length = length;
+  msg->refs = 1;
+  memcpy(msg->text, text, length);
+  msg->text[length] = '\0';
+  return msg;
+}
+
+/**
+ * @brief Drops a reference to a message, freeing it with the last one.
+ *
+ * @param msg The message, or NULL.
+ */
+void release_message(struct message *msg) {
+  if (msg != NULL && --msg->refs == 0) {
+    free(msg);
+  }
+}
+
+/**
+ * @brief Initialises an empty mailbox.
+ *
+ * The ring is only allocated by the first message. The mailbox borrows its
+ * messages until the caller sets counted.
+ *
+ * @param mail The mailbox.
+ * @param name The name of the mailbox, which it takes over.
+ * @param capacity The maximum number of messages, at most
+ * MAILBOX_MAX_CAPACITY.
+ */
+void init_mailbox(struct mailbox *mail, char *name, int capacity) {
+  mail->name = name;
+  mail->messages = NULL;
+  mail->counted = 0;
+  mail->capacity = capacity;
+  mail->slots = 0;
+  mail->head = 0;
+  mail->count = 0;
+  mail->topic = NULL;
+  mail->next = NULL;
+}
+
+/**
+ * @brief Appends a message to a mailbox.
+ *
+ * A full ring is doubled and its wrapped part moved behind the old end, so
+ * appending takes constant amortized time and the ring never holds more
+ * than twice the capacity. Only the pointer to the message is stored.
+ *
+ * @param mail A mailbox with fewer than capacity messages.
+ * @param msg The message, referenced by the mailbox if it is counted.
+ */
+void mailbox_put(struct mailbox *mail, struct message *msg) {
+  int slots;
+
+  if (mail->count == mail->slots) {
+    slots = mail->slots > 0 ? 2 * mail->slots : 8;
+    mail->messages = realloc(mail->messages, sizeof(struct message *) * slots);
+    memcpy(mail->messages + mail->slots, mail->messages,
+           sizeof(struct message *) * mail->head);
+    mail->slots = slots;
+  }
+  if (mail->counted) {
+    ++msg->refs;
+  }
+  mail->messages[(mail->head + mail->count++) & (mail->slots - 1)] = msg;
 }
 
 /**
- * @brief Returns the terminatedQueue for the CPU scheduler.
+ * @brief Returns a message of a mailbox.
  *
- * Initialises and returns the terminatedQueue for the CPU scheduler. If the
- * queue has been initialised it just returns the pointer to the queue.
+ * @param mail The mailbox.
+ * @param i The position of the message, 0 for the oldest.
  *
- * @return terminatedQueue Pointer to the terminatedQueue for the CPU scheduler.
+ * @return The message.
  */
+struct message *mailbox_message(const struct mailbox *mail, int i) {
+  return mail->messages[(mail->head + i) & (mail->slots - 1)];
+}
 
-struct queue *terminated_queue() {
+/**
+ * @brief Removes the oldest messages of a mailbox.
+ *
+ * Only moves the head, unless the mailbox is counted and releases them.
+ *
+ * @param mail The mailbox.
+ * @param n The number of messages to remove, at most the number held.
+ */
+void mailbox_drop(struct mailbox *mail, int n) {
+  int i;
 
-  if (terminatedQueue == NULL) {
-    struct queue *terminatedq = malloc(sizeof(struct queue));
-    terminatedQueue = terminatedq;
-    return terminatedq;
+  if (mail->counted) {
+    for (i = 0; i < n; i++) {
+      release_message(mail->messages[(mail->head + i) & (mail->slots - 1)]);
+    }
   }
-  return terminatedQueue;
+  mail->count -= n;
+  mail->head = mail->count > 0 ? (mail->head + n) & (mail->slots - 1) : 0;
+}
+
+/**
+ * @brief Frees the ring of a mailbox and releases its messages.
+ *
+ * The mailbox is an empty plain mailbox afterwards and its name is left
+ * alone.
+ *
+ * @param mail The mailbox.
+ */
+void free_mailbox(struct mailbox *mail) {
+  mailbox_drop(mail, mail->count);
+  topic_free(mail);
+  free(mail->messages);
+  mail->messages = NULL;
+  mail->slots = 0;
 }
 
 /**
  * @brief Frees all the memory allocated for the processes.
  *
  * Iterates over the loaded processes, starting from the first, freeing all the
- * allocated memory assigned to each process.
+ * allocated memory assigned to each process. Afterwards the loader is empty
+ * again and a new process file can be loaded.
+ *
+ * @param sim The simulator holding the processes.
  */
-void dealloc_processes() {
+void dealloc_processes(struct simulator *sim) {
   struct processControlBlock *current;
   struct processControlBlock *next;
   struct resourceList *availableResources;
 
-  dealloc_queues();
-  current = get_loaded_processes();
+  current = get_loaded_processes(sim);
 
-  do {
+  while (current != NULL) {
     dealloc_page(current->pagePtr);
     /* Instructions are freed after they are executed */
     if (current->resourceListPtr != NULL) {
       dealloc_resourceList(current->resourceListPtr);
     }
-    dealloc_cpuSchedule(current->cpuSchedulePtr);
+    dealloc_resourceList(current->spareResources);
     next = current->next;
     free(current);
     current = next;
-  } while (current != NULL);
+  }
+
+  /* The resources held by the processes share the names of the system
+   * resources, so the names are freed with the system list only */
+  availableResources = get_available_resources(sim);
+  while (availableResources != NULL) {
+    free(availableResources->name);
+    availableResources = availableResources->next;
+  }
+  dealloc_resourceList(get_available_resources(sim));
 
-  availableResources = get_available_resources();
-  dealloc_resourceList(availableResources);
+  dealloc_mailboxes(sim);
+  dealloc_subroutines(sim);
 
-  dealloc_mailboxes();
+  table_free(&sim->table);
+
+  sim->firstPCB = sim->currentPCB = NULL;
+  sim->firstResource = sim->currentResource = NULL;
+  sim->firstMailbox = sim->currentMailbox = NULL;
+  sim->currentInstruction = NULL;
+  sim->currentProcessName = "";
 }
 
 /**
- * @brief Frees the allocated memory for the page struct.
+ * @brief Frees one process with its page, program and acquired resource
+ * list.
  *
- * Frees the name stored in the structed followed by the struct.
+ * The process must already be unlinked from the loaded processes and
+ * removed from the process table. The instances it holds are removed from
+ * the holders of their resources, which stay unavailable like the
+ * resources of any terminated process.
+ *
+ * @param pcb The process control block.
  */
-void dealloc_page(struct page *p) {
-  free(p->name);
-  free(p);
+void dealloc_process(struct processControlBlock *pcb) {
+  struct resourceList *held;
+
+  dealloc_page(pcb->pagePtr);
+  while ((held = pcb->resourceListPtr) != NULL) {
+    unlink_holder(pcb, held);
+  }
+  dealloc_resourceList(pcb->spareResources);
+  free(pcb);
 }
 
 /**
- * @brief Frees the allocated memory for the instruction struct.
+ * @brief Frees every subroutine with its name and instructions.
  *
- * Frees the instruction struct.
+ * @param sim The simulator holding the subroutines.
  */
-void dealloc_instruction(struct instruction *i) {
-  if (i != NULL) {
-    free(i);
+void dealloc_subroutines(struct simulator *sim) {
+  struct subroutine *sub;
+
+  while ((sub = sim->firstSubroutine) != NULL) {
+    sim->firstSubroutine = sub->next;
+    dealloc_subroutine(sub);
   }
 }
 
 /**
- * @brief Frees the queue allocated for the CPU Scheduler.
+ * @brief Frees one subroutine with its name and instructions.
  *
- * Frees the readyQueue, waitingQueue and terminatedQueue allocated for the CPU
- * scheduler.
+ * @param sub The subroutine, which is no longer in the list.
  */
-void dealloc_queues() {
-  struct queueItem *next, *w_current, *r_current, *t_current = NULL;
-  if (waitingQueue != NULL) {
-    w_current = waitingQueue->head;
-    while (w_current != NULL) {
-      next = w_current->next;
-      free(w_current);
-      w_current = next;
-    }
+void dealloc_subroutine(struct subroutine *sub) {
+  struct instruction *next;
+
+  while (sub->firstInstruction != NULL) {
+    next = sub->firstInstruction->next;
+    free(sub->firstInstruction->resource);
+    free(sub->firstInstruction->msg);
+    dealloc_instruction(sub->firstInstruction);
+    sub->firstInstruction = next;
   }
+  free(sub->name);
+  free(sub);
+}
 
-  if (readyQueue != NULL) {
-    r_current = readyQueue->head;
-    while (r_current != NULL) {
-      next = r_current->next;
-      free(r_current);
-      r_current = next;
-    }
+/**
+ * @brief Frees the allocated memory for the page struct.
+ *
+ * Frees the name stored in the structed followed by the struct.
+ */
+void dealloc_page(struct page *p) {
+  struct instruction *next;
+
+  while (p->firstInstruction != NULL) {
+    next = p->firstInstruction->next;
+    free(p->firstInstruction->resource);
+    free(p->firstInstruction->msg);
+    dealloc_instruction(p->firstInstruction);
+    p->firstInstruction = next;
   }
+  dealloc_program(p->program);
+  free(p->name);
+  free(p);
+}
 
-  if (terminatedQueue != NULL) {
-    t_current = terminatedQueue->head;
-    while (t_current != NULL) {
-      next = t_current->next;
-      free(t_current);
-      t_current = next;
-    }
+/**
+ * @brief Frees the compiled program of a process.
+ *
+ * Frees the names and releases the messages of every op up to and including
+ * the END_V op followed by the array itself. A message still queued in a
+ * counted mailbox outlives its op.
+ */
+void dealloc_program(struct op *program) {
+  struct op *op = program;
+
+  if (program == NULL) {
+    return;
   }
+  while (op->type != END_V) {
+    free(op->name);
+    release_message(op->msg);
+    ++op;
+  }
+  free(program);
 }
 
 /**
- * @brief Frees the CPU schedule struct.
+ * @brief Frees the allocated memory for the instruction struct.
  *
- * Frees the struct which represents and stores the attributes of the CPU
- * scheduler.
+ * Frees the instruction struct.
  */
-void dealloc_cpuSchedule(struct cpuSchedule *s) {
-  if (s != NULL) {
-    free(s);
+void dealloc_instruction(struct instruction *i) {
+  if (i != NULL) {
+    free(i);
   }
 }
 
@@ -423,6 +1076,7 @@ void dealloc_resourceList(struct resourceList *r) {
     current = r;
     do {
       next = current->next;
+      free(current->holderIndex);
       free(current);
       current = next;
     } while (current != NULL);
@@ -434,17 +1088,15 @@ void dealloc_resourceList(struct resourceList *r) {
  *
  * Free each of the mailboxes which are available and used in the system.
  */
-void dealloc_mailboxes() {
+void dealloc_mailboxes(struct simulator *sim) {
   struct mailbox *current;
   struct mailbox *next;
 
-  current = get_mailboxes();
+  current = get_mailboxes(sim);
   if (current != NULL) {
     do {
+      free_mailbox(current);
       free(current->name);
-      if (current->msg != NULL) {
-        free(current->msg);
-      }
       next = current->next;
       free(current);
       current = next;
@@ -453,18 +1105,18 @@ void dealloc_mailboxes() {
 }
 
 #ifdef DEBUG
-void debug_process_memory() {
+void debug_process_memory(struct simulator *sim) {
   struct processControlBlock *debug;
-  debug = firstPCB;
+  debug = sim->firstPCB;
   do {
     printf("Process name in pcb: %s\n", debug->pagePtr->name);
     debug = debug->next;
   } while (debug != NULL);
 }
 
-void debug_resources() {
+void debug_resources(struct simulator *sim) {
   struct resourceList *debug;
-  debug = firstResource;
+  debug = sim->firstResource;
   do {
     printf("The Resource is: %s\n", debug->name);
     debug = debug->next;
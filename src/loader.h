@@ -17,11 +17,53 @@
 #define WAITING 3
 /** The process TERMINATED state */
 #define TERMINATED 4
+/** The state of a periodic process whose next job is not released yet */
+#define SLEEPING 5
 
 #define REQ_V 0
 #define REL_V 1
 #define SEND_V 2
 #define RECV_V 3
+#define END_V 4
+/** Starts a loop, the operand is the number of iterations */
+#define REPEAT_V 5
+/** Ends a loop, the operand is the distance back to the first op of its
+ * body */
+#define LOOP_V 6
+/** Calls a subroutine. Only used in instruction lists, calls are expanded
+ * when the processes are compiled */
+#define CALL_V 7
+/** Ends a block of ops that was paged in, the next op is in the next block
+ * of the program, see pager.h */
+#define PAGE_V 8
+/** Requests a resource shared with other shared requests. Plain and reqx
+ * requests are exclusive and load as REQ_V */
+#define REQS_V 9
+/** Requests a set of resources all at once, the operand is the number of
+ * the set in the resource set table */
+#define REQSET_V 10
+/** Receives every message in a mailbox at once, waiting like RECV_V while
+ * the mailbox is empty */
+#define DRAIN_V 11
+/** Subscribes the process to the messages sent to a topic from now on */
+#define SUBSCRIBE_V 12
+/** Ends the subscription of the process to a topic */
+#define UNSUBSCRIBE_V 13
+/** Waits at a barrier until its parties have all arrived, the operand is
+ * the number of the barrier in the barrier table */
+#define SYNC_V 14
+
+/** The largest number of messages a mailbox can hold */
+#define MAILBOX_MAX_CAPACITY (1 << 30)
+
+/** A holder of the resource is raised to the priority of the most urgent
+ * process waiting for it, R1:inherit in the Resources line */
+#define RESOURCE_INHERIT 1
+/** A holder of the resource is raised to the priority of the most urgent
+ * process that ever requests it, R1:ceiling in the Resources line */
+#define RESOURCE_CEILING 2
+
+struct simulator;
 
 /**
  * Each process has a list of instructions to execute, with a pointer to the
@@ -32,65 +74,280 @@
 struct instruction {
   /** The type of instruction */
   int type;
-  /** The resource or mailbox name used in the instruction */
+  /** The resource, mailbox or barrier name used in the instruction, the
+   * count of a loop or the name of a called subroutine */
   char *resource; /* any resource, including a mailbox name */
-  /** The message of a send and receive instruction */
+  /** The message of a send and receive instruction, the number of parties
+   * of a sync instruction */
   char *msg;
   /** A pointer to the next instruction */
   struct instruction *next;
 };
 
+/**
+ * A pre-decoded instruction. When the processes are compiled after loading,
+ * the linked list of instructions of each process is turned into a
+ * contiguous array of ops ending with an END_V op. The resource or mailbox
+ * of an op is resolved to its index in the compiled tables, and code holds
+ * the address of the code that executes the op so the scheduler can jump
+ * straight to it.
+ */
+struct op {
+  /** The address of the code executing this op, NULL if not threaded */
+  const void *code;
+  /** The type of instruction */
+  int type;
+  /** The index of the resource or mailbox, -1 if the name is unknown, the
+   * index of the resource set of REQSET_V or the barrier of SYNC_V or the
+   * loop count or distance of REPEAT_V and LOOP_V */
+  int operand;
+  /** The resource or mailbox name used in the instruction */
+  char *name;
+  /** The message of a send instruction, NULL for any other */
+  struct message *msg;
+};
+
+/**
+ * A message sent by send ops. The text is stored inline with its length, so
+ * sending and receiving move a pointer whatever the length, and a message
+ * queued in several mailboxes is stored once. A message compiled from a
+ * process list counts its references, the send op and the slots of counted
+ * mailboxes holding it, and is freed with the last of them. The messages of
+ * an image are records in its string area and live as long as the mapping.
+ */
+struct message {
+  /** The length of the text */
+  int length;
+  /** The number of references, 0 for a message of an image */
+  int refs;
+  /** The text, ending with a 0 */
+  char text[];
+};
+
+/**
+ * A set of resources requested together by REQSET_V ops. The set is
+ * canonical: its members are the resource numbers in increasing order, each
+ * once, so sets naming the same resources in any order are one set. The
+ * bitset of the members covers only the words between the first and the
+ * last member, and is checked against the availability bitset of the
+ * process table a word at a time.
+ */
+struct resourceSet {
+  /** The resource numbers of the members in increasing order */
+  int *members;
+  /** The number of members */
+  int count;
+  /** The index of the first word of the availability bitset covered */
+  int firstWord;
+  /** The number of words covered */
+  int words;
+  /** One bit per resource of the covered words, set for the members */
+  unsigned long long *bits;
+  /** The member numbers separated by commas, which identifies the set */
+  char *key;
+};
+
+/**
+ * A barrier synchronised by SYNC_V ops. A barrier is declared by the first
+ * sync instruction naming it, which also fixes the number of processes that
+ * must arrive before any of them continues. The processes waiting at a
+ * barrier are kept in the process table, so a barrier is only read while the
+ * processes run and is shared with the views of the simulator.
+ */
+struct barrier {
+  /** The name of the barrier */
+  char *name;
+  /** The number of processes that arrive in each phase of the barrier */
+  int parties;
+};
+
 /**
  * A process page stores the name and number of the process.
+ *
+ * The program of a process loaded from an image under a memory budget is
+ * not loaded up front: it is split into blocks of PAGE_OPS ops that are
+ * read from the image into frames when the process reaches them and evicted
+ * again when the frames are needed, see pager.h.
  */
 struct page {
   /** Stores the number of the process. Used to index in the queues */
   int number;
   /** The name of the process */
   char *name;
-  /** A Linked list of the process's instructions */
+  /** The base priority of the process, P1:3 in the Processes line, 0
+   * unless given. A larger number is more urgent */
+  int priority;
+  /** The ticks between the arrivals of the jobs of a periodic process,
+   * P1@20 in the Processes line, 0 for a process that runs once */
+  int period;
+  /** The ticks from the arrival of a job to its deadline, P1@20/15, the
+   * period unless given */
+  int deadline;
+  /** The longest delay of the release of a job after its arrival,
+   * P1@20~3, 0 unless given */
+  int jitter;
+  /** The number of instructions one job of a periodic process executes,
+   * its loops unrolled, 0 for a process that runs once */
+  long long cost;
+  /** A Linked list of the process's instructions, until it is compiled */
+  struct instruction *firstInstruction;
+  /** The compiled instructions of the process, NULL if it is paged */
+  struct op *program;
+  /** The maximum number of nested loops in the program */
+  int loopNesting;
+  /** Paged: the index of the first op of the program in the image */
+  unsigned long long firstOp;
+  /** Paged: the number of ops of the program, including the END_V op */
+  int length;
+  /** Paged: the frame holding each block of the program, -1 if the block
+   * is not in memory */
+  int *frames;
+};
+
+/**
+ * A named list of instructions that processes can call. Each call is
+ * replaced by the instructions of the subroutine when the processes are
+ * compiled.
+ */
+struct subroutine {
+  /** The name of the subroutine */
+  char *name;
+  /** The instructions of the subroutine */
   struct instruction *firstInstruction;
+  /** The last instruction, new instructions are appended after it */
+  struct instruction *lastInstruction;
+  /** Set while a call of the subroutine is expanded, to detect recursion */
+  int expanding;
+  /** The next subroutine */
+  struct subroutine *next;
 };
 
 /**
- * Represents the mailbox resource. A message sent between two processes are
- * stored and retrieve from the mailbox struct.
+ * Represents the mailbox resource. The messages sent between processes are
+ * stored in the mailbox and retrieved from it in the order they were sent.
+ *
+ * A mailbox is a bounded ring buffer: it holds at most capacity messages,
+ * M1:64 in the Mailboxes line, and 1 unless given. Senders wait while it is
+ * full and receivers while it is empty. The ring only grows as messages
+ * arrive, so a large capacity costs nothing until it is used.
+ *
+ * A topic, T1:64:block in the Mailboxes line, delivers every message to
+ * each of its subscribers from the same ring, see topic.h; capacity bounds
+ * how far its slowest subscriber may fall behind.
  */
 struct mailbox {
   /** The name of the mailbox. Used to find the correct mailbox for sending and
    * receiving */
   char *name;
-  /** The variable is used to store the sent message for retrieval */
-  char *msg;
+  /** The ring of messages, the oldest at head */
+  struct message **messages;
+  /** Whether the ring holds a reference to each of its messages. Mailboxes
+   * of images and of simulator views borrow the messages instead, which
+   * the send ops keep alive */
+  int counted;
+  /** The maximum number of messages in the mailbox */
+  int capacity;
+  /** The size of the ring, a power of two */
+  int slots;
+  /** The slot of the oldest message */
+  int head;
+  /** The number of messages in the mailbox */
+  int count;
+  /** The subscribers if the mailbox is a topic, otherwise NULL */
+  struct topic *topic;
   /** A pointer to the next mailbox in the system */
   struct mailbox *next;
 };
 
 /**
- * Each process has a priority and reference to the cpu scheduling queues.
- */
-struct cpuSchedule {
-  /** The priority of the process */
-  int processPriority;
-  /** The readyQueue, where a bit is set if the process is ready */
-  struct queue* readyQueue;
-  /** The waitingQueue, where a bit is set if the process is waiting for
-   * a resource */
-  struct queue *waitingQueue;
-  /** The terminatedQueue, where a bit is set if the process has finished
-   * executing all the instructions and terminated */
-  struct queue *terminatedQueue;
+ * Statistics gathered for each process while it is scheduled.
+ */
+struct processStats {
+  /** The number of ops the process has executed */
+  long long executed;
+  /** The number of times the process had to wait for a resource */
+  long long waits;
+  /** The number of time slices the process has run */
+  long long slices;
+  /** The number of jobs of a periodic process that were released */
+  long long jobs;
+  /** The number of its jobs that completed after their deadline */
+  long long missed;
+  /** The longest time from the arrival of one of its jobs to its
+   * completion */
+  long long worstResponse;
 };
 
 /**
  * Used to store the available resources in the system as well as the acquired
  * resources for each process.
+ *
+ * A system resource is a counted resource (a semaphore): it has capacity
+ * identical instances, R1:8 in the Resources line, and only counts the
+ * instances that are available. Every acquired instance is a node in the
+ * list of the process that acquired it and in the doubly linked holders
+ * list of its system resource, so acquiring and releasing an instance
+ * costs the same however large the pool. The system resource also indexes
+ * the newest instance of each process holding it in a hash table, and the
+ * instances a process holds of the same resource are chained from newest
+ * to oldest, so a release finds its instance in constant time in whatever
+ * order the process releases. Released nodes are kept by the process for
+ * its next acquire. A
+ * resource can also be held shared by any number of readers while none of
+ * its instances is held exclusively.
+ *
+ * When processes are scheduled by priority a resource can protect the
+ * processes waiting for it from priority inversion: R1:inherit raises its
+ * holders to the priority of the most urgent process waiting for it, and
+ * R1:ceiling raises them to its ceiling as soon as they acquire it.
  */
 struct resourceList {
   /** The name of the resource */
   char *name;
-  /** The status of the result, either available or occupied */
+  /** The number of a system resource in the resource table, the number of
+   * the system resource for an acquired instance, -1 until compiled */
+  int number;
+  /** The number of available instances, 0 for an acquired instance */
   int available;
+  /** The number of instances of a system resource, 1 unless given */
+  int capacity;
+  /** How the holders of a system resource are raised to the priority of
+   * other processes, RESOURCE_INHERIT, RESOURCE_CEILING or 0 for not at all */
+  int protocol;
+  /** The priority ceiling of a system resource, the highest base priority
+   * of the processes that request it */
+  int ceiling;
+  /** The number of processes holding a system resource shared, 1 for a
+   * resource acquired shared */
+  int readers;
+  /** The number of readers woken together that have not acquired the
+   * system resource yet, see wake_waiters */
+  int wokenReaders;
+  /** The number of the process holding an acquired instance, -1 for a
+   * system resource */
+  int holder;
+  /** The system resource an acquired instance belongs to, NULL for a
+   * system resource */
+  struct resourceList *resource;
+  /** The first acquired instance of a system resource, NULL if none is
+   * held */
+  struct resourceList *holders;
+  /** The next acquired instance of the same system resource */
+  struct resourceList *nextHolder;
+  /** The previous acquired instance of the same system resource */
+  struct resourceList *prevHolder;
+  /** The newest instance each process holding a system resource holds, an
+   * open addressing table keyed by holder, NULL until the first acquire */
+  struct resourceList **holderIndex;
+  /** The number of slots of holderIndex, a power of two */
+  int holderSlots;
+  /** The number of processes in holderIndex */
+  int holderCount;
+  /** The previous acquired instance in the list of the process */
+  struct resourceList *prevHeld;
+  /** The instance of the same resource the process acquired before this
+   * one and still holds, NULL if none */
+  struct resourceList *olderHeld;
   /** The next resource in the list */
   struct resourceList *next;
 };
@@ -101,65 +358,194 @@ struct resourceList {
   * a process is stored. In this project each process will be
   * stored in a data structure, called a page; therefore  the PCB
   * can simply point to the page.
+  *
+  * The state, next op, priority and queue links of the process are
+  * used on every time slice and live in the process table (table.h),
+  * indexed by the process number stored in the page.
   */
 struct processControlBlock {
   /** The process page, which stores the number and name of the process */
   struct page *pagePtr;
-  /** The current state of the process */
-  int processState;
-  /** A pointer to the next instruction to be executed */
-  struct instruction *nextInstruction;
-  /** Pointer to the process priority and scheduling queues */
-  struct cpuSchedule *cpuSchedulePtr;
   /** The resources which the current process occupies */
   struct resourceList *resourceListPtr;
+  /** Released instances kept for the next acquire of the process, linked
+   * by next */
+  struct resourceList *spareResources;
+  /** The statistics of the process */
+  struct processStats stats;
   /** Pointer to the next process control block in memory */
   struct processControlBlock *next;
 };
 
 /*
  * Creates the process control block and adds
- * it to a linked list of of process control blocks
+ * it to a linked list of of process control blocks. A name ending in
+ * :priority has that base priority, one ending in @period is periodic.
+ */
+void load_process ( struct simulator *sim, char* process_name );
+/*
+ * Cuts a :priority suffix off a process name and returns the priority, 0 if
+ * the name has none.
  */
-void load_process ( char* process_name );
+int cut_priority ( char* process_name );
 /*
- * Loads and stores the instruction of the process
+ * Cuts an @period[/deadline][~jitter] suffix off a process name and stores
+ * the timing, a period of 0 if the name has none.
  */
-void load_process_instruction ( char* process_name, char* instruction,
+void cut_timing ( char* process_name, int *period, int *deadline,
+    int *jitter );
+/*
+ * Loads and stores the instruction of the process, returns -1 if it is not
+ * in a named Process section
+ */
+int load_process_instruction ( struct simulator *sim, char* process_name,
+    char* instruction, char* resource_name, char *msg );
+/*
+ * Starts a subroutine, the instructions loaded next are appended to it
+ */
+void load_subroutine ( struct simulator *sim, char* subroutine_name );
+/*
+ * Loads and stores an instruction of the last loaded subroutine
+ */
+void load_subroutine_instruction ( struct simulator *sim, char* instruction,
     char* resource_name, char *msg );
+/*
+ * Returns the subroutine with the given name or NULL
+ */
+struct subroutine* find_subroutine(struct simulator *sim,
+    const char *subroutine_name);
 /*
  * Loads the mailbox and those things associated with
- * it
+ * it. A name ending in :count holds count messages.
  */
-void load_mailbox ( char* mailboxName );
+void load_mailbox ( struct simulator *sim, char* mailboxName );
 /*
- * Loads the available system resources for the processes
+ * Loads the available system resources for the processes. A name ending in
+ * :count has count instances, and one ending in :inherit or :ceiling
+ * protects its waiters from priority inversion.
  */
-void load_resource ( char* resource_name );
+void load_resource ( struct simulator *sim, char* resource_name );
 
 /*
  * Returns a pointer to the first pcb in the list of loaded processes.
  */
-struct processControlBlock* get_loaded_processes();
+struct processControlBlock* get_loaded_processes(struct simulator *sim);
 
 /*
  * Return the list of available resources
  */
-struct resourceList* get_available_resources();
+struct resourceList* get_available_resources(struct simulator *sim);
 
 /*
  * Returns a list of the available mailbox resources.
  */
-struct mailbox* get_mailboxes();
+struct mailbox* get_mailboxes(struct simulator *sim);
+
+/*
+ * Returns the process table of the loaded processes.
+ */
+struct processTable* get_process_table(struct simulator *sim);
+
+/*
+ * Creates an acquired instance of resource held by process pcb, reusing one
+ * it released before, and adds it to the front of the list of pcb and to
+ * the holders of resource. The available count is not changed.
+ */
+struct resourceList *link_holder(struct processControlBlock *pcb,
+                                 struct resourceList *resource);
+
+/*
+ * Returns the newest instance of resource that process holder holds, NULL
+ * if it holds none.
+ */
+struct resourceList *find_holder(struct resourceList *resource, int holder);
+
+/*
+ * Removes the newest instance of its resource process pcb holds from the
+ * list of pcb and the holders of the resource and keeps it for the next
+ * acquire of pcb. The available count is not changed.
+ */
+void unlink_holder(struct processControlBlock *pcb,
+                   struct resourceList *held);
+
+/*
+ * Forgets every holder of a system resource without unlinking them.
+ */
+void clear_holders(struct resourceList *resource);
+
+/*
+ * Creates a message holding a copy of length bytes of text, with one
+ * reference.
+ */
+struct message *create_message(const char *text, int length);
+
+/*
+ * Drops a reference to a message, freeing it with the last one.
+ */
+void release_message(struct message *msg);
+
+/*
+ * Initialises an empty mailbox holding at most capacity messages, which
+ * borrows its messages until counted is set.
+ */
+void init_mailbox(struct mailbox *mail, char *name, int capacity);
+
+/*
+ * Appends a message to a mailbox that is not full, growing its ring if
+ * needed. A counted mailbox takes a reference to the message.
+ */
+void mailbox_put(struct mailbox *mail, struct message *msg);
+
+/*
+ * Returns message i of a mailbox, 0 being the oldest.
+ */
+struct message *mailbox_message(const struct mailbox *mail, int i);
+
+/*
+ * Removes the n oldest messages of a mailbox, releasing them if counted.
+ */
+void mailbox_drop(struct mailbox *mail, int n);
+
+/*
+ * Frees the ring and the subscribers of a mailbox and releases its
+ * messages, but not its name.
+ */
+void free_mailbox(struct mailbox *mail);
 
 /*
  * Frees all the processes after termination.
  */
-void dealloc_processes();
+void dealloc_processes(struct simulator *sim);
+
+/*
+ * Frees one process that is no longer loaded or in the process table. The
+ * resources it holds stay unavailable.
+ */
+void dealloc_process(struct processControlBlock *pcb);
+
+/*
+ * Frees the nodes of a resource list, but not the names.
+ */
+void dealloc_resourceList(struct resourceList *r);
+
+/*
+ * Frees every subroutine and its instructions.
+ */
+void dealloc_subroutines(struct simulator *sim);
+
+/*
+ * Frees one subroutine that is no longer in the list.
+ */
+void dealloc_subroutine(struct subroutine *sub);
 
 /*
  *  Frees the instruction i 
  */
 void dealloc_instruction(struct instruction *i);
 
+/*
+ * Frees the compiled program of a process.
+ */
+void dealloc_program(struct op *program);
+
 #endif
@@ -0,0 +1,1362 @@
+/**
+ * @file lockorder.c
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "loader.h"
+#include "lockorder.h"
+#include "pager.h"
+#include "simulator.h"
+
+/** The number of processes kept for each order */
+#define WITNESSES 4
+
+/** The most orders a cycle search may follow in one component before the
+ * component is reported without checking that different processes can
+ * wait around one of its cycles */
+#define SEARCH_BUDGET (1L << 22)
+
+/** The most instances of a resource counted for a process */
+#define HELD_MAX (1 << 30)
+
+/**
+ * An order of two resources: some process requests to while it holds from.
+ */
+struct order {
+  /** The resource held */
+  int from;
+  /** The resource requested */
+  int to;
+  /** The first WITNESSES processes found that order the resources */
+  int witness[WITNESSES];
+  /** The number of processes that order the resources, WITNESSES + 1 for
+   * more than WITNESSES */
+  int witnesses;
+  /** The last process that ordered the resources */
+  int last;
+};
+
+/**
+ * The lock order graph. The orders are collected in a hash table while
+ * the programs are walked, then sorted into adjacency lists by the
+ * resource they start at.
+ */
+struct graph {
+  /** The orders in the order they were found */
+  struct order *orders;
+  /** The number of orders */
+  int count;
+  /** The number of orders there is room for */
+  int capacity;
+  /** The index of the order hashed to each slot, -1 for a free slot */
+  int *slots;
+  /** The number of slots, a power of two at least twice count */
+  int slotCount;
+  /** Set for every resource some process requests exclusively */
+  unsigned char *exclusive;
+  /** The instances of each resource the walked process holds */
+  int *held;
+  /** The resources the walked process holds, in no particular order */
+  int *heldList;
+  /** The position of each held resource in heldList */
+  int *heldAt;
+  /** The number of resources the walked process holds */
+  int heldCount;
+  /** The XOR of mix() of the held resources, to compare held sets */
+  uint64_t heldHash;
+  /** The process requesting each resource, -1 if none does, -2 if more
+   * than one does */
+  int *requester;
+  /** Pairs of a resource and its instances held at the start of the last
+   * walk of the body of each open loop */
+  int *saved;
+  /** The number of ints in saved */
+  int savedCount;
+  /** The number of ints there is room for in saved */
+  int savedCapacity;
+  /** Pairs of a process and a resource it holds when it ends */
+  int *leaks;
+  /** The number of ints in leaks */
+  int leakCount;
+  /** The number of ints there is room for in leaks */
+  int leakCapacity;
+  /** The orders of resource v are targets[first[v]] to
+   * targets[first[v + 1] - 1] */
+  int *first;
+  /** The indices of the orders, grouped by the resource they start at */
+  int *targets;
+};
+
+/**
+ * A loop of the walked program. Walking its body once finds the orders of
+ * its first iteration, and walking it a second time, if the first changed
+ * the held resources, those of every other iteration: whether a resource
+ * is held after an iteration only depends on the last request or release
+ * of it in the body, so the second iteration ends with the same resources
+ * held as it started with. The instances the last walk gained or lost are
+ * gained or lost again by each iteration not walked.
+ */
+struct loopFrame {
+  /** The index of the first op of the body */
+  int body;
+  /** The number of iterations */
+  int count;
+  /** Set once the body is walked a second time */
+  int again;
+  /** The number of resources held when the body was entered */
+  int heldCount;
+  /** The heldHash when the body was entered */
+  uint64_t heldHash;
+  /** The index in saved of the resources held at the start of the last
+   * walk of the body */
+  int saved;
+};
+
+/**
+ * A strongly connected component of the graph that contains a cycle.
+ */
+struct component {
+  /** The lowest numbered resource of the component */
+  int root;
+  /** The number of resources of the component */
+  int size;
+};
+
+/**
+ * The state of the search for a cycle around which different processes can
+ * wait, one holding each resource of the cycle and requesting the next.
+ * An order that a single process makes pins that process to it, so a path
+ * never takes two orders pinned to the same process; the other orders get
+ * processes by bipartite matching once the path closes.
+ */
+struct search {
+  /** The graph */
+  const struct graph *g;
+  /** The component of each resource */
+  const int *comp;
+  /** The resources of the component searched, by increasing number */
+  int *members;
+  /** Set for the resources on the path */
+  unsigned char *onPath;
+  /** The orders of the path */
+  int *path;
+  /** The next order to try from each resource of the path */
+  int *edge;
+  /** The process given to each order of a closed path, -1 if none of the
+   * processes kept for it is free */
+  int *assigned;
+  /** The number of orders of the path pinned to each process */
+  int *pinned;
+  /** The order of the closed path each process is given to */
+  int *owner;
+  /** Marks the processes given to an order with stamp */
+  int *ownerStamp;
+  /** Marks the processes tried by a matching step with visit */
+  int *visitStamp;
+  /** The number of closed paths matched */
+  int stamp;
+  /** The number of matching steps */
+  int visit;
+  /** The orders left to follow in the component */
+  long budget;
+};
+
+static int init_graph(struct graph *g, int resources);
+static void free_graph(struct graph *g);
+static uint64_t mix(uint64_t x);
+static int add_order(struct graph *g, int from, int to, int p);
+static int grow_slots(struct graph *g);
+static void hold(struct graph *g, int r);
+static void release(struct graph *g, int r);
+static int request(struct graph *g, int r, int p);
+static int walk_process(struct simulator *sim, struct graph *g, int p,
+                        struct loopFrame *frames);
+static int build_adjacency(struct graph *g, int resources, int *ordered);
+static int find_components(const struct graph *g, int resources, int *comp,
+                           struct component **cyclic);
+static int compare_roots(const void *a, const void *b);
+static int compare_ints(const void *a, const void *b);
+static int save_held(struct graph *g);
+static void repeat_held(struct graph *g, const struct loopFrame *f);
+static int append_pair(int **pairs, int *count, int *capacity, int a, int b);
+static int init_search(struct search *s, const struct graph *g,
+                       const int *comp, int resources, int processes);
+static void free_search(struct search *s);
+static int component_members(struct search *s, int root, int *seen);
+static int find_cycle(struct search *s, int members);
+static int search_from(struct search *s, int start, int limit);
+static int blocked(const struct search *s, const struct order *o);
+static void pin(struct search *s, const struct order *o, int by);
+static int assign_processes(struct search *s, int length);
+static int match(struct search *s, int i);
+static int shortest_cycle(const struct graph *g, const int *comp, int root,
+                          int *queue, int *via, int *seen, int *cycle);
+static void print_cycle(struct simulator *sim, const struct graph *g,
+                        const int *cycle, const int *assigned, int length,
+                        int number, FILE *out);
+static int print_leaks(struct simulator *sim, const struct graph *g,
+                       FILE *out);
+
+/**
+ * @brief Builds the lock order graph of the processes of a simulator and
+ * reports its cycles and the processes that end holding resources.
+ *
+ * Every program is walked once, loops twice at most, and every request is
+ * ordered after each resource the process holds at that point. The
+ * strongly connected components of the graph are found with Tarjan's
+ * algorithm. A cycle can only deadlock if a different process makes each
+ * of its orders, so every component with a cycle is searched for a
+ * shortest such cycle, by iterative deepening from each of its resources
+ * in turn, and reported with the processes that wait around it. A
+ * component without such a cycle, as when one process takes the same
+ * resources in both orders at different times, is not reported. A
+ * component whose cycles are too many to search within SEARCH_BUDGET is
+ * reported with one shortest cycle through its lowest numbered resource.
+ * A process that ends holding a resource that other processes request
+ * exclusively makes them wait forever and is reported as well.
+ *
+ * @param sim The simulator holding the compiled processes.
+ * @param out The stream the report is written to.
+ *
+ * @return The number of components with a cycle reported plus the number
+ * of processes reported to end holding a resource, -1 if memory ran out.
+ */
+int lockorder_analyze(struct simulator *sim, FILE *out) {
+  struct processTable *t = &sim->table;
+  int resources = sim->resourceCount;
+  struct graph g;
+  struct search search;
+  struct loopFrame *frames = NULL;
+  struct component *cyclic = NULL;
+  const struct order *o;
+  int *comp = NULL, *queue = NULL, *via = NULL, *seen = NULL;
+  int *cycle = NULL;
+  int nesting = 0;
+  int ordered = 0;
+  int components;
+  int cycles = 0;
+  int leaks;
+  int found = -1;
+  int searching = 0;
+  int length, members;
+  int p, i, j, k;
+
+  if (init_graph(&g, resources) != 0) {
+    free_graph(&g);
+    return -1;
+  }
+  for (p = 0; p < t->count; p++) {
+    if (t->pcb[p]->pagePtr->loopNesting > nesting) {
+      nesting = t->pcb[p]->pagePtr->loopNesting;
+    }
+  }
+  frames = malloc(sizeof(struct loopFrame) * (nesting + 1));
+  if (frames == NULL) {
+    goto done;
+  }
+  for (p = 0; p < t->count; p++) {
+    if (walk_process(sim, &g, p, frames) != 0) {
+      goto done;
+    }
+  }
+  if (build_adjacency(&g, resources, &ordered) != 0) {
+    goto done;
+  }
+
+  comp = malloc(sizeof(int) * (resources + 1));
+  queue = malloc(sizeof(int) * (resources + 1));
+  via = malloc(sizeof(int) * (resources + 1));
+  seen = calloc(resources + 1, sizeof(int));
+  cycle = malloc(sizeof(int) * (resources + 1));
+  if (comp == NULL || queue == NULL || via == NULL || seen == NULL ||
+      cycle == NULL) {
+    goto done;
+  }
+  components = find_components(&g, resources, comp, &cyclic);
+  if (components < 0) {
+    goto done;
+  }
+  searching = components > 0;
+  if (searching && init_search(&search, &g, comp, resources, t->count) != 0) {
+    goto done;
+  }
+
+  fprintf(out, "Lock order: %d processes, %d resources, %d order%s\n",
+          t->count, ordered, g.first[resources],
+          g.first[resources] == 1 ? "" : "s");
+  for (i = 0; i < components; i++) {
+    members = component_members(&search, cyclic[i].root, seen);
+    length = find_cycle(&search, members);
+    if (length == 0) {
+      continue;
+    }
+    if (length > 0) {
+      for (j = 0; j < length; j++) {
+        cycle[j] = search.path[j];
+      }
+    } else {
+      /* Too many cycles to search: report one with the first processes
+       * kept for its orders, different ones where there are */
+      length = shortest_cycle(&g, comp, cyclic[i].root, queue, via, seen,
+                              cycle);
+      ++search.stamp;
+      for (j = 0; j < length; j++) {
+        o = &g.orders[cycle[j]];
+        search.assigned[j] = o->witness[0];
+        for (k = 0; k < WITNESSES && k < o->witnesses; k++) {
+          if (search.ownerStamp[o->witness[k]] != search.stamp) {
+            search.assigned[j] = o->witness[k];
+            break;
+          }
+        }
+        search.ownerStamp[search.assigned[j]] = search.stamp;
+      }
+    }
+    print_cycle(sim, &g, cycle, search.assigned, length, ++cycles, out);
+    if (search.budget < 0) {
+      fprintf(out, "  not all of its cycles were checked for processes "
+                   "that wait around them\n");
+    }
+    if (cyclic[i].size > length) {
+      fprintf(out, "  and %d more resource%s in cycles with them\n",
+              cyclic[i].size - length,
+              cyclic[i].size - length == 1 ? "" : "s");
+    }
+  }
+  leaks = print_leaks(sim, &g, out);
+  if (cycles == 0 && leaks == 0) {
+    fprintf(out, "Deadlock free\n");
+  } else if (leaks == 0) {
+    fprintf(out, "May deadlock: %d cycle%s\n", cycles,
+            cycles == 1 ? "" : "s");
+  } else {
+    fprintf(out, "May deadlock: %d cycle%s, %d process%s ending with "
+                 "resources held\n",
+            cycles, cycles == 1 ? "" : "s", leaks, leaks == 1 ? "" : "es");
+  }
+  found = cycles + leaks;
+
+done:
+  free(frames);
+  free(cyclic);
+  free(comp);
+  free(queue);
+  free(via);
+  free(seen);
+  free(cycle);
+  if (searching) {
+    free_search(&search);
+  }
+  free_graph(&g);
+  return found;
+}
+
+/**
+ * @brief Allocates an empty graph over a number of resources.
+ *
+ * @param g The graph.
+ * @param resources The number of resources.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int init_graph(struct graph *g, int resources) {
+  int i;
+
+  g->count = 0;
+  g->capacity = 64;
+  g->slotCount = 128;
+  g->heldCount = 0;
+  g->heldHash = 0;
+  g->savedCount = g->leakCount = 0;
+  g->savedCapacity = g->leakCapacity = 0;
+  g->saved = g->leaks = NULL;
+  g->first = NULL;
+  g->targets = NULL;
+  g->orders = malloc(sizeof(struct order) * g->capacity);
+  g->slots = malloc(sizeof(int) * g->slotCount);
+  g->exclusive = calloc(resources + 1, 1);
+  g->held = calloc(resources + 1, sizeof(int));
+  g->heldList = malloc(sizeof(int) * (resources + 1));
+  g->heldAt = malloc(sizeof(int) * (resources + 1));
+  g->requester = malloc(sizeof(int) * (resources + 1));
+  if (g->orders == NULL || g->slots == NULL || g->exclusive == NULL ||
+      g->held == NULL || g->heldList == NULL || g->heldAt == NULL ||
+      g->requester == NULL) {
+    return -1;
+  }
+  for (i = 0; i < g->slotCount; i++) {
+    g->slots[i] = -1;
+  }
+  for (i = 0; i < resources; i++) {
+    g->requester[i] = -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Frees a graph.
+ *
+ * @param g The graph.
+ */
+static void free_graph(struct graph *g) {
+  free(g->orders);
+  free(g->slots);
+  free(g->exclusive);
+  free(g->held);
+  free(g->heldList);
+  free(g->heldAt);
+  free(g->requester);
+  free(g->saved);
+  free(g->leaks);
+  free(g->first);
+  free(g->targets);
+}
+
+/**
+ * @brief Scrambles the bits of a number (the splitmix64 finalizer).
+ *
+ * @param x The number.
+ *
+ * @return The scrambled number.
+ */
+static uint64_t mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/**
+ * @brief Adds the order of two resources by a process, or the process as
+ * another witness of a known order.
+ *
+ * @param g The graph.
+ * @param from The resource held.
+ * @param to The resource requested.
+ * @param p The process.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int add_order(struct graph *g, int from, int to, int p) {
+  struct order *o;
+  uint64_t key = (uint64_t)from << 32 | (uint32_t)to;
+  int s;
+
+  if (2 * (g->count + 1) > g->slotCount && grow_slots(g) != 0) {
+    return -1;
+  }
+  for (s = mix(key) & (g->slotCount - 1); g->slots[s] != -1;
+       s = (s + 1) & (g->slotCount - 1)) {
+    o = &g->orders[g->slots[s]];
+    if (o->from == from && o->to == to) {
+      /* A process is walked at once, so it is the last witness if it
+       * ordered the resources before */
+      if (o->last != p && o->witnesses <= WITNESSES) {
+        if (o->witnesses < WITNESSES) {
+          o->witness[o->witnesses] = p;
+        }
+        ++o->witnesses;
+      }
+      o->last = p;
+      return 0;
+    }
+  }
+
+  if (g->count == g->capacity) {
+    o = realloc(g->orders, sizeof(struct order) * 2 * g->capacity);
+    if (o == NULL) {
+      return -1;
+    }
+    g->orders = o;
+    g->capacity *= 2;
+  }
+  o = &g->orders[g->count];
+  o->from = from;
+  o->to = to;
+  o->witness[0] = p;
+  o->witnesses = 1;
+  o->last = p;
+  g->slots[s] = g->count++;
+  return 0;
+}
+
+/**
+ * @brief Doubles the slots of the hash table of a graph and rehashes its
+ * orders.
+ *
+ * @param g The graph.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int grow_slots(struct graph *g) {
+  int slotCount = 2 * g->slotCount;
+  int *slots = malloc(sizeof(int) * slotCount);
+  const struct order *o;
+  int s, i;
+
+  if (slots == NULL) {
+    return -1;
+  }
+  for (s = 0; s < slotCount; s++) {
+    slots[s] = -1;
+  }
+  for (i = 0; i < g->count; i++) {
+    o = &g->orders[i];
+    s = mix((uint64_t)o->from << 32 | (uint32_t)o->to) & (slotCount - 1);
+    while (slots[s] != -1) {
+      s = (s + 1) & (slotCount - 1);
+    }
+    slots[s] = i;
+  }
+  free(g->slots);
+  g->slots = slots;
+  g->slotCount = slotCount;
+  return 0;
+}
+
+/**
+ * @brief Records that the walked process holds one more instance of a
+ * resource.
+ *
+ * @param g The graph.
+ * @param r The resource.
+ */
+static void hold(struct graph *g, int r) {
+  if (g->held[r]++ == 0) {
+    g->heldAt[r] = g->heldCount;
+    g->heldList[g->heldCount++] = r;
+    g->heldHash ^= mix(r);
+  }
+}
+
+/**
+ * @brief Records that the walked process releases an instance of a
+ * resource, if it holds one.
+ *
+ * @param g The graph.
+ * @param r The resource.
+ */
+static void release(struct graph *g, int r) {
+  int last;
+
+  if (g->held[r] > 0 && --g->held[r] == 0) {
+    last = g->heldList[--g->heldCount];
+    g->heldList[g->heldAt[r]] = last;
+    g->heldAt[last] = g->heldAt[r];
+    g->heldHash ^= mix(r);
+  }
+}
+
+/**
+ * @brief Orders a requested resource after every resource the walked
+ * process holds.
+ *
+ * @param g The graph.
+ * @param r The resource.
+ * @param p The process.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int request(struct graph *g, int r, int p) {
+  int i;
+
+  if (g->requester[r] == -1) {
+    g->requester[r] = p;
+  } else if (g->requester[r] != p) {
+    g->requester[r] = -2;
+  }
+  for (i = 0; i < g->heldCount; i++) {
+    if (add_order(g, g->heldList[i], r, p) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Walks the program of a process and adds its orders to the graph.
+ *
+ * A set request orders each of its members after the held resources but
+ * not after each other, since they are acquired at once. Loops are walked
+ * as described at struct loopFrame. The resources the process still holds
+ * at its end are added to the leaks of the graph, and the walked process
+ * holds nothing afterwards.
+ *
+ * @param sim The simulator holding the process.
+ * @param g The graph.
+ * @param p The process.
+ * @param frames Room for the nested loops of the program.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int walk_process(struct simulator *sim, struct graph *g, int p,
+                        struct loopFrame *frames) {
+  struct page *page = sim->table.pcb[p]->pagePtr;
+  const struct op *op;
+  const struct resourceSet *set;
+  struct loopFrame *f;
+  int depth = 0;
+  int type, operand;
+  int i, m;
+
+  for (i = 0;; i++) {
+    op = page->program != NULL ? page->program + i : pager_op(sim, p, i);
+    type = op->type;
+    operand = op->operand;
+    if (type == END_V) {
+      break;
+    }
+    switch (type) {
+    case REQ_V:
+    case REQS_V:
+      if (operand < 0) {
+        break;
+      }
+      if (request(g, operand, p) != 0) {
+        return -1;
+      }
+      g->exclusive[operand] |= type == REQ_V;
+      hold(g, operand);
+      break;
+    case REQSET_V:
+      if (operand < 0) {
+        break;
+      }
+      set = &sim->resourceSets[operand];
+      for (m = 0; m < set->count; m++) {
+        if (request(g, set->members[m], p) != 0) {
+          return -1;
+        }
+      }
+      for (m = 0; m < set->count; m++) {
+        g->exclusive[set->members[m]] = 1;
+        hold(g, set->members[m]);
+      }
+      break;
+    case REL_V:
+      if (operand >= 0) {
+        release(g, operand);
+      }
+      break;
+    case REPEAT_V:
+      f = &frames[depth++];
+      f->body = i + 1;
+      f->count = operand;
+      f->again = 0;
+      f->heldCount = g->heldCount;
+      f->heldHash = g->heldHash;
+      f->saved = g->savedCount;
+      if (save_held(g) != 0) {
+        return -1;
+      }
+      break;
+    case LOOP_V:
+      f = &frames[depth - 1];
+      if (!f->again && f->count > 1 &&
+          (f->heldCount != g->heldCount || f->heldHash != g->heldHash)) {
+        f->again = 1;
+        i = f->body - 1;
+        g->savedCount = f->saved;
+        if (save_held(g) != 0) {
+          return -1;
+        }
+      } else {
+        repeat_held(g, f);
+        g->savedCount = f->saved;
+        --depth;
+      }
+      break;
+    }
+  }
+
+  for (m = 0; m < g->heldCount; m++) {
+    if (append_pair(&g->leaks, &g->leakCount, &g->leakCapacity, p,
+                    g->heldList[m]) != 0) {
+      return -1;
+    }
+  }
+  while (g->heldCount > 0) {
+    g->held[g->heldList[--g->heldCount]] = 0;
+  }
+  g->heldHash = 0;
+  return 0;
+}
+
+/**
+ * @brief Saves the resources the walked process holds with their instances
+ * on the saved stack of the graph.
+ *
+ * @param g The graph.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int save_held(struct graph *g) {
+  int i;
+
+  for (i = 0; i < g->heldCount; i++) {
+    if (append_pair(&g->saved, &g->savedCount, &g->savedCapacity,
+                    g->heldList[i], g->held[g->heldList[i]]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Applies the iterations of a loop that were not walked to the
+ * instances the walked process holds.
+ *
+ * The last walk of the body started and ended with the same resources
+ * held, so every further iteration changes their instances as it did. A
+ * resource held after an iteration is requested last in the body and stays
+ * held, however many instances the iterations release.
+ *
+ * @param g The graph.
+ * @param f The loop, with the resources held at the start of its last walk
+ * saved.
+ */
+static void repeat_held(struct graph *g, const struct loopFrame *f) {
+  long long held;
+  int left = f->count - 1 - f->again;
+  int i, r;
+
+  for (i = f->saved; left > 0 && i < g->savedCount; i += 2) {
+    r = g->saved[i];
+    if (g->held[r] == 0) {
+      continue;
+    }
+    held = g->held[r] + (long long)left * (g->held[r] - g->saved[i + 1]);
+    g->held[r] = held < 1 ? 1 : held > HELD_MAX ? HELD_MAX : (int)held;
+  }
+}
+
+/**
+ * @brief Appends a pair of ints to a growing array.
+ *
+ * @param pairs The array, reallocated as it grows.
+ * @param count The number of ints in the array.
+ * @param capacity The number of ints there is room for.
+ * @param a The first int.
+ * @param b The second int.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int append_pair(int **pairs, int *count, int *capacity, int a, int b) {
+  int size = *capacity == 0 ? 64 : 2 * *capacity;
+  int *grown;
+
+  if (*count + 2 > *capacity) {
+    grown = realloc(*pairs, sizeof(int) * size);
+    if (grown == NULL) {
+      return -1;
+    }
+    *pairs = grown;
+    *capacity = size;
+  }
+  (*pairs)[(*count)++] = a;
+  (*pairs)[(*count)++] = b;
+  return 0;
+}
+
+/**
+ * @brief Sorts the orders of two resources that some process requests
+ * exclusively into adjacency lists, by a counting sort on the resource
+ * held. Resources only ever requested shared never make a process wait,
+ * so their orders are left out.
+ *
+ * @param g The graph.
+ * @param resources The number of resources.
+ * @param ordered Set to the number of resources with orders kept.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int build_adjacency(struct graph *g, int resources, int *ordered) {
+  unsigned char *touched;
+  int *next;
+  const struct order *o;
+  int v, i;
+
+  g->first = calloc(resources + 1, sizeof(int));
+  g->targets = malloc(sizeof(int) * (g->count + 1));
+  touched = calloc(resources + 1, 1);
+  next = malloc(sizeof(int) * (resources + 1));
+  if (g->first == NULL || g->targets == NULL || touched == NULL ||
+      next == NULL) {
+    free(touched);
+    free(next);
+    return -1;
+  }
+
+  *ordered = 0;
+  for (i = 0; i < g->count; i++) {
+    o = &g->orders[i];
+    if (g->exclusive[o->from] && g->exclusive[o->to]) {
+      g->first[o->from + 1]++;
+      *ordered += !touched[o->from] + (o->to != o->from && !touched[o->to]);
+      touched[o->from] = touched[o->to] = 1;
+    }
+  }
+  for (v = 0; v < resources; v++) {
+    g->first[v + 1] += g->first[v];
+    next[v] = g->first[v];
+  }
+  for (i = 0; i < g->count; i++) {
+    o = &g->orders[i];
+    if (g->exclusive[o->from] && g->exclusive[o->to]) {
+      g->targets[next[o->from]++] = i;
+    }
+  }
+
+  free(touched);
+  free(next);
+  return 0;
+}
+
+/**
+ * @brief Finds the strongly connected components of the graph with
+ * Tarjan's algorithm, iteratively so that long chains of orders do not
+ * overflow the stack, and collects those that contain a cycle: more than
+ * one resource or a resource ordered after itself.
+ *
+ * @param g The graph with its adjacency lists.
+ * @param resources The number of resources.
+ * @param comp Set to the component of each resource, -1 for resources not
+ * reached.
+ * @param cyclic Set to the components with a cycle, by increasing root.
+ *
+ * @return The number of components with a cycle, -1 if memory ran out.
+ */
+static int find_components(const struct graph *g, int resources, int *comp,
+                           struct component **cyclic) {
+  int *index = malloc(sizeof(int) * (resources + 1));
+  int *low = malloc(sizeof(int) * (resources + 1));
+  int *stack = malloc(sizeof(int) * (resources + 1));
+  int *callVertex = malloc(sizeof(int) * (resources + 1));
+  int *callEdge = malloc(sizeof(int) * (resources + 1));
+  struct component *found = NULL, *grown;
+  int count = -1, capacity = 0;
+  int next = 0, sp = 0, cp = 0, components = 0;
+  int v, u, w, e, root, size, self;
+
+  *cyclic = NULL;
+  if (index == NULL || low == NULL || stack == NULL || callVertex == NULL ||
+      callEdge == NULL) {
+    goto done;
+  }
+  for (v = 0; v < resources; v++) {
+    index[v] = -1;
+    comp[v] = -1;
+  }
+
+  count = 0;
+  for (v = 0; v < resources; v++) {
+    if (index[v] != -1 || g->first[v] == g->first[v + 1]) {
+      continue;
+    }
+    index[v] = low[v] = next++;
+    stack[sp++] = v;
+    callVertex[cp] = v;
+    callEdge[cp++] = g->first[v];
+
+    while (cp > 0) {
+      u = callVertex[cp - 1];
+      if (callEdge[cp - 1] < g->first[u + 1]) {
+        w = g->orders[g->targets[callEdge[cp - 1]++]].to;
+        if (index[w] == -1) {
+          index[w] = low[w] = next++;
+          stack[sp++] = w;
+          callVertex[cp] = w;
+          callEdge[cp++] = g->first[w];
+        } else if (comp[w] == -1 && index[w] < low[u]) {
+          /* w is still on the stack, in the component being built */
+          low[u] = index[w];
+        }
+        continue;
+      }
+
+      --cp;
+      if (cp > 0 && low[u] < low[callVertex[cp - 1]]) {
+        low[callVertex[cp - 1]] = low[u];
+      }
+      if (low[u] != index[u]) {
+        continue;
+      }
+      root = u;
+      size = 0;
+      do {
+        w = stack[--sp];
+        comp[w] = components;
+        root = w < root ? w : root;
+        size++;
+      } while (w != u);
+      components++;
+
+      self = 0;
+      for (e = g->first[u]; size == 1 && e < g->first[u + 1]; e++) {
+        self |= g->orders[g->targets[e]].to == u;
+      }
+      if (size == 1 && !self) {
+        continue;
+      }
+      if (count == capacity) {
+        capacity = capacity == 0 ? 8 : 2 * capacity;
+        grown = realloc(found, sizeof(struct component) * capacity);
+        if (grown == NULL) {
+          count = -1;
+          goto done;
+        }
+        found = grown;
+      }
+      found[count].root = root;
+      found[count++].size = size;
+    }
+  }
+  if (count > 1) {
+    qsort(found, count, sizeof(struct component), compare_roots);
+  }
+
+done:
+  if (count < 0) {
+    free(found);
+    found = NULL;
+  }
+  *cyclic = found;
+  free(index);
+  free(low);
+  free(stack);
+  free(callVertex);
+  free(callEdge);
+  return count;
+}
+
+/**
+ * @brief Compares two components by their root, for qsort.
+ *
+ * @return A negative number, 0 or a positive number.
+ */
+static int compare_roots(const void *a, const void *b) {
+  return ((const struct component *)a)->root -
+         ((const struct component *)b)->root;
+}
+
+/**
+ * @brief Compares two ints, for qsort.
+ *
+ * @return A negative number, 0 or a positive number.
+ */
+static int compare_ints(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+/**
+ * @brief Allocates the state of the cycle search.
+ *
+ * @param s The search.
+ * @param g The graph with its adjacency lists.
+ * @param comp The component of each resource.
+ * @param resources The number of resources.
+ * @param processes The number of processes.
+ *
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int init_search(struct search *s, const struct graph *g,
+                       const int *comp, int resources, int processes) {
+  s->g = g;
+  s->comp = comp;
+  s->stamp = s->visit = 0;
+  s->budget = 0;
+  s->members = malloc(sizeof(int) * (resources + 1));
+  s->onPath = calloc(resources + 1, 1);
+  s->path = malloc(sizeof(int) * (resources + 1));
+  s->edge = malloc(sizeof(int) * (resources + 1));
+  s->assigned = malloc(sizeof(int) * (resources + 1));
+  s->pinned = calloc(processes + 1, sizeof(int));
+  s->owner = malloc(sizeof(int) * (processes + 1));
+  s->ownerStamp = calloc(processes + 1, sizeof(int));
+  s->visitStamp = calloc(processes + 1, sizeof(int));
+  if (s->members == NULL || s->onPath == NULL || s->path == NULL ||
+      s->edge == NULL || s->assigned == NULL || s->pinned == NULL ||
+      s->owner == NULL || s->ownerStamp == NULL || s->visitStamp == NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Frees the state of the cycle search.
+ *
+ * @param s The search.
+ */
+static void free_search(struct search *s) {
+  free(s->members);
+  free(s->onPath);
+  free(s->path);
+  free(s->edge);
+  free(s->assigned);
+  free(s->pinned);
+  free(s->owner);
+  free(s->ownerStamp);
+  free(s->visitStamp);
+}
+
+/**
+ * @brief Collects the resources of a component by increasing number.
+ *
+ * @param s The search, whose members are set.
+ * @param root A resource of the component.
+ * @param seen Marks the resources collected with minus the component
+ * number minus one.
+ *
+ * @return The number of resources of the component.
+ */
+static int component_members(struct search *s, int root, int *seen) {
+  const struct graph *g = s->g;
+  int stamp = -s->comp[root] - 1;
+  int head = 0, tail = 0;
+  int u, w, e;
+
+  s->members[tail++] = root;
+  seen[root] = stamp;
+  while (head < tail) {
+    u = s->members[head++];
+    for (e = g->first[u]; e < g->first[u + 1]; e++) {
+      w = g->orders[g->targets[e]].to;
+      if (s->comp[w] == s->comp[root] && seen[w] != stamp) {
+        seen[w] = stamp;
+        s->members[tail++] = w;
+      }
+    }
+  }
+  qsort(s->members, tail, sizeof(int), compare_ints);
+  return tail;
+}
+
+/**
+ * @brief Finds a shortest cycle of a component around which different
+ * processes can wait.
+ *
+ * Every length is tried in turn, each from every resource of the
+ * component as the lowest numbered resource of the cycle, so the first
+ * cycle found is a shortest one and lists the fewest processes.
+ *
+ * @param s The search, whose members are set to the component. The path
+ * and assigned are set to the orders of the cycle and their processes.
+ * @param members The number of resources of the component.
+ *
+ * @return The number of orders of the cycle, 0 if the component has no
+ * such cycle, -1 if SEARCH_BUDGET ran out first.
+ */
+static int find_cycle(struct search *s, int members) {
+  int limit, i, length;
+
+  s->budget = SEARCH_BUDGET;
+  for (limit = 1; limit <= members; limit++) {
+    for (i = 0; i < members; i++) {
+      length = search_from(s, s->members[i], limit);
+      if (length != 0) {
+        return length;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Searches the cycles of at most limit orders whose lowest numbered
+ * resource is start, depth first, for one around which different
+ * processes can wait.
+ *
+ * @param s The search.
+ * @param start The lowest numbered resource of the cycles.
+ * @param limit The most orders of a cycle.
+ *
+ * @return The number of orders of the cycle found, 0 if there is none, -1
+ * if the budget ran out.
+ */
+static int search_from(struct search *s, int start, int limit) {
+  const struct graph *g = s->g;
+  const struct order *o;
+  int depth = 0, found = 0;
+  int u = start, w;
+
+  s->onPath[start] = 1;
+  s->edge[0] = g->first[start];
+  while (found == 0) {
+    if (--s->budget < 0) {
+      found = -1;
+      break;
+    }
+    if (s->edge[depth] == g->first[u + 1]) {
+      s->onPath[u] = 0;
+      if (depth == 0) {
+        return 0;
+      }
+      o = &g->orders[s->path[--depth]];
+      pin(s, o, -1);
+      u = o->from;
+      continue;
+    }
+    s->path[depth] = g->targets[s->edge[depth]++];
+    o = &g->orders[s->path[depth]];
+    w = o->to;
+    if (w < start || s->comp[w] != s->comp[start] || blocked(s, o)) {
+      continue;
+    }
+    if (w == start) {
+      if (assign_processes(s, depth + 1)) {
+        found = depth + 1;
+      }
+      continue;
+    }
+    if (s->onPath[w] || depth + 2 > limit) {
+      continue;
+    }
+    pin(s, o, 1);
+    s->onPath[w] = 1;
+    s->edge[++depth] = g->first[w];
+    u = w;
+  }
+
+  /* Leave the marks clear for the next search */
+  s->onPath[start] = 0;
+  while (depth > 0) {
+    o = &g->orders[s->path[--depth]];
+    pin(s, o, -1);
+    s->onPath[o->to] = 0;
+  }
+  return found;
+}
+
+/**
+ * @brief Tells if all the processes of an order are pinned to orders of
+ * the path already.
+ *
+ * @param s The search.
+ * @param o The order.
+ *
+ * @return 1 if no process is left for the order, 0 otherwise.
+ */
+static int blocked(const struct search *s, const struct order *o) {
+  int k;
+
+  if (o->witnesses > WITNESSES) {
+    return 0;
+  }
+  for (k = 0; k < o->witnesses; k++) {
+    if (s->pinned[o->witness[k]] == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Pins the process of an order to the path, or unpins it, if only
+ * one process makes the order.
+ *
+ * @param s The search.
+ * @param o The order.
+ * @param by 1 to pin, -1 to unpin.
+ */
+static void pin(struct search *s, const struct order *o, int by) {
+  if (o->witnesses == 1) {
+    s->pinned[o->witness[0]] += by;
+  }
+}
+
+/**
+ * @brief Gives each order of a closed path a different process.
+ *
+ * The pinned orders keep their process and the others are matched to
+ * theirs along augmenting paths. An order made by more processes than are
+ * kept always has one left, so it only takes a kept one that is free.
+ *
+ * @param s The search, whose assigned is set.
+ * @param length The number of orders of the path.
+ *
+ * @return 1 if every order has a process, 0 otherwise.
+ */
+static int assign_processes(struct search *s, int length) {
+  const struct order *o;
+  int i;
+
+  ++s->stamp;
+  for (i = 0; i < length; i++) {
+    o = &s->g->orders[s->path[i]];
+    s->assigned[i] = -1;
+    if (o->witnesses == 1) {
+      s->assigned[i] = o->witness[0];
+      s->owner[o->witness[0]] = i;
+      s->ownerStamp[o->witness[0]] = s->stamp;
+    }
+  }
+  for (i = 0; i < length; i++) {
+    o = &s->g->orders[s->path[i]];
+    if (o->witnesses > 1 && o->witnesses <= WITNESSES) {
+      ++s->visit;
+      if (!match(s, i)) {
+        return 0;
+      }
+    }
+  }
+  for (i = 0; i < length; i++) {
+    if (s->g->orders[s->path[i]].witnesses > WITNESSES) {
+      ++s->visit;
+      match(s, i);
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Gives an order of a closed path a process along an augmenting
+ * path, moving the orders of its processes to others.
+ *
+ * @param s The search.
+ * @param i The position of the order in the path.
+ *
+ * @return 1 if the order got a process, 0 otherwise.
+ */
+static int match(struct search *s, int i) {
+  const struct order *o = &s->g->orders[s->path[i]];
+  int k, q;
+
+  for (k = 0; k < o->witnesses && k < WITNESSES; k++) {
+    q = o->witness[k];
+    if (s->visitStamp[q] == s->visit) {
+      continue;
+    }
+    s->visitStamp[q] = s->visit;
+    if (s->ownerStamp[q] != s->stamp ||
+        (s->g->orders[s->path[s->owner[q]]].witnesses > 1 &&
+         match(s, s->owner[q]))) {
+      s->ownerStamp[q] = s->stamp;
+      s->owner[q] = i;
+      s->assigned[i] = q;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Finds a shortest cycle through a resource within its component by
+ * a breadth first search.
+ *
+ * @param g The graph.
+ * @param comp The component of each resource.
+ * @param root The resource, in a component with a cycle.
+ * @param queue Room for the resources of the component.
+ * @param via Set to the order each resource reached was reached by.
+ * @param seen Marks the resources reached with the component number plus
+ * one.
+ * @param cycle Set to the orders of the cycle, the first starting at root.
+ *
+ * @return The number of orders of the cycle.
+ */
+static int shortest_cycle(const struct graph *g, const int *comp, int root,
+                          int *queue, int *via, int *seen, int *cycle) {
+  int stamp = comp[root] + 1;
+  int head = 0, tail = 0, n = 0;
+  int u, w, e, o, i, swap;
+
+  queue[tail++] = root;
+  seen[root] = stamp;
+  while (head < tail) {
+    u = queue[head++];
+    for (e = g->first[u]; e < g->first[u + 1]; e++) {
+      o = g->targets[e];
+      w = g->orders[o].to;
+      if (w == root) {
+        cycle[n++] = o;
+        for (; u != root; u = g->orders[via[u]].from) {
+          cycle[n++] = via[u];
+        }
+        for (i = 0; i < n / 2; i++) {
+          swap = cycle[i];
+          cycle[i] = cycle[n - 1 - i];
+          cycle[n - 1 - i] = swap;
+        }
+        return n;
+      }
+      if (comp[w] == comp[root] && seen[w] != stamp) {
+        seen[w] = stamp;
+        via[w] = o;
+        queue[tail++] = w;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Writes a cycle with the process that waits for each of its orders.
+ *
+ * @param sim The simulator holding the processes and resources.
+ * @param g The graph.
+ * @param cycle The orders of the cycle.
+ * @param assigned The process of each order, -1 for one of those not kept.
+ * @param length The number of orders.
+ * @param number The number of the cycle, from 1.
+ * @param out The stream the cycle is written to.
+ */
+static void print_cycle(struct simulator *sim, const struct graph *g,
+                        const int *cycle, const int *assigned, int length,
+                        int number, FILE *out) {
+  struct processTable *t = &sim->table;
+  struct resourceList **r = sim->resourceTable;
+  const struct order *o;
+  int i;
+
+  fprintf(out, "Cycle %d:", number);
+  for (i = 0; i < length; i++) {
+    fprintf(out, " %s ->", r[g->orders[cycle[i]].from]->name);
+  }
+  fprintf(out, " %s\n", r[g->orders[cycle[0]].from]->name);
+
+  for (i = 0; i < length; i++) {
+    o = &g->orders[cycle[i]];
+    fprintf(out, "  %s holds %s and requests %s\n",
+            assigned[i] >= 0 ? t->pcb[assigned[i]]->pagePtr->name
+                             : "another process",
+            r[o->from]->name, r[o->to]->name);
+  }
+}
+
+/**
+ * @brief Writes the processes that end holding a resource which other
+ * processes request exclusively, so that they wait for it forever.
+ *
+ * @param sim The simulator holding the processes and resources.
+ * @param g The graph, with the leaks of every process.
+ * @param out The stream the processes are written to.
+ *
+ * @return The number of processes written.
+ */
+static int print_leaks(struct simulator *sim, const struct graph *g,
+                       FILE *out) {
+  struct processTable *t = &sim->table;
+  struct resourceList **r = sim->resourceTable;
+  int last = -1, count = 0;
+  int i, p, held;
+
+  for (i = 0; i < g->leakCount; i += 2) {
+    p = g->leaks[i];
+    held = g->leaks[i + 1];
+    if (g->requester[held] != -2 || !g->exclusive[held]) {
+      continue;
+    }
+    if (p != last) {
+      fprintf(out, "%s%s ends holding", count > 0 ? "\n" : "",
+              t->pcb[p]->pagePtr->name);
+      last = p;
+      ++count;
+    }
+    fprintf(out, " %s", r[held]->name);
+  }
+  if (count > 0) {
+    fprintf(out, "\n");
+  }
+  return count;
+}
@@ -0,0 +1,35 @@
+/**
+  * @file lockorder.h
+  * @description A definition of the static lock order analysis, which finds
+  *              the deadlocks a workload can run into before it runs.
+  *
+  * A process that holds resource A while it requests resource B orders A
+  * before B. The orders of all processes form a graph over the resources,
+  * and processes can only deadlock waiting for each other's resources if
+  * the graph has a cycle whose orders different processes make: each of
+  * them holds one resource of the cycle and requests the next. A process
+  * that ends holding a resource makes every other process that requests it
+  * wait forever. Resources that are only ever requested shared never make
+  * a process wait and are left out, and so are waits for mailboxes,
+  * barriers and unknown resources.
+  */
+
+#ifndef _LOCKORDER_H
+#define _LOCKORDER_H
+
+#include <stdio.h>
+
+struct simulator;
+
+/*
+ * Builds the lock order graph of the compiled processes of sim, writes its
+ * cycles to out with a different process for each order of a cycle, and
+ * the processes that end holding resources others request, and returns
+ * the number of cycles (strongly connected components of the graph with
+ * such a cycle) plus the number of those processes, or -1 if memory ran
+ * out. 0 certifies that no process waits for a resource held by another
+ * that waits in turn or has ended.
+ */
+int lockorder_analyze(struct simulator *sim, FILE *out);
+
+#endif
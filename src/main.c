@@ -9,6 +9,8 @@
  *
  * The project consists of 3 main files parser, loader and manager. Which
  * respectively handles the loading, parsing and management of the processes.
+ * procsched.h wraps them in a library interface without global state, which
+ * this program uses to run one simulation.
  *
  * @section make_sec Compile
  *
@@ -18,85 +20,853 @@
  *
  * $ ./process-management data/process.list
  *
+ * $ ./my_executable [-q] [-s] input_file schedule_alg [quantum]
+ *
+ * schedule_alg is 0 for first come first serve, 1 for round robin with a
+ * time slice of quantum instructions (1 by default) and 2 for priority
+ * scheduling, which runs the most urgent ready process and time slices
+ * processes of equal priority only if a quantum is given.
+ *
+ * $ ./my_executable [-H horizon] input_file 3|4 [quantum]
+ *
+ * A process named P@period, P@period/deadline or P@period~jitter in the
+ * Processes line is periodic: it runs its program once per job, one job
+ * every period ticks (one tick per instruction), and each job must
+ * complete by its deadline. 3 schedules the job with the earliest deadline
+ * first, 4 the process with the shortest period first (rate monotonic);
+ * both run the other processes only when no job is ready. A schedulability
+ * test is written to stderr before the run and -s adds the number of jobs
+ * and missed deadlines to the summary. Jobs arrive until the horizon, the
+ * least common multiple of the periods by default.
+ *
+ * -q suppresses the per-instruction trace and -s prints a one line summary of
+ * the run (instructions executed, scheduling time and peak RSS) to stderr.
+ * Both are used by the benchmark suite in bench/.
+ *
+ * $ ./my_executable -b [-j threads] [-o results.csv] [-s] schedule_alg quantum
+ *   file|glob|@list ...
+ *
+ * Batch mode schedules every file on a pool of threads (one per CPU unless
+ * -j is given) and writes one CSV row per file to stdout or the -o file.
+ *
+ * $ ./my_executable -S [-j threads] [-o grid.csv] [-s] input_file
+ *   alg[:first[-last[:step]]] ...
+ *
+ * Sweep mode loads the file once and schedules it under every listed
+ * configuration, e.g. 0 1:1-64 for FCFS and round robin with quanta 1 to 64,
+ * writing one CSV row per configuration.
+ *
+ * $ ./my_executable [-k checkpoint [-e every]] input_file schedule_alg
+ *   [quantum]
+ * $ ./my_executable -r checkpoint [-k checkpoint [-e every]] input_file
+ *
+ * -k writes a checkpoint of the run every -e instructions and whenever the
+ * process receives SIGUSR1, -r continues the run saved in a checkpoint with
+ * its algorithm and quantum.
+ *
+ * $ ./my_executable -R run.rec [-e every] input_file schedule_alg [quantum]
+ * $ ./my_executable -P run.rec [-g event|process:name|deadlock:n] input_file
+ *
+ * -R records every scheduling decision of the run with a snapshot every -e
+ * instructions (a million by default). -P replays a recording without a
+ * trace up to the event with the given index, the first time slice of the
+ * named process or the n-th deadlock, and traces it from there on with one
+ * line per event.
+ *
+ * $ ./my_executable -c workload.img input_file
+ *
+ * Compiles the file into a binary image, which every mode accepts in place
+ * of a process list and loads by mapping it instead of parsing it.
+ *
+ * $ ./my_executable -A [-m budget[K|M|G]] [-s] input_file
+ *
+ * Checks the lock order of the processes without running them: prints every
+ * cycle of resources that different processes request while holding the
+ * previous one, with the processes that request them, and every process
+ * that ends holding a resource others request, and exits with a failure
+ * status if there is one, so a workload that cannot deadlock over
+ * resources passes.
+ *
+ * $ ./my_executable -m budget[K|M|G] [-s] workload.img schedule_alg [quantum]
+ *
+ * Pages the programs of an image in and out of budget bytes of memory
+ * instead of mapping them whole, so workloads larger than the memory can
+ * run; -s adds the number of page faults to the summary. Process lists are
+ * loaded whole, compile them with -c first.
+ *
+ * $ ./my_executable -D [-l live] [-u socket] [-q] [-s] schedule_alg [quantum]
+ *
+ * Daemon mode reads Process and Subroutine sections from stdin, or from the
+ * connections to a Unix domain socket, and schedules every process as soon
+ * as its section is complete. At most -l processes (1024 by default) are
+ * live at a time; further input waits until processes terminate. It runs
+ * until stdin ends or SIGINT or SIGTERM arrives, see daemon.h.
+ *
+ * $ ./my_executable -M /name ... input_file schedule_alg [quantum]
+ * $ ./my_executable -M /name -D ... schedule_alg [quantum]
+ * $ tools/procsched-top /name
+ *
+ * -M publishes live counters of a single run or the daemon to the POSIX
+ * shared memory segment /name, which procsched-top displays. The segment is
+ * removed when a single run is stopped by SIGINT or SIGTERM.
+ *
+ * $ ./my_executable -w writer|fair ... input_file schedule_alg [quantum]
+ *
+ * -w sets how shared (reqs) and exclusive (req, reqx) requests of a
+ * resource take turns in a single run or the daemon: writer, the default,
+ * wakes waiting writers first, fair wakes waiting readers first.
+ *
  */
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "daemon.h"
+#include "pool.h"
+#include "procsched.h"
+#include "sweep.h"
 
-#include "loader.h"
-#include "manager.h"
-#include "parser.h"
-#include "queue.h"
+void print_run_stats(struct simulator *sim, double seconds);
+int run_batch(int argc, char **argv, int threads, const char *output,
+              int stats);
+int run_sweep(int argc, char **argv, int threads, const char *output,
+              int stats);
+int compile_image(int argc, char **argv, const char *image);
+int check_lock_order(int argc, char **argv, size_t budget, int stats);
+int run_daemon(int argc, char **argv, const char *path, int limit,
+               const char *monitor, int policy, int trace, int stats);
+void print_usage(const char *program);
+int parse_policy(const char *text);
+size_t parse_size(const char *text);
+int replay(struct simulator *sim, const char *recording, const char *target,
+           int trace);
+void request_checkpoint(int signo);
+void request_stop(int signo);
 
-void debug_pcb(struct processControlBlock *pcb);
-void debug_mailboxes(struct mailbox *mail);
+/* Set by SIGUSR1 to checkpoint the running simulation */
+static volatile sig_atomic_t checkpointRequested = 0;
+
+/* Set to the signal by SIGINT and SIGTERM to stop the daemon or a
+ * monitored run */
+static volatile sig_atomic_t stopRequested = 0;
 
 int main(int argc, char **argv) {
   char *filename;
   int schedule_alg;
   int quantum = 1;
-  struct processControlBlock *pcb;
-  struct resourceList *resources;
-  struct mailbox *mailboxes;
+  struct simulator *sim;
+  struct timespec start, end;
+  int trace = 1;
+  int stats = 0;
+  int batch = 0;
+  int sweep = 0;
+  int threads = 0;
+  char *output = NULL;
+  char *image = NULL;
+  char *checkpoint = NULL;
+  char *restore = NULL;
+  long long every = 0;
+  char *record = NULL;
+  char *playback = NULL;
+  char *target = "0";
+  size_t budget = 0;
+  int daemonMode = 0;
+  int limit = DAEMON_LIMIT;
+  char *socketPath = NULL;
+  char *monitor = NULL;
+  int policy = PROCSCHED_WRITER_PREFERRING;
+  long long horizon = 0;
+  int lockOrder = 0;
+  struct sigaction action;
+  char *rest;
+  int opt;
 
   filename = NULL;
 
-  if (argc < 1) {
+  while ((opt = getopt(argc, argv, "qsbSj:o:c:k:e:r:R:P:g:m:Dl:u:M:w:H:A")) !=
+         -1) {
+    switch (opt) {
+    case 'q':
+      trace = 0;
+      break;
+    case 's':
+      stats = 1;
+      break;
+    case 'b':
+      batch = 1;
+      break;
+    case 'S':
+      sweep = 1;
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'c':
+      image = optarg;
+      break;
+    case 'k':
+      checkpoint = optarg;
+      break;
+    case 'e':
+      every = atoll(optarg);
+      break;
+    case 'r':
+      restore = optarg;
+      break;
+    case 'R':
+      record = optarg;
+      break;
+    case 'P':
+      playback = optarg;
+      break;
+    case 'g':
+      target = optarg;
+      break;
+    case 'm':
+      budget = parse_size(optarg);
+      break;
+    case 'D':
+      daemonMode = 1;
+      break;
+    case 'l':
+      limit = atoi(optarg);
+      break;
+    case 'u':
+      socketPath = optarg;
+      break;
+    case 'M':
+      monitor = optarg;
+      break;
+    case 'w':
+      policy = parse_policy(optarg);
+      if (policy == -1) {
+        fprintf(stderr, "Unknown policy %s, use writer or fair\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'H':
+      horizon = atoll(optarg);
+      break;
+    case 'A':
+      lockOrder = 1;
+      break;
+    default:
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (batch) {
+    return run_batch(argc - optind, argv + optind, threads, output, stats);
+  }
+  if (sweep) {
+    return run_sweep(argc - optind, argv + optind, threads, output, stats);
+  }
+
+  if (daemonMode) {
+    return run_daemon(argc - optind, argv + optind, socketPath, limit, monitor,
+                      policy, trace, stats);
+  }
+
+  if (image != NULL) {
+    return compile_image(argc - optind, argv + optind, image);
+  }
+
+  if (lockOrder) {
+    return check_lock_order(argc - optind, argv + optind, budget, stats);
+  }
+
+  if (argc - optind < (restore != NULL || playback != NULL ? 1 : 2)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  filename = argv[optind];
+  schedule_alg = 0;
+  if (argc - optind > 1) {
+    schedule_alg = (int)strtol(argv[optind + 1], &rest, 10);
+    if (*argv[optind + 1] == '\0' || *rest != '\0' ||
+        schedule_alg < PROCSCHED_FCFS || schedule_alg > PROCSCHED_RM) {
+      fprintf(stderr, "Unknown schedule_alg %s\n", argv[optind + 1]);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (schedule_alg != 0 && argc - optind > 2) {
+    quantum = atoi(argv[optind + 2]);
+  } else if (schedule_alg >= PROCSCHED_PRIORITY) {
+    quantum = 0;
+  }
+
+  sim = procsched_create();
+  if (sim == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (!trace) {
+    procsched_set_trace(sim, NULL);
+  }
+  procsched_set_rw_policy(sim, policy);
+
+  procsched_set_memory_budget(sim, budget);
+  if (procsched_load_file(sim, filename) != 0) {
+    fprintf(stderr, "Could not load %s\n", filename);
+    procsched_destroy(sim);
+    return EXIT_FAILURE;
+  }
+
+  if (procsched_set_horizon(sim, horizon) != 0) {
+    fprintf(stderr, "Invalid horizon %lld\n", horizon);
+    procsched_destroy(sim);
+    return EXIT_FAILURE;
+  }
+
+  if (playback != NULL) {
+    opt = replay(sim, playback, target, trace);
+    procsched_destroy(sim);
+    return opt;
+  }
+
+  if (restore != NULL &&
+      procsched_restore(sim, restore, &schedule_alg, &quantum) != 0) {
+    fprintf(stderr, "Could not restore %s\n", restore);
+    procsched_destroy(sim);
     return EXIT_FAILURE;
   }
+  if (restore == NULL &&
+      (schedule_alg == PROCSCHED_EDF || schedule_alg == PROCSCHED_RM)) {
+    procsched_analyze(sim, schedule_alg, stderr);
+  }
 
-  filename = argv[1];
-  schedule_alg = atoi(argv[2]);
+  if (checkpoint != NULL) {
+    action.sa_handler = request_checkpoint;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+    procsched_set_checkpoint(sim, checkpoint, every, &checkpointRequested);
+  }
 
-  if (schedule_alg == 1) {
-    quantum = atoi(argv[3]);
+  if (monitor != NULL) {
+    if (procsched_set_monitor(sim, monitor, &stopRequested) != 0) {
+      fprintf(stderr, "Could not create the segment %s\n", monitor);
+      procsched_destroy(sim);
+      return EXIT_FAILURE;
+    }
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
   }
 
-  parse_process_file(filename);
+  if (record != NULL &&
+      procsched_record(sim, record, every > 0 ? every : 1000000) != 0) {
+    fprintf(stderr, "Could not record to %s\n", record);
+    procsched_destroy(sim);
+    return EXIT_FAILURE;
+  }
 
-  pcb = get_loaded_processes();
-  resources = get_available_resources();
-  mailboxes = get_mailboxes();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  procsched_run(sim, schedule_alg, quantum);
+  clock_gettime(CLOCK_MONOTONIC, &end);
 
-#ifdef DEBUG
-  debug_pcb(pcb);
-#endif
+  if (stats) {
+    print_run_stats(sim, (end.tv_sec - start.tv_sec) +
+                             (end.tv_nsec - start.tv_nsec) / 1e9);
+  }
 
-  schedule_processes(pcb, resources, mailboxes, schedule_alg, quantum);
-  dealloc_processes();
+  procsched_destroy(sim);
 
   return EXIT_SUCCESS;
 }
 
-#ifdef DEBUG
-void debug_pcb(struct processControlBlock *pcb) {
-  struct processControlBlock *debug;
-  struct instruction *debugInst;
-
-  debug = pcb;
-  do {
-    printf("PCB %s\n", debug->pagePtr->name);
-    printf("State: %d\n", debug->processState);
-    debugInst = debug->nextInstruction;
-    do {
-      if (debugInst == NULL) {
-        break;
-      }
-      printf("(%d, %s, %s)\n", debugInst->type, debugInst->resource,
-             debugInst->msg);
-      debugInst = debugInst->next;
-    } while (debugInst != NULL);
+/**
+ * @brief Replays a recording, see -P.
+ *
+ * @param sim The simulator holding the recorded workload.
+ * @param recording The path of the recording.
+ * @param target An event index, process:name or deadlock:n.
+ * @param trace Trace from the target on if set.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int replay(struct simulator *sim, const char *recording, const char *target,
+           int trace) {
+  int seek = PROCSCHED_SEEK_EVENT;
+  const char *process = NULL;
+  long long n = 0;
 
-    debug = debug->next;
-  } while (debug != NULL);
+  if (strncmp(target, "process:", 8) == 0) {
+    seek = PROCSCHED_SEEK_PROCESS;
+    process = target + 8;
+  } else if (strncmp(target, "deadlock:", 9) == 0) {
+    seek = PROCSCHED_SEEK_DEADLOCK;
+    n = atoll(target + 9);
+  } else {
+    n = atoll(target);
+  }
+
+  if (procsched_replay(sim, recording, seek, n, process,
+                       trace ? stdout : NULL) != 0) {
+    fprintf(stderr, "Could not replay %s to %s\n", recording, target);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes the modes of the program to stderr, see the main page.
+ *
+ * @param program The name the program was run with.
+ */
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-q] [-s] [-H horizon] input_file schedule_alg "
+          "[quantum]\n"
+          "       %s -b [-j threads] [-o results.csv] [-s] schedule_alg "
+          "quantum file|glob|@list ...\n"
+          "       %s -S [-j threads] [-o grid.csv] [-s] input_file "
+          "alg[:first[-last[:step]]] ...\n"
+          "       %s [-k checkpoint [-e every]] input_file schedule_alg "
+          "[quantum]\n"
+          "       %s -r checkpoint [-k checkpoint [-e every]] input_file\n"
+          "       %s -R run.rec [-e every] input_file schedule_alg "
+          "[quantum]\n"
+          "       %s -P run.rec [-g event|process:name|deadlock:n] "
+          "input_file\n"
+          "       %s -c workload.img input_file\n"
+          "       %s -A [-m budget[K|M|G]] [-s] input_file\n"
+          "       %s -m budget[K|M|G] [-s] workload.img schedule_alg "
+          "[quantum]\n"
+          "       %s -D [-l live] [-u socket] [-q] [-s] schedule_alg "
+          "[quantum]\n"
+          "-M /name publishes live counters, -w writer|fair sets the "
+          "read-write policy.\n"
+          "schedule_alg: 0 first come first serve, 1 round robin, "
+          "2 priority,\n"
+          "              3 earliest deadline first, 4 rate monotonic\n",
+          program, program, program, program, program, program, program,
+          program, program, program, program);
 }
 
-void debug_mailboxes(struct mailbox *mail) {
-  struct mailbox *debug;
-  debug = mail;
-  do {
-    printf("Mailbox %s\n", debug->name);
-    debug = debug->next;
-  } while (debug != NULL);
+/**
+ * @brief Parses a read-write policy, see -w.
+ *
+ * @param text "writer" or "fair".
+ *
+ * @return PROCSCHED_WRITER_PREFERRING, PROCSCHED_FAIR or -1 if the policy
+ * is unknown.
+ */
+int parse_policy(const char *text) {
+  if (strcmp(text, "writer") == 0) {
+    return PROCSCHED_WRITER_PREFERRING;
+  }
+  if (strcmp(text, "fair") == 0) {
+    return PROCSCHED_FAIR;
+  }
+  return -1;
+}
+
+/**
+ * @brief Parses a size in bytes with an optional K, M or G suffix, see -m.
+ *
+ * @param text The size.
+ *
+ * @return The size in bytes.
+ */
+size_t parse_size(const char *text) {
+  char *end;
+  size_t size = strtoull(text, &end, 10);
+
+  switch (*end) {
+  case 'G':
+  case 'g':
+    size *= 1024;
+    /* fall through */
+  case 'M':
+  case 'm':
+    size *= 1024;
+    /* fall through */
+  case 'K':
+  case 'k':
+    size *= 1024;
+    break;
+  }
+  return size;
+}
+
+/**
+ * @brief Requests a checkpoint of the running simulation, see -k.
+ *
+ * @param signo The signal, SIGUSR1.
+ */
+void request_checkpoint(int signo) {
+  (void)signo;
+  checkpointRequested = 1;
+}
+
+/**
+ * @brief Stops the daemon, see -D, or a run with -M.
+ *
+ * @param signo The signal, SIGINT or SIGTERM.
+ */
+void request_stop(int signo) {
+  stopRequested = signo;
+}
+
+/**
+ * @brief Prints a summary of the run to stderr as key=value pairs.
+ *
+ * @param sim The simulator that ran.
+ * @param seconds Wall time spent in the scheduler.
+ */
+void print_run_stats(struct simulator *sim, double seconds) {
+  struct procschedStats stats;
+  struct rusage usage;
+
+  procsched_get_stats(sim, &stats);
+  getrusage(RUSAGE_SELF, &usage);
+
+  fprintf(stderr,
+          "processes=%d instructions=%lld schedule_s=%.6f "
+          "instr_per_s=%.0f peak_rss_kb=%ld page_faults=%lld",
+          stats.processes, stats.instructions, seconds,
+          seconds > 0 ? stats.instructions / seconds : 0.0, usage.ru_maxrss,
+          stats.pageFaults);
+  if (stats.jobs > 0) {
+    fprintf(stderr, " jobs=%lld deadline_misses=%lld", stats.jobs,
+            stats.deadlineMisses);
+  }
+  fputc('\n', stderr);
+}
+
+/**
+ * @brief Runs batch mode.
+ *
+ * @param argc The number of operands.
+ * @param argv The operands: schedule_alg, quantum and the files.
+ * @param threads The number of threads, 0 for one per CPU.
+ * @param output The path of the results table, NULL for stdout.
+ * @param stats Print a one line summary to stderr if set.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int run_batch(int argc, char **argv, int threads, const char *output,
+              int stats) {
+  struct batch b;
+  struct timespec start, end;
+  long long instructions = 0;
+  double seconds;
+  FILE *out = stdout;
+  int failed = 0;
+  int i;
+
+  if (argc < 3) {
+    return EXIT_FAILURE;
+  }
+
+  batch_init(&b);
+  for (i = 2; i < argc; i++) {
+    if (batch_add(&b, argv[i]) == 0) {
+      fprintf(stderr, "No files match %s\n", argv[i]);
+    }
+  }
+
+  if (output != NULL && (out = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "Could not write %s\n", output);
+    batch_free(&b);
+    return EXIT_FAILURE;
+  }
+  if (threads <= 0) {
+    threads = pool_default_threads();
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  batch_run(&b, threads, atoi(argv[0]), atoi(argv[1]));
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  batch_print(out, &b);
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  for (i = 0; i < b.count; i++) {
+    instructions += b.results[i].stats.instructions;
+    failed += b.results[i].status != 0;
+  }
+  if (stats) {
+    fprintf(stderr,
+            "files=%d failed=%d threads=%d instructions=%lld wall_s=%.6f "
+            "files_per_s=%.0f\n",
+            b.count, failed, threads, instructions, seconds,
+            seconds > 0 ? b.count / seconds : 0.0);
+  }
+
+  batch_free(&b);
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Runs sweep mode.
+ *
+ * @param argc The number of operands.
+ * @param argv The operands: the file and the configurations.
+ * @param threads The number of threads, 0 for one per CPU.
+ * @param output The path of the results grid, NULL for stdout.
+ * @param stats Print a one line summary to stderr if set.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int run_sweep(int argc, char **argv, int threads, const char *output,
+              int stats) {
+  struct simulator *image;
+  struct sweep s;
+  struct timespec start, end;
+  double seconds;
+  FILE *out = stdout;
+  int i;
+
+  if (argc < 2) {
+    return EXIT_FAILURE;
+  }
+
+  image = procsched_create();
+  if (image == NULL) {
+    return EXIT_FAILURE;
+  }
+  procsched_set_trace(image, NULL);
+  if (procsched_load_file(image, argv[0]) != 0) {
+    fprintf(stderr, "Could not load %s\n", argv[0]);
+    procsched_destroy(image);
+    return EXIT_FAILURE;
+  }
+
+  sweep_init(&s, image);
+  for (i = 1; i < argc; i++) {
+    if (sweep_add(&s, argv[i]) < 0) {
+      fprintf(stderr, "Bad configuration %s\n", argv[i]);
+      sweep_free(&s);
+      procsched_destroy(image);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (output != NULL && (out = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "Could not write %s\n", output);
+    sweep_free(&s);
+    procsched_destroy(image);
+    return EXIT_FAILURE;
+  }
+  if (threads <= 0) {
+    threads = pool_default_threads();
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  sweep_run(&s, threads);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  sweep_print(out, &s);
+  if (out != stdout) {
+    fclose(out);
+  }
+  if (stats) {
+    fprintf(stderr, "configurations=%d threads=%d wall_s=%.6f\n", s.count,
+            threads, seconds);
+  }
+
+  sweep_free(&s);
+  procsched_destroy(image);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Compiles a process list into a binary image.
+ *
+ * @param argc The number of operands.
+ * @param argv The operands: the process list.
+ * @param image The path of the image.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int compile_image(int argc, char **argv, const char *image) {
+  struct simulator *sim;
+  int status = EXIT_SUCCESS;
+
+  if (argc < 1) {
+    return EXIT_FAILURE;
+  }
+
+  sim = procsched_create();
+  if (sim == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (procsched_load_file(sim, argv[0]) != 0) {
+    fprintf(stderr, "Could not load %s\n", argv[0]);
+    status = EXIT_FAILURE;
+  } else if (procsched_save_image(sim, image) != 0) {
+    fprintf(stderr, "Could not write %s\n", image);
+    status = EXIT_FAILURE;
+  }
+  procsched_destroy(sim);
+
+  return status;
+}
+
+/**
+ * @brief Checks the lock order of a process list or image, see -A.
+ *
+ * @param argc The number of operands.
+ * @param argv The operands: the process list or image.
+ * @param budget The memory budget of a paged image, 0 to map it whole.
+ * @param stats Print a one line summary to stderr if set.
+ *
+ * @return EXIT_SUCCESS if nothing that may deadlock was found, EXIT_FAILURE
+ * otherwise.
+ */
+int check_lock_order(int argc, char **argv, size_t budget, int stats) {
+  struct simulator *sim;
+  struct procschedStats counts;
+  struct timespec start, end;
+  struct rusage usage;
+  int found;
+
+  if (argc < 1) {
+    return EXIT_FAILURE;
+  }
+
+  sim = procsched_create();
+  if (sim == NULL) {
+    return EXIT_FAILURE;
+  }
+  procsched_set_memory_budget(sim, budget);
+  if (procsched_load_file(sim, argv[0]) != 0) {
+    fprintf(stderr, "Could not load %s\n", argv[0]);
+    procsched_destroy(sim);
+    return EXIT_FAILURE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  found = procsched_lock_order(sim, stdout);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (found < 0) {
+    fprintf(stderr, "Could not check the lock order of %s\n", argv[0]);
+  }
+
+  if (stats) {
+    procsched_get_stats(sim, &counts);
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "processes=%d found=%d analyze_s=%.6f peak_rss_kb=%ld\n",
+            counts.processes, found,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+            usage.ru_maxrss);
+  }
+
+  procsched_destroy(sim);
+
+  return found == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Runs daemon mode.
+ *
+ * @param argc The number of operands.
+ * @param argv The operands: schedule_alg and quantum.
+ * @param path The path of the socket to listen on, NULL to read stdin.
+ * @param limit The maximum number of live processes.
+ * @param monitor The shared memory segment to publish the counters to, or
+ * NULL.
+ * @param trace Write the trace to stdout if set.
+ * @param stats Print a one line summary to stderr if set.
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int run_daemon(int argc, char **argv, const char *path, int limit,
+               const char *monitor, int policy, int trace, int stats) {
+  struct simulator *sim;
+  struct daemon d;
+  struct procschedStats run;
+  struct sigaction action;
+  struct timespec start, end;
+  struct rusage usage;
+  double seconds;
+  int schedule_alg;
+  int quantum = 1;
+  int status;
+
+  if (argc < 1) {
+    return EXIT_FAILURE;
+  }
+  schedule_alg = atoi(argv[0]);
+  if (schedule_alg != PROCSCHED_FCFS && argc > 1) {
+    quantum = atoi(argv[1]);
+  } else if (schedule_alg == PROCSCHED_PRIORITY) {
+    quantum = 0;
+  }
+  if (schedule_alg != PROCSCHED_FCFS && schedule_alg != PROCSCHED_RR &&
+      schedule_alg != PROCSCHED_PRIORITY) {
+    return EXIT_FAILURE;
+  }
+
+  sim = procsched_create();
+  if (sim == NULL) {
+    return EXIT_FAILURE;
+  }
+  if (!trace) {
+    procsched_set_trace(sim, NULL);
+  }
+  procsched_set_rw_policy(sim, policy);
+  if (monitor != NULL && procsched_set_monitor(sim, monitor, NULL) != 0) {
+    fprintf(stderr, "Could not create the segment %s\n", monitor);
+    procsched_destroy(sim);
+    return EXIT_FAILURE;
+  }
+  if (daemon_init(&d, sim, path, limit) != 0) {
+    fprintf(stderr, "Could not listen on %s\n", path);
+    procsched_destroy(sim);
+    return EXIT_FAILURE;
+  }
+
+  /* Without SA_RESTART the signal also ends a wait for input */
+  action.sa_handler = request_stop;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  d.stop = &stopRequested;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  status = daemon_run(&d, schedule_alg, quantum);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  if (status != 0) {
+    fprintf(stderr, "Could not read the input\n");
+  }
+  if (stats) {
+    procsched_get_stats(sim, &run);
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr,
+            "admitted=%lld retired=%lld instructions=%lld "
+            "deadlock_victims=%d schedule_s=%.6f peak_rss_kb=%ld\n",
+            d.admitted, d.retired, run.instructions, run.deadlockVictims,
+            seconds, usage.ru_maxrss);
+  }
+
+  daemon_free(&d);
+  procsched_destroy(sim);
+
+  return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
-#endif
@@ -1,75 +1,120 @@
 /**
  * @file manager.c
  */
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "checkpoint.h"
 #include "manager.h"
+#include "monitor.h"
+#include "pager.h"
+#include "procsched.h"
+#include "program.h"
 #include "queue.h"
+#include "realtime.h"
+#include "replay.h"
+#include "simulator.h"
+#include "syntax.h"
+#include "table.h"
+#include "topic.h"
 
 #define QUANTUM 1
 #define TRUE 1
 #define FALSE 0
 
-void process_release(struct processControlBlock *current,
-                     struct instruction *instruct,
-                     struct resourceList *resource);
-void process_request(struct processControlBlock *current,
-                     struct instruction *instruct,
-                     struct resourceList *resource);
-void process_send_message(struct processControlBlock *pcb,
-                          struct instruction *instruct, struct mailbox *mail);
-void process_receive_message(struct processControlBlock *pcb,
-                             struct instruction *instruct,
-                             struct mailbox *mail);
-int acquire_resource(char *resourceName, struct resourceList *resource,
+void run_scheduler(struct simulator *sim, int quantum);
+void process_release(struct simulator *sim, int p, struct op *op);
+int process_request(struct simulator *sim, int p, struct op *op);
+int process_request_set(struct simulator *sim, int p, struct op *op);
+int process_send_message(struct simulator *sim, int p, struct op *op);
+int process_receive_message(struct simulator *sim, int p, struct op *op);
+void process_subscribe(struct simulator *sim, int p, struct op *op);
+int process_sync(struct simulator *sim, int p, struct op *op);
+void make_room(struct simulator *sim, struct mailbox *mail);
+void leave_topics(struct simulator *sim, int p);
+struct mailbox *find_mailbox(char *mailboxName, struct mailbox *mail);
+int acquire_resource(struct resourceList *resource,
                      struct processControlBlock *p);
-int release_resource(char *resourceName, struct resourceList *resource,
+int acquire_shared(struct resourceList *resource,
+                   struct processControlBlock *p);
+int release_resource(struct resourceList *resource,
                      struct processControlBlock *p);
-void add_resource_to_process(struct processControlBlock *current,
-                             struct resourceList *resource);
-void release_resource_from_process(struct processControlBlock *current,
-                                   struct resourceList *resource);
-void process_to_readyq(struct cpuSchedule *schedule,
-                       struct processControlBlock *proc);
-void process_to_waitingq(struct cpuSchedule *schedule,
-                         struct processControlBlock *proc);
-void process_to_terminateq(struct cpuSchedule *schedule,
-                           struct processControlBlock *proc);
-int processes_finished(struct processControlBlock *firstPCB);
-int processes_deadlocked(struct processControlBlock *firstPCB);
-int is_resource_available(char *resourceName, struct resourceList *resource);
-void send_processes_to_readyq(struct queue *waitingQueue,
+struct resourceList *
+add_resource_to_process(struct processControlBlock *current,
+                        struct resourceList *resource);
+struct resourceList *
+release_resource_from_process(struct processControlBlock *current,
                               struct resourceList *resource);
+void process_to_readyq(struct processTable *t, int p);
+void process_to_waitingq(struct processTable *t, int p);
+void process_to_terminateq(struct processTable *t, int p);
+struct queue *wait_queue_of(struct processTable *t, struct op *op);
+void wake_waiters(struct simulator *sim, int resource);
+int wake_set_waiter(struct simulator *sim, int resource);
+void wake_mailbox_waiters(struct simulator *sim, struct queue *q, int n);
+int dequeue_waiter(struct processTable *t, struct queue *q);
+void inherit_priority(struct simulator *sim, int p);
+static void raise_holders(struct simulator *sim, int resource, int p);
+void acquire_priority(struct simulator *sim, int p,
+                      struct resourceList *resource);
+void restore_priority(struct simulator *sim, int p, const char *released);
+int waiter_priority(struct simulator *sim, int resource);
+static void trace_priority(struct simulator *sim, int p, const char *reason,
+                           const char *name);
+static inline int has_member(const struct resourceSet *set, int resource);
+int processes_finished(struct processTable *t);
+void recover_from_deadlock(struct simulator *sim);
+int is_resource_available(struct resourceList *resource);
+int is_resource_shareable(struct resourceList *resource);
+int is_set_available(struct processTable *t, const struct resourceSet *set);
+static inline void update_available_bit(struct simulator *sim, int resource);
+int request_must_wait(struct simulator *sim, struct op *op);
+int is_op_ready(struct simulator *sim, int p, struct op *op);
+void send_processes_to_readyq(struct simulator *sim);
 void release_all_resources_from_process(struct processControlBlock *pcb);
-void print_available_resources(struct resourceList *resource);
+void print_available_resources(FILE *out, struct resourceList *resource);
+
+/* The code address of each op type, see run_process. It is the same for
+ * every simulator, so it is shared by all threads. */
+static const void *const *opHandlers = NULL;
 
 /**
- * @brief Schedules processes by either robin-round fashion or first come
- * first serve depending on the alogrithm selected through the variable
- * schedule_alg
+ * @brief Schedules processes by either robin-round fashion, first come
+ * first serve, priority, earliest deadline first or rate monotonic
+ * depending on the alogrithm selected through the variable schedule_alg
  *
- * @param pcb The process control block which contains the current process as
- * well as a pointer to the next process control block.
- * @param resource The list of resources available to the system.
- * @param mail The list of mailboxes available to the system.
- * @param schedule_alg Bit indicating which scheduling alogrithm to use
+ * @param sim The simulator holding the compiled processes, resources and
+ * mailboxes.
+ * @param schedule_alg 0 for first come first serve, 1 for round robin,
+ * PROCSCHED_PRIORITY, PROCSCHED_EDF or PROCSCHED_RM
  * @param quantum Number of instructions a process should run before it is
  * preemptied
  */
 
-void schedule_processes(struct processControlBlock *pcb,
-                        struct resourceList *resource, struct mailbox *mail,
-                        int schedule_alg, int quantum) {
-
-  struct processControlBlock *firstPCB = pcb;
-  int num = pcb->cpuSchedulePtr->readyQueue->tail->item->pagePtr->number;
+void schedule_processes(struct simulator *sim, int schedule_alg,
+                        int quantum) {
+  if (sim->firstPCB == NULL) {
+    return;
+  }
 
+  if (schedule_alg == PROCSCHED_EDF) {
+    table_prioritize(&sim->table, TABLE_BY_DEADLINE);
+  } else if (schedule_alg == PROCSCHED_RM) {
+    table_prioritize(&sim->table, TABLE_BY_PERIOD);
+  } else {
+    table_prioritize(&sim->table, schedule_alg == PROCSCHED_PRIORITY
+                                      ? TABLE_BY_PRIORITY
+                                      : 0);
+  }
   if (schedule_alg == 0) {
-    schedule_processes_fcfs(pcb, resource, mail);
+    schedule_processes_fcfs(sim);
   } else if (schedule_alg == 1) {
-    schedule_processes_rr(pcb, firstPCB, resource, mail, quantum, num, 0);
+    schedule_processes_rr(sim, quantum);
+  } else if (schedule_alg == PROCSCHED_PRIORITY ||
+             schedule_alg == PROCSCHED_EDF || schedule_alg == PROCSCHED_RM) {
+    schedule_processes_priority(sim, quantum);
   }
 }
 
@@ -78,324 +123,1005 @@ void schedule_processes(struct processControlBlock *pcb,
  * The number of instruction to execute for each process is governed by the
  * QUANTUM variable.
  *
- * @param pcb The process control block which contains the current process as
- * well as a pointer to the next process control block
- * @param resource The list of resources available to the system
- * @param mail     The list of mailboxes available to the system
+ * @param sim The simulator holding the processes.
  * @param quantum  Number of instructions the process should be allowed to
  * run before it is preemptied
- * @param tally    The number of times the current process has been running
  */
 
-void schedule_processes_rr(struct processControlBlock *pcb,
-                           struct processControlBlock *firstPCB,
-                           struct resourceList *resource, struct mailbox *mail,
-                           int quantum, int num, int tally) {
+void schedule_processes_rr(struct simulator *sim, int quantum) {
+  quantum = quantum <= 0 ? QUANTUM : quantum;
 
-  quantum = quantum == 0 ? QUANTUM : quantum;
+  run_scheduler(sim, quantum);
+}
 
-  while (pcb->cpuSchedulePtr->readyQueue->head != NULL) {
-    struct processControlBlock *p =
-        dequeue(pcb->cpuSchedulePtr->readyQueue)->item;
+/**
+ * @brief Schedules the processes first come first serve.
+ *
+ * Each process in the readyQueue runs until it terminates or has to wait for
+ * a resource.
+ *
+ * @param sim The simulator holding the processes.
+ */
+void schedule_processes_fcfs(struct simulator *sim) {
+  run_scheduler(sim, INT_MAX);
+}
 
-    tally = 0;
-    while (tally < quantum) {
-      if (p->nextInstruction == NULL) {
-        break;
-      }
+/**
+ * @brief Schedules the most urgent ready process first.
+ *
+ * The ready processes are taken from the ready heap of the process table,
+ * which schedule_processes has built. A process runs until it waits,
+ * terminates, has run quantum ops or makes a more urgent process ready,
+ * and processes of equal priority take turns in the order they became
+ * ready. The order of the heap decides what is more urgent: the priority,
+ * the deadline of the current job or the period, see table_prioritize.
+ *
+ * @param sim The simulator holding the processes.
+ * @param quantum The number of ops a process may run in one time slice, 0
+ * or less for no limit.
+ */
+void schedule_processes_priority(struct simulator *sim, int quantum) {
+  run_scheduler(sim, quantum > 0 ? quantum : INT_MAX);
+}
 
-      switch (p->nextInstruction->type) {
-      case REQ_V:
-        process_request(p, p->nextInstruction, resource);
-        ++tally;
-        break;
-      case REL_V:
-        process_release(p, p->nextInstruction, resource);
-        ++tally;
-        break;
-      case SEND_V:
-        process_send_message(p, p->nextInstruction, mail);
-        ++tally;
-        break;
-      case RECV_V:
-        process_receive_message(p, p->nextInstruction, mail);
-        ++tally;
-        break;
-      default:
-        break;
-      }
+/**
+ * @brief Runs the processes in the readyQueue until every process has
+ * terminated.
+ *
+ * Each process taken from the readyQueue executes at most quantum ops, and a
+ * process that is still running afterwards joins the end of the readyQueue.
+ * Processes waiting for a resource are woken by the release of that resource,
+ * and processes waiting on a full or empty mailbox by a receive or send. When
+ * only waiting processes are left the system is deadlocked and
+ * recover_from_deadlock terminates processes until one of them can continue,
+ * unless a periodic process sleeps until the release of its next job, which may
+ * free them. Events are recorded after every time slice and checkpoints and
+ * snapshots only taken between time slices, when every process is in a queue.
+ *
+ * @param sim The simulator holding the processes.
+ * @param quantum The number of ops a process may run in one time slice.
+ */
+void run_scheduler(struct simulator *sim, int quantum) {
+  while (schedule_slice(sim, quantum)) {
+  }
+}
+
+/**
+ * @brief Runs the process at the head of the readyQueue for one time slice.
+ *
+ * See run_scheduler, which calls it until the readyQueue is empty. The
+ * daemon (daemon.h) calls it directly so it can admit new processes between
+ * time slices. A prioritized process table runs the most urgent ready
+ * process instead of the head of the readyQueue. The jobs of periodic
+ * processes that are due are released first, after idling until the next
+ * release if no process is ready, see realtime.h.
+ *
+ * @param sim The simulator holding the processes.
+ * @param quantum The number of ops the process may run.
+ *
+ * @return 1 (TRUE) if a process ran, 0 (FALSE) if the readyQueue was empty.
+ */
+int schedule_slice(struct simulator *sim, int quantum) {
+  struct processTable *t = &sim->table;
+  int executed;
+  int p;
+
+  if (t->timerCount > 0) {
+    realtime_idle(sim);
+    realtime_release(sim, realtime_now(sim));
+  }
+  if (t->prioritized) {
+    if ((p = table_ready_pop(t)) == -1) {
+      return FALSE;
     }
+    queue_remove(t, &t->readyQueue, p);
+  } else if ((p = dequeue(t, &t->readyQueue)) == -1) {
+    return FALSE;
+  }
+  executed = run_process(sim, p, quantum);
 
-    send_processes_to_readyq(pcb->cpuSchedulePtr->waitingQueue, resource);
+  if (t->state[p] == RUNNING) {
+    process_to_readyq(t, p);
+  }
+  if (sim->recording != NULL) {
+    recording_slice(sim, p, executed);
+  }
 
-    if (p->processState == RUNNING && p->nextInstruction != NULL) {
-      process_to_readyq(p->cpuSchedulePtr, p);
-    }
+  if (t->readyQueue.head == -1 && t->waiting > 0 && t->timerCount == 0) {
+    recover_from_deadlock(sim);
+  }
 
-    if (processes_deadlocked(firstPCB)) {
-#ifdef DEBUG
-      printf("DEADLOCKED\n");
+  if (sim->recording != NULL) {
+    recording_poll(sim);
+  }
+  if (sim->checkpointFile != NULL) {
+    checkpoint_poll(sim);
+  }
+  if (sim->monitor != NULL) {
+    monitor_poll(sim);
+  }
+  return TRUE;
+}
+
+#ifdef __GNUC__
+/* Direct threading: every op stores the address of the code executing it. */
+#define DISPATCH() goto *pc->code
+#else
+#define DISPATCH()                                                             \
+  switch (pc->type) {                                                          \
+  case REQ_V:                                                                  \
+  case REQS_V:                                                                 \
+    goto op_req;                                                               \
+  case REQSET_V:                                                               \
+    goto op_reqset;                                                            \
+  case REL_V:                                                                  \
+    goto op_rel;                                                               \
+  case SEND_V:                                                                 \
+    goto op_send;                                                              \
+  case RECV_V:                                                                 \
+  case DRAIN_V:                                                                \
+    goto op_recv;                                                              \
+  case SUBSCRIBE_V:                                                            \
+  case UNSUBSCRIBE_V:                                                          \
+    goto op_subscribe;                                                         \
+  case SYNC_V:                                                                 \
+    goto op_sync;                                                              \
+  case REPEAT_V:                                                               \
+  case LOOP_V:                                                                 \
+  case PAGE_V:                                                                 \
+    goto op_loop;                                                              \
+  default:                                                                     \
+    goto op_end;                                                               \
+  }
 #endif
 
-      struct processControlBlock *firstPCB_copy = firstPCB;
-      while (processes_deadlocked(firstPCB)) {
-#ifdef DEBUG
-        printf("RECOVERING FROM DEADLOCK\n");
+/**
+ * @brief Executes a REPEAT_V or LOOP_V op.
+ *
+ * REPEAT_V pushes the iteration count of the loop onto the loop stack of
+ * the process. LOOP_V counts an iteration down and jumps back to the start
+ * of the body, or pops the loop after its last iteration.
+ *
+ * @param loop The loop stack of the process.
+ * @param pc The op.
+ *
+ * @return The next op.
+ */
+static inline struct op *loop_step(struct loopStack *loop, struct op *pc) {
+  if (pc->type == REPEAT_V) {
+    loop->counters[loop->depth++] = pc->operand;
+    return pc + 1;
+  }
+  if (--loop->counters[loop->depth - 1] > 0) {
+    return pc - pc->operand;
+  }
+  --loop->depth;
+  return pc + 1;
+}
+
+/**
+ * @brief Executes a REPEAT_V, LOOP_V or PAGE_V op of the running process.
+ *
+ * Ops of a paged program that may leave their frame go through the pager.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The running process.
+ * @param pc The op.
+ *
+ * @return The next op.
+ */
+static inline struct op *control_step(struct simulator *sim, int p,
+                                      struct op *pc) {
+  if (pc->type == REPEAT_V || sim->pager == NULL) {
+    return loop_step(&sim->table.loops[p], pc);
+  }
+  return pager_step(sim, p, pc);
+}
+
+/**
+ * @brief Returns the number of ops a process may execute before its time
+ * slice ends or the next job of a periodic process is released.
+ *
+ * Only a prioritized table lets a released job preempt the running
+ * process; any other releases its jobs between time slices.
+ *
+ * @param sim The simulator holding the running process.
+ * @param budget The number of ops left in the time slice, counted from its
+ * start.
+ *
+ * @return The number of ops from the start of the time slice.
+ */
+static inline int release_limit(struct simulator *sim, int budget) {
+  struct processTable *t = &sim->table;
+  long long release;
+
+  if (!t->prioritized || t->timerCount == 0) {
+    return budget;
+  }
+  release = t->release[t->timers[0]] - realtime_now(sim);
+  return release < budget ? (int)release : budget;
+}
+
+/* Moves on to the next op unless the time slice is used up or a job is
+ * released. */
+#define NEXT()                                                                 \
+  do {                                                                         \
+    ++pc;                                                                      \
+    if (++executed == limit) {                                                 \
+      goto budget_spent;                                                       \
+    }                                                                          \
+    DISPATCH();                                                                \
+  } while (0)
+
+/* Ends the time slice after an op that made a more urgent process ready, or
+ * made the running process less urgent than a ready one. */
+#define PREEMPT()                                                              \
+  do {                                                                         \
+    if (t->prioritized && t->heapCount > 0 &&                                  \
+        table_more_urgent(t, t->heap[0], p)) {                                 \
+      ++pc;                                                                    \
+      ++executed;                                                              \
+      goto budget_spent;                                                       \
+    }                                                                          \
+  } while (0)
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/**
+ * @brief Executes the ops of process p.
+ *
+ * The process runs until it has executed budget ops, has to wait for a
+ * resource, a mailbox or a barrier or reaches its END_V op and terminates. A
+ * process whose last op ran at the end of the time slice terminates in the same
+ * slice. In a prioritized process table it is also preempted by the ops that
+ * make a more urgent process ready, and when the job of a periodic process is
+ * released it only continues if the job is not more urgent. A periodic process
+ * that reaches its END_V op completes its job instead of terminating and goes
+ * back to the start of its program, see realtime_complete. The REPEAT_V and
+ * LOOP_V ops that run loops do not count as executed, so a loop is scheduled
+ * exactly like its unrolled instructions, and neither do the PAGE_V ops that
+ * move on to the next block of a paged program. While the process runs its next
+ * op in the process table is NULL, so the pager does not take it for the op of
+ * a process that is not running. Calling the function with a NULL simulator
+ * only publishes the code address of every op type for compile_processes.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The number of the process to run.
+ * @param budget The maximum number of ops to execute.
+ *
+ * @return The number of ops executed.
+ */
+int run_process(struct simulator *sim, int p, int budget) {
+#ifdef __GNUC__
+  static const void *const handlers[] = {
+      &&op_req,  &&op_rel,  &&op_send,   &&op_recv, &&op_end,
+      &&op_loop, &&op_loop, &&op_end,    &&op_loop, &&op_req,
+      &&op_reqset, &&op_recv, &&op_subscribe, &&op_subscribe, &&op_sync};
+#endif
+  struct processTable *t;
+  struct processStats *stats;
+  struct op *pc;
+  int executed = 0;
+  int limit;
+
+  if (sim == NULL) {
+#ifdef __GNUC__
+    __atomic_store_n(&opHandlers, handlers, __ATOMIC_RELEASE);
 #endif
-        release_all_resources_from_process(firstPCB_copy);
-        process_to_terminateq(firstPCB_copy->cpuSchedulePtr, firstPCB_copy);
-        send_processes_to_readyq(firstPCB->cpuSchedulePtr->waitingQueue,
-                                 resource);
-        firstPCB_copy = firstPCB_copy->next;
+    return 0;
+  }
+
+  t = &sim->table;
+  pc = t->nextOp[p] != NULL ? t->nextOp[p] : pager_next_op(sim, p);
+  t->nextOp[p] = NULL;
+  t->state[p] = RUNNING;
+  limit = release_limit(sim, budget);
+  DISPATCH();
+
+op_req:
+  if (!process_request(sim, p, pc)) {
+    goto stop;
+  }
+  NEXT();
+
+op_reqset:
+  if (!process_request_set(sim, p, pc)) {
+    goto stop;
+  }
+  NEXT();
+
+op_rel:
+  process_release(sim, p, pc);
+  PREEMPT();
+  NEXT();
+
+op_send:
+  if (!process_send_message(sim, p, pc)) {
+    goto stop;
+  }
+  PREEMPT();
+  NEXT();
+
+op_recv:
+  if (!process_receive_message(sim, p, pc)) {
+    goto stop;
+  }
+  PREEMPT();
+  NEXT();
+
+op_subscribe:
+  process_subscribe(sim, p, pc);
+  PREEMPT();
+  NEXT();
+
+op_sync:
+  if (!process_sync(sim, p, pc)) {
+    goto stop;
+  }
+  PREEMPT();
+  NEXT();
+
+op_loop:
+  /* Loop control is not an instruction and takes no time */
+  pc = control_step(sim, p, pc);
+  DISPATCH();
+
+budget_spent:
+  while (pc->type == REPEAT_V || pc->type == LOOP_V || pc->type == PAGE_V) {
+    pc = control_step(sim, p, pc);
+  }
+  if (pc->type != END_V) {
+    /* Stopped early for a release, or preempted */
+    if (executed < budget && t->timerCount > 0) {
+      realtime_release(sim, realtime_now(sim) + executed);
+      if (t->heapCount == 0 || !table_more_urgent(t, t->heap[0], p)) {
+        limit = release_limit(sim, budget);
+        DISPATCH();
       }
     }
+    goto stop;
+  }
+
+op_end:
+  if (sim->topicCount > 0) {
+    leave_topics(sim, p);
+  }
+  if (t->timed && t->pcb[p]->pagePtr->period > 0 &&
+      realtime_complete(sim, p, realtime_now(sim) + executed)) {
+    pc = sim->pager == NULL ? t->pcb[p]->pagePtr->program : NULL;
+    goto stop;
   }
+  process_to_terminateq(t, p);
+
+stop:
+  t->nextOp[p] = pc;
+  sim->instructionsExecuted += executed;
+
+  stats = &t->pcb[p]->stats;
+  stats->executed += executed;
+  ++stats->slices;
+
+  return executed;
 }
 
-void schedule_processes_fcfs(struct processControlBlock *pcb,
-                             struct resourceList *resource,
-                             struct mailbox *mail) {
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
 
-  while (pcb->nextInstruction != NULL) {
-    switch (pcb->nextInstruction->type) {
-	  case REQ_V:
-		process_request(pcb, pcb->nextInstruction, resource);
-		break;
-	  case REL_V:
-		process_release(pcb, pcb->nextInstruction, resource);
-		break;
-	  case SEND_V:
-		process_send_message(pcb, pcb->nextInstruction, mail);
-		break;
-	  case RECV_V:
-		process_receive_message(pcb, pcb->nextInstruction, mail);
-		break;
-	  default:
-		break;
-	}
-  }
+/**
+ * @brief Returns the code address of every op type.
+ *
+ * @return The addresses indexed by op type, or NULL when the compiler does
+ * not support direct threading and ops are dispatched with a switch.
+ */
+const void *const *get_op_handlers() {
+#ifdef __GNUC__
+  const void *const *handlers = __atomic_load_n(&opHandlers, __ATOMIC_ACQUIRE);
 
-  if (pcb->cpuSchedulePtr->readyQueue->head != NULL) {
-    struct processControlBlock *h =
-        dequeue(pcb->cpuSchedulePtr->readyQueue)->item;
-    schedule_processes_fcfs(h, resource, mail);
+  if (handlers == NULL) {
+    run_process(NULL, 0, 0);
+    handlers = __atomic_load_n(&opHandlers, __ATOMIC_ACQUIRE);
   }
-  return;
+  return handlers;
+#else
+  return NULL;
+#endif
 }
 
 /**
  * @brief Handles the request resource instruction.
  *
- * Executes the request instruction for the process. The function loops
- * through the list of resources and acquires the resource if it is available.
- * If the resource is not available the process sits in the waiting queue and
- * tries to acquire the resource on the next cycle.
+ * Executes the request instruction for the process. An exclusive request
+ * acquires an available instance of the resource the op was resolved to, a
+ * shared request shares the resource with the other shared requests. If the
+ * resource is not available, or the read-write policy makes the request
+ * wait behind requests of the other kind, the process waits in the wait
+ * queue of the resource for requests of its kind until it is woken.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process for which the resource must be acquired.
+ * @param op The op which requests the resource.
  *
- * @param current The current process for which the resource must be acquired.
- * @param instruct The instruction which requests the resource.
- * @param resource The list of resources.
+ * @return 1 (TRUE) if the resource was acquired else 0 (FALSE).
  */
 
-void process_request(struct processControlBlock *current,
-                     struct instruction *instruct,
-                     struct resourceList *resource) {
-  int acquired;
-
-  current->processState = RUNNING;
+int process_request(struct simulator *sim, int p, struct op *op) {
+  struct processTable *t = &sim->table;
+  struct processControlBlock *current = t->pcb[p];
+  struct resourceList *resource =
+      op->operand >= 0 ? sim->resourceTable[op->operand] : NULL;
+  const char *request = op->type == REQS_V ? REQS : REQ;
+
+  if (resource == NULL || request_must_wait(sim, op) ||
+      !(op->type == REQS_V ? acquire_shared(resource, current)
+                           : acquire_resource(resource, current))) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: waiting;\n", current->pagePtr->name,
+              request, op->name);
+    }
+    t->nextOp[p] = op;
+    process_to_waitingq(t, p);
+    if (t->prioritized) {
+      inherit_priority(sim, p);
+    }
+    return FALSE;
+  }
+  update_available_bit(sim, op->operand);
 
-  acquired = acquire_resource(instruct->resource, resource, current);
+  if (sim->trace != NULL) {
+    fprintf(sim->trace, "%s %s %s: acquired; ", current->pagePtr->name,
+            request, op->name);
+    print_available_resources(sim->trace, sim->firstResource);
+  }
+  if (t->prioritized && resource->protocol != 0) {
+    acquire_priority(sim, p, resource);
+  }
+  return TRUE;
+}
 
-  if (!acquired) {
-    printf("%s req %s: waiting;\n", current->pagePtr->name, instruct->resource);
-    process_to_waitingq(current->cpuSchedulePtr, current);
-    return;
+/**
+ * @brief Handles the request instruction of a resource set.
+ *
+ * The process acquires an instance of every resource of the set at once, or
+ * none of them: if the bitset of the set is not covered by the availability
+ * bitset, or the read-write policy makes one of the resources wait, the
+ * process waits in the setQueue without holding any of them. So a set
+ * request never holds one resource while it waits for another.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process for which the resources must be acquired.
+ * @param op The REQSET_V op.
+ *
+ * @return 1 (TRUE) if the resources were acquired else 0 (FALSE).
+ */
+int process_request_set(struct simulator *sim, int p, struct op *op) {
+  struct processTable *t = &sim->table;
+  struct processControlBlock *current = t->pcb[p];
+  const struct resourceSet *set =
+      op->operand >= 0 ? &sim->resourceSets[op->operand] : NULL;
+  int i;
+
+  if (set == NULL || !is_set_available(t, set) ||
+      request_must_wait(sim, op)) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s req %s: waiting;\n", current->pagePtr->name,
+              op->name);
+    }
+    t->waitSet[p] = op->operand;
+    t->nextOp[p] = op;
+    process_to_waitingq(t, p);
+    if (t->prioritized && set != NULL) {
+      inherit_priority(sim, p);
+    }
+    return FALSE;
   }
 
-  printf("%s req %s: acquired; ", current->pagePtr->name, instruct->resource);
-  print_available_resources(resource);
+  for (i = 0; i < set->count; i++) {
+    acquire_resource(sim->resourceTable[set->members[i]], current);
+    update_available_bit(sim, set->members[i]);
+  }
 
-  current->nextInstruction = current->nextInstruction->next;
-  dealloc_instruction(instruct);
+  if (sim->trace != NULL) {
+    fprintf(sim->trace, "%s req %s: acquired; ", current->pagePtr->name,
+            op->name);
+    print_available_resources(sim->trace, sim->firstResource);
+  }
+  for (i = 0; t->prioritized && i < set->count; i++) {
+    if (sim->resourceTable[set->members[i]]->protocol != 0) {
+      acquire_priority(sim, p, sim->resourceTable[set->members[i]]);
+    }
+  }
+  return TRUE;
 }
 
 /**
  * @brief Handles the release resource instruction.
  *
- * Executes the release instruction for the process. If the resource can be
- * released the process is ready for next execution. If the resource can not
- * be released the process sits in the waiting queue.
+ * Executes the release instruction for the process, which makes an instance
+ * of the resource available again, or ends a shared hold of it, and wakes
+ * the processes that can acquire it now. A process raised by the resources
+ * it held drops back to the priority the resources it still holds give it.
+ * Releasing an unknown resource or one the process does not hold is traced
+ * as an error and changes nothing.
  *
- * @param current The process which releases the resource.
- * @param instruct The instruction to release the resource.
- * @param resource The list of resources.
+ * @param sim The simulator holding the process.
+ * @param p The process which releases the resource.
+ * @param op The op to release the resource.
  */
 
-void process_release(struct processControlBlock *current,
-                     struct instruction *instruct,
-                     struct resourceList *resource) {
-
-  current->processState = RUNNING;
+void process_release(struct simulator *sim, int p, struct op *op) {
+  struct processControlBlock *current = sim->table.pcb[p];
+  struct resourceList *resource =
+      op->operand >= 0 ? sim->resourceTable[op->operand] : NULL;
 
-  if (release_resource(instruct->resource, resource, current)) {
-    printf("%s rel %s: released; ", current->pagePtr->name, instruct->resource);
-    print_available_resources(resource);
-
-    if (current->nextInstruction->next == NULL) {
-      process_to_terminateq(current->cpuSchedulePtr, current);
+  if (!release_resource(resource, current)) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s rel %s: ERROR: Nothing to release\n",
+              current->pagePtr->name, op->name);
     }
-  } else {
-    process_to_waitingq(current->cpuSchedulePtr, current);
+    return;
   }
 
-  current->nextInstruction = current->nextInstruction->next;
-  dealloc_instruction(instruct);
+  if (sim->trace != NULL) {
+    fprintf(sim->trace, "%s rel %s: released; ", current->pagePtr->name,
+            op->name);
+    print_available_resources(sim->trace, sim->firstResource);
+  }
+  update_available_bit(sim, op->operand);
+  wake_waiters(sim, op->operand);
+  if (sim->table.prioritized &&
+      sim->table.priority[p] != current->pagePtr->priority) {
+    restore_priority(sim, p, op->name);
+  }
 }
 
 /**
  * @brief Sends the message the prescribed mailbox.
  *
- * Sends the message specified in the instruction of the current process, to
- * the mailbox specified in the instruction. The function gets the pointer to
- * the first mailbox and loops through all the mailboxes to find the one to
- * which the message must be sent.
+ * Appends the message specified in the op of the current process to the
+ * mailbox the op was resolved to and wakes the first process waiting to
+ * receive from it. Only the pointer to the message moves, whatever its
+ * length; a counted mailbox takes a reference so the message outlives the
+ * op. If the mailbox is full the process waits in the sendQueue
+ * of the mailbox until a receiver makes room.
+ *
+ * A message sent to a topic is stored once for all its subscribers and
+ * wakes every waiting receiver. A full topic only makes the sender wait
+ * under TOPIC_BLOCK, the other policies make room, see make_room.
  *
- * @param pcb The current process which instruct us to send a message.
- * @param instruct The current send instruction which contains the message.
- * @param mail The list of available mailboxes.
+ * @param sim The simulator holding the process.
+ * @param p The process which instruct us to send a message.
+ * @param op The current send op which contains the message.
+ *
+ * @return 1 (TRUE) if the message was sent else 0 (FALSE).
  */
-void process_send_message(struct processControlBlock *pcb,
-                          struct instruction *instruct, struct mailbox *mail) {
+int process_send_message(struct simulator *sim, int p, struct op *op) {
+  struct processTable *t = &sim->table;
+  struct mailbox *currentMbox;
+
+  if (op->operand < 0) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s send %s: ERROR: No such mailbox\n",
+              t->pcb[p]->pagePtr->name, op->name);
+    }
+    return TRUE;
+  }
+  currentMbox = sim->mailboxTable[op->operand];
+
+  if (currentMbox->count == currentMbox->capacity &&
+      currentMbox->topic != NULL &&
+      currentMbox->topic->policy != TOPIC_BLOCK) {
+    make_room(sim, currentMbox);
+  }
+  if (currentMbox->count == currentMbox->capacity) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s send %s: waiting;\n", t->pcb[p]->pagePtr->name,
+              op->name);
+    }
+    t->nextOp[p] = op;
+    process_to_waitingq(t, p);
+    return FALSE;
+  }
+
+  if (sim->trace != NULL) {
+    fprintf(sim->trace,
+            "%s send: Message \033[22;31m %s \033[0m addede to %s\n",
+            t->pcb[p]->pagePtr->name, op->msg->text, currentMbox->name);
+  }
 
+  if (currentMbox->topic != NULL) {
+    /* Every waiting receiver is a subscriber that has received everything
+     * else */
+    topic_publish(currentMbox, op->msg);
+    if (t->recvQueues[op->operand].head != -1) {
+      wake_mailbox_waiters(sim, &t->recvQueues[op->operand],
+                           t->recvQueues[op->operand].n);
+    }
+    return TRUE;
+  }
+  mailbox_put(currentMbox, op->msg);
+  if (t->recvQueues[op->operand].head != -1) {
+    wake_mailbox_waiters(sim, &t->recvQueues[op->operand], 1);
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Retrieves the message from the mailbox specified in the op.
+ *
+ * Takes the oldest message out of the mailbox the op was resolved to, or
+ * every message for a drain op, and wakes as many processes waiting to send
+ * to it as messages were taken. A drain removes its messages in one step,
+ * whatever their number, and taken messages are released, not copied.
+ * A subscriber of a topic receives the messages after its cursor, and
+ * senders are only woken when the slowest subscriber frees slots. If the
+ * mailbox is empty the process waits in the recvQueue of the mailbox until
+ * a message is sent.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process which requests a message retrieval.
+ * @param op The op to retrieve a message from a specific mailbox.
+ *
+ * @return 1 (TRUE) if a message was received else 0 (FALSE).
+ */
+int process_receive_message(struct simulator *sim, int p, struct op *op) {
+  struct processTable *t = &sim->table;
   struct mailbox *currentMbox;
+  struct message *msg;
+  int available;
+  int freed;
+  int s = -1;
+  int n;
+  int i;
+
+  if (op->operand < 0) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: ERROR: No such mailbox\n",
+              t->pcb[p]->pagePtr->name, op->type == DRAIN_V ? DRAIN : RECV,
+              op->name);
+    }
+    return TRUE;
+  }
+  currentMbox = sim->mailboxTable[op->operand];
+
+  if (currentMbox->topic != NULL &&
+      (s = topic_subscriber(currentMbox, p)) < 0) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: ERROR: Not subscribed\n",
+              t->pcb[p]->pagePtr->name, op->type == DRAIN_V ? DRAIN : RECV,
+              op->name);
+    }
+    return TRUE;
+  }
+  available = s >= 0 ? topic_unread(currentMbox, s) : currentMbox->count;
 
-  pcb->processState = RUNNING;
+  if (available == 0) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: waiting;\n", t->pcb[p]->pagePtr->name,
+              op->type == DRAIN_V ? DRAIN : RECV, op->name);
+    }
+    t->nextOp[p] = op;
+    process_to_waitingq(t, p);
+    return FALSE;
+  }
 
-  currentMbox = mail;
-  do {
-    if (strcmp(currentMbox->name, instruct->resource) == 0) {
-      /* We found the mailbox in which a message should be left */
-      break;
+  n = op->type == DRAIN_V ? available : 1;
+  if (sim->trace != NULL) {
+    for (i = 0; i < n; i++) {
+      msg = s >= 0 ? topic_message(currentMbox, s, i)
+                   : mailbox_message(currentMbox, i);
+      fprintf(sim->trace,
+              "%s %s: Message \033[22;32m %s "
+              "\033[0m removed from %s\n",
+              t->pcb[p]->pagePtr->name, op->type == DRAIN_V ? DRAIN : RECV,
+              msg->text, currentMbox->name);
     }
-    currentMbox = currentMbox->next;
-  } while (currentMbox != NULL);
+  }
+
+  if (s >= 0) {
+    freed = topic_receive(currentMbox, s, n);
+  } else {
+    mailbox_drop(currentMbox, n);
+    freed = n;
+  }
+  if (freed > 0 && t->sendQueues[op->operand].head != -1) {
+    wake_mailbox_waiters(sim, &t->sendQueues[op->operand], freed);
+  }
+  return TRUE;
+}
 
-  printf("%s send: Message \033[22;31m %s \033[0m addede to %s\n",
-         pcb->pagePtr->name, instruct->msg, currentMbox->name);
+/**
+ * @brief Handles the subscribe and unsubscribe instructions.
+ *
+ * A subscriber receives every message sent to the topic after it
+ * subscribed. Unsubscribing gives up the messages the process has not
+ * received, which wakes senders waiting for it to fall behind less.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process which subscribes or unsubscribes.
+ * @param op The SUBSCRIBE_V or UNSUBSCRIBE_V op.
+ */
+void process_subscribe(struct simulator *sim, int p, struct op *op) {
+  struct processTable *t = &sim->table;
+  struct mailbox *topic =
+      op->operand >= 0 ? sim->mailboxTable[op->operand] : NULL;
+  const char *request = op->type == SUBSCRIBE_V ? SUBSCRIBE : UNSUBSCRIBE;
+  const char *error = NULL;
+  int freed;
+  int s;
+
+  if (topic == NULL) {
+    error = "No such mailbox";
+  } else if (topic->topic == NULL) {
+    error = "Not a topic";
+  } else if (op->type == SUBSCRIBE_V) {
+    if (topic_subscribe(topic, p) < 0) {
+      error = "Already subscribed";
+    }
+  } else if ((s = topic_subscriber(topic, p)) < 0) {
+    error = "Not subscribed";
+  } else {
+    freed = topic_unsubscribe(topic, s);
+    if (freed > 0 && t->sendQueues[op->operand].head != -1) {
+      wake_mailbox_waiters(sim, &t->sendQueues[op->operand], freed);
+    }
+  }
 
-  currentMbox->msg = instruct->msg;
-  pcb->nextInstruction = pcb->nextInstruction->next;
-  dealloc_instruction(instruct);
+  if (sim->trace != NULL) {
+    if (error != NULL) {
+      fprintf(sim->trace, "%s %s %s: ERROR: %s\n", t->pcb[p]->pagePtr->name,
+              request, op->name, error);
+    } else {
+      fprintf(sim->trace, "%s %s %s: %sd;\n", t->pcb[p]->pagePtr->name,
+              request, op->name, request);
+    }
+  }
 }
 
 /**
- * @brief Retrieves the message from the mailbox specified in the instruction
- * and stores it in the instruction message field.
+ * @brief Frees the oldest slot of a full topic whose policy does not make
+ * the sender wait.
  *
- * The function loops through the available mailboxes and finds the mailbox
- * from which the message must be retrieved. The retrieved message is stored
- * in the message field of the instruction of the process.
+ * The subscribers that have not received the oldest message are the
+ * slowest. Under TOPIC_DROP_OLDEST they lose that message, under
+ * TOPIC_DISCONNECT they are unsubscribed and lose all their messages.
  *
- * @param pcb The current process which requests a message retrieval.
- * @param instruct The instruction to retrieve a message from a specific
- * mailbox.
- * @param mail The list of mailboxes.
+ * @param sim The simulator holding the topic.
+ * @param mail A full topic.
+ */
+void make_room(struct simulator *sim, struct mailbox *mail) {
+  struct topic *topic = mail->topic;
+  long long oldest = topic->published - mail->count;
+  const char *name;
+  int s;
+
+  for (s = 0; s < topic->count; s++) {
+    if (topic->subscribers[s].cursor != oldest) {
+      continue;
+    }
+    name = sim->table.pcb[topic->subscribers[s].process]->pagePtr->name;
+    if (topic->policy == TOPIC_DROP_OLDEST) {
+      if (sim->trace != NULL) {
+        fprintf(sim->trace,
+                "%s %s: Message \033[22;33m %s \033[0m dropped from %s\n",
+                name, RECV, topic_message(mail, s, 0)->text, mail->name);
+      }
+      topic_receive(mail, s, 1);
+    } else {
+      if (sim->trace != NULL) {
+        fprintf(sim->trace, "%s %s %s: disconnected;\n", name, SUBSCRIBE,
+                mail->name);
+      }
+      /* The last subscriber moves to s */
+      topic_unsubscribe(mail, s--);
+    }
+  }
+}
+
+/**
+ * @brief Unsubscribes a terminating process from every topic, so that it
+ * does not hold back their senders.
+ *
+ * @param sim The simulator holding the topics.
+ * @param p The terminating process.
  */
-void process_receive_message(struct processControlBlock *pcb,
-                             struct instruction *instruct,
-                             struct mailbox *mail) {
+void leave_topics(struct simulator *sim, int p) {
+  struct processTable *t = &sim->table;
+  struct mailbox *mail;
+  int freed;
+  int s;
+  int i;
+
+  for (i = 0; i < sim->mailboxCount; i++) {
+    mail = sim->mailboxTable[i];
+    if (mail->topic == NULL || (s = topic_subscriber(mail, p)) < 0) {
+      continue;
+    }
+    freed = topic_unsubscribe(mail, s);
+    if (freed > 0 && t->sendQueues[i].head != -1) {
+      wake_mailbox_waiters(sim, &t->sendQueues[i], freed);
+    }
+  }
+}
 
-  struct mailbox *currentMbox;
+/**
+ * @brief Handles the sync instruction.
+ *
+ * The processes arriving at a barrier wait in its queue until the last of
+ * its parties arrives, which moves all of them to the readyQueue in the
+ * order they arrived and starts the next phase of the barrier. A released
+ * process runs its sync op again when it is scheduled and passes it without
+ * arriving a second time, so the barrier can be reused at once, however
+ * often, without allocating anything per phase.
+ *
+ * @param sim The simulator holding the process and the barriers.
+ * @param p The process which arrives at the barrier.
+ * @param op The SYNC_V op.
+ *
+ * @return 1 (TRUE) if the process passes the barrier else 0 (FALSE).
+ */
+int process_sync(struct simulator *sim, int p, struct op *op) {
+  struct processTable *t = &sim->table;
+  const char *name = t->pcb[p]->pagePtr->name;
+  struct queue *q;
+  int waiter;
+  int n;
+
+  if (op->operand < 0) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: ERROR: Invalid barrier\n", name, SYNC,
+              op->name);
+    }
+    return TRUE;
+  }
+  if (t->released[p]) {
+    t->released[p] = 0;
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: passed;\n", name, SYNC, op->name);
+    }
+    return TRUE;
+  }
+
+  q = &t->syncQueues[op->operand];
+  if (q->n + 1 < sim->barriers[op->operand].parties) {
+    if (sim->trace != NULL) {
+      fprintf(sim->trace, "%s %s %s: waiting;\n", name, SYNC, op->name);
+    }
+    t->nextOp[p] = op;
+    process_to_waitingq(t, p);
+    return FALSE;
+  }
 
-  pcb->processState = RUNNING;
+  n = q->n;
+  while ((waiter = dequeue(t, q)) != -1) {
+    --t->waiting;
+    t->released[waiter] = 1;
+    process_to_readyq(t, waiter);
+  }
+  ++t->generations[op->operand];
+  if (sim->trace != NULL) {
+    fprintf(sim->trace, "%s %s %s: released %d; generation %lld\n", name,
+            SYNC, op->name, n, t->generations[op->operand]);
+  }
+  return TRUE;
+}
 
-  currentMbox = mail;
-  do {
-    if (strcmp(currentMbox->name, instruct->resource) == 0) {
-      /* We found the mailbox from which a message must be read. */
+/**
+ * @brief Finds the mailbox with the given name.
+ *
+ * Loops through the list of mailboxes and returns the one whose name matches
+ * mailboxName.
+ *
+ * @param mailboxName The name of the mailbox to find.
+ * @param mail The list of mailboxes.
+ *
+ * @return The matching mailbox or NULL if there is no such mailbox.
+ */
+struct mailbox *find_mailbox(char *mailboxName, struct mailbox *mail) {
+  struct mailbox *currentMbox = mail;
+
+  while (currentMbox != NULL) {
+    if (strcmp(currentMbox->name, mailboxName) == 0) {
       break;
     }
     currentMbox = currentMbox->next;
-  } while (currentMbox != NULL);
-
-  printf("%s recv: Message \033[22;32m %s "
-         "\033[0m removed from %s\n",
-         pcb->pagePtr->name, currentMbox->msg, currentMbox->name);
+  }
 
-  instruct->msg = currentMbox->msg;
-  currentMbox->msg = NULL;
-  pcb->nextInstruction = pcb->nextInstruction->next;
-  dealloc_instruction(instruct);
+  return currentMbox;
 }
 
 /**
- * @brief Acquires the resource specified by resourceName.
+ * @brief Acquires an instance of a resource.
  *
- * The function iterates over the list of resources trying to acquire the
- * resource specified by resourceName. If the resources is available, the
- * process acquires the resource. The resource is indicated as not available
- * in the resourceList and 1 is returned indicating that the resource has been
- * acquired successfully.
+ * If an instance of the resource is available, the process acquires it: the
+ * available count of the resource is decremented and the process is added
+ * to its holders. Both take constant time, whatever the number of
+ * instances.
  *
- * @param resourceName The name of the resource to acquire.
- * @param resources The list of resources.
+ * @param resource The resource to acquire, NULL for an unknown resource.
  * @param p The process which acquires the resource.
  *
- * @return 1 for TRUE if the resource is available. 0 for FALSE if the
+ * @return 1 for TRUE if an instance was available. 0 for FALSE if the
  * resource is not available.
  */
 
-int acquire_resource(char *resourceName, struct resourceList *resource,
+int acquire_resource(struct resourceList *resource,
                      struct processControlBlock *p) {
-
-  if (resource == NULL) {
+  if (!is_resource_available(resource)) {
     return FALSE;
   }
 
-  if (strcmp(resource->name, resourceName) == 0) {
-    if (resource->available == 1) {
 #ifdef DEBUG
-      printf("%s acquiring resource %s\n", p->pagePtr->name, resource->name);
+  printf("%s acquiring resource %s\n", p->pagePtr->name, resource->name);
 #endif
-      add_resource_to_process(p, resource);
+  --resource->available;
+  add_resource_to_process(p, resource);
+  return TRUE;
+}
 
-      return TRUE;
-    } else {
-      // search for another instance of this resource
-      return acquire_resource(resourceName, resource->next, p);
-    }
-  } else {
-    return acquire_resource(resourceName, resource->next, p);
+/**
+ * @brief Acquires a resource shared with other shared requests.
+ *
+ * A resource is shared while no instance of it is held exclusively. The
+ * process is added to its readers and holders, which takes constant time.
+ *
+ * @param resource The resource to acquire, NULL for an unknown resource.
+ * @param p The process which acquires the resource.
+ *
+ * @return 1 (TRUE) if the resource was acquired, 0 (FALSE) if an instance
+ * is held exclusively.
+ */
+int acquire_shared(struct resourceList *resource,
+                   struct processControlBlock *p) {
+  if (!is_resource_shareable(resource)) {
+    return FALSE;
   }
+
+  ++resource->readers;
+  if (resource->wokenReaders > 0) {
+    --resource->wokenReaders;
+  }
+  add_resource_to_process(p, resource)->readers = 1;
+  return TRUE;
 }
 
 /**
- * @brief Releases the resource specified by resourceName
+ * @brief Releases an instance of a resource.
  *
- * Iterates over the resourceList finding the resource which must be set to
- * available again. The resource is then released from the process.
+ * Ends the newest hold of the resource by the process: a shared hold
+ * leaves the readers, an exclusive one makes its instance available again.
+ * A process that holds no instance releases nothing, so the available
+ * instances and the holders of a resource always add up to its capacity.
  *
- * @param resourceName The name of the resource to release.
- * @param resources The list of available resources.
+ * @param resource The resource to release, NULL for an unknown resource.
  * @param p The current process.
  *
- * @return 1 (TRUE) if the resource was released succesfully else 1 (FALSE).
+ * @return 1 (TRUE) if the resource was released succesfully, 0 (FALSE) if
+ * it is unknown or the process holds none of it.
  */
 
-int release_resource(char *resourceName, struct resourceList *resource,
+int release_resource(struct resourceList *resource,
                      struct processControlBlock *p) {
+  struct resourceList *held;
+
   if (resource == NULL) {
-    printf("%s rel %s: ERROR: Nothing to release\n", p->pagePtr->name,
-           resourceName);
     return FALSE;
   }
 
-  if (strcmp(resource->name, resourceName) == 0) {
-    resource->available = 1;
-    release_resource_from_process(p, resource);
-    return TRUE;
+  held = release_resource_from_process(p, resource);
+  if (held == NULL) {
+    return FALSE;
+  }
+  if (held->readers > 0) {
+    --resource->readers;
   } else {
-    return release_resource(resourceName, resource->next, p);
+    ++resource->available;
   }
+  unlink_holder(p, held);
+  return TRUE;
 }
 
 /**
@@ -407,203 +1133,552 @@ int release_resource(char *resourceName, struct resourceList *resource,
  *
  * @param current The process to which the resource must be added.
  * @param resource The resource to add to the process.
+ *
+ * @return The acquired instance.
  */
 
-void add_resource_to_process(struct processControlBlock *current,
-                             struct resourceList *resource) {
-  struct resourceList *proc_rsrc = current->resourceListPtr;
-  struct resourceList *r = malloc(sizeof(struct resourceList));
-
-  if (current->resourceListPtr == NULL) {
-    r->available = resource->available = 0;
-    r->name = resource->name;
-    r->next = resource->next;
-    current->resourceListPtr = r;
-    return;
-  }
-
-  while (proc_rsrc != NULL) {
-    proc_rsrc = proc_rsrc->next;
-  }
-
-  resource->available = r->available = 0;
-  r->name = resource->name;
-  r->next = resource->next;
-  proc_rsrc = r;
+struct resourceList *
+add_resource_to_process(struct processControlBlock *current,
+                        struct resourceList *resource) {
+  /* The node of the instance is both in the holders of the resource and in
+   * the list of the process, so either side unlinks it without a search. */
+  return link_holder(current, resource);
 }
 
 /**
  * @brief Release the specified resource from the process acquired list.
  *
- * The function releases the specified resource from the current process
- * acquired list.
+ * The function finds the most recently acquired instance of the specified
+ * resource in the current process acquired list. The holder index of the
+ * resource leads to it in constant time, in whatever order the process
+ * releases its resources. The caller removes it from the list of the
+ * process and the holders of the resource with unlink_holder.
  *
  * @param current The current process from which the resource must be
  * released.
  * @param resource The resource to release.
+ *
+ * @return The instance, or NULL if the process holds none.
  */
 
-void release_resource_from_process(struct processControlBlock *current,
-                                   struct resourceList *resource) {
-  struct resourceList *cur = current->resourceListPtr;
-  struct resourceList *prev = NULL;
+struct resourceList *
+release_resource_from_process(struct processControlBlock *current,
+                              struct resourceList *resource) {
+  struct resourceList *newest = current->resourceListPtr;
 
-  while (cur != NULL) {
-    if (strcmp(cur->name, resource->name) == 0) {
-      if (prev == NULL) {
-        cur = cur->next;
-        return;
-      }
-      prev->next = cur->next;
-      return;
-    }
-    prev = cur;
-    cur = cur->next;
+  /* A release in reverse order of acquiring needs no lookup */
+  if (newest != NULL && newest->resource == resource) {
+    return newest;
   }
-
-  return;
+  return find_holder(resource, current->pagePtr->number);
 }
 
 /**
- * @brief Add process (with id proc) to readyQueue
+ * @brief Add process p to the readyQueue
  *
- * If readyQueue is a bitvector then set the bit in the readyQueue for the
- * process with id proc.
+ * In a prioritized process table the process joins the ready heap as well.
  *
- * @param schedule The struct which stores the queues.
- * @param proc The process which must be set to ready.
+ * @param t The process table which stores the queues.
+ * @param p The process which must be set to ready.
  */
 
-void process_to_readyq(struct cpuSchedule *schedule,
-                       struct processControlBlock *proc) {
-  struct queue *readyq;
+void process_to_readyq(struct processTable *t, int p) {
+  t->state[p] = READY;
 
-  proc->processState = READY;
+#ifdef DEGUB
+  printf("Added Process %s to the readyQueue\n", t->pcb[p]->pagePtr->name);
+#endif
 
-  readyq = schedule->readyQueue;
+  enqueue(t, &t->readyQueue, p);
+  if (t->prioritized) {
+    t->blockedOn[p] = -1;
+    table_ready_push(t, p);
+  }
+
+  return;
+}
+
+/**
+ * @brief Add process p to the wait queue of the resource its next op
+ * requests
+ *
+ * @param t The process table which stores the queues.
+ * @param p The process which must be set to waiting.
+ */
+
+void process_to_waitingq(struct processTable *t, int p) {
+  t->state[p] = WAITING;
+  ++t->pcb[p]->stats.waits;
 
 #ifdef DEGUB
-  printf("Added Process %s to the readyQueue\n", proc->pagePtr->name);
+  printf("Added Process %s to the waitingQueue\n", t->pcb[p]->pagePtr->name);
+#endif
+
+  enqueue(t, wait_queue_of(t, t->nextOp[p]), p);
+  ++t->waiting;
+  if (t->prioritized && t->nextOp[p]->operand >= 0) {
+    if (t->nextOp[p]->type == REQ_V || t->nextOp[p]->type == REQS_V) {
+      t->blockedOn[p] = t->nextOp[p]->operand;
+    } else if (t->nextOp[p]->type == REQSET_V) {
+      t->blockedOn[p] = TABLE_BLOCKED_ON_SET;
+    }
+  }
+
+  return;
+}
+
+/**
+ * @brief Add process p to the terminatedQueue
+ *
+ * @param t The process table which stores the queues.
+ * @param p The process which must be set to terminated.
+ */
+
+void process_to_terminateq(struct processTable *t, int p) {
+  t->state[p] = TERMINATED;
+  if (t->prioritized) {
+    t->blockedOn[p] = -1;
+  }
+
+#ifdef DEBUG
+  printf("Added Process %s to the terminatedQueue\n",
+         t->pcb[p]->pagePtr->name);
 #endif
 
-  enqueue(readyq, proc);
+  enqueue(t, &t->terminatedQueue, p);
 
   return;
 }
 
 /**
- * @brief Add process (with id proc) to the waitingQueue
+ * @brief Returns the wait queue for the resource requested by op.
+ *
+ * Shared requests wait in the readQueue of the resource and requests of
+ * resource sets in the setQueue. Sends wait in the sendQueue and receives in
+ * the recvQueue of their mailbox, syncs in the syncQueue of their barrier.
+ * Requests for an unknown resource wait in an extra queue after the queues of
+ * the resources, where they are only found by deadlock recovery.
  *
- * If waitingQueue is a bitvector then set the bit in the waitingQueue for the
- * process with id proc.
+ * @param t The process table which stores the queues.
+ * @param op A request, send, receive or sync op.
  *
- * @param schedule The struct which stores the queues.
- * @param proc The process which must be set to waiting.
+ * @return The wait queue.
  */
+struct queue *wait_queue_of(struct processTable *t, struct op *op) {
+  if (op->operand < 0) {
+    return &t->waitQueues[t->waitQueueCount];
+  }
+  switch (op->type) {
+  case REQSET_V:
+    return t->setQueue;
+  case SEND_V:
+    return &t->sendQueues[op->operand];
+  case RECV_V:
+  case DRAIN_V:
+    return &t->recvQueues[op->operand];
+  case SYNC_V:
+    return &t->syncQueues[op->operand];
+  }
+  return op->type == REQS_V ? &t->readQueues[op->operand]
+                            : &t->waitQueues[op->operand];
+}
 
-void process_to_waitingq(struct cpuSchedule *schedule,
-                         struct processControlBlock *proc) {
-  struct queue *waitingQueue;
+/**
+ * @brief Moves the processes that can acquire a released resource to the
+ * readyQueue.
+ *
+ * Nothing is woken while readers still hold the resource. Otherwise waiting
+ * writers go first, except under the fair policy, where waiting readers go
+ * first after any release since request_must_wait keeps writers waiting
+ * while readers are queued. Among the writers a request of a resource set
+ * that can now acquire its whole set goes before the requests of the
+ * resource alone, since it needs every one of its resources at the
+ * same time. One release makes one instance available, so one writer is
+ * woken. Readers are woken all at once if no instance is held exclusively;
+ * until they have acquired the resource, new writers wait and readers do
+ * not wait for queued writers. If another process takes the instance first
+ * a woken writer simply waits again. In a prioritized process table the
+ * most urgent writer is woken.
+ *
+ * @param sim The simulator holding the resources and queues.
+ * @param resource The number of the released resource.
+ */
+void wake_waiters(struct simulator *sim, int resource) {
+  struct processTable *t = &sim->table;
+  struct resourceList *r;
+  struct queue *readers;
+  int fair;
+  int p;
+
+  if (resource < 0 || sim->resourceTable[resource]->readers > 0) {
+    return;
+  }
+  r = sim->resourceTable[resource];
+  readers = &t->readQueues[resource];
+  fair = sim->rwPolicy == PROCSCHED_FAIR;
 
-  proc->processState = WAITING;
+  if ((!fair || readers->head == -1) && t->setQueue->head != -1 &&
+      wake_set_waiter(sim, resource)) {
+    return;
+  }
+  if (fair ? readers->head != -1 : t->waitQueues[resource].head == -1) {
+    if (!is_resource_shareable(r)) {
+      return;
+    }
+    while ((p = dequeue(t, readers)) != -1) {
+      --t->waiting;
+      ++r->wokenReaders;
+      process_to_readyq(t, p);
+    }
+  } else {
+    p = dequeue_waiter(t, &t->waitQueues[resource]);
+    if (p != -1) {
+      --t->waiting;
+      process_to_readyq(t, p);
+    }
+  }
+}
 
-  waitingQueue = schedule->waitingQueue;
+/**
+ * @brief Wakes the first process in the setQueue whose resource set holds
+ * a released resource and is available as a whole.
+ *
+ * Processes whose set is still missing a resource stay in the setQueue, so
+ * a set request is only woken when it can acquire every resource of its
+ * set.
+ *
+ * @param sim The simulator holding the resources and queues.
+ * @param resource The number of the released resource.
+ *
+ * @return 1 (TRUE) if a process was woken, 0 (FALSE) otherwise.
+ */
+int wake_set_waiter(struct simulator *sim, int resource) {
+  struct processTable *t = &sim->table;
+  const struct resourceSet *set;
+  int p;
 
-#ifdef DEGUB
-  printf("Added Process %s to the waitingQueue\n", proc->pagePtr->name);
-#endif
+  if (!(t->availableBits[resource / 64] >> (resource % 64) & 1)) {
+    return FALSE;
+  }
+  for (p = t->setQueue->head; p != -1; p = t->next[p]) {
+    set = &sim->resourceSets[t->waitSet[p]];
+    if (has_member(set, resource) && is_set_available(t, set)) {
+      queue_remove(t, t->setQueue, p);
+      --t->waiting;
+      process_to_readyq(t, p);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
 
-  enqueue(waitingQueue, proc);
+/**
+ * @brief Moves up to n processes waiting on a mailbox to the readyQueue.
+ *
+ * A send wakes one receiver and a receive wakes one sender per message it
+ * took, so a drain wakes the senders it made room for in one batch. If
+ * another process gets to the mailbox first a woken process simply waits
+ * again.
+ *
+ * @param sim The simulator holding the queues.
+ * @param q The sendQueue or recvQueue of the mailbox.
+ * @param n The maximum number of processes to wake.
+ */
+void wake_mailbox_waiters(struct simulator *sim, struct queue *q, int n) {
+  struct processTable *t = &sim->table;
+  int p;
 
-  return;
+  for (; n > 0 && (p = dequeue(t, q)) != -1; n--) {
+    --t->waiting;
+    process_to_readyq(t, p);
+  }
 }
 
 /**
- * @brief Add process (with id proc) to the terminatedQueue
+ * @brief Removes the next process to wake from a wait queue.
+ *
+ * That is the head of the queue, or in a prioritized process table the
+ * most urgent process, see table_more_urgent, and among equally urgent
+ * ones the one nearest the head.
  *
- * If terminateQueue is a bitvector then set the bit in the terminatedQueue
- * for the process with id proc.
+ * @param t The process table.
+ * @param q The wait queue.
  *
- * @param schedule The struct which stores the queues.
- * @param proc The process which must be set to waiting.
+ * @return The process, -1 if the queue is empty.
  */
+int dequeue_waiter(struct processTable *t, struct queue *q) {
+  int best = q->head;
+  int p;
 
-void process_to_terminateq(struct cpuSchedule *schedule,
-                           struct processControlBlock *proc) {
-  struct queue *terminatedQueue;
+  if (!t->prioritized || best == -1) {
+    return dequeue(t, q);
+  }
+  for (p = t->next[best]; p != -1; p = t->next[p]) {
+    if (table_more_urgent(t, p, best)) {
+      best = p;
+    }
+  }
+  queue_remove(t, q, best);
+  return best;
+}
 
-  proc->processState = TERMINATED;
+/**
+ * @brief Raises the holders of what a waiting process waits for to its
+ * priority.
+ *
+ * Only the holders of resources with RESOURCE_INHERIT are raised, and only
+ * if they are less urgent. A raised holder that waits itself passes its new
+ * priority on to the holders of what it waits for, so the priority follows
+ * a chain of nested requests to the process at its end. Every step raises a
+ * process, so a cycle of waiting processes ends the chain.
+ *
+ * @param sim The simulator holding the processes.
+ * @param p The process, which waits on a request.
+ */
+void inherit_priority(struct simulator *sim, int p) {
+  struct processTable *t = &sim->table;
+  const struct resourceSet *set;
+  int i;
+
+  if (t->blockedOn[p] >= 0) {
+    raise_holders(sim, t->blockedOn[p], p);
+  } else if (t->blockedOn[p] == TABLE_BLOCKED_ON_SET) {
+    set = &sim->resourceSets[t->waitSet[p]];
+    for (i = 0; i < set->count; i++) {
+      raise_holders(sim, set->members[i], p);
+    }
+  }
+}
 
-  terminatedQueue = schedule->terminatedQueue;
+/**
+ * @brief Raises the holders of a resource with RESOURCE_INHERIT to the
+ * priority of process p, see inherit_priority.
+ */
+static void raise_holders(struct simulator *sim, int resource, int p) {
+  struct processTable *t = &sim->table;
+  struct resourceList *r = sim->resourceTable[resource];
+  struct resourceList *held;
+  int holder;
 
-#ifdef DEBUG
-  printf("Added Process %s to the terminatedQueue\n", proc->pagePtr->name);
-#endif
+  if (r->protocol != RESOURCE_INHERIT) {
+    return;
+  }
+  for (held = r->holders; held != NULL; held = held->nextHolder) {
+    holder = held->holder;
+    if (t->priority[holder] >= t->priority[p]) {
+      continue;
+    }
+    table_set_priority(t, holder, t->priority[p]);
+    trace_priority(sim, holder, "inherited from", t->pcb[p]->pagePtr->name);
+    if (t->state[holder] == WAITING) {
+      inherit_priority(sim, holder);
+    }
+  }
+}
 
-  enqueue(terminatedQueue, proc);
+/**
+ * @brief Raises a process that acquired a protected resource.
+ *
+ * A resource with RESOURCE_CEILING raises it to the ceiling of the
+ * resource, one with RESOURCE_INHERIT to the priority of the most urgent
+ * process still waiting for the resource.
+ *
+ * @param sim The simulator holding the processes.
+ * @param p The running process.
+ * @param resource The resource it acquired.
+ */
+void acquire_priority(struct simulator *sim, int p,
+                      struct resourceList *resource) {
+  struct processTable *t = &sim->table;
+  int priority = resource->protocol == RESOURCE_CEILING
+                     ? resource->ceiling
+                     : waiter_priority(sim, resource->number);
+
+  if (priority > t->priority[p]) {
+    table_set_priority(t, p, priority);
+    trace_priority(sim, p,
+                   resource->protocol == RESOURCE_CEILING
+                       ? "ceiling of"
+                       : "inherited through",
+                   resource->name);
+  }
+}
 
-  return;
+/**
+ * @brief Lowers a raised process to the priority it still has a claim to.
+ *
+ * That is its base priority, the ceiling of every resource with
+ * RESOURCE_CEILING it holds and the priority of the most urgent process
+ * waiting for every resource with RESOURCE_INHERIT it holds, whichever is
+ * highest.
+ *
+ * @param sim The simulator holding the processes.
+ * @param p The process, which just released a resource.
+ * @param released The name of the resource.
+ */
+void restore_priority(struct simulator *sim, int p, const char *released) {
+  struct processTable *t = &sim->table;
+  struct resourceList *held;
+  int priority = t->pcb[p]->pagePtr->priority;
+  int claim;
+
+  for (held = t->pcb[p]->resourceListPtr; held != NULL; held = held->next) {
+    if (held->resource->protocol == RESOURCE_CEILING) {
+      claim = held->resource->ceiling;
+    } else if (held->resource->protocol == RESOURCE_INHERIT) {
+      claim = waiter_priority(sim, held->number);
+    } else {
+      continue;
+    }
+    priority = claim > priority ? claim : priority;
+  }
+  if (priority != t->priority[p]) {
+    table_set_priority(t, p, priority);
+    trace_priority(sim, p, "restored after", released);
+  }
+}
+
+/**
+ * @brief Returns the priority of the most urgent process waiting for a
+ * resource on an exclusive, shared or resource set request.
+ *
+ * @param sim The simulator holding the processes.
+ * @param resource The number of the resource.
+ *
+ * @return The priority, -1 if no process waits for the resource.
+ */
+int waiter_priority(struct simulator *sim, int resource) {
+  struct processTable *t = &sim->table;
+  int priority = -1;
+  int p;
+
+  for (p = t->waitQueues[resource].head; p != -1; p = t->next[p]) {
+    priority = t->priority[p] > priority ? t->priority[p] : priority;
+  }
+  for (p = t->readQueues[resource].head; p != -1; p = t->next[p]) {
+    priority = t->priority[p] > priority ? t->priority[p] : priority;
+  }
+  for (p = t->setQueue->head; p != -1; p = t->next[p]) {
+    if (t->priority[p] > priority &&
+        has_member(&sim->resourceSets[t->waitSet[p]], resource)) {
+      priority = t->priority[p];
+    }
+  }
+  return priority;
+}
+
+/**
+ * @brief Traces a change of the effective priority of a process.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process.
+ * @param reason What changed it.
+ * @param name The process or resource that changed it.
+ */
+static void trace_priority(struct simulator *sim, int p, const char *reason,
+                           const char *name) {
+  if (sim->trace != NULL) {
+    fprintf(sim->trace, "%s priority %d: %s %s\n",
+            sim->table.pcb[p]->pagePtr->name, sim->table.priority[p], reason,
+            name);
+  }
 }
 
 /**
  * @brief Prints all available resources in the resource list
+ *
+ * A counted resource is printed with its number of available instances and
+ * a shared resource with its number of readers.
+ *
  * @param resource  resource list containing all the resources
  */
 
-void print_available_resources(struct resourceList *resource) {
+void print_available_resources(FILE *out, struct resourceList *resource) {
   struct resourceList *cur = resource;
 
-  printf("Available : ");
+  fputs("Available : ", out);
   while (cur != NULL) {
-    if (cur->available == 1) {
-      printf("%s ", cur->name);
+    if (cur->available > 0) {
+      fputs(cur->name, out);
+      if (cur->capacity != 1) {
+        fprintf(out, ":%d", cur->available);
+      }
+      if (cur->readers > 0) {
+        fprintf(out, "(shared:%d)", cur->readers);
+      }
+      fputc(' ', out);
     }
     cur = cur->next;
   }
-  printf("\n");
+  fputc('\n', out);
 }
 
 /**
- * @brief Iterates over each of the loaded processes and checks if it has been
- * terminated.
+ * @brief Checks if every loaded process has terminated.
  *
- * Iterates over the processes to determine if they have terminated.
+ * Sweeps over the states in the process table.
  *
- * @param firstPCB A pointer to start of all the processes.
+ * @param t The process table.
  *
  * @return 1 (TRUE) if all the processes are terminated else 0 (FALSE).
  */
 
-int processes_finished(struct processControlBlock *firstPCB) {
-  if (firstPCB == NULL) {
-    return 1;
-  }
-  if (firstPCB->processState != TERMINATED) {
-    return 0;
+int processes_finished(struct processTable *t) {
+  int p;
+
+  for (p = 0; p < t->count; p++) {
+    if (t->state[p] != TERMINATED) {
+      return FALSE;
+    }
   }
-  return processes_finished(firstPCB->next);
+  return TRUE;
 }
 
 /**
- * @brief Detects deadlock.
+ * @brief Recovers from a deadlock.
  *
- * This function implements a deadlock detection algorithm.
+ * The system is deadlocked when every process that has not terminated is
+ * waiting. Waiting processes are terminated one by one in order of their
+ * number, releasing all their resources, until one of the remaining
+ * processes can continue.
  *
- * @param firstPCB A pointer to the start of all the processes.
- *
- * @return 1 (TRUE) if all the processes are in the waiting state else
- * 0 (FALSE).
+ * @param sim The simulator holding the processes.
  */
 
-int processes_deadlocked(struct processControlBlock *firstPCB) {
-  if (firstPCB == NULL) {
-    return 1;
-  }
-  if (firstPCB->processState == WAITING) {
-    return processes_deadlocked(firstPCB->next);
+void recover_from_deadlock(struct simulator *sim) {
+  struct processTable *t = &sim->table;
+  int p;
+
+#ifdef DEBUG
+  printf("DEADLOCKED\n");
+#endif
+  ++sim->deadlocks;
+  if (sim->recording != NULL) {
+    recording_event(sim, EVENT_DEADLOCK, 0);
   }
 
-  return 0;
+  for (p = 0; p < t->count && t->readyQueue.head == -1; p++) {
+    if (t->state[p] != WAITING) {
+      continue;
+    }
+#ifdef DEBUG
+    printf("RECOVERING FROM DEADLOCK\n");
+#endif
+    queue_remove(t, wait_queue_of(t, pager_next_op(sim, p)), p);
+    --t->waiting;
+
+    release_all_resources_from_process(t->pcb[p]);
+    refresh_available_bits(sim);
+    if (sim->topicCount > 0) {
+      leave_topics(sim, p);
+    }
+    process_to_terminateq(t, p);
+    ++sim->deadlockVictims;
+    if (sim->recording != NULL) {
+      recording_event(sim, EVENT_VICTIM, p);
+    }
+    send_processes_to_readyq(sim);
+  }
 }
 
 /**
@@ -611,58 +1686,225 @@ int processes_deadlocked(struct processControlBlock *firstPCB) {
  * @param p Process to release resources from
  */
 void release_all_resources_from_process(struct processControlBlock *p) {
-  struct resourceList *r = p->resourceListPtr;
-  while (r != NULL) {
-    release_resource(r->name, r, p);
-    r = r->next;
+  while (p->resourceListPtr != NULL) {
+    release_resource(p->resourceListPtr->resource, p);
   }
   return;
 }
 
 /**
- * @brief Checks if a certain resource is available
- * @param  resourceName The name of the process to check
- * @param  resource     List of all available resources to the system
+ * @brief Checks if an instance of a resource is available for an exclusive
+ * request
+ * @param  resource     The resource to check
  * @return              1 (TRUE) if the resource is available,
  *                      returns 0 (FALSE) otherwise.
  */
-int is_resource_available(char *resourceName, struct resourceList *resource) {
-  if (resource == NULL) {
-    return FALSE;
-  }
+int is_resource_available(struct resourceList *resource) {
+  return resource != NULL && resource->available > 0 &&
+         resource->readers == 0;
+}
 
-  if (strcmp(resource->name, resourceName) == 0) {
-    if (resource->available == 1) {
-      return TRUE;
-    } else {
-      return is_resource_available(resourceName, resource->next);
+/**
+ * @brief Checks if an instance of every resource of a set is available for
+ * an exclusive request
+ *
+ * The bitset of the set is compared with the availability bitset one word
+ * at a time, so the check takes a few instructions however many resources
+ * the set holds.
+ *
+ * @param  t            The process table holding the availability bitset
+ * @param  set          The resource set to check
+ * @return              1 (TRUE) if every resource is available,
+ *                      returns 0 (FALSE) otherwise.
+ */
+int is_set_available(struct processTable *t, const struct resourceSet *set) {
+  const unsigned long long *available = t->availableBits + set->firstWord;
+  int word;
+
+  for (word = 0; word < set->words; word++) {
+    if (set->bits[word] & ~available[word]) {
+      return FALSE;
     }
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Checks if a resource is a member of a resource set.
+ *
+ * @param set The resource set.
+ * @param resource The number of the resource.
+ *
+ * @return 1 (TRUE) if it is a member, 0 (FALSE) otherwise.
+ */
+static inline int has_member(const struct resourceSet *set, int resource) {
+  int word = resource / 64 - set->firstWord;
+
+  return word >= 0 && word < set->words &&
+         (set->bits[word] >> (resource % 64) & 1);
+}
+
+/**
+ * @brief Sets or clears the bit of a resource in the availability bitset
+ * after its instances or readers changed.
+ *
+ * @param sim The simulator holding the resource and the process table.
+ * @param resource The number of the resource.
+ */
+static inline void update_available_bit(struct simulator *sim, int resource) {
+  unsigned long long bit = 1ull << (resource % 64);
+
+  if (is_resource_available(sim->resourceTable[resource])) {
+    sim->table.availableBits[resource / 64] |= bit;
   } else {
-    return is_resource_available(resourceName, resource->next);
+    sim->table.availableBits[resource / 64] &= ~bit;
   }
 }
 
 /**
- * @brief Checks for processes in the waiting queue ready to run and puts them
- *        in a ready queue
- * @param waitingQueue The waiting queue to check in
- * @param resource     List of resources svailable to the system
+ * @brief Recomputes the availability bitset from the resources, e.g. after
+ * they were released outside of the release instruction or restored.
+ *
+ * @param sim The simulator holding the resources and the process table.
  */
+void refresh_available_bits(struct simulator *sim) {
+  int i;
 
-void send_processes_to_readyq(struct queue *waitingQueue,
-                              struct resourceList *resource) {
-  if (waitingQueue->head != NULL) {
-    int n = waitingQueue->n;
-    while (n > 0) {
+  for (i = 0; i < sim->resourceCount; i++) {
+    update_available_bit(sim, i);
+  }
+}
 
-      struct queueItem *q = dequeue(waitingQueue);
-      if (is_resource_available(q->item->nextInstruction->resource, resource)) {
-        process_to_readyq(q->item->cpuSchedulePtr, q->item);
+/**
+ * @brief Checks if a resource is available for a shared request, which is
+ * the case while none of its instances is held exclusively
+ * @param  resource     The resource to check
+ * @return              1 (TRUE) if the resource can be shared,
+ *                      returns 0 (FALSE) otherwise.
+ */
+int is_resource_shareable(struct resourceList *resource) {
+  return resource != NULL && resource->capacity > 0 &&
+         resource->available == resource->capacity;
+}
 
-      } else {
-        enqueue(waitingQueue, q->item);
+/**
+ * @brief Checks if the read-write policy makes a request of an existing
+ * resource wait behind the queued requests of the other kind.
+ *
+ * Shared requests wait while an exclusive request is queued, so writers do
+ * not starve, unless woken readers are still acquiring the resource. Under
+ * the fair policy exclusive requests also wait while shared requests are
+ * queued, and under both policies while woken readers acquire it. A request
+ * of a resource set is exclusive and waits if any of its resources would
+ * make an exclusive request wait.
+ *
+ * @param sim The simulator holding the resources and queues.
+ * @param op A request op.
+ *
+ * @return 1 (TRUE) if the request must wait, 0 (FALSE) otherwise.
+ */
+int request_must_wait(struct simulator *sim, struct op *op) {
+  struct processTable *t = &sim->table;
+  const struct resourceSet *set;
+  struct resourceList *r;
+  int i;
+
+  if (op->type == REQSET_V) {
+    set = &sim->resourceSets[op->operand];
+    for (i = 0; i < set->count; i++) {
+      if (sim->resourceTable[set->members[i]]->wokenReaders > 0 ||
+          (sim->rwPolicy == PROCSCHED_FAIR &&
+           t->readQueues[set->members[i]].head != -1)) {
+        return TRUE;
+      }
+    }
+    return FALSE;
+  }
+  r = sim->resourceTable[op->operand];
+  if (op->type == REQS_V) {
+    return r->wokenReaders == 0 && t->waitQueues[op->operand].head != -1;
+  }
+  return r->wokenReaders > 0 || (sim->rwPolicy == PROCSCHED_FAIR &&
+                                 t->readQueues[op->operand].head != -1);
+}
+
+/**
+ * @brief Checks for waiting processes ready to run and puts them in the
+ *        readyQueue
+ *
+ * Sweeps over the states in the process table. Only used after resources
+ * were released without going through the wait queues.
+ *
+ * @param sim The simulator holding the processes.
+ */
+
+void send_processes_to_readyq(struct simulator *sim) {
+  struct processTable *t = &sim->table;
+  int p;
+
+  for (p = 0; p < t->count; p++) {
+    if (t->state[p] == WAITING &&
+        is_op_ready(sim, p, pager_next_op(sim, p))) {
+      queue_remove(t, wait_queue_of(t, t->nextOp[p]), p);
+      --t->waiting;
+      process_to_readyq(t, p);
+    }
+  }
+}
+
+/**
+ * @brief Checks if an op can execute without waiting.
+ *
+ * Only a request, send, receive or sync can wait. A request is ready when
+ * its resource is available for a request of its kind, or every resource of
+ * its set for a set request, a send when its mailbox is not full and a
+ * receive when its mailbox is not empty. For a topic a receive is ready when
+ * the process has a message left to receive, and a send is only held back by
+ * a full topic under TOPIC_BLOCK. A sync is only ready once the last party
+ * of its barrier has released the process. The read-write policy is left
+ * to the request when it runs again, so that queued readers and writers
+ * waiting for each other cannot keep each other waiting after deadlock
+ * recovery.
+ *
+ * @param sim The simulator holding the resource and mailbox tables.
+ * @param p The waiting process.
+ * @param op Its next op.
+ *
+ * @return 1 (TRUE) if the op can execute, 0 (FALSE) otherwise.
+ */
+int is_op_ready(struct simulator *sim, int p, struct op *op) {
+  struct resourceList *resource;
+  struct mailbox *mail;
+  int s;
+
+  if (op->type != REQ_V && op->type != REQS_V && op->type != REQSET_V &&
+      op->type != SEND_V && op->type != RECV_V && op->type != DRAIN_V &&
+      op->type != SYNC_V) {
+    return TRUE;
+  }
+  if (op->type == SYNC_V) {
+    return op->operand < 0 || sim->table.released[p];
+  }
+  if (op->operand < 0) {
+    return FALSE;
+  }
+  if (op->type == REQSET_V) {
+    return is_set_available(&sim->table, &sim->resourceSets[op->operand]);
+  }
+  if (op->type == SEND_V || op->type == RECV_V || op->type == DRAIN_V) {
+    mail = sim->mailboxTable[op->operand];
+    if (mail->topic != NULL) {
+      if (op->type == SEND_V) {
+        return mail->count < mail->capacity ||
+               mail->topic->policy != TOPIC_BLOCK;
       }
-      --n;
+      s = topic_subscriber(mail, p);
+      return s < 0 || topic_unread(mail, s) > 0;
     }
+    return op->type == SEND_V ? mail->count < mail->capacity
+                              : mail->count > 0;
   }
+  resource = sim->resourceTable[op->operand];
+  return op->type == REQS_V ? is_resource_shareable(resource)
+                            : is_resource_available(resource);
 }
@@ -5,18 +5,40 @@
 #define _MANAGER_H
 
 #include "loader.h"
+#include "table.h"
 
-void schedule_processes(struct processControlBlock *pcb,
-    struct resourceList *resource, struct mailbox *mail, int quantum, int schedule_alg);
+struct simulator;
 
-void schedule_processes_fcfs(struct processControlBlock *pcb,
-    struct resourceList *resource, struct mailbox *mail);
+void schedule_processes(struct simulator *sim, int schedule_alg, int quantum);
 
-void schedule_processes_rr(struct processControlBlock *pcb,
-    struct processControlBlock *firstPCB,
-		struct resourceList *resource, struct mailbox *mail, int quantum,int num, int tally);
+void schedule_processes_fcfs(struct simulator *sim);
 
-void process_to_readyq(struct cpuSchedule *schedule,
-	struct processControlBlock *proc);
+void schedule_processes_rr(struct simulator *sim, int quantum);
+
+void schedule_processes_priority(struct simulator *sim, int quantum);
+
+int schedule_slice(struct simulator *sim, int quantum);
+
+void recover_from_deadlock(struct simulator *sim);
+
+void process_to_readyq(struct processTable *t, int p);
+
+struct queue *wait_queue_of(struct processTable *t, struct op *op);
+
+int acquire_resource(struct resourceList *resource,
+    struct processControlBlock *p);
+
+int release_resource(struct resourceList *resource,
+    struct processControlBlock *p);
+
+int is_resource_available(struct resourceList *resource);
+
+void refresh_available_bits(struct simulator *sim);
+
+struct mailbox *find_mailbox(char *mailboxName, struct mailbox *mail);
+
+int run_process(struct simulator *sim, int p, int budget);
+
+const void *const *get_op_handlers();
 
 #endif
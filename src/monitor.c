@@ -0,0 +1,282 @@
+/**
+ * @file monitor.c
+ */
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "loader.h"
+#include "monitor.h"
+#include "simulator.h"
+#include "table.h"
+
+static int map_segment(struct simulator *sim);
+static uint32_t publish_holders(struct monitorResource *record,
+                                struct resourceList *r);
+static long long now_ns(void);
+
+/**
+ * @brief Makes the simulator publish its counters to a shared memory
+ * segment.
+ *
+ * A segment with the same name is replaced. A simulator that is not
+ * compiled yet, e.g. the one of a daemon waiting for its first process,
+ * maps the segment at its first publication, when its resources are known.
+ *
+ * A handler of e.g. SIGTERM cannot remove the segment itself, so it stores
+ * the signal in stop and the scheduler removes the segment and raises the
+ * signal again with its default action the next time it looks at the
+ * clock.
+ *
+ * @param sim The simulator.
+ * @param name The name of the segment, e.g. "/procsched".
+ * @param stop The signal to stop on, set by a signal handler, or NULL.
+ *
+ * @return 0 on success, -1 if the segment could not be created.
+ */
+int monitor_open(struct simulator *sim, const char *name,
+                 volatile sig_atomic_t *stop) {
+  struct monitor *m = malloc(sizeof(struct monitor));
+
+  monitor_close(sim);
+  if (m == NULL) {
+    return -1;
+  }
+  m->name = malloc(strlen(name) + 1);
+  if (m->name == NULL) {
+    free(m);
+    return -1;
+  }
+  strcpy(m->name, name);
+  m->header = NULL;
+  m->size = 0;
+  m->slices = 0;
+  m->lastNs = 0;
+  m->rateInstructions = m->nextInstructions = 0;
+  m->rateNs = m->nextNs = 0;
+  m->stop = stop;
+  sim->monitor = m;
+
+  if (sim->compiled && map_segment(sim) != 0) {
+    monitor_close(sim);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Unmaps and removes the segment, readers attached to it keep their
+ * mapping.
+ *
+ * @param sim The simulator.
+ */
+void monitor_close(struct simulator *sim) {
+  struct monitor *m = sim->monitor;
+
+  if (m == NULL) {
+    return;
+  }
+  if (m->header != NULL) {
+    munmap(m->header, m->size);
+    shm_unlink(m->name);
+  }
+  free(m->name);
+  free(m);
+  sim->monitor = NULL;
+}
+
+/**
+ * @brief Publishes the counters if the last publication is at least
+ * MONITOR_PERIOD_NS old.
+ *
+ * The clock is only read every MONITOR_POLL_SLICES time slices, so a time
+ * slice costs one counter increment and compare. The stop signal is looked
+ * at as often.
+ *
+ * @param sim The running simulator.
+ */
+void monitor_poll(struct simulator *sim) {
+  struct monitor *m = sim->monitor;
+  int signo;
+
+  if (++m->slices < MONITOR_POLL_SLICES) {
+    return;
+  }
+  m->slices = 0;
+  if (m->stop != NULL && (signo = *m->stop) != 0) {
+    monitor_close(sim);
+    signal(signo, SIG_DFL);
+    raise(signo);
+    return;
+  }
+  if (now_ns() - m->lastNs >= MONITOR_PERIOD_NS) {
+    monitor_publish(sim);
+  }
+}
+
+/**
+ * @brief Publishes the counters.
+ *
+ * Every store to the segment is relaxed, the seqlock orders them with two
+ * release fences, so the writer never waits for a reader.
+ *
+ * @param sim The simulator.
+ */
+void monitor_publish(struct simulator *sim) {
+  struct monitor *m = sim->monitor;
+  struct monitorHeader *h;
+  struct monitorResource *records;
+  struct processTable *t = &sim->table;
+  struct resourceList *r;
+  long long now = now_ns();
+  double rate;
+  uint32_t sequence;
+  uint32_t i;
+
+  if (m->header == NULL && (!sim->compiled || map_segment(sim) != 0)) {
+    return;
+  }
+  h = m->header;
+  records = (struct monitorResource *)(h + 1);
+
+  /* Averaged over at least MONITOR_RATE_NS, so a slow run does not read
+   * 0 between two instructions */
+  if (m->lastNs == 0) {
+    m->rateInstructions = m->nextInstructions = sim->instructionsExecuted;
+    m->rateNs = m->nextNs = now;
+    __atomic_store_n(&h->startNs, now, __ATOMIC_RELAXED);
+  } else if (now - m->nextNs >= MONITOR_RATE_NS) {
+    m->rateInstructions = m->nextInstructions;
+    m->rateNs = m->nextNs;
+    m->nextInstructions = sim->instructionsExecuted;
+    m->nextNs = now;
+  }
+  rate = now > m->rateNs ? (sim->instructionsExecuted - m->rateInstructions) *
+                               1e9 / (now - m->rateNs)
+                         : 0.0;
+
+  sequence = __atomic_load_n(&h->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  __atomic_store_n(&h->timeNs, now, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->instructions, sim->instructionsExecuted,
+                   __ATOMIC_RELAXED);
+  __atomic_store(&h->instructionsPerSecond, &rate, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->deadlocks, sim->deadlocks, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->deadlockVictims, sim->deadlockVictims,
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&h->processes, t->count, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->ready, t->readyQueue.n, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->waiting, t->waiting, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->terminated, t->terminatedQueue.n, __ATOMIC_RELAXED);
+  __atomic_store_n(&h->finished, sim->finished, __ATOMIC_RELAXED);
+  for (i = 0; i < h->resources; i++) {
+    r = sim->resourceTable[i];
+    __atomic_store_n(&records[i].holders, publish_holders(&records[i], r),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&records[i].available, r->available, __ATOMIC_RELAXED);
+    __atomic_store_n(&records[i].readers, r->readers, __ATOMIC_RELAXED);
+  }
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&h->sequence, sequence + 2, __ATOMIC_RELAXED);
+
+  m->lastNs = now;
+}
+
+/**
+ * @brief Stores the first MONITOR_HOLDERS processes holding a resource in
+ * its record.
+ *
+ * The holder index has one entry per process however many instances it
+ * holds, so the scan stops once it found all of them or MONITOR_HOLDERS.
+ *
+ * @param record The record of the resource.
+ * @param r The system resource.
+ *
+ * @return The number of processes holding the resource.
+ */
+static uint32_t publish_holders(struct monitorResource *record,
+                                struct resourceList *r) {
+  int found = 0;
+  int slot;
+
+  for (slot = 0; slot < r->holderSlots && found < r->holderCount &&
+                 found < MONITOR_HOLDERS;
+       slot++) {
+    if (r->holderIndex[slot] != NULL) {
+      __atomic_store_n(&record->holder[found++],
+                       r->holderIndex[slot]->holder, __ATOMIC_RELAXED);
+    }
+  }
+  return r->holderCount;
+}
+
+/**
+ * @brief Creates, sizes and maps the segment and writes the parts that
+ * never change.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int map_segment(struct simulator *sim) {
+  struct monitor *m = sim->monitor;
+  struct monitorHeader *h;
+  struct monitorResource *records;
+  int resources = sim->resourceCount < MONITOR_RESOURCES ? sim->resourceCount
+                                                         : MONITOR_RESOURCES;
+  int fd;
+  int i;
+
+  m->size = sizeof(struct monitorHeader) +
+            sizeof(struct monitorResource) * resources;
+  shm_unlink(m->name);
+  fd = shm_open(m->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd == -1) {
+    return -1;
+  }
+  if (ftruncate(fd, m->size) != 0) {
+    close(fd);
+    shm_unlink(m->name);
+    return -1;
+  }
+  h = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (h == MAP_FAILED) {
+    shm_unlink(m->name);
+    return -1;
+  }
+
+  /* The segment starts out zeroed, so the sequence is even */
+  records = (struct monitorResource *)(h + 1);
+  h->version = MONITOR_VERSION;
+  h->pid = getpid();
+  h->resourceCount = sim->resourceCount;
+  h->resources = resources;
+  for (i = 0; i < resources; i++) {
+    strncpy(records[i].name, sim->resourceTable[i]->name,
+            MONITOR_NAME_SIZE - 1);
+    records[i].available = sim->resourceTable[i]->available;
+    records[i].capacity = sim->resourceTable[i]->capacity;
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(h->magic, MONITOR_MAGIC, sizeof(h->magic));
+
+  m->header = h;
+  return 0;
+}
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds.
+ */
+static long long now_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ll + now.tv_nsec;
+}
@@ -0,0 +1,162 @@
+/**
+  * @file monitor.h
+  * @description A definition of the monitor, which publishes live counters
+  *              of a running simulation in a POSIX shared memory segment so
+  *              other programs, e.g. tools/procsched-top, can watch it.
+  *
+  * This header is also included by tools/top.c and only needs the C
+  * library.
+  */
+
+#ifndef _MONITOR_H
+#define _MONITOR_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct simulator;
+
+/** The first bytes of every segment */
+#define MONITOR_MAGIC "PSCHDMON"
+/** The version of the layout below, bumped on every incompatible change */
+#define MONITOR_VERSION 4
+/** The size of a resource name in the segment, including the final 0 */
+#define MONITOR_NAME_SIZE 32
+/** The maximum number of resources whose holders are published */
+#define MONITOR_RESOURCES 1024
+/** The maximum number of holders published per resource */
+#define MONITOR_HOLDERS 8
+/** The number of time slices between two looks at the clock */
+#define MONITOR_POLL_SLICES 64
+/** The minimum time between two publications in nanoseconds */
+#define MONITOR_PERIOD_NS 10000000
+/** The minimum time instructions per second are averaged over in
+ * nanoseconds */
+#define MONITOR_RATE_NS 1000000000
+
+/**
+ * The header at the start of a segment. It is followed by one
+ * monitorResource per published resource.
+ *
+ * The counters are protected by a seqlock: the writer makes the sequence
+ * odd, stores the counters and the resources and makes it even again, every
+ * store relaxed and ordered by fences. A reader copies everything between
+ * two reads of the same even sequence and retries otherwise, so it never
+ * sees a half written publication and never slows the writer down. The
+ * magic, version, pid, resource count, names and capacities are written
+ * before the magic and never change.
+ */
+struct monitorHeader {
+  /** MONITOR_MAGIC without the terminating 0, set once the segment is
+   * complete */
+  char magic[8];
+  /** MONITOR_VERSION */
+  uint32_t version;
+  /** The seqlock, odd while a publication is written */
+  uint32_t sequence;
+  /** The process writing the segment */
+  int64_t pid;
+  /** The number of resources of the simulation */
+  uint32_t resourceCount;
+  /** The number of monitorResource records, at most MONITOR_RESOURCES */
+  uint32_t resources;
+  /** CLOCK_MONOTONIC of the first publication in nanoseconds */
+  int64_t startNs;
+  /** CLOCK_MONOTONIC of the last publication in nanoseconds */
+  int64_t timeNs;
+  /** The number of completed instructions */
+  int64_t instructions;
+  /** Instructions per second over the last one to two MONITOR_RATE_NS,
+   * or since the first publication if the run is younger */
+  double instructionsPerSecond;
+  /** The number of deadlocks detected */
+  int64_t deadlocks;
+  /** The number of processes terminated to recover from a deadlock */
+  int64_t deadlockVictims;
+  /** The number of processes in the process table */
+  uint32_t processes;
+  /** The number of processes in the readyQueue */
+  uint32_t ready;
+  /** The number of processes in a wait queue */
+  uint32_t waiting;
+  /** The number of processes in the terminatedQueue */
+  uint32_t terminated;
+  /** Set by the last publication of a finished run */
+  uint32_t finished;
+  /** Unused, 0 */
+  uint32_t reserved;
+};
+
+/**
+ * A published resource.
+ */
+struct monitorResource {
+  /** The name of the resource, cut to MONITOR_NAME_SIZE - 1 bytes */
+  char name[MONITOR_NAME_SIZE];
+  /** The number of processes holding an instance, exclusive or shared */
+  uint32_t holders;
+  /** The number of available instances */
+  uint32_t available;
+  /** The number of instances */
+  uint32_t capacity;
+  /** The number of processes holding the resource shared */
+  uint32_t readers;
+  /** The numbers of the first min(holders, MONITOR_HOLDERS) of those
+   * processes, in no particular order */
+  int32_t holder[MONITOR_HOLDERS];
+};
+
+/**
+ * The writer side of a segment.
+ */
+struct monitor {
+  /** The name of the segment, e.g. "/procsched" */
+  char *name;
+  /** The mapped segment, NULL until the simulator is compiled */
+  struct monitorHeader *header;
+  /** The size of the mapping in bytes */
+  size_t size;
+  /** The number of time slices since the clock was last read */
+  int slices;
+  /** CLOCK_MONOTONIC of the last publication in nanoseconds */
+  long long lastNs;
+  /** The instructions and CLOCK_MONOTONIC at the start of the window
+   * instructionsPerSecond is averaged over */
+  long long rateInstructions;
+  long long rateNs;
+  /** The same at the start of the next window, which replaces it once it
+   * is MONITOR_RATE_NS long */
+  long long nextInstructions;
+  long long nextNs;
+  /** The signal to stop on, set by a signal handler, NULL for none */
+  volatile sig_atomic_t *stop;
+};
+
+/*
+ * Makes sim publish its counters to the shared memory segment name, which
+ * is created or replaced. The segment is mapped right away if sim is
+ * compiled, otherwise at the first publication. Once stop, if not NULL,
+ * holds a signal number the segment is removed and the signal raised again
+ * with its default action. Returns 0 on success or -1 on failure.
+ */
+int monitor_open(struct simulator *sim, const char *name,
+                 volatile sig_atomic_t *stop);
+
+/*
+ * Unmaps and removes the segment of sim.
+ */
+void monitor_close(struct simulator *sim);
+
+/*
+ * Publishes the counters of sim if the last publication is at least
+ * MONITOR_PERIOD_NS old. Called by the scheduler between time slices.
+ */
+void monitor_poll(struct simulator *sim);
+
+/*
+ * Publishes the counters of sim right away.
+ */
+void monitor_publish(struct simulator *sim);
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file names.c
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "names.h"
+
+static unsigned int hash_name(const char *name);
+static void names_grow(struct nameTable *table);
+
+/**
+ * @brief Initialises an empty name table.
+ *
+ * The number of slots is the smallest power of two that keeps the table at
+ * most half full with capacity names.
+ *
+ * @param table The table to initialise.
+ * @param capacity The expected number of names.
+ */
+void names_init(struct nameTable *table, int capacity) {
+  unsigned int size = 16;
+
+  while (size < 2u * (unsigned int)capacity) {
+    size <<= 1;
+  }
+  table->names = calloc(size, sizeof(char *));
+  table->ids = malloc(size * sizeof(int));
+  table->mask = size - 1;
+  table->count = 0;
+}
+
+/**
+ * @brief Adds a name to the table.
+ *
+ * Uses linear probing. A name that is already in the table keeps the number
+ * it was first inserted with, so duplicate resource names resolve to the
+ * first instance in the resource list.
+ *
+ * @param table The table to add the name to.
+ * @param name The name to add.
+ * @param id The number stored with the name.
+ */
+void names_insert(struct nameTable *table, char *name, int id) {
+  unsigned int slot;
+
+  if (2 * (table->count + 1) > (int)table->mask + 1) {
+    names_grow(table);
+  }
+
+  slot = hash_name(name) & table->mask;
+  while (table->names[slot] != NULL) {
+    if (strcmp(table->names[slot], name) == 0) {
+      return;
+    }
+    slot = (slot + 1) & table->mask;
+  }
+  table->names[slot] = name;
+  table->ids[slot] = id;
+  ++table->count;
+}
+
+/**
+ * @brief Finds the number stored with a name.
+ *
+ * @param table The table to search.
+ * @param name The name to look up.
+ *
+ * @return The number of the name or -1 if the name is not in the table.
+ */
+int names_find(struct nameTable *table, const char *name) {
+  unsigned int slot = hash_name(name) & table->mask;
+
+  while (table->names[slot] != NULL) {
+    if (strcmp(table->names[slot], name) == 0) {
+      return table->ids[slot];
+    }
+    slot = (slot + 1) & table->mask;
+  }
+  return -1;
+}
+
+/**
+ * @brief Frees the slots of the table.
+ *
+ * @param table The table to free.
+ */
+void names_free(struct nameTable *table) {
+  free(table->names);
+  free(table->ids);
+  table->names = NULL;
+  table->ids = NULL;
+  table->mask = 0;
+  table->count = 0;
+}
+
+/**
+ * @brief Hashes a name with 32 bit FNV-1a.
+ */
+static unsigned int hash_name(const char *name) {
+  unsigned int hash = 2166136261u;
+
+  while (*name != '\0') {
+    hash ^= (unsigned char)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Doubles the number of slots and reinserts every name.
+ */
+static void names_grow(struct nameTable *table) {
+  struct nameTable bigger;
+  unsigned int slot;
+
+  names_init(&bigger, table->mask + 1);
+  for (slot = 0; slot <= table->mask; slot++) {
+    if (table->names[slot] != NULL) {
+      names_insert(&bigger, table->names[slot], table->ids[slot]);
+    }
+  }
+  names_free(table);
+  *table = bigger;
+}
@@ -0,0 +1,46 @@
+/**
+  * @file names.h
+  * @description A definition of the hash table used to map process, resource
+  *              and mailbox names to their numbers.
+  */
+
+#ifndef _NAMES_H
+#define _NAMES_H
+
+/**
+ * An open addressing hash table from a name to a number. The table does not
+ * own the names, they must outlive it.
+ */
+struct nameTable {
+  /** The names stored in each slot, NULL for an empty slot */
+  char **names;
+  /** The number stored with the name in the same slot */
+  int *ids;
+  /** The number of slots minus one, the number of slots is a power of two */
+  unsigned int mask;
+  /** The number of names stored */
+  int count;
+};
+
+/*
+ * Initialises an empty table with room for at least capacity names.
+ */
+void names_init(struct nameTable *table, int capacity);
+
+/*
+ * Adds name with the number id. If the name is already present the first
+ * number is kept.
+ */
+void names_insert(struct nameTable *table, char *name, int id);
+
+/*
+ * Returns the number stored for name or -1 if it is not present.
+ */
+int names_find(struct nameTable *table, const char *name);
+
+/*
+ * Frees the slots of the table, but not the names.
+ */
+void names_free(struct nameTable *table);
+
+#endif
@@ -0,0 +1,396 @@
+/**
+ * @file pager.c
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "loader.h"
+#include "manager.h"
+#include "pager.h"
+#include "simulator.h"
+#include "table.h"
+
+/* The number of records checked before they are dropped from memory */
+#define SCAN_OPS 65536
+
+static int scan_program(const struct imageOp *records, int length,
+                        const struct imageHeader *header, char *strings);
+static struct op *page_in(struct simulator *sim, int p, int block);
+static int choose_frame(struct simulator *sim);
+static void evict(struct simulator *sim, int f);
+static void drop_records(const struct imageOp *records, size_t count);
+
+/**
+ * @brief Attaches a pager to a simulator that is loading an image.
+ *
+ * The programs of the image must follow each other in process order, as
+ * image_save writes them. Every record is checked once here, a chunk at a
+ * time, so blocks can later be paged in without checking them again. No
+ * program is read in until a process runs.
+ *
+ * @param sim The simulator loading the image.
+ * @param base The start of the mapped image.
+ * @param header The checked header of the image.
+ * @param pages The pages of the processes, in process order.
+ * @param budget The memory for frames in bytes, there is at least one.
+ *
+ * @return 0 on success, -1 if the image is not valid or memory ran out.
+ */
+int pager_create(struct simulator *sim, char *base,
+                 const struct imageHeader *header, struct page *pages,
+                 size_t budget) {
+  const struct imageProcess *processes =
+      (const struct imageProcess *)(base + header->processOffset);
+  const struct imageOp *records =
+      (const struct imageOp *)(base + header->opOffset);
+  char *strings = base + header->stringOffset;
+  struct pager *pager;
+  uint64_t first = 0;
+  uint64_t end;
+  size_t blocks = 0;
+  size_t frames;
+  uint32_t i;
+  int f;
+
+  if (strings[header->stringSize - 1] != '\0') {
+    return -1;
+  }
+  for (i = 0; i < header->processes; i++) {
+    end = i + 1 < header->processes ? processes[i + 1].firstOp : header->ops;
+    if (processes[i].firstOp != first || end <= first ||
+        end - first > INT_MAX) {
+      return -1;
+    }
+    pages[i].firstOp = first;
+    pages[i].length = end - first;
+    pages[i].loopNesting =
+        scan_program(records + first, pages[i].length, header, strings);
+    if (pages[i].loopNesting < 0) {
+      pages[i].loopNesting = 0;
+      return -1;
+    }
+    blocks += (pages[i].length + PAGE_OPS - 1) / PAGE_OPS;
+    first = end;
+  }
+
+  frames = budget / (sizeof(struct op) * (PAGE_OPS + 1));
+  frames = frames < 1 ? 1 : frames > blocks ? blocks : frames;
+  frames = frames > INT_MAX ? INT_MAX : frames;
+
+  pager = malloc(sizeof(struct pager));
+  if (pager == NULL) {
+    return -1;
+  }
+  pager->slab = malloc(sizeof(struct op) * (PAGE_OPS + 1) * frames);
+  pager->owner = malloc(sizeof(int) * frames);
+  pager->block = malloc(sizeof(int) * frames);
+  pager->referenced = calloc(frames, sizeof(unsigned char));
+  pager->pageFrames = malloc(sizeof(int) * blocks);
+  sim->pager = pager;
+  if (pager->slab == NULL || pager->owner == NULL || pager->block == NULL ||
+      pager->referenced == NULL || pager->pageFrames == NULL) {
+    pager_free(sim);
+    return -1;
+  }
+  pager->frames = frames;
+  pager->hand = 0;
+  pager->records = records;
+  pager->header = *header;
+  pager->strings = strings;
+  pager->handlers = get_op_handlers();
+  pager->faults = 0;
+  pager->evictions = 0;
+  for (f = 0; f < pager->frames; f++) {
+    pager->owner[f] = -1;
+  }
+
+  blocks = 0;
+  for (i = 0; i < header->processes; i++) {
+    pages[i].frames = pager->pageFrames + blocks;
+    for (f = 0; f < (pages[i].length + PAGE_OPS - 1) / PAGE_OPS; f++) {
+      pages[i].frames[f] = -1;
+    }
+    blocks += f;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Frees the pager of a simulator.
+ *
+ * @param sim The simulator.
+ */
+void pager_free(struct simulator *sim) {
+  struct pager *pager = sim->pager;
+
+  if (pager == NULL) {
+    return;
+  }
+  free(pager->slab);
+  free(pager->owner);
+  free(pager->block);
+  free(pager->referenced);
+  free(pager->pageFrames);
+  free(pager);
+  sim->pager = NULL;
+}
+
+/**
+ * @brief Returns an op of the program of a process.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process.
+ * @param index The index of the op, at most that of the END_V op.
+ *
+ * @return The op, which stays valid until the next block is paged in.
+ */
+struct op *pager_op(struct simulator *sim, int p, int index) {
+  struct page *page = sim->table.pcb[p]->pagePtr;
+
+  if (sim->pager == NULL) {
+    return page->program + index;
+  }
+  return page_in(sim, p, index / PAGE_OPS) + index % PAGE_OPS;
+}
+
+/**
+ * @brief Returns the next op of a process, paging it in if it was evicted.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process.
+ *
+ * @return The next op.
+ */
+struct op *pager_next_op(struct simulator *sim, int p) {
+  struct processTable *t = &sim->table;
+
+  if (t->nextOp[p] == NULL) {
+    t->nextOp[p] = pager_op(sim, p, t->resume[p]);
+  }
+  return t->nextOp[p];
+}
+
+/**
+ * @brief Returns the index of the next op of a process in its program.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process.
+ *
+ * @return The index.
+ */
+int pager_index(struct simulator *sim, int p) {
+  struct pager *pager = sim->pager;
+  struct op *op = sim->table.nextOp[p];
+  int f;
+
+  if (pager == NULL) {
+    return op - sim->table.pcb[p]->pagePtr->program;
+  }
+  if (op == NULL) {
+    return sim->table.resume[p];
+  }
+  f = (op - pager->slab) / (PAGE_OPS + 1);
+  return pager->block[f] * PAGE_OPS + (op - pager->slab) % (PAGE_OPS + 1);
+}
+
+/**
+ * @brief Executes a LOOP_V or PAGE_V op of a paged program.
+ *
+ * A loop that jumps back within its frame and the end of a loop stay in the
+ * frame, anything else continues at the index of the next op in the
+ * program, which may have to be paged in.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The running process.
+ * @param pc The op.
+ *
+ * @return The next op.
+ */
+struct op *pager_step(struct simulator *sim, int p, struct op *pc) {
+  struct pager *pager = sim->pager;
+  struct loopStack *loop = &sim->table.loops[p];
+  int f = (pc - pager->slab) / (PAGE_OPS + 1);
+  struct op *frame = pager->slab + (size_t)f * (PAGE_OPS + 1);
+  int index = pager->block[f] * PAGE_OPS + (pc - frame);
+
+  if (pc->type == LOOP_V) {
+    if (--loop->counters[loop->depth - 1] <= 0) {
+      --loop->depth;
+      return pc + 1;
+    }
+    if (pc - frame >= pc->operand) {
+      return pc - pc->operand;
+    }
+    index -= pc->operand;
+  }
+  return pager_op(sim, p, index);
+}
+
+/**
+ * @brief Checks the op records of one program and returns its loop nesting.
+ *
+ * Every record must be a valid op, the last one the only END_V op, and the
+ * loops must be properly nested as in program_loop_nesting. The records are
+ * dropped from memory once they are checked.
+ *
+ * @return The nesting or -1 if the program is not valid.
+ */
+static int scan_program(const struct imageOp *records, int length,
+                        const struct imageHeader *header, char *strings) {
+  struct imageOp record;
+  struct op op;
+  int *open = NULL;
+  int depth = 0;
+  int nesting = 0;
+  int capacity = 0;
+  int i;
+
+  for (i = 0; i < length; i++) {
+    memcpy(&record, &records[i], sizeof(record));
+    if (image_op(&record, header, strings, NULL, &op) != 0 ||
+        (op.type == END_V) != (i == length - 1)) {
+      break;
+    }
+    if (op.type == REPEAT_V) {
+      if (depth == capacity) {
+        capacity = capacity == 0 ? 8 : 2 * capacity;
+        open = realloc(open, sizeof(int) * capacity);
+      }
+      open[depth++] = i;
+      nesting = depth > nesting ? depth : nesting;
+    } else if (op.type == LOOP_V) {
+      if (depth == 0 || open[depth - 1] != i - op.operand - 1) {
+        break;
+      }
+      --depth;
+    }
+    if ((i + 1) % SCAN_OPS == 0) {
+      drop_records(records + i + 1 - SCAN_OPS, SCAN_OPS);
+    }
+  }
+  drop_records(records + i - i % SCAN_OPS, i % SCAN_OPS);
+
+  free(open);
+  return i == length && depth == 0 ? nesting : -1;
+}
+
+/**
+ * @brief Returns the frame holding a block of a program, reading the block
+ * into a frame chosen by choose_frame if it is not in memory.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The process.
+ * @param block The block of its program.
+ *
+ * @return The first op of the block.
+ */
+static struct op *page_in(struct simulator *sim, int p, int block) {
+  struct pager *pager = sim->pager;
+  struct page *page = sim->table.pcb[p]->pagePtr;
+  const struct imageOp *records;
+  struct imageOp record;
+  struct op *frame;
+  int f = page->frames[block];
+  int n;
+  int i;
+
+  if (f >= 0) {
+    pager->referenced[f] = 1;
+    return pager->slab + (size_t)f * (PAGE_OPS + 1);
+  }
+
+  f = choose_frame(sim);
+  frame = pager->slab + (size_t)f * (PAGE_OPS + 1);
+  records = pager->records + page->firstOp + (size_t)block * PAGE_OPS;
+  n = page->length - block * PAGE_OPS;
+  n = n > PAGE_OPS ? PAGE_OPS : n;
+
+  /* The records were checked by pager_create */
+  for (i = 0; i < n; i++) {
+    memcpy(&record, &records[i], sizeof(record));
+    image_op(&record, &pager->header, pager->strings, pager->handlers,
+             &frame[i]);
+  }
+  drop_records(records, n);
+  if (frame[n - 1].type != END_V) {
+    frame[n].code = pager->handlers != NULL ? pager->handlers[PAGE_V] : NULL;
+    frame[n].type = PAGE_V;
+    frame[n].operand = -1;
+    frame[n].name = NULL;
+    frame[n].msg = NULL;
+  }
+
+  pager->owner[f] = p;
+  pager->block[f] = block;
+  pager->referenced[f] = 1;
+  page->frames[block] = f;
+  ++pager->faults;
+
+  return frame;
+}
+
+/**
+ * @brief Chooses the frame the next block is read into with the CLOCK
+ * algorithm, evicting the block it holds.
+ *
+ * @return The frame.
+ */
+static int choose_frame(struct simulator *sim) {
+  struct pager *pager = sim->pager;
+  int f;
+
+  for (;;) {
+    f = pager->hand;
+    pager->hand = f + 1 < pager->frames ? f + 1 : 0;
+    if (pager->owner[f] == -1) {
+      return f;
+    }
+    if (!pager->referenced[f]) {
+      evict(sim, f);
+      return f;
+    }
+    pager->referenced[f] = 0;
+  }
+}
+
+/**
+ * @brief Evicts the block held by a frame.
+ *
+ * A process whose next op is in the block keeps its index instead.
+ */
+static void evict(struct simulator *sim, int f) {
+  struct pager *pager = sim->pager;
+  struct processTable *t = &sim->table;
+  struct op *frame = pager->slab + (size_t)f * (PAGE_OPS + 1);
+  int q = pager->owner[f];
+  struct page *page = t->pcb[q]->pagePtr;
+
+  if (t->nextOp[q] != NULL && t->nextOp[q] >= frame &&
+      t->nextOp[q] <= frame + PAGE_OPS) {
+    t->resume[q] = pager->block[f] * PAGE_OPS + (t->nextOp[q] - frame);
+    t->nextOp[q] = NULL;
+  }
+  page->frames[pager->block[f]] = -1;
+  pager->owner[f] = -1;
+  ++pager->evictions;
+}
+
+/**
+ * @brief Drops the memory pages that lie wholly inside a range of records
+ * from the mapping. They are read from the file again when used.
+ */
+static void drop_records(const struct imageOp *records, size_t count) {
+  uintptr_t size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)records + size - 1) & ~(size - 1);
+  uintptr_t end = (uintptr_t)(records + count) & ~(size - 1);
+
+  if (end > start) {
+    madvise((void *)start, end - start, MADV_DONTNEED);
+  }
+}
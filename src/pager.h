@@ -0,0 +1,100 @@
+/**
+  * @file pager.h
+  * @description A definition of the pager, which keeps the programs of a
+  *              workload image in a fixed number of frames and reads blocks
+  *              of ops in from the image when a process reaches them, so
+  *              workloads larger than the memory can be scheduled.
+  */
+
+#ifndef _PAGER_H
+#define _PAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+struct op;
+struct page;
+struct simulator;
+
+/** The number of ops in a block */
+#define PAGE_OPS 256
+
+/**
+ * The frames of a paged simulator. Every frame holds one block of a
+ * program followed by a PAGE_V op, which moves on to the next block, and
+ * frames are chosen for eviction with the CLOCK algorithm: the hand sweeps
+ * over the frames, clears the referenced flag of every frame it passes and
+ * evicts the first frame whose flag was clear.
+ *
+ * A process whose block is evicted keeps the index of its next op in its
+ * page and its next op in the process table becomes NULL until it is paged
+ * in again.
+ */
+struct pager {
+  /** The frames, PAGE_OPS + 1 ops each */
+  struct op *slab;
+  /** The number of frames */
+  int frames;
+  /** The process whose block each frame holds, -1 for a free frame */
+  int *owner;
+  /** The block of the program each frame holds */
+  int *block;
+  /** Set when a frame was used since the hand last passed it */
+  unsigned char *referenced;
+  /** The next frame the hand looks at */
+  int hand;
+  /** The block to frame maps of all pages in one array */
+  int *pageFrames;
+  /** The op records of the mapped image */
+  const struct imageOp *records;
+  /** The header of the image */
+  struct imageHeader header;
+  /** The string area of the image */
+  char *strings;
+  /** The code address of each op type, or NULL */
+  const void *const *handlers;
+  /** The number of blocks read in */
+  long long faults;
+  /** The number of blocks evicted */
+  long long evictions;
+};
+
+/*
+ * Checks the op records of the image mapped at base, sets the program
+ * length and loop nesting of every page and attaches a pager with room for
+ * budget bytes of frames to sim. Returns 0 on success or -1 if the image is
+ * not valid or memory ran out.
+ */
+int pager_create(struct simulator *sim, char *base,
+                 const struct imageHeader *header, struct page *pages,
+                 size_t budget);
+
+/*
+ * Frees the pager of sim.
+ */
+void pager_free(struct simulator *sim);
+
+/*
+ * Returns op index of the program of process p, paging it in if needed.
+ */
+struct op *pager_op(struct simulator *sim, int p, int index);
+
+/*
+ * Returns the next op of process p, paging it in if needed.
+ */
+struct op *pager_next_op(struct simulator *sim, int p);
+
+/*
+ * Returns the index of the next op of process p in its program.
+ */
+int pager_index(struct simulator *sim, int p);
+
+/*
+ * Executes the LOOP_V or PAGE_V op pc of the running process p and returns
+ * the next op, paging it in if needed.
+ */
+struct op *pager_step(struct simulator *sim, int p, struct op *pc);
+
+#endif
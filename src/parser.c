@@ -7,21 +7,30 @@
 
 #include "loader.h"
 #include "parser.h"
+#include "simulator.h"
 #include "syntax.h"
 
 #define READING 0
 #define END_OF_FILE 2
 
-FILE *open_process_file(char *filename);
-void read_processes(FILE *fptr, char *line);
-void read_resources(FILE *fptr, char *line);
-void read_mailboxes(FILE *fptr, char *line);
-int read_process(FILE *fptr, char *line);
+FILE *open_process_file(const char *filename);
+void read_processes(struct simulator *sim, FILE *fptr, char *line);
+void read_resources(struct simulator *sim, FILE *fptr, char *line);
+void read_mailboxes(struct simulator *sim, FILE *fptr, char *line);
+int read_process(struct simulator *sim, FILE *fptr, char *line);
+void load_instruction(struct simulator *sim, FILE *fptr, char *process_name,
+                      char *instruction, char *resource_name, char *msg);
+static long stream_line(FILE *fptr);
+void read_repeat_count(FILE *fptr, char *line);
+void read_word(FILE *fptr, char *line);
 void read_req_resource(FILE *fptr, char *line);
 void read_rel_resource(FILE *fptr, char *line);
+void read_resource_set(FILE *fptr, char *line);
 char *read_comms_send(FILE *fptr, char *line);
 char *read_comms_recv(FILE *fptr, char *line);
+static char *read_comms(FILE *fptr, char *line);
 int read_string(FILE *fptr, char *line);
+char *copy_string(char *line);
 
 /**
  * @brief Reads in a specified file, parse it and store it in the associated
@@ -32,31 +41,52 @@ int read_string(FILE *fptr, char *line);
  * setup and reads the request and release statements. At each stage of the
  * parsing each element is stored in the specific datastructure.
  *
+ * @param sim The simulator to load the processes into.
  * @param filename A string with the location of the process.list file for
  * reading.
+ *
+ * @return 0 on success, -1 if the file could not be opened or has an
+ * instruction outside a process section.
  */
-void parse_process_file(char *filename) {
+int parse_process_file(struct simulator *sim, const char *filename) {
   FILE *fptr = NULL;
-  char line[1024];
   int status;
 
   fptr = open_process_file(filename);
 
   if (fptr == NULL) {
-    printf("File is NULL: this is bad");
+    return -1;
   }
 
+  status = parse_process_stream(sim, fptr);
+
+  fclose(fptr);
+  return status;
+}
+
+/**
+ * @brief Parses a process list from an open stream and loads it.
+ *
+ * @param sim The simulator to load the processes into.
+ * @param fptr The stream to read, it is not closed.
+ *
+ * @return 0 on success, -1 if an instruction is outside a process section.
+ */
+int parse_process_stream(struct simulator *sim, FILE *fptr) {
+  char line[1024];
+  int status;
+
   read_string(fptr, line);
 
-  read_processes(fptr, line);
+  read_processes(sim, fptr, line);
 
   read_string(fptr, line);
 
-  read_resources(fptr, line);
+  read_resources(sim, fptr, line);
 
   read_string(fptr, line);
 
-  read_mailboxes(fptr, line);
+  read_mailboxes(sim, fptr, line);
 
   read_string(fptr, line);
   /* If the mailboxes exist an extra readline is needed
@@ -67,10 +97,33 @@ void parse_process_file(char *filename) {
 
   status = READING;
   while (status != END_OF_FILE) {
-    status = read_process(fptr, line);
+    status = read_process(sim, fptr, line);
   }
+  return sim->loadErrors == 0 ? 0 : -1;
+}
 
-  fclose(fptr);
+/**
+ * @brief Parses the Process and Subroutine sections in an open stream.
+ *
+ * Unlike parse_process_stream the stream has no Processes, Resources or
+ * Mailboxes lines, the processes of its sections must already be loaded.
+ *
+ * @param sim The simulator holding the processes.
+ * @param fptr The stream to read, it is not closed.
+ *
+ * @return 0 on success, -1 if an instruction is outside a process section.
+ */
+int parse_process_sections(struct simulator *sim, FILE *fptr) {
+  char line[1024];
+  int status;
+
+  read_word(fptr, line);
+
+  status = READING;
+  while (status != END_OF_FILE) {
+    status = read_process(sim, fptr, line);
+  }
+  return sim->loadErrors == 0 ? 0 : -1;
 }
 
 /**
@@ -83,7 +136,7 @@ void parse_process_file(char *filename) {
  *
  * @return A file pointer
  */
-FILE *open_process_file(char *filename) {
+FILE *open_process_file(const char *filename) {
   FILE *file = fopen(filename, "r");
 
   if (file == NULL) {
@@ -101,20 +154,16 @@ FILE *open_process_file(char *filename) {
  * PROCESSES keyword. If true continue to reserve space for the process name
  * and repeatedly read all the processes and load it.
  *
+ * @param sim The simulator to load the processes into.
  * @param fptr A pointer to the file from which to read.
  * @param line A pointer to a string read from the file.
  */
-void read_processes(FILE *fptr, char *line) {
-  char *processName;
-
+void read_processes(struct simulator *sim, FILE *fptr, char *line) {
   if (strcmp(line, PROCESSES) == 0) {
-    processName = malloc(3 * sizeof(char));
-
-    while (read_string(fptr, processName) != 0) {
-      load_process(processName);
-      processName = malloc(3 * sizeof(char));
+    while (read_string(fptr, line) != 0) {
+      load_process(sim, copy_string(line));
     }
-    load_process(processName);
+    load_process(sim, copy_string(line));
   }
 }
 
@@ -125,19 +174,16 @@ void read_processes(FILE *fptr, char *line) {
  * Reads the list of resources and loads it with the load_resource function
  * defined in loader.h
  *
+ * @param sim The simulator to load the resources into.
  * @param fptr A pointer to the file from which to read.
  * @param line A pointer to a string read from the file.
  */
-void read_resources(FILE *fptr, char *line) {
-  char *resourceName;
-
+void read_resources(struct simulator *sim, FILE *fptr, char *line) {
   if (strcmp(line, RESOURCES) == 0) {
-    resourceName = malloc(3 * sizeof(char));
-    while (read_string(fptr, resourceName) != 0) {
-      load_resource(resourceName);
-      resourceName = malloc(3 * sizeof(char));
+    while (read_string(fptr, line) != 0) {
+      load_resource(sim, copy_string(line));
     }
-    load_resource(resourceName);
+    load_resource(sim, copy_string(line));
   }
 }
 
@@ -147,99 +193,300 @@ void read_resources(FILE *fptr, char *line) {
  * Reads the list of mailboxes and loads it with the load_mailbox function
  * defined in loader.h
  *
+ * @param sim The simulator to load the mailboxes into.
  * @param fptr A pointer to the file from which to read.
  * @param line A pointer to a string read from file.
  */
-void read_mailboxes(FILE *fptr, char *line) {
-  char *mailboxName;
-
+void read_mailboxes(struct simulator *sim, FILE *fptr, char *line) {
   if (strcmp(line, MAILBOXES) == 0) {
-    mailboxName = malloc(strlen(line) * sizeof(char));
-    while (read_string(fptr, mailboxName) != 0) {
-      load_mailbox(mailboxName);
-      mailboxName = malloc(strlen(line) * sizeof(char));
+    while (read_string(fptr, line) != 0) {
+      load_mailbox(sim, copy_string(line));
     }
-    load_mailbox(mailboxName);
+    load_mailbox(sim, copy_string(line));
   }
 }
 
 /**
- * @brief Reads the defined instruction for a process and loads it.
+ * @brief Reads the defined instruction for a process or subroutine and loads
+ *        it.
  *
  * Reads the list of instructions for each process and loads it in the
- * appropriate datastructure using the functions defined in loader.h
+ * appropriate datastructure using the functions defined in loader.h. A
+ * Subroutine section is read the same way and its instructions are loaded
+ * into the subroutine. The section ends at the first word that is not an
+ * instruction, which starts the next section, and a repeat block that is
+ * still open then is reported like an unmatched closing bracket.
  *
+ * @param sim The simulator holding the process.
  * @param fptr A pointer to the file from which to read.
  * @param line A pointer to a string read from file.
  *
  * @return s Indicates the current status of reading the process.
  */
-int read_process(FILE *fptr, char *line) {
-  char *resource_name;
-  char *process_name;
+int read_process(struct simulator *sim, FILE *fptr, char *line) {
+  char name[1024];
+  char word[1024];
+  char *process_name = NULL;
+  char *request;
   char *msg;
+  int subroutine;
+  int timing[3];
+  int blocks = 0;
   int s;
 
   s = 0; /* Must test this assignment */
 
-  if (strcmp(line, PROCESS) == 0) {
+  subroutine = strcmp(line, SUBROUTINE) == 0;
+  if (subroutine || strcmp(line, PROCESS) == 0) {
     /* reads the process name */
-    process_name = malloc(sizeof(char) * 3);
-    read_string(fptr, process_name);
+    read_string(fptr, name);
+    if (subroutine) {
+      load_subroutine(sim, copy_string(name));
+    } else {
+      /* The priority and timing were read with the Processes line */
+      process_name = copy_string(name);
+      cut_timing(process_name, &timing[0], &timing[1], &timing[2]);
+      cut_priority(process_name);
+    }
     /* 1. Use the resource_name to find the relevant pcb */
 #ifdef DEBUG
-    printf("Process %s\n", process_name);
+    printf("%s %s\n", line, name);
 #endif
-    resource_name = malloc(sizeof(char) * 64);
-    while ((s = read_string(fptr, resource_name)) != 0 && s != 2) {
-      if (strcmp(resource_name, REQ) == 0) {
-        /* Read the REQ resource */
-        read_req_resource(fptr, resource_name);
-        load_process_instruction(process_name, REQ, resource_name, NULL);
+    do {
+      s = read_string(fptr, word);
+      if (strcmp(word, REQ) == 0 || strcmp(word, REQX) == 0 ||
+          strcmp(word, REQS) == 0) {
+        /* Read the REQ resource, reqx is another name for req */
+        request = strcmp(word, REQS) == 0 ? REQS : REQ;
+        read_req_resource(fptr, word);
+        load_instruction(sim, fptr, process_name, request, copy_string(word),
+                         NULL);
         /* 2. Store instruction using the pcb pointer */
-      } else if (strcmp(resource_name, REL) == 0) {
+      } else if (strcmp(word, REL) == 0) {
         /* Read the REL resource */
-        read_rel_resource(fptr, resource_name);
-        load_process_instruction(process_name, REL, resource_name, NULL);
-      } else if (strcmp(resource_name, SEND) == 0) {
-        /* Read the COMMS resource */
-        msg = read_comms_send(fptr, resource_name);
-        load_process_instruction(process_name, SEND, resource_name, msg);
-      } else if (strcmp(resource_name, RECV) == 0) {
+        read_rel_resource(fptr, word);
+        load_instruction(sim, fptr, process_name, REL, copy_string(word), NULL);
+      } else if (strcmp(word, SEND) == 0) {
         /* Read the COMMS resource */
-        msg = read_comms_recv(fptr, resource_name);
-        load_process_instruction(process_name, RECV, resource_name, msg);
-      } else {
+        msg = read_comms_send(fptr, word);
+        load_instruction(sim, fptr, process_name, SEND, copy_string(word), msg);
+      } else if (strcmp(word, RECV) == 0 || strcmp(word, DRAIN) == 0) {
+        /* Read the COMMS resource, drain receives every message at once */
+        request = strcmp(word, DRAIN) == 0 ? DRAIN : RECV;
+        msg = read_comms_recv(fptr, word);
+        load_instruction(sim, fptr, process_name, request, copy_string(word),
+                         msg);
+      } else if (strcmp(word, SUBSCRIBE) == 0 ||
+                 strcmp(word, UNSUBSCRIBE) == 0) {
+        /* Read the topic */
+        request = strcmp(word, SUBSCRIBE) == 0 ? SUBSCRIBE : UNSUBSCRIBE;
+        read_string(fptr, word);
+        load_instruction(sim, fptr, process_name, request, copy_string(word),
+                         NULL);
+      } else if (strcmp(word, SYNC) == 0) {
+        /* Read the barrier and its number of parties like a message */
+        msg = read_comms(fptr, word);
+        load_instruction(sim, fptr, process_name, SYNC, copy_string(word), msg);
+      } else if (strcmp(word, REPEAT) == 0) {
+        read_repeat_count(fptr, word);
+        load_instruction(sim, fptr, process_name, REPEAT, copy_string(word),
+                         NULL);
+        ++blocks;
+      } else if (strcmp(word, BLOCKEND) == 0) {
+        load_instruction(sim, fptr, process_name, BLOCKEND, NULL, NULL);
+        blocks -= blocks > 0;
+      } else if (strcmp(word, CALL) == 0) {
+        read_word(fptr, word);
+        load_instruction(sim, fptr, process_name, CALL, copy_string(word),
+                         NULL);
+      } else if (strcmp(word, "") != 0) {
         /* Execute on white spaces */
         /* Execute the while loop when encoutering new lines and white spaces,
          * exit the loop when encountering the instructions for the next
-         * Process */
-        if (strcmp(resource_name, "") != 0) {
-          break;
-        }
+         * Process or Subroutine. Any other word is taken to start a process
+         * as well */
+        strcpy(line, strcmp(word, SUBROUTINE) == 0 ? SUBROUTINE : PROCESS);
+        break;
       }
-      resource_name = malloc(sizeof(char) * 64);
+      /* A closing bracket usually ends its line */
+    } while (s != END_OF_FILE && (s != 0 || strcmp(word, BLOCKEND) == 0));
+    if (blocks > 0) {
+      printf("Unmatched %s in %s\n", BLOCKSTART, name);
     }
+    free(process_name);
+  } else {
+    /* Skip anything outside a process section, which would otherwise be
+     * read again forever */
+    s = read_string(fptr, line);
   }
   return s;
 }
 
+/**
+ * @brief Loads an instruction into the process or, without a process name,
+ * into the subroutine that is being read.
+ *
+ * An instruction the loader cannot append to a process, because the words
+ * before it did not open a named Process section, is reported with its line
+ * to stderr, which keeps it out of the CSV of a batch on stdout, and
+ * counted in the load errors of the simulator.
+ *
+ * @param sim The simulator holding the process or subroutine.
+ * @param fptr The stream the instruction was read from.
+ * @param process_name The name of the process or NULL.
+ * @param instruction The instruction keyword.
+ * @param resource_name The resource, mailbox, count or subroutine name.
+ * @param msg The message of a send or receive instruction.
+ */
+void load_instruction(struct simulator *sim, FILE *fptr, char *process_name,
+                      char *instruction, char *resource_name, char *msg) {
+  if (process_name == NULL) {
+    load_subroutine_instruction(sim, instruction, resource_name, msg);
+  } else if (load_process_instruction(sim, process_name, instruction,
+                                      resource_name, msg) != 0) {
+    fprintf(stderr, "Line %ld: %s outside a %s section\n", stream_line(fptr),
+            instruction, PROCESS);
+    ++sim->loadErrors;
+  }
+}
+
+/**
+ * @brief Finds the line of a stream that was read last.
+ *
+ * Only used to report errors, so the stream is read again from the start
+ * up to the current position instead of counting every line as it is read.
+ *
+ * @param fptr The stream, which is left at the same position.
+ *
+ * @return The line, 1 for the first, or 0 if the stream cannot seek.
+ */
+static long stream_line(FILE *fptr) {
+  long position = ftell(fptr);
+  long lines = 1;
+  long i;
+  int ch = EOF;
+
+  if (position < 0 || fseek(fptr, 0, SEEK_SET) != 0) {
+    return 0;
+  }
+  for (i = 0; i < position && (ch = fgetc(fptr)) != EOF; i++) {
+    /* A newline ending the instruction does not start its line */
+    lines += ch == '\n' && i + 1 < position;
+  }
+  fseek(fptr, position, SEEK_SET);
+  return lines;
+}
+
+/**
+ * @brief Reads the count of a repeat instruction and the opening bracket of
+ * its block.
+ *
+ * The bracket may follow the count with or without a space in between.
+ *
+ * @param fptr A pointer to the file from which to read.
+ * @param line A pointer to space where the count is stored.
+ */
+void read_repeat_count(FILE *fptr, char *line) {
+  char bracket[1024];
+  size_t length;
+
+  read_word(fptr, line);
+  length = strlen(line);
+  if (length > 0 && line[length - 1] == BLOCKSTART[0]) {
+    line[length - 1] = '\0';
+  } else {
+    read_word(fptr, bracket);
+    if (strcmp(bracket, BLOCKSTART) != 0) {
+      printf("Expected %s after %s %s\n", BLOCKSTART, REPEAT, line);
+    }
+  }
+#ifdef DEBUG
+  printf("repeat %s\n", line);
+#endif
+}
+
+/**
+ * @brief Reads the next non-empty string, skipping repeated white space.
+ *
+ * @param fptr A pointer to the file from which to read.
+ * @param line A pointer to space where the string can be stored.
+ */
+void read_word(FILE *fptr, char *line) {
+  while (read_string(fptr, line) != END_OF_FILE && strcmp(line, "") == 0) {
+  }
+}
+
 /**
  * @brief Reads the resource name in a request instruction.
  *
  * Uses the read_string function to read the name of the resource specified in
- * this request instruction.
+ * this request instruction. A name starting with an opening bracket starts a
+ * list of resources, see read_resource_set.
  *
  * @param fptr A pointer to the file from which to read.
  * @param line A pointer to a string read from file.
  */
 void read_req_resource(FILE *fptr, char *line) {
   read_string(fptr, line);
+  if (line[0] == LEFTBRACKET) {
+    read_resource_set(fptr, line);
+  }
 #ifdef DEBUG
   printf("req %s\n", line);
 #endif
 }
 
+/**
+ * @brief Reads the rest of a bracketed list of resources, e.g.
+ * (R1, R2, R3).
+ *
+ * The first word of the list is already in line. The list ends at the
+ * closing bracket or at the end of the line, and the end of the line after
+ * the bracket is read as well. The list is stored back in line without
+ * white space and with one space after each comma, so the same list is
+ * always spelled the same way.
+ *
+ * @param fptr A pointer to the file from which to read.
+ * @param line The first word of the list, replaced by the whole list.
+ */
+void read_resource_set(FILE *fptr, char *line) {
+  /* Half the size of the line, which has room for a space after every
+   * comma */
+  char list[512];
+  size_t length = 0;
+  size_t i;
+  int closed = strchr(line, RIGHTBRACKET) != NULL;
+  int ch;
+
+  for (i = 0; line[i] != '\0' && length < sizeof(list) - 1; i++) {
+    list[length++] = line[i];
+  }
+  while (!closed && (ch = fgetc(fptr)) != EOF && ch != '\n') {
+    if (ch != WHITESPACE && ch != '\t' && ch != '\r' &&
+        length < sizeof(list) - 1) {
+      list[length++] = ch;
+    }
+    if (ch == RIGHTBRACKET) {
+      /* Read the end of the line like read_string does */
+      closed = 1;
+      if ((ch = fgetc(fptr)) != '\n' && ch != EOF) {
+        ungetc(ch, fptr);
+      }
+    }
+  }
+  list[length] = '\0';
+
+  length = 0;
+  for (i = 0; list[i] != '\0' && list[i] != RIGHTBRACKET; i++) {
+    line[length++] = list[i];
+    if (list[i] == COMMA) {
+      line[length++] = WHITESPACE;
+    }
+  }
+  line[length++] = RIGHTBRACKET;
+  line[length] = '\0';
+}
+
 /**
  * @brief Reads the resource name in a release instruction.
  *
@@ -268,32 +515,8 @@ void read_rel_resource(FILE *fptr, char *line) {
  * @return message The message which the instruction will send.
  */
 char *read_comms_send(FILE *fptr, char *line) {
-  int ch;
-  char *message;
-  int index;
+  char *message = read_comms(fptr, line);
 
-  message = malloc(sizeof(char) * 128);
-
-  while ((ch = fgetc(fptr)) != '\n') {
-    /* Check to make sure that the character is in the
-     * range of all the ascii letters */
-    if ((ch >= 65 && ch <= 90) || (ch >= 97 && ch <= 122)) {
-      index = 1;
-      line[0] = ch;
-      while ((ch = fgetc(fptr)) != COMMA) {
-        if (ch != WHITESPACE) {
-          line[index] = ch;
-          index++;
-        }
-      }
-      line[index] = '\0'; /* Adds the termination character at the string end */
-      index = 0;
-      while ((ch = fgetc(fptr)) != RIGHTBRACKET) {
-        message[index] = ch;
-        index++;
-      }
-    }
-  }
 #ifdef DEBUG
   printf("send (%s, %s)\n", line, message);
 #endif
@@ -315,35 +538,61 @@ char *read_comms_send(FILE *fptr, char *line) {
  * @return message A placeholder for the variable which receives the message.
  */
 char *read_comms_recv(FILE *fptr, char *line) {
-  int ch;
+  char *message = read_comms(fptr, line);
+
+#ifdef DEBUG
+  printf("recv (%s, %s)\n", line, message);
+#endif
+  return message;
+}
+
+/**
+ * @brief Reads the mailbox and the message of a send or receive instruction,
+ * or the barrier and the number of parties of a sync instruction, up to the
+ * end of the line.
+ *
+ * The message is everything between the comma and the closing bracket and
+ * may be of any length, the buffer doubles whenever it is full.
+ *
+ * @param fptr A pointer to the file from which to read.
+ * @param line A pointer to space where the mailbox name is stored.
+ *
+ * @return The message, empty if the instruction has none.
+ */
+static char *read_comms(FILE *fptr, char *line) {
+  size_t capacity = 128;
+  size_t index;
   char *message;
-  int index;
+  int ch;
 
-  message = malloc(sizeof(char) * 128);
+  message = malloc(capacity);
+  message[0] = '\0';
 
-  while ((ch = fgetc(fptr)) != '\n') {
+  while ((ch = fgetc(fptr)) != '\n' && ch != EOF) {
     /* Check to make sure that the character is in the
      * range of all the ascii letters */
     if ((ch >= 65 && ch <= 90) || (ch >= 97 && ch <= 122)) {
       index = 1;
       line[0] = ch;
-      while ((ch = fgetc(fptr)) != COMMA) {
+      while ((ch = fgetc(fptr)) != COMMA && ch != EOF) {
         if (ch != WHITESPACE) {
           line[index] = ch;
           index++;
         }
       }
-      line[index] = '\0';
+      line[index] = '\0'; /* Adds the termination character at the string end */
       index = 0;
-      while ((ch = fgetc(fptr)) != RIGHTBRACKET) {
+      while ((ch = fgetc(fptr)) != RIGHTBRACKET && ch != EOF) {
+        if (index + 1 == capacity) {
+          capacity *= 2;
+          message = realloc(message, capacity);
+        }
         message[index] = ch;
         index++;
       }
+      message[index] = '\0';
     }
   }
-#ifdef DEBUG
-  printf("recv (%s, %s)\n", line, message);
-#endif
   return message;
 }
 
@@ -379,3 +628,21 @@ int read_string(FILE *fptr, char *line) {
 
   return status;
 }
+
+/**
+ * @brief Copies a string read from the file into its own allocation.
+ *
+ * Names are read into the caller's line buffer and copied out at their exact
+ * length, so process, resource and mailbox names are not limited in size.
+ *
+ * @param line The string to copy.
+ *
+ * @return A newly allocated copy of line.
+ */
+char *copy_string(char *line) {
+  size_t length = strlen(line) + 1;
+  char *copy = malloc(sizeof(char) * length);
+
+  memcpy(copy, line, length);
+  return copy;
+}
@@ -8,6 +8,10 @@
 #ifndef _PARSER_H
 #define _PARSER_H
 
+#include <stdio.h>
+
+struct simulator;
+
 /**
  * @brief Reads in a specified file, parse it and store it in the associated
  *        data-structure.
@@ -17,8 +21,34 @@
  * setup and reads the request and release statements. At each stage of the
  * parsing each element is stored in the specific datastructure.
  *
+ * @param sim The simulator to load the processes into.
  * @param filename A string with the location of the process.list file for reading.
+ *
+ * @return 0 on success, -1 if the file could not be opened or has an
+ *         instruction outside a process section.
+ */
+int parse_process_file(struct simulator *sim, const char* filename);
+
+/**
+ * @brief Parses a process list from an open stream, e.g. a memory buffer
+ *        opened with fmemopen, and loads it into the simulator.
+ *
+ * @param sim The simulator to load the processes into.
+ * @param fptr The stream to read, it is not closed.
+ *
+ * @return 0 on success, -1 if an instruction is outside a process section.
+ */
+int parse_process_stream(struct simulator *sim, FILE *fptr);
+
+/**
+ * @brief Parses Process and Subroutine sections without the Processes,
+ *        Resources and Mailboxes lines from an open stream.
+ *
+ * @param sim The simulator holding the processes of the sections.
+ * @param fptr The stream to read, it is not closed.
+ *
+ * @return 0 on success, -1 if an instruction is outside a process section.
  */
-void parse_process_file(char* filename);
+int parse_process_sections(struct simulator *sim, FILE *fptr);
 
 #endif
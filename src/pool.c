@@ -0,0 +1,197 @@
+/**
+ * @file pool.c
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/**
+ * A worker of the pool. The jobs the worker has left are the range
+ * [head, tail), packed into one word as tail << 32 | head so that the owner
+ * taking a job from the head and a thief taking jobs from the tail both
+ * update it with a single compare and swap.
+ */
+struct poolWorker {
+  /** The remaining jobs of the worker */
+  unsigned long long range;
+  /** The number of the worker */
+  int id;
+  /** The pool the worker belongs to */
+  struct pool *pool;
+  /** The thread running the worker, unused for worker 0 */
+  pthread_t thread;
+  /** Keeps the ranges of neighbouring workers on separate cache lines */
+  char padding[64];
+};
+
+/**
+ * The pool, shared by its workers.
+ */
+struct pool {
+  struct poolWorker *workers;
+  int threads;
+  void (*job)(int i, int worker, void *arg);
+  void *arg;
+};
+
+static unsigned long long pack_range(unsigned int head, unsigned int tail);
+static int take_job(struct poolWorker *w);
+static int steal_jobs(struct poolWorker *thief);
+static void *run_worker(void *worker);
+
+/**
+ * @brief Runs every job on a fixed number of threads.
+ *
+ * @param jobs The number of jobs.
+ * @param threads The number of threads, the calling thread included.
+ * @param job Runs job i on a worker with arg, must be safe to call
+ * concurrently for different jobs on different workers.
+ * @param arg Passed to every job.
+ */
+void pool_run(int jobs, int threads,
+              void (*job)(int i, int worker, void *arg), void *arg) {
+  struct pool pool;
+  int started;
+  int i;
+
+  if (jobs <= 0) {
+    return;
+  }
+  if (threads > jobs) {
+    threads = jobs;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  pool.workers = calloc(threads, sizeof(struct poolWorker));
+  pool.threads = threads;
+  pool.job = job;
+  pool.arg = arg;
+
+  for (i = 0; i < threads; i++) {
+    pool.workers[i].id = i;
+    pool.workers[i].pool = &pool;
+    pool.workers[i].range = pack_range((long long)jobs * i / threads,
+                                       (long long)jobs * (i + 1) / threads);
+  }
+
+  /* A worker whose thread could not be created is drained by stealing */
+  for (started = 1; started < threads; started++) {
+    if (pthread_create(&pool.workers[started].thread, NULL, run_worker,
+                       &pool.workers[started]) != 0) {
+      break;
+    }
+  }
+  run_worker(&pool.workers[0]);
+  for (i = 1; i < started; i++) {
+    pthread_join(pool.workers[i].thread, NULL);
+  }
+
+  free(pool.workers);
+}
+
+/**
+ * @brief Returns the number of online CPUs.
+ *
+ * @return The number of CPUs, at least 1.
+ */
+int pool_default_threads() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return cpus < 1 ? 1 : (int)cpus;
+}
+
+/**
+ * @brief Packs a range of jobs into one word.
+ */
+static unsigned long long pack_range(unsigned int head, unsigned int tail) {
+  return (unsigned long long)tail << 32 | head;
+}
+
+/**
+ * @brief Takes the first job of the worker's own range.
+ *
+ * @param w The worker.
+ *
+ * @return The job or -1 if the range is empty.
+ */
+static int take_job(struct poolWorker *w) {
+  unsigned long long range = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+  unsigned int head;
+  unsigned int tail;
+
+  do {
+    head = (unsigned int)range;
+    tail = (unsigned int)(range >> 32);
+    if (head >= tail) {
+      return -1;
+    }
+  } while (!__atomic_compare_exchange_n(&w->range, &range,
+                                        pack_range(head + 1, tail), 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  return (int)head;
+}
+
+/**
+ * @brief Moves the upper half of another worker's jobs to the thief.
+ *
+ * The victims are tried in order starting after the thief. The thief's own
+ * range is empty when it steals, so nobody else updates it in the meantime.
+ *
+ * @param thief The worker without jobs.
+ *
+ * @return 1 if jobs were stolen, 0 if every worker has run out of jobs.
+ */
+static int steal_jobs(struct poolWorker *thief) {
+  struct pool *pool = thief->pool;
+  struct poolWorker *victim;
+  unsigned long long range;
+  unsigned int head;
+  unsigned int tail;
+  unsigned int half;
+  int i;
+
+  for (i = 1; i < pool->threads; i++) {
+    victim = &pool->workers[(thief->id + i) % pool->threads];
+    range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+      head = (unsigned int)range;
+      tail = (unsigned int)(range >> 32);
+      if (head >= tail) {
+        break;
+      }
+      half = (tail - head + 1) / 2;
+      if (__atomic_compare_exchange_n(&victim->range, &range,
+                                      pack_range(head, tail - half), 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&thief->range, pack_range(tail - half, tail),
+                         __ATOMIC_RELEASE);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Runs jobs until no worker has any left.
+ *
+ * @param worker The worker to run.
+ *
+ * @return NULL
+ */
+static void *run_worker(void *worker) {
+  struct poolWorker *w = worker;
+  int i;
+
+  do {
+    while ((i = take_job(w)) != -1) {
+      w->pool->job(i, w->id, w->pool->arg);
+    }
+  } while (steal_jobs(w));
+
+  return NULL;
+}
@@ -0,0 +1,26 @@
+/**
+  * @file pool.h
+  * @description A definition of the fixed-size thread pool used to run many
+  *              independent simulations in parallel.
+  */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+/*
+ * Runs job(i, worker, arg) for every i from 0 to jobs - 1 on threads threads
+ * and returns when all jobs have finished. worker is the number of the
+ * thread running the job, from 0 to threads - 1, so jobs can reuse per
+ * thread state. The jobs are split into one range per thread; a thread that
+ * runs out of jobs steals half of the remaining range of another thread. The
+ * calling thread is worker 0.
+ */
+void pool_run(int jobs, int threads,
+    void (*job)(int i, int worker, void *arg), void *arg);
+
+/*
+ * Returns the number of online CPUs, at least 1.
+ */
+int pool_default_threads();
+
+#endif
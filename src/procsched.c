@@ -0,0 +1,721 @@
+/**
+ * @file procsched.c
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "checkpoint.h"
+#include "image.h"
+#include "loader.h"
+#include "lockorder.h"
+#include "manager.h"
+#include "monitor.h"
+#include "pager.h"
+#include "parser.h"
+#include "procsched.h"
+#include "program.h"
+#include "realtime.h"
+#include "replay.h"
+#include "simulator.h"
+#include "table.h"
+#include "topic.h"
+
+int load_stream(struct simulator *sim, FILE *fptr);
+void free_view(struct simulator *sim);
+
+#ifdef DEBUG
+void debug_pcb(struct simulator *sim);
+#endif
+
+/**
+ * @brief Initialises an empty simulator.
+ *
+ * @param sim The simulator to initialise.
+ */
+void simulator_init(struct simulator *sim) {
+  sim->firstPCB = NULL;
+  sim->currentPCB = NULL;
+  sim->firstResource = NULL;
+  sim->currentResource = NULL;
+  sim->firstMailbox = NULL;
+  sim->currentMailbox = NULL;
+  sim->currentInstruction = NULL;
+  sim->currentProcessName = "";
+  sim->loadErrors = 0;
+  sim->firstSubroutine = NULL;
+  table_init(&sim->table, 0);
+  sim->resourceTable = NULL;
+  sim->mailboxTable = NULL;
+  sim->resourceSets = NULL;
+  sim->resourceSetNames = NULL;
+  sim->resourceSetCount = 0;
+  sim->resourceSetCapacity = 0;
+  sim->barriers = NULL;
+  sim->barrierNames = NULL;
+  sim->barrierCount = 0;
+  sim->barrierCapacity = 0;
+  sim->resourceCount = 0;
+  sim->mailboxCount = 0;
+  sim->topicCount = 0;
+  sim->image = NULL;
+  sim->mapping = NULL;
+  sim->mappingSize = 0;
+  sim->memoryBudget = 0;
+  sim->pager = NULL;
+  sim->trace = stdout;
+  sim->scheduleAlg = PROCSCHED_FCFS;
+  sim->quantum = 0;
+  sim->rwPolicy = PROCSCHED_WRITER_PREFERRING;
+  sim->checkpointFile = NULL;
+  sim->checkpointEvery = 0;
+  sim->nextCheckpoint = 0;
+  sim->checkpointRequest = NULL;
+  sim->recording = NULL;
+  sim->monitor = NULL;
+  sim->fingerprint = 0;
+  sim->instructionsExecuted = 0;
+  sim->idle = 0;
+  sim->horizon = 0;
+  sim->deadlockVictims = 0;
+  sim->deadlocks = 0;
+  sim->compiled = 0;
+  sim->finished = 0;
+}
+
+/**
+ * @brief Frees everything loaded into the simulator.
+ *
+ * Afterwards the simulator is empty again and keeps its trace stream and
+ * memory budget.
+ *
+ * @param sim The simulator to empty.
+ */
+void simulator_free(struct simulator *sim) {
+  FILE *trace = sim->trace;
+  size_t budget = sim->memoryBudget;
+
+  recording_stop(sim);
+  monitor_close(sim);
+  if (sim->image != NULL) {
+    free_view(sim);
+  } else if (sim->mapping != NULL) {
+    image_unload(sim);
+  } else {
+    dealloc_processes(sim);
+  }
+  dealloc_tables(sim);
+  simulator_init(sim);
+  sim->trace = trace;
+  sim->memoryBudget = budget;
+}
+
+/**
+ * @brief Creates an empty simulator.
+ *
+ * @return The simulator or NULL if it could not be allocated.
+ */
+struct simulator *procsched_create() {
+  struct simulator *sim = malloc(sizeof(struct simulator));
+
+  if (sim != NULL) {
+    simulator_init(sim);
+  }
+  return sim;
+}
+
+/**
+ * @brief Loads and compiles the process list in a file.
+ *
+ * A binary image written by procsched_save_image is recognised by its first
+ * bytes and mapped instead of parsed.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param filename The path of the process list.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_load_file(struct simulator *sim, const char *filename) {
+  FILE *fptr;
+  int status;
+
+  if (sim->firstPCB != NULL) {
+    return -1;
+  }
+  if (image_detect(filename)) {
+    return image_load(sim, filename);
+  }
+
+  fptr = fopen(filename, "r");
+  if (fptr == NULL) {
+    return -1;
+  }
+  status = load_stream(sim, fptr);
+  fclose(fptr);
+
+  return status;
+}
+
+/**
+ * @brief Sets the memory a binary image may use for its programs.
+ *
+ * An image loaded afterwards is paged: the programs stay in the file and
+ * blocks of ops are read into at most budget bytes of frames as the
+ * processes reach them. Process lists are always loaded whole.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param budget The budget in bytes, 0 to load images whole.
+ *
+ * @return 0 on success, -1 if the simulator already holds processes.
+ */
+int procsched_set_memory_budget(struct simulator *sim, size_t budget) {
+  if (sim->firstPCB != NULL) {
+    return -1;
+  }
+  sim->memoryBudget = budget;
+  return 0;
+}
+
+/**
+ * @brief Loads and compiles a process list held in memory.
+ *
+ * The buffer is read through a memory stream, so it is parsed by the same
+ * code as a file.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param buffer The text of the process list.
+ * @param size The length of the text in bytes.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_load_buffer(struct simulator *sim, const char *buffer,
+                          size_t size) {
+  FILE *fptr;
+  int status;
+
+  if (sim->firstPCB != NULL || size == 0) {
+    return -1;
+  }
+
+  /* The stream is only read, so the buffer is never written through it */
+  fptr = fmemopen((void *)buffer, size, "r");
+  if (fptr == NULL) {
+    return -1;
+  }
+  status = load_stream(sim, fptr);
+  fclose(fptr);
+
+  return status;
+}
+
+/**
+ * @brief Parses a process list from a stream and compiles the processes.
+ *
+ * @param sim The simulator to load the processes into.
+ * @param fptr The stream to read.
+ *
+ * @return 0 on success, -1 if the stream declared no processes or has an
+ * instruction outside a process section.
+ */
+int load_stream(struct simulator *sim, FILE *fptr) {
+  if (parse_process_stream(sim, fptr) != 0 || sim->firstPCB == NULL) {
+    simulator_free(sim);
+    return -1;
+  }
+
+  compile_processes(sim);
+  realtime_reset(sim);
+  sim->compiled = 1;
+
+#ifdef DEBUG
+  debug_pcb(sim);
+#endif
+
+  return 0;
+}
+
+/**
+ * @brief Saves the compiled processes as a binary image.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the image.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_save_image(struct simulator *sim, const char *filename) {
+  return image_save(sim, filename);
+}
+
+/**
+ * @brief Creates a view of a loaded simulator.
+ *
+ * The view shares the pages, ops and names of the image and copies the
+ * process control blocks, resources and mailboxes into three arrays, linked
+ * in the same order as in the image so that every process, resource and
+ * mailbox keeps its number. Only the names and compiled ops of the image are
+ * read, so views of one image can be created and run on different threads.
+ *
+ * @param image A simulator with loaded processes.
+ *
+ * @return The view or NULL if the image holds no processes, is paged or
+ * memory ran out.
+ */
+struct simulator *procsched_view(const struct simulator *image) {
+  struct simulator *view;
+  struct processControlBlock *pcb;
+  struct processControlBlock *pcbs;
+  struct resourceList *resource;
+  struct resourceList *resources;
+  struct mailbox *mail;
+  struct mailbox *mailboxes;
+  int i;
+
+  if (!image->compiled || image->pager != NULL ||
+      (view = procsched_create()) == NULL) {
+    return NULL;
+  }
+  view->image = image;
+  view->trace = image->trace;
+  view->rwPolicy = image->rwPolicy;
+  view->horizon = image->horizon;
+  view->resourceCount = image->resourceCount;
+  view->mailboxCount = image->mailboxCount;
+  view->topicCount = image->topicCount;
+  view->resourceSets = image->resourceSets;
+  view->resourceSetCount = image->resourceSetCount;
+  view->barriers = image->barriers;
+  view->barrierCount = image->barrierCount;
+
+  pcbs = malloc(sizeof(struct processControlBlock) * image->table.count);
+  resources = image->resourceCount > 0
+                  ? malloc(sizeof(struct resourceList) * image->resourceCount)
+                  : NULL;
+  mailboxes = image->mailboxCount > 0
+                  ? malloc(sizeof(struct mailbox) * image->mailboxCount)
+                  : NULL;
+  view->resourceTable =
+      malloc(sizeof(struct resourceList *) * (image->resourceCount + 1));
+  view->mailboxTable =
+      malloc(sizeof(struct mailbox *) * (image->mailboxCount + 1));
+  if (pcbs == NULL || (resources == NULL && image->resourceCount > 0) ||
+      (mailboxes == NULL && image->mailboxCount > 0) ||
+      view->resourceTable == NULL || view->mailboxTable == NULL) {
+    free(pcbs);
+    free(resources);
+    free(mailboxes);
+    procsched_destroy(view);
+    return NULL;
+  }
+  /* The arrays are freed through the heads of the lists */
+  view->firstPCB = pcbs;
+  view->firstResource = resources;
+  view->firstMailbox = mailboxes;
+
+  i = 0;
+  for (resource = image->firstResource; resource != NULL;
+       resource = resource->next) {
+    resources[i].name = resource->name;
+    resources[i].number = i;
+    resources[i].capacity = resource->capacity;
+    resources[i].protocol = resource->protocol;
+    resources[i].ceiling = resource->ceiling;
+    resources[i].readers = resources[i].wokenReaders = 0;
+    resources[i].holder = -1;
+    resources[i].resource = NULL;
+    resources[i].holderIndex = NULL;
+    resources[i].holderSlots = resources[i].holderCount = 0;
+    resources[i].next = resource->next != NULL ? &resources[i + 1] : NULL;
+    view->resourceTable[i] = &resources[i];
+    ++i;
+  }
+
+  i = 0;
+  for (mail = image->firstMailbox; mail != NULL; mail = mail->next) {
+    init_mailbox(&mailboxes[i], mail->name, mail->capacity);
+    if (mail->topic != NULL) {
+      topic_init(&mailboxes[i], mail->topic->policy);
+    }
+    mailboxes[i].next = mail->next != NULL ? &mailboxes[i + 1] : NULL;
+    view->mailboxTable[i] = &mailboxes[i];
+    ++i;
+  }
+
+  table_init(&view->table, image->table.count);
+  i = 0;
+  for (pcb = image->firstPCB; pcb != NULL; pcb = pcb->next) {
+    pcbs[i].pagePtr = pcb->pagePtr;
+    pcbs[i].resourceListPtr = NULL;
+    pcbs[i].spareResources = NULL;
+    pcbs[i].next = pcb->next != NULL ? &pcbs[i + 1] : NULL;
+    table_add(&view->table, &pcbs[i]);
+    ++i;
+  }
+  table_init_wait_queues(&view->table, view->resourceCount,
+                         view->mailboxCount);
+  table_init_barriers(&view->table, view->barrierCount);
+  table_init_loops(&view->table);
+  table_init_timers(&view->table);
+
+  view->compiled = 1;
+  procsched_reset(view);
+
+  return view;
+}
+
+/**
+ * @brief Returns a simulator to the state it had right after loading.
+ *
+ * Every resource becomes available, every mailbox empty and every process
+ * ready at its first instruction, or sleeping until the release of its
+ * first job, and the statistics start from zero, so the processes can be
+ * scheduled again without loading them again.
+ *
+ * @param sim A simulator with loaded processes or a view.
+ *
+ * @return 0 on success, -1 if nothing was loaded.
+ */
+int procsched_reset(struct simulator *sim) {
+  struct processControlBlock *pcb;
+  struct resourceList *resource;
+  struct resourceList *held;
+  struct mailbox *mail;
+
+  if (!sim->compiled) {
+    return -1;
+  }
+
+  for (resource = sim->firstResource; resource != NULL;
+       resource = resource->next) {
+    resource->available = resource->capacity;
+    resource->readers = resource->wokenReaders = 0;
+    clear_holders(resource);
+  }
+  for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+    if (mail->topic != NULL) {
+      topic_reset(mail);
+    } else {
+      mailbox_drop(mail, mail->count);
+    }
+  }
+  for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+    /* The holders of the resources were cleared above, so the instances
+     * are kept for the next run without unlinking them one by one */
+    while ((held = pcb->resourceListPtr) != NULL) {
+      pcb->resourceListPtr = held->next;
+      held->next = pcb->spareResources;
+      pcb->spareResources = held;
+    }
+    pcb->stats.executed = 0;
+    pcb->stats.waits = 0;
+    pcb->stats.slices = 0;
+    pcb->stats.jobs = 0;
+    pcb->stats.missed = 0;
+    pcb->stats.worstResponse = 0;
+  }
+  table_reset(&sim->table);
+  realtime_reset(sim);
+  refresh_available_bits(sim);
+
+  sim->instructionsExecuted = 0;
+  sim->idle = 0;
+  sim->deadlockVictims = 0;
+  sim->deadlocks = 0;
+  sim->nextCheckpoint = sim->checkpointEvery;
+  sim->finished = 0;
+
+  return 0;
+}
+
+/**
+ * @brief Frees the state a view owns.
+ *
+ * @param sim The view.
+ */
+void free_view(struct simulator *sim) {
+  struct processControlBlock *pcb;
+  struct resourceList *resource;
+  struct mailbox *mail;
+
+  for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+    dealloc_resourceList(pcb->resourceListPtr);
+    dealloc_resourceList(pcb->spareResources);
+  }
+  for (resource = sim->firstResource; resource != NULL;
+       resource = resource->next) {
+    free(resource->holderIndex);
+  }
+  for (mail = sim->firstMailbox; mail != NULL; mail = mail->next) {
+    free_mailbox(mail);
+  }
+  free(sim->firstPCB);
+  free(sim->firstResource);
+  free(sim->firstMailbox);
+  table_free(&sim->table);
+}
+
+/**
+ * @brief Sets the stream the trace is written to, NULL suppresses it.
+ *
+ * @param sim The simulator.
+ * @param trace The trace stream.
+ */
+void procsched_set_trace(struct simulator *sim, FILE *trace) {
+  sim->trace = trace;
+}
+
+/**
+ * @brief Sets how shared and exclusive requests of a resource take turns.
+ *
+ * @param sim The simulator.
+ * @param policy PROCSCHED_WRITER_PREFERRING or PROCSCHED_FAIR.
+ *
+ * @return 0 on success, -1 for an unknown policy.
+ */
+int procsched_set_rw_policy(struct simulator *sim, int policy) {
+  if (policy != PROCSCHED_WRITER_PREFERRING && policy != PROCSCHED_FAIR) {
+    return -1;
+  }
+  sim->rwPolicy = policy;
+  return 0;
+}
+
+/**
+ * @brief Schedules the loaded processes until all of them have terminated.
+ *
+ * @param sim The simulator.
+ * @param schedule_alg PROCSCHED_FCFS, PROCSCHED_RR, PROCSCHED_PRIORITY,
+ * PROCSCHED_EDF or PROCSCHED_RM.
+ * @param quantum The time slice in instructions.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_run(struct simulator *sim, int schedule_alg, int quantum) {
+  if (!sim->compiled || sim->finished) {
+    return -1;
+  }
+  if (schedule_alg < PROCSCHED_FCFS || schedule_alg > PROCSCHED_RM) {
+    return -1;
+  }
+
+  sim->scheduleAlg = schedule_alg;
+  sim->quantum = quantum;
+  schedule_processes(sim, schedule_alg, quantum);
+  sim->finished = 1;
+  recording_stop(sim);
+  if (sim->monitor != NULL) {
+    monitor_publish(sim);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Sets the horizon of the periodic processes.
+ *
+ * The release of the first jobs does not depend on it, so only the time
+ * the processes terminate changes.
+ *
+ * @param sim The simulator.
+ * @param ticks The horizon, 0 for realtime_horizon.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_set_horizon(struct simulator *sim, long long ticks) {
+  if (!sim->compiled || sim->finished || ticks < 0 ||
+      ticks > LLONG_MAX / 2) {
+    return -1;
+  }
+  sim->horizon = ticks > 0 ? ticks : realtime_horizon(sim);
+  return 0;
+}
+
+/**
+ * @brief Tests whether the periodic processes meet their deadlines.
+ *
+ * @param sim The simulator.
+ * @param schedule_alg PROCSCHED_EDF or PROCSCHED_RM.
+ * @param out The stream the analysis is written to.
+ *
+ * @return 1 if schedulable, 0 if not, -1 on failure.
+ */
+int procsched_analyze(const struct simulator *sim, int schedule_alg,
+                      FILE *out) {
+  if (!sim->compiled) {
+    return -1;
+  }
+  return realtime_analyze(sim, schedule_alg, out);
+}
+
+/**
+ * @brief Reports the lock order cycles of the loaded processes and the
+ * processes that end holding resources.
+ *
+ * @param sim The simulator.
+ * @param out The stream the report is written to.
+ *
+ * @return The number of cycles and processes reported, -1 on failure.
+ */
+int procsched_lock_order(struct simulator *sim, FILE *out) {
+  if (!sim->compiled) {
+    return -1;
+  }
+  return lockorder_analyze(sim, out);
+}
+
+/**
+ * @brief Makes procsched_run write checkpoints while it runs.
+ *
+ * @param sim The simulator.
+ * @param filename The checkpoint, replaced by every new one, or NULL to stop
+ * writing checkpoints. It must stay valid while the simulator runs.
+ * @param every The number of instructions between checkpoints, 0 for none.
+ * @param request A flag that requests a checkpoint when set, or NULL.
+ */
+void procsched_set_checkpoint(struct simulator *sim, const char *filename,
+                              long long every,
+                              volatile sig_atomic_t *request) {
+  sim->checkpointFile = filename;
+  sim->checkpointEvery = every > 0 ? every : 0;
+  sim->nextCheckpoint = sim->instructionsExecuted + sim->checkpointEvery;
+  sim->checkpointRequest = request;
+}
+
+/**
+ * @brief Publishes the counters of the simulator to a shared memory
+ *        segment.
+ *
+ * @param sim The simulator.
+ * @param name The name of the segment.
+ * @param stop The signal to stop on, or NULL.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_set_monitor(struct simulator *sim, const char *name,
+                          volatile sig_atomic_t *stop) {
+  return monitor_open(sim, name, stop);
+}
+
+/**
+ * @brief Writes a checkpoint of the simulator.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the checkpoint.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_checkpoint(struct simulator *sim, const char *filename) {
+  return checkpoint_write(sim, filename);
+}
+
+/**
+ * @brief Restores a checkpoint so that procsched_run continues the saved
+ *        run.
+ *
+ * @param sim A simulator holding the workload of the checkpoint.
+ * @param filename The path of the checkpoint.
+ * @param schedule_alg Set to the algorithm of the saved run.
+ * @param quantum Set to the time slice of the saved run.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_restore(struct simulator *sim, const char *filename,
+                      int *schedule_alg, int *quantum) {
+  return checkpoint_restore(sim, filename, schedule_alg, quantum);
+}
+
+/**
+ * @brief Records the scheduling decisions of the next procsched_run.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the recording.
+ * @param snapshot_every The number of instructions between snapshots.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_record(struct simulator *sim, const char *filename,
+                     long long snapshot_every) {
+  return recording_start(sim, filename, snapshot_every);
+}
+
+/**
+ * @brief Replays a recording and traces it from a chosen event on.
+ *
+ * @param sim A simulator holding the recorded workload.
+ * @param filename The path of the recording.
+ * @param seek What to seek to, see procsched.h.
+ * @param n The event index or deadlock number.
+ * @param process The name of the process for PROCSCHED_SEEK_PROCESS.
+ * @param trace The stream the trace goes to from the target on.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_replay(struct simulator *sim, const char *filename, int seek,
+                     long long n, const char *process, FILE *trace) {
+  if (seek != PROCSCHED_SEEK_EVENT && seek != PROCSCHED_SEEK_PROCESS &&
+      seek != PROCSCHED_SEEK_DEADLOCK) {
+    return -1;
+  }
+  return recording_replay(sim, filename, seek, n, process, trace);
+}
+
+/**
+ * @brief Sums the statistics of the processes.
+ *
+ * @param sim The simulator.
+ * @param stats Filled with the statistics.
+ */
+void procsched_get_stats(struct simulator *sim, struct procschedStats *stats) {
+  struct processControlBlock *pcb;
+
+  stats->processes = sim->table.count;
+  stats->terminated = sim->table.terminatedQueue.n;
+  stats->deadlockVictims = sim->deadlockVictims;
+  stats->instructions = sim->instructionsExecuted;
+  stats->waits = 0;
+  stats->slices = 0;
+  stats->pageFaults = sim->pager != NULL ? sim->pager->faults : 0;
+  stats->jobs = 0;
+  stats->deadlineMisses = 0;
+  for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+    stats->waits += pcb->stats.waits;
+    stats->slices += pcb->stats.slices;
+    stats->jobs += pcb->stats.jobs;
+    stats->deadlineMisses += pcb->stats.missed;
+  }
+}
+
+/**
+ * @brief Frees the simulator and everything loaded into it.
+ *
+ * @param sim The simulator, may be NULL.
+ */
+void procsched_destroy(struct simulator *sim) {
+  if (sim == NULL) {
+    return;
+  }
+  simulator_free(sim);
+  free(sim);
+}
+
+#ifdef DEBUG
+void debug_pcb(struct simulator *sim) {
+  struct processControlBlock *debug;
+  struct processTable *table = &sim->table;
+  struct op *debugOp;
+
+  debug = sim->firstPCB;
+  do {
+    printf("PCB %s\n", debug->pagePtr->name);
+    printf("State: %d\n", table->state[debug->pagePtr->number]);
+    for (debugOp = table->nextOp[debug->pagePtr->number];
+         debugOp != NULL && debugOp->type != END_V &&
+         debugOp->type != PAGE_V;
+         debugOp++) {
+      printf("(%d, %s, %s)\n", debugOp->type, debugOp->name,
+             debugOp->msg != NULL ? debugOp->msg->text : NULL);
+    }
+
+    debug = debug->next;
+  } while (debug != NULL);
+}
+#endif
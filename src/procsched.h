@@ -0,0 +1,406 @@
+/**
+  * @file procsched.h
+  * @description The public interface of libprocsched, which loads process
+  *              lists and schedules them without any global state. Every
+  *              simulation lives in its own simulator handle, so a program
+  *              can run any number of simulations, one after another or at
+  *              the same time on different threads. A single handle must
+  *              not be used by two threads at once.
+  */
+
+#ifndef _PROCSCHED_H
+#define _PROCSCHED_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** Schedule the processes first come first serve */
+#define PROCSCHED_FCFS 0
+/** Schedule the processes round robin */
+#define PROCSCHED_RR 1
+/** Schedule the most urgent ready process first, preempting a less urgent
+ * one as soon as a more urgent process becomes ready, and processes of equal
+ * priority round robin */
+#define PROCSCHED_PRIORITY 2
+/** Like PROCSCHED_PRIORITY, but the job of a periodic process with the
+ * earliest deadline is the most urgent, and processes that are not periodic
+ * only run when no job is ready */
+#define PROCSCHED_EDF 3
+/** Like PROCSCHED_EDF, but the periodic process with the shortest period is
+ * the most urgent */
+#define PROCSCHED_RM 4
+
+/** Shared requests wait while an exclusive request waits, woken writers go
+ * before waiting readers */
+#define PROCSCHED_WRITER_PREFERRING 0
+/** Like PROCSCHED_WRITER_PREFERRING, but waiting readers go before waiting
+ * writers, so neither starves */
+#define PROCSCHED_FAIR 1
+
+/** Replay up to the event with a given index */
+#define PROCSCHED_SEEK_EVENT 0
+/** Replay up to the first time slice of a given process */
+#define PROCSCHED_SEEK_PROCESS 1
+/** Replay up to a given deadlock */
+#define PROCSCHED_SEEK_DEADLOCK 2
+
+/**
+ * An opaque simulation handle.
+ */
+struct simulator;
+
+/**
+ * The statistics of a simulation.
+ */
+struct procschedStats {
+  /** The number of loaded processes */
+  int processes;
+  /** The number of processes that have terminated */
+  int terminated;
+  /** The number of processes terminated to recover from a deadlock */
+  int deadlockVictims;
+  /** The number of completed instructions */
+  long long instructions;
+  /** The number of times a process had to wait for a resource */
+  long long waits;
+  /** The number of time slices the processes have run */
+  long long slices;
+  /** The number of blocks of ops paged in, 0 unless paged */
+  long long pageFaults;
+  /** The number of jobs of periodic processes released */
+  long long jobs;
+  /** The number of those jobs that completed after their deadline */
+  long long deadlineMisses;
+};
+
+/**
+ * @brief Creates an empty simulator.
+ *
+ * The simulator writes its trace to stdout until procsched_set_trace
+ * redirects it.
+ *
+ * @return The simulator or NULL if it could not be allocated.
+ */
+struct simulator *procsched_create();
+
+/**
+ * @brief Loads and compiles the process list in a file.
+ *
+ * The file may also be a binary image saved with procsched_save_image,
+ * which is mapped into memory and runs without being parsed.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param filename The path of the process list.
+ *
+ * @return 0 on success, -1 if the simulator already holds processes, the
+ * file could not be opened, it is an invalid image or it declares no
+ * processes or has an instruction outside a Process section, which is
+ * reported with its line. The simulator is empty again after a failure.
+ */
+int procsched_load_file(struct simulator *sim, const char *filename);
+
+/**
+ * @brief Sets the memory a binary image may use for its programs.
+ *
+ * An image loaded afterwards is paged: its programs are read from the file
+ * in blocks as the processes reach them and evicted again when the frames
+ * are full, so workloads larger than the memory can be scheduled. Paged
+ * simulators cannot be viewed or saved as an image. Process lists are
+ * always loaded whole; compile them into an image first.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param budget The budget in bytes, 0 to map images whole.
+ *
+ * @return 0 on success, -1 if the simulator already holds processes.
+ */
+int procsched_set_memory_budget(struct simulator *sim, size_t budget);
+
+/**
+ * @brief Loads and compiles a process list held in memory.
+ *
+ * @param sim The simulator, which must be empty.
+ * @param buffer The text of the process list, it is not modified.
+ * @param size The length of the text in bytes.
+ *
+ * @return 0 on success, -1 if the simulator already holds processes, the
+ * buffer could not be read or, like a file, does not parse.
+ */
+int procsched_load_buffer(struct simulator *sim, const char *buffer,
+    size_t size);
+
+/**
+ * @brief Saves the compiled processes as a binary image.
+ *
+ * The image holds the compiled programs and interned names and is only
+ * valid for the version of the library and the word size that wrote it;
+ * other images are rejected when loaded.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the image.
+ *
+ * @return 0 on success, -1 if nothing was loaded, the image is paged or the
+ * file could not be written.
+ */
+int procsched_save_image(struct simulator *sim, const char *filename);
+
+/**
+ * @brief Creates a view of a loaded simulator.
+ *
+ * A view runs the processes of its image without loading them again: it
+ * shares the parsed and compiled programs of the image, which never change,
+ * and has its own copy of the state a run changes. Views of one image can be
+ * created and run on different threads. The image must not be destroyed
+ * before its views and no more processes can be loaded into a view.
+ *
+ * @param image A simulator with loaded processes.
+ *
+ * @return The view, ready to run, or NULL on failure.
+ */
+struct simulator *procsched_view(const struct simulator *image);
+
+/**
+ * @brief Returns a simulator or view to its state right after loading, so
+ *        that the processes can be scheduled again.
+ *
+ * @param sim The simulator.
+ *
+ * @return 0 on success, -1 if nothing was loaded.
+ */
+int procsched_reset(struct simulator *sim);
+
+/**
+ * @brief Sets the stream the per-instruction trace is written to.
+ *
+ * @param sim The simulator.
+ * @param trace The stream, or NULL to suppress the trace.
+ */
+void procsched_set_trace(struct simulator *sim, FILE *trace);
+
+/**
+ * @brief Sets how shared (reqs) and exclusive (req, reqx) requests of a
+ * resource take turns.
+ *
+ * Under both policies a shared request waits while an exclusive request of
+ * the resource waits, so writers do not starve, and the readers woken by a
+ * release are woken all at once. On a release PROCSCHED_WRITER_PREFERRING
+ * wakes a waiting writer before the waiting readers, PROCSCHED_FAIR wakes
+ * the waiting readers first and makes new writers wait for them. A view
+ * starts with the policy of its image, a restored checkpoint or replayed
+ * recording brings its own.
+ *
+ * @param sim The simulator.
+ * @param policy PROCSCHED_WRITER_PREFERRING, the default, or
+ * PROCSCHED_FAIR.
+ *
+ * @return 0 on success, -1 for an unknown policy.
+ */
+int procsched_set_rw_policy(struct simulator *sim, int policy);
+
+/**
+ * @brief Sets when periodic processes stop.
+ *
+ * A process named P@period in the process list is periodic: it runs its
+ * program once per job, one job every period, and terminates after the last
+ * job that arrives before the horizon. Time is counted in ticks, one per
+ * executed instruction, and passes while every process sleeps.
+ *
+ * @param sim A simulator with loaded processes that has not run.
+ * @param ticks The horizon, 0 for the default: the least common multiple of
+ * the periods, at most 1000 times the longest period.
+ *
+ * @return 0 on success, -1 if nothing was loaded, it has run or ticks is
+ * negative or above LLONG_MAX / 2.
+ */
+int procsched_set_horizon(struct simulator *sim, long long ticks);
+
+/**
+ * @brief Tests whether the jobs of the periodic processes meet their
+ * deadlines.
+ *
+ * The cost of a job is the number of instructions of the program, and the
+ * test ignores waiting for resources, mailboxes and barriers. Rate
+ * monotonic scheduling gets a response time analysis and earliest deadline
+ * first a utilization or density test. One line per periodic process and
+ * the verdict are written to out.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param schedule_alg PROCSCHED_EDF or PROCSCHED_RM.
+ * @param out The stream the analysis is written to.
+ *
+ * @return 1 if the processes are schedulable, 0 if a job may miss its
+ * deadline, -1 if nothing was loaded or schedule_alg is neither.
+ */
+int procsched_analyze(const struct simulator *sim, int schedule_alg,
+    FILE *out);
+
+/**
+ * @brief Finds the deadlocks the loaded processes can run into without
+ * running them.
+ *
+ * Every process that requests a resource while it holds another orders the
+ * two, and the processes can only deadlock over resources if different
+ * processes make the orders of a cycle. Each such cycle is written to out
+ * with the process for each of its orders, then every process that ends
+ * holding a resource other processes request, followed by the verdict.
+ * Waits for mailboxes, barriers and unknown resources are not taken into
+ * account, and paged programs are paged in to be read.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param out The stream the report is written to.
+ *
+ * @return The number of cycles plus the number of processes that end
+ * holding resources, 0 if the processes cannot deadlock over resources, -1
+ * if nothing was loaded or memory ran out.
+ */
+int procsched_lock_order(struct simulator *sim, FILE *out);
+
+/**
+ * @brief Schedules the loaded processes until all of them have terminated.
+ *
+ * @param sim The simulator.
+ * @param schedule_alg PROCSCHED_FCFS, PROCSCHED_RR, PROCSCHED_PRIORITY,
+ * PROCSCHED_EDF or PROCSCHED_RM.
+ * @param quantum The number of instructions a process runs before it is
+ * preempted under round robin, or by an equally urgent process under the
+ * other algorithms but first come first serve, where 0 lets it run until
+ * it waits.
+ *
+ * @return 0 on success, -1 if nothing was loaded, the processes have already
+ * been scheduled since loading or the last procsched_reset, or schedule_alg
+ * is unknown.
+ */
+int procsched_run(struct simulator *sim, int schedule_alg, int quantum);
+
+/**
+ * @brief Makes procsched_run write checkpoints of the simulation.
+ *
+ * A checkpoint holds the complete state of the run and replaces the previous
+ * one atomically. It is written at the end of the time slice in which every
+ * instructions have completed since the last one, or in which the request
+ * flag was found set; the flag is cleared again. Setting the flag from a
+ * signal handler checkpoints a run on demand.
+ *
+ * @param sim The simulator.
+ * @param filename The path of the checkpoint, or NULL to stop checkpointing.
+ * The string must stay valid while the simulator runs.
+ * @param every The number of instructions between checkpoints, 0 for none.
+ * @param request A flag requesting a checkpoint, or NULL.
+ */
+void procsched_set_checkpoint(struct simulator *sim, const char *filename,
+    long long every, volatile sig_atomic_t *request);
+
+/**
+ * @brief Publishes live counters of the simulation to a POSIX shared memory
+ * segment, see src/monitor.h for its layout and tools/procsched-top.
+ *
+ * While the simulator runs the counters are published at most every 10 ms
+ * and once more when the run ends. The segment is removed when the
+ * simulator is freed. Loading a workload into the simulator stops the
+ * monitor, so call this after loading.
+ *
+ * A handler of e.g. SIGTERM that stores its signal number in stop makes the
+ * running simulator remove the segment and raise the signal again with its
+ * default action within 64 time slices, so a killed run does not leave the
+ * segment behind.
+ *
+ * @param sim The simulator.
+ * @param name The name of the segment, e.g. "/procsched", replaced if it
+ * exists.
+ * @param stop The signal to stop on, or NULL.
+ *
+ * @return 0 on success, -1 if the segment could not be created.
+ */
+int procsched_set_monitor(struct simulator *sim, const char *name,
+    volatile sig_atomic_t *stop);
+
+/**
+ * @brief Writes a checkpoint of a simulator that is not running.
+ *
+ * @param sim The simulator.
+ * @param filename The path of the checkpoint.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int procsched_checkpoint(struct simulator *sim, const char *filename);
+
+/**
+ * @brief Restores the state saved in a checkpoint.
+ *
+ * The simulator must hold the same workload as the simulator that wrote the
+ * checkpoint, loaded from the process list or from an image of it.
+ * Calling procsched_run with the returned algorithm and time slice then
+ * continues the saved run exactly: it executes and traces the same
+ * instructions and ends with the same statistics as the uninterrupted run.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the checkpoint.
+ * @param schedule_alg Set to the scheduling algorithm of the saved run.
+ * @param quantum Set to the time slice of the saved run.
+ *
+ * @return 0 on success, -1 if the checkpoint could not be read, is corrupt or
+ * belongs to a different workload, in which case the simulator is reset.
+ */
+int procsched_restore(struct simulator *sim, const char *filename,
+    int *schedule_alg, int *quantum);
+
+/**
+ * @brief Records the scheduling decisions of the next procsched_run.
+ *
+ * Every time slice, deadlock and deadlock victim is an event and gets a few
+ * bytes in the recording, numbered from 0 in the order they happen. The
+ * recording also holds a snapshot of the state at the start and then every
+ * snapshot_every instructions, so a replay can start close to any event.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the recording.
+ * @param snapshot_every The number of instructions between snapshots, 0 for
+ * only the first one.
+ *
+ * @return 0 on success, -1 if nothing was loaded or the file could not be
+ * created.
+ */
+int procsched_record(struct simulator *sim, const char *filename,
+    long long snapshot_every);
+
+/**
+ * @brief Replays a recording and traces it from a chosen event on.
+ *
+ * The run restarts from the last snapshot before the target and continues
+ * without a trace until the target, from where the trace and one line per
+ * event are written to trace. The replay is checked against the recording
+ * event by event.
+ *
+ * @param sim A simulator holding the recorded workload, it must not be
+ * running.
+ * @param filename The path of the recording.
+ * @param seek PROCSCHED_SEEK_EVENT to seek to the event with index n,
+ * PROCSCHED_SEEK_PROCESS to the first time slice of process or
+ * PROCSCHED_SEEK_DEADLOCK to the n-th deadlock, counting from 1.
+ * @param n The event index or the deadlock number.
+ * @param process The name of the process, only used with
+ * PROCSCHED_SEEK_PROCESS.
+ * @param trace The stream for the trace from the target on, or NULL.
+ *
+ * @return 0 on success, -1 if the recording does not belong to the workload
+ * or does not contain the target, or if the replay diverged from it.
+ */
+int procsched_replay(struct simulator *sim, const char *filename, int seek,
+    long long n, const char *process, FILE *trace);
+
+/**
+ * @brief Returns the statistics of the simulation.
+ *
+ * @param sim The simulator.
+ * @param stats Filled with the statistics.
+ */
+void procsched_get_stats(struct simulator *sim, struct procschedStats *stats);
+
+/**
+ * @brief Frees the simulator and everything loaded into it.
+ *
+ * @param sim The simulator, may be NULL.
+ */
+void procsched_destroy(struct simulator *sim);
+
+#endif
@@ -0,0 +1,789 @@
+/**
+ * @file program.c
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loader.h"
+#include "manager.h"
+#include "names.h"
+#include "program.h"
+#include "simulator.h"
+#include "syntax.h"
+#include "table.h"
+
+/**
+ * The state of compiling the instructions of one process.
+ */
+struct compiler {
+  /** The simulator holding the subroutines */
+  struct simulator *sim;
+  /** Maps resource names to resource table indices */
+  struct nameTable *resourceNames;
+  /** Maps mailbox names to mailbox table indices */
+  struct nameTable *mailboxNames;
+  /** The code address of each op type, or NULL */
+  const void *const *handlers;
+  /** The ops compiled so far */
+  struct op *program;
+  /** The number of ops compiled so far */
+  int length;
+  /** The number of ops the program has room for */
+  int capacity;
+  /** The maximum number of nested loops so far */
+  int nesting;
+  /** Set while a subroutine is expanded, its names are copied */
+  int copy;
+};
+
+struct op *compile_instructions(struct simulator *sim,
+                                struct instruction *first,
+                                struct nameTable *resourceNames,
+                                struct nameTable *mailboxNames,
+                                const void *const *handlers, int *nesting);
+static void compile_block(struct compiler *c, struct instruction **i,
+                          int depth, int block);
+static void compile_call(struct compiler *c, struct instruction *call,
+                         int depth);
+static int compile_resource_set(struct compiler *c, const char *list);
+static int compile_barrier(struct compiler *c, const char *name,
+                           const char *parties);
+static int compare_numbers(const void *a, const void *b);
+static void raise_ceilings(struct simulator *sim, const struct op *program,
+                           int priority);
+static struct op *emit(struct compiler *c, int type, int operand, char *name,
+                       struct message *msg);
+static char *take_string(struct compiler *c, char **string);
+
+
+/**
+ * @brief Compiles the instructions of every loaded process.
+ *
+ * Numbers the resources and mailboxes in list order and stores them in the
+ * resource and mailbox tables. Each process's linked list of instructions is
+ * then replaced by a contiguous array of ops in its page, with the names
+ * resolved to table indices through a hash table, and the process's next op
+ * in the process table is set to the start of the array. A resource name
+ * that occurs more than once resolves to its first instance, and a list of
+ * resources requested at once to a resource set. Finally every resource and
+ * every barrier gets a wait queue in the process table.
+ *
+ * @param sim The simulator holding the loaded processes.
+ */
+void compile_processes(struct simulator *sim) {
+  struct nameTable resourceNames;
+  struct nameTable mailboxNames;
+  struct processControlBlock *pcb;
+
+  compile_tables(sim, &resourceNames, &mailboxNames);
+  for (pcb = sim->firstPCB; pcb != NULL; pcb = pcb->next) {
+    compile_process(sim, pcb, &resourceNames, &mailboxNames);
+  }
+  dealloc_subroutines(sim);
+  table_init_wait_queues(&sim->table, sim->resourceCount,
+                         sim->mailboxCount);
+  table_init_barriers(&sim->table, sim->barrierCount);
+  table_init_loops(&sim->table);
+  table_init_timers(&sim->table);
+  refresh_available_bits(sim);
+
+  names_free(&resourceNames);
+  names_free(&mailboxNames);
+}
+
+/**
+ * @brief Numbers the loaded resources and mailboxes.
+ *
+ * Stores the resources and mailboxes in list order in the resource and
+ * mailbox tables of the simulator and maps their names to their numbers.
+ * A resource named more than once is one counted resource with the
+ * instances of all its entries, so "R1 R1" is the same as "R1:2".
+ *
+ * @param sim The simulator holding the resources and mailboxes.
+ * @param resourceNames Initialised with the resource names, free it with
+ * names_free.
+ * @param mailboxNames Initialised with the mailbox names.
+ */
+void compile_tables(struct simulator *sim, struct nameTable *resourceNames,
+                    struct nameTable *mailboxNames) {
+  struct resourceList **resourceTable;
+  struct mailbox **mailboxTable;
+  struct resourceList **link;
+  struct resourceList *r;
+  struct mailbox *m;
+  int resources;
+  int first;
+  int count;
+
+  count = 0;
+  for (r = sim->firstResource; r != NULL; r = r->next) {
+    ++count;
+  }
+  resourceTable = malloc(sizeof(struct resourceList *) * (count + 1));
+  names_init(resourceNames, count);
+  count = 0;
+  for (link = &sim->firstResource; (r = *link) != NULL;) {
+    first = names_find(resourceNames, r->name);
+    if (first < 0) {
+      resourceTable[count] = r;
+      r->number = count;
+      names_insert(resourceNames, r->name, count++);
+      sim->currentResource = r;
+      link = &r->next;
+      continue;
+    }
+    /* A repeated name adds its instances to the first resource */
+    resourceTable[first]->capacity =
+        r->capacity < INT_MAX - resourceTable[first]->capacity
+            ? resourceTable[first]->capacity + r->capacity
+            : INT_MAX;
+    resourceTable[first]->available = resourceTable[first]->capacity;
+    *link = r->next;
+    free(r->name);
+    free(r);
+  }
+  resources = count;
+
+  count = 0;
+  for (m = sim->firstMailbox; m != NULL; m = m->next) {
+    ++count;
+  }
+  mailboxTable = malloc(sizeof(struct mailbox *) * (count + 1));
+  names_init(mailboxNames, count);
+  count = 0;
+  sim->topicCount = 0;
+  for (m = sim->firstMailbox; m != NULL; m = m->next) {
+    mailboxTable[count] = m;
+    names_insert(mailboxNames, m->name, count++);
+    sim->topicCount += m->topic != NULL;
+  }
+
+  sim->resourceTable = resourceTable;
+  sim->mailboxTable = mailboxTable;
+  sim->resourceCount = resources;
+  sim->mailboxCount = count;
+}
+
+/**
+ * @brief Compiles the instructions of one process.
+ *
+ * Replaces the process's linked list of instructions by its program and sets
+ * its next op in the process table to the start of the program. A periodic
+ * process also gets the cost of one job. The ceiling of every resource the
+ * program requests is raised to the base priority of the process.
+ *
+ * @param sim The simulator holding the process and the subroutines.
+ * @param pcb The process.
+ * @param resourceNames Maps resource names to resource table indices.
+ * @param mailboxNames Maps mailbox names to mailbox table indices.
+ */
+void compile_process(struct simulator *sim, struct processControlBlock *pcb,
+                     struct nameTable *resourceNames,
+                     struct nameTable *mailboxNames) {
+  pcb->pagePtr->program = compile_instructions(
+      sim, pcb->pagePtr->firstInstruction, resourceNames, mailboxNames,
+      get_op_handlers(), &pcb->pagePtr->loopNesting);
+  pcb->pagePtr->firstInstruction = NULL;
+  sim->table.nextOp[pcb->pagePtr->number] = pcb->pagePtr->program;
+  if (pcb->pagePtr->period > 0) {
+    pcb->pagePtr->cost = program_cost(pcb->pagePtr->program);
+  }
+  raise_ceilings(sim, pcb->pagePtr->program, pcb->pagePtr->priority);
+}
+
+/**
+ * @brief Raises the ceiling of every resource a program requests to a
+ * priority.
+ *
+ * @param sim The simulator holding the resource table and resource sets.
+ * @param program The compiled program.
+ * @param priority The base priority of its process.
+ */
+static void raise_ceilings(struct simulator *sim, const struct op *program,
+                           int priority) {
+  const struct op *op;
+  struct resourceList *r;
+  int i;
+
+  for (op = program; op->type != END_V; op++) {
+    if (op->operand < 0) {
+      continue;
+    }
+    if (op->type == REQ_V || op->type == REQS_V) {
+      r = sim->resourceTable[op->operand];
+      r->ceiling = priority > r->ceiling ? priority : r->ceiling;
+    } else if (op->type == REQSET_V) {
+      for (i = 0; i < sim->resourceSets[op->operand].count; i++) {
+        r = sim->resourceTable[sim->resourceSets[op->operand].members[i]];
+        r->ceiling = priority > r->ceiling ? priority : r->ceiling;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Compiles one linked list of instructions into an array of ops.
+ *
+ * The names and messages move from the instructions to the ops and the
+ * instructions are freed. The array ends with an END_V op. A repeat block
+ * becomes a REPEAT_V op followed by the body and a LOOP_V op that jumps back
+ * to the start of the body, so the body is compiled once however often it
+ * runs. Blocks that would run no op are left out. A block that is not
+ * closed ends with the process.
+ *
+ * @param sim The simulator holding the subroutines.
+ * @param first The first instruction of the process.
+ * @param resourceNames Maps resource names to resource table indices.
+ * @param mailboxNames Maps mailbox names to mailbox table indices.
+ * @param handlers The code address of each op type, or NULL.
+ * @param nesting Set to the maximum number of nested loops.
+ *
+ * @return The compiled program.
+ */
+struct op *compile_instructions(struct simulator *sim,
+                                struct instruction *first,
+                                struct nameTable *resourceNames,
+                                struct nameTable *mailboxNames,
+                                const void *const *handlers, int *nesting) {
+  struct compiler c;
+  struct instruction *i;
+  struct instruction *next;
+
+  c.sim = sim;
+  c.resourceNames = resourceNames;
+  c.mailboxNames = mailboxNames;
+  c.handlers = handlers;
+  c.length = 0;
+  c.capacity = 0;
+  c.nesting = 0;
+  c.copy = 0;
+  for (i = first; i != NULL; i = i->next) {
+    ++c.capacity;
+  }
+  ++c.capacity;
+  c.program = malloc(sizeof(struct op) * c.capacity);
+
+  i = first;
+  compile_block(&c, &i, 0, 0);
+  emit(&c, END_V, -1, NULL, NULL);
+
+  for (i = first; i != NULL; i = next) {
+    next = i->next;
+    free(i->resource);
+    free(i->msg);
+    dealloc_instruction(i);
+  }
+
+  *nesting = c.nesting;
+  if (c.length < c.capacity) {
+    return realloc(c.program, sizeof(struct op) * c.length);
+  }
+  return c.program;
+}
+
+/**
+ * @brief Returns the maximum number of nested loops of a compiled program.
+ *
+ * Also checks that the loops of the program are properly nested and that
+ * every LOOP_V op jumps back to the first op after its REPEAT_V op, so a
+ * program that passes can be run with a loop stack of the returned depth.
+ *
+ * @param program The program, ending with an END_V op.
+ *
+ * @return The nesting or -1 if the loops of the program are malformed.
+ */
+int program_loop_nesting(const struct op *program) {
+  int *open = NULL;
+  int depth = 0;
+  int nesting = 0;
+  int capacity = 0;
+  int i;
+
+  for (i = 0; program[i].type != END_V; i++) {
+    if (program[i].type == REPEAT_V) {
+      if (program[i].operand < 1) {
+        break;
+      }
+      if (depth == capacity) {
+        capacity = capacity == 0 ? 8 : 2 * capacity;
+        open = realloc(open, sizeof(int) * capacity);
+      }
+      open[depth++] = i;
+      nesting = depth > nesting ? depth : nesting;
+    } else if (program[i].type == LOOP_V) {
+      if (depth == 0 || program[i].operand < 1 ||
+          open[depth - 1] != i - program[i].operand - 1) {
+        break;
+      }
+      --depth;
+    }
+  }
+
+  free(open);
+  return program[i].type == END_V && depth == 0 ? nesting : -1;
+}
+
+/**
+ * @brief Returns the number of instructions one run of a program executes.
+ *
+ * The body of a loop counts once per iteration and the REPEAT_V, LOOP_V and
+ * PAGE_V ops, which take no time, not at all.
+ *
+ * @param program The program, ending with an END_V op, with properly nested
+ * loops.
+ *
+ * @return The number of instructions, LLONG_MAX if there are more.
+ */
+long long program_cost(const struct op *program) {
+  long long *outer = NULL;
+  long long cost = 0;
+  long long count;
+  int depth = 0;
+  int capacity = 0;
+  const struct op *op;
+
+  for (op = program; op->type != END_V; op++) {
+    if (op->type == REPEAT_V) {
+      if (depth == capacity) {
+        capacity = capacity == 0 ? 8 : 2 * capacity;
+        outer = realloc(outer, sizeof(long long) * capacity);
+      }
+      /* The body is counted on its own and multiplied at its LOOP_V op */
+      outer[depth++] = cost;
+      cost = 0;
+    } else if (op->type == LOOP_V) {
+      count = (op - op->operand - 1)->operand;
+      --depth;
+      cost = cost > 0 && count > (LLONG_MAX - outer[depth]) / cost
+                 ? LLONG_MAX
+                 : outer[depth] + cost * count;
+    } else if (op->type != PAGE_V) {
+      cost += cost < LLONG_MAX;
+    }
+  }
+
+  free(outer);
+  return cost;
+}
+
+/**
+ * @brief Compiles instructions until the end of the list or of the block.
+ *
+ * @param c The compiler.
+ * @param i The next instruction, advanced past the compiled instructions.
+ * @param depth The number of loops around the instructions.
+ * @param block Set inside a repeat block, which ends at its closing bracket.
+ */
+static void compile_block(struct compiler *c, struct instruction **i,
+                          int depth, int block) {
+  struct instruction *instruct;
+  struct message *msg;
+  const char *text;
+  char *name;
+  char *end;
+  long count;
+  int operand;
+  int start;
+
+  while ((instruct = *i) != NULL) {
+    *i = instruct->next;
+
+    switch (instruct->type) {
+    case LOOP_V:
+      if (block) {
+        return;
+      }
+      printf("Unmatched %s\n", BLOCKEND);
+      break;
+    case REPEAT_V:
+      count = strtol(instruct->resource, &end, 10);
+      if (*instruct->resource == '\0' || *end != '\0' || count < 0 ||
+          count > INT_MAX) {
+        printf("Invalid %s count %s\n", REPEAT, instruct->resource);
+        count = 0;
+      }
+      start = c->length;
+      emit(c, REPEAT_V, count, NULL, NULL);
+      compile_block(c, i, depth + 1, 1);
+      if (count == 0 || c->length == start + 1) {
+        /* Leave out a loop that runs no op */
+        while (c->length > start) {
+          --c->length;
+          free(c->program[c->length].name);
+          release_message(c->program[c->length].msg);
+        }
+      } else {
+        emit(c, LOOP_V, c->length - start - 1, NULL, NULL);
+        c->nesting = depth + 1 > c->nesting ? depth + 1 : c->nesting;
+      }
+      break;
+    case CALL_V:
+      compile_call(c, instruct, depth);
+      break;
+    case REQSET_V:
+      operand = compile_resource_set(c, instruct->resource);
+      name = take_string(c, &instruct->resource);
+      emit(c, REQSET_V, operand, name, NULL);
+      break;
+    case SYNC_V:
+      operand = compile_barrier(c, instruct->resource, instruct->msg);
+      name = take_string(c, &instruct->resource);
+      emit(c, SYNC_V, operand, name, NULL);
+      break;
+    default:
+      if (instruct->type == REQ_V || instruct->type == REQS_V ||
+          instruct->type == REL_V) {
+        operand = names_find(c->resourceNames, instruct->resource);
+      } else {
+        operand = names_find(c->mailboxNames, instruct->resource);
+      }
+      name = take_string(c, &instruct->resource);
+      msg = NULL;
+      if (instruct->type == SEND_V) {
+        text = instruct->msg != NULL ? instruct->msg : "";
+        msg = create_message(text, (int)strlen(text));
+      }
+      emit(c, instruct->type, operand, name, msg);
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Compiles the instructions of a called subroutine in place of the
+ * call.
+ *
+ * The ops get copies of the names and messages of the subroutine, which is
+ * compiled again for every call. Loops that are not closed end with the
+ * subroutine.
+ *
+ * @param c The compiler.
+ * @param call The call instruction.
+ * @param depth The number of loops around the call.
+ */
+static void compile_call(struct compiler *c, struct instruction *call,
+                         int depth) {
+  struct subroutine *sub = find_subroutine(c->sim, call->resource);
+  struct instruction *i;
+  int copy = c->copy;
+
+  if (sub == NULL) {
+    printf("Subroutine %s is not declared\n", call->resource);
+    return;
+  }
+  if (sub->expanding) {
+    printf("Subroutine %s calls itself\n", call->resource);
+    return;
+  }
+
+  sub->expanding = 1;
+  c->copy = 1;
+  i = sub->firstInstruction;
+  compile_block(c, &i, depth, 0);
+  c->copy = copy;
+  sub->expanding = 0;
+}
+
+/**
+ * @brief Resolves a bracketed list of resources to the number of its
+ * resource set.
+ *
+ * The names are resolved to resource numbers, which are sorted and freed of
+ * duplicates, so a resource named twice is requested once.
+ *
+ * @param c The compiler.
+ * @param list The list as read by the parser, e.g. "(R1, R2, R3)".
+ *
+ * @return The number of the set, -1 if the list is empty or names an
+ * unknown resource.
+ */
+static int compile_resource_set(struct compiler *c, const char *list) {
+  char *name = malloc(strlen(list) + 1);
+  int *members = malloc(sizeof(int) * (strlen(list) / 2 + 1));
+  const char *start;
+  size_t length;
+  int count = 0;
+  int unique = 0;
+  int number = 0;
+  int i;
+
+  while (*list != '\0' && number >= 0) {
+    while (*list == LEFTBRACKET || *list == RIGHTBRACKET || *list == COMMA ||
+           *list == WHITESPACE) {
+      ++list;
+    }
+    start = list;
+    while (*list != '\0' && *list != RIGHTBRACKET && *list != COMMA &&
+           *list != WHITESPACE) {
+      ++list;
+    }
+    length = list - start;
+    if (length > 0) {
+      memcpy(name, start, length);
+      name[length] = '\0';
+      number = names_find(c->resourceNames, name);
+      members[count++] = number;
+    }
+  }
+
+  if (count > 0 && number >= 0) {
+    qsort(members, count, sizeof(int), compare_numbers);
+    for (i = 0; i < count; i++) {
+      if (i == 0 || members[i] != members[unique - 1]) {
+        members[unique++] = members[i];
+      }
+    }
+    number = program_resource_set(c->sim, members, unique);
+  } else {
+    number = -1;
+  }
+
+  free(name);
+  free(members);
+  return number;
+}
+
+/**
+ * @brief Resolves the barrier of a sync instruction to its number.
+ *
+ * The first sync instruction naming a barrier declares it with its number
+ * of parties, every later one must give the same number.
+ *
+ * @param c The compiler.
+ * @param name The name of the barrier.
+ * @param parties The number of parties as read by the parser, e.g. " 3".
+ *
+ * @return The number of the barrier, -1 if the number of parties is not a
+ * positive number or differs from the one the barrier was declared with.
+ */
+static int compile_barrier(struct compiler *c, const char *name,
+                           const char *parties) {
+  char *end;
+  long count;
+  int number;
+
+  parties = parties != NULL ? parties : "";
+  while (*parties == WHITESPACE) {
+    ++parties;
+  }
+  count = strtol(parties, &end, 10);
+  while (*end == WHITESPACE) {
+    ++end;
+  }
+  if (end == parties || *end != '\0' || count < 1 || count > INT_MAX) {
+    printf("Invalid %s count %s\n", SYNC, parties);
+    return -1;
+  }
+
+  number = program_barrier(c->sim, name, count);
+  if (number < 0) {
+    printf("Barrier %s is synchronised by %d processes, not %ld\n", name,
+           c->sim->barriers[names_find(c->sim->barrierNames, name)].parties,
+           count);
+  }
+  return number;
+}
+
+/**
+ * @brief Orders two resource numbers for qsort.
+ */
+static int compare_numbers(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Returns the number of the resource set with the given members,
+ * adding the set to the resource set table if it is not there yet.
+ *
+ * Sets are identified by their key, the member numbers separated by commas,
+ * so every request of the same resources shares one set.
+ *
+ * @param sim The simulator holding the resource set table.
+ * @param members The resource numbers in increasing order, each once.
+ * @param count The number of members, at least 1.
+ *
+ * @return The number of the set.
+ */
+int program_resource_set(struct simulator *sim, const int *members,
+                         int count) {
+  struct resourceSet *set;
+  char *key = malloc(12 * count);
+  size_t length = 0;
+  int number;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    length += sprintf(key + length, i == 0 ? "%d" : ",%d", members[i]);
+  }
+  if (sim->resourceSetNames == NULL) {
+    sim->resourceSetNames = malloc(sizeof(struct nameTable));
+    names_init(sim->resourceSetNames, 16);
+  }
+  number = names_find(sim->resourceSetNames, key);
+  if (number >= 0) {
+    free(key);
+    return number;
+  }
+
+  if (sim->resourceSetCount == sim->resourceSetCapacity) {
+    sim->resourceSetCapacity =
+        sim->resourceSetCapacity == 0 ? 16 : 2 * sim->resourceSetCapacity;
+    sim->resourceSets =
+        realloc(sim->resourceSets,
+                sizeof(struct resourceSet) * sim->resourceSetCapacity);
+  }
+  set = &sim->resourceSets[sim->resourceSetCount];
+  set->members = malloc(sizeof(int) * count);
+  memcpy(set->members, members, sizeof(int) * count);
+  set->count = count;
+  set->firstWord = members[0] / 64;
+  set->words = members[count - 1] / 64 - set->firstWord + 1;
+  set->bits = calloc(set->words, sizeof(unsigned long long));
+  for (i = 0; i < count; i++) {
+    set->bits[members[i] / 64 - set->firstWord] |= 1ull << (members[i] % 64);
+  }
+  set->key = key;
+
+  number = sim->resourceSetCount++;
+  names_insert(sim->resourceSetNames, key, number);
+  return number;
+}
+
+/**
+ * @brief Returns the number of the barrier with the given name, adding the
+ * barrier to the barrier table if it is not there yet.
+ *
+ * @param sim The simulator holding the barrier table.
+ * @param name The name of the barrier, which is copied.
+ * @param parties The number of processes that arrive in each phase.
+ *
+ * @return The number of the barrier, -1 if it exists with a different
+ * number of parties.
+ */
+int program_barrier(struct simulator *sim, const char *name, int parties) {
+  struct barrier *barrier;
+  size_t length;
+  int number;
+
+  if (sim->barrierNames == NULL) {
+    sim->barrierNames = malloc(sizeof(struct nameTable));
+    names_init(sim->barrierNames, 16);
+  }
+  number = names_find(sim->barrierNames, name);
+  if (number >= 0) {
+    return sim->barriers[number].parties == parties ? number : -1;
+  }
+
+  if (sim->barrierCount == sim->barrierCapacity) {
+    sim->barrierCapacity =
+        sim->barrierCapacity == 0 ? 16 : 2 * sim->barrierCapacity;
+    sim->barriers =
+        realloc(sim->barriers, sizeof(struct barrier) * sim->barrierCapacity);
+  }
+  barrier = &sim->barriers[sim->barrierCount];
+  length = strlen(name) + 1;
+  barrier->name = malloc(length);
+  memcpy(barrier->name, name, length);
+  barrier->parties = parties;
+
+  number = sim->barrierCount++;
+  names_insert(sim->barrierNames, barrier->name, number);
+  return number;
+}
+
+/**
+ * @brief Appends an op to the program, growing the array when it is full.
+ *
+ * @return The op.
+ */
+static struct op *emit(struct compiler *c, int type, int operand, char *name,
+                       struct message *msg) {
+  struct op *op;
+
+  if (c->length == c->capacity) {
+    c->capacity *= 2;
+    c->program = realloc(c->program, sizeof(struct op) * c->capacity);
+  }
+  op = &c->program[c->length++];
+  op->type = type;
+  op->operand = operand;
+  op->name = name;
+  op->msg = msg;
+  op->code = c->handlers != NULL ? c->handlers[type] : NULL;
+
+  return op;
+}
+
+/**
+ * @brief Moves a name from an instruction to an op, or copies it while a
+ * subroutine is expanded.
+ *
+ * @return The string for the op.
+ */
+static char *take_string(struct compiler *c, char **string) {
+  char *taken = *string;
+  size_t length;
+
+  if (taken == NULL) {
+    return NULL;
+  }
+  if (c->copy) {
+    length = strlen(taken) + 1;
+    taken = malloc(length);
+    memcpy(taken, *string, length);
+  } else {
+    *string = NULL;
+  }
+  return taken;
+}
+
+/**
+ * @brief Frees the resource, mailbox, resource set and barrier tables.
+ *
+ * The resources and mailboxes themselves are freed with the loaded
+ * processes. The resource sets and barriers of a view belong to its image.
+ *
+ * @param sim The simulator holding the tables.
+ */
+void dealloc_tables(struct simulator *sim) {
+  int i;
+
+  free(sim->resourceTable);
+  free(sim->mailboxTable);
+  sim->resourceTable = NULL;
+  sim->mailboxTable = NULL;
+
+  if (sim->image == NULL) {
+    for (i = 0; i < sim->resourceSetCount; i++) {
+      free(sim->resourceSets[i].members);
+      free(sim->resourceSets[i].bits);
+      free(sim->resourceSets[i].key);
+    }
+    free(sim->resourceSets);
+    if (sim->resourceSetNames != NULL) {
+      names_free(sim->resourceSetNames);
+      free(sim->resourceSetNames);
+    }
+    for (i = 0; i < sim->barrierCount; i++) {
+      free(sim->barriers[i].name);
+    }
+    free(sim->barriers);
+    if (sim->barrierNames != NULL) {
+      names_free(sim->barrierNames);
+      free(sim->barrierNames);
+    }
+  }
+  sim->resourceSets = NULL;
+  sim->resourceSetNames = NULL;
+  sim->resourceSetCount = 0;
+  sim->resourceSetCapacity = 0;
+  sim->barriers = NULL;
+  sim->barrierNames = NULL;
+  sim->barrierCount = 0;
+  sim->barrierCapacity = 0;
+}
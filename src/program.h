@@ -0,0 +1,69 @@
+/**
+  * @file program.h
+  * @description A definition of the load time compilation step that turns the
+  *              instruction lists of the loaded processes into arrays of
+  *              pre-decoded ops.
+  */
+
+#ifndef _PROGRAM_H
+#define _PROGRAM_H
+
+#include "loader.h"
+
+struct nameTable;
+struct simulator;
+
+/*
+ * Compiles the instruction list of every process loaded into the simulator
+ * into an array of ops and resolves the resource and mailbox names to
+ * indices in the simulator's resource and mailbox tables.
+ */
+void compile_processes(struct simulator *sim);
+
+/*
+ * Numbers the resources and mailboxes of the simulator in its resource and
+ * mailbox tables and maps their names to their numbers.
+ */
+void compile_tables(struct simulator *sim, struct nameTable *resourceNames,
+                    struct nameTable *mailboxNames);
+
+/*
+ * Compiles the instruction list of one process with the names mapped by
+ * compile_tables.
+ */
+void compile_process(struct simulator *sim, struct processControlBlock *pcb,
+                     struct nameTable *resourceNames,
+                     struct nameTable *mailboxNames);
+
+/*
+ * Returns the number of the resource set of sim with the given members, in
+ * increasing order without duplicates, and adds the set if it is new.
+ */
+int program_resource_set(struct simulator *sim, const int *members,
+                         int count);
+
+/*
+ * Returns the number of the barrier of sim with the given name, adding it
+ * with the given number of parties if it is new. Returns -1 if the barrier
+ * has a different number of parties.
+ */
+int program_barrier(struct simulator *sim, const char *name, int parties);
+
+/*
+ * Returns the maximum number of nested loops of a compiled program, or -1
+ * if its loops are malformed.
+ */
+int program_loop_nesting(const struct op *program);
+
+/*
+ * Returns the number of instructions one run of a compiled program with
+ * properly nested loops executes, at most LLONG_MAX.
+ */
+long long program_cost(const struct op *program);
+
+/*
+ * Frees the resource, mailbox, resource set and barrier tables.
+ */
+void dealloc_tables(struct simulator *sim);
+
+#endif
@@ -1,39 +1,40 @@
 #include "loader.h"
 #include "queue.h"
+#include "table.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 /**
- * @brief Enqueues an item to the end of a queue
- * @param q   The queue on which the item is enqueue to
- * @param pcb The process control block to add to the queue.
+ * @brief Initialises an empty queue
+ * @param q The queue to initialise
  */
-void enqueue(struct queue *q, struct processControlBlock *pcb) {
+void queue_init(struct queue *q) {
+  q->head = -1;
+  q->tail = -1;
+  q->n = 0;
+}
+
+/**
+ * @brief Enqueues a process to the end of a queue
+ * @param t       The process table holding the queue links
+ * @param q       The queue on which the process is enqueued
+ * @param process The number of the process to add to the queue.
+ */
+void enqueue(struct processTable *t, struct queue *q, int process) {
   ++q->n;
 
-  if (q->head == NULL) {
-    q->head = malloc(sizeof(struct queueItem));
-    q->head->next = NULL;
-    q->head->item = pcb;
-    q->tail = q->head;
+  t->next[process] = -1;
+  t->prev[process] = q->tail;
 
-#ifdef DEGUB
-    print_queue(q);
-#endif
-
-    return;
+  if (q->head == -1) {
+    q->head = process;
+  } else {
+    t->next[q->tail] = process;
   }
-
-  struct queueItem *newTail = malloc(sizeof(struct queueItem));
-
-  newTail->next = NULL;
-  newTail->item = pcb;
-
-  q->tail->next = newTail;
-  q->tail = newTail;
+  q->tail = process;
 
 #ifdef DEGUB
-  print_queue(q);
+  print_queue(t, q);
 #endif
 
   return;
@@ -41,40 +42,65 @@ void enqueue(struct queue *q, struct processControlBlock *pcb) {
 
 /**
  * @brief Dequeues the head of a queue
- * @param  q The queue on which the item is dequeued from
- * @return  returns the pointer to the dequeued item
+ * @param  t The process table holding the queue links
+ * @param  q The queue on which the process is dequeued from
+ * @return  returns the number of the dequeued process, -1 if the queue is
+ *          empty
  */
-struct queueItem *dequeue(struct queue *q) {
-  if (q->head == NULL) {
-    return NULL;
-  }
+int dequeue(struct processTable *t, struct queue *q) {
+  int head = q->head;
 
-  struct queueItem *head = q->head;
+  if (head == -1) {
+    return -1;
+  }
 
-  q->head = q->head->next;
+  q->head = t->next[head];
+  if (q->head == -1) {
+    q->tail = -1;
+  } else {
+    t->prev[q->head] = -1;
+  }
   --q->n;
 
 #ifdef DEBUG
-  print_queue(q);
+  print_queue(t, q);
 #endif
 
   return head;
 }
 
+/**
+ * @brief Removes a process from anywhere in a queue
+ * @param t       The process table holding the queue links
+ * @param q       The queue the process is in
+ * @param process The number of the process to remove
+ */
+void queue_remove(struct processTable *t, struct queue *q, int process) {
+  if (t->prev[process] == -1) {
+    q->head = t->next[process];
+  } else {
+    t->next[t->prev[process]] = t->next[process];
+  }
+
+  if (t->next[process] == -1) {
+    q->tail = t->prev[process];
+  } else {
+    t->prev[t->next[process]] = t->prev[process];
+  }
+  --q->n;
+}
+
 /**
  * @brief Prints the contents of a queue
+ * @param t The process table holding the queue links
  * @param q The queue to print
  */
-void print_queue(struct queue *q) {
-  if (q->head == NULL) {
-    printf("NULL\n");
-    return;
-  }
-  struct queueItem *h = q->head;
+void print_queue(struct processTable *t, struct queue *q) {
+  int h = q->head;
 
-  while (h != NULL) {
-    printf("%s -> ", h->item->pagePtr->name);
-    h = h->next;
+  while (h != -1) {
+    printf("%s -> ", t->pcb[h]->pagePtr->name);
+    h = t->next[h];
   }
 
   printf("NULL\n");
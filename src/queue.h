@@ -8,22 +8,27 @@
 #ifndef _QUEUE_H
 #define _QUEUE_H
 
-#include "loader.h"
-
-struct queueItem {
-	struct processControlBlock *item;
-	struct queueItem* next;
-};
+struct processTable;
 
+/**
+ * A queue of processes. The queue only stores the numbers of the first and
+ * last process, the links between the processes are kept in the next and
+ * prev arrays of the process table. A process is in at most one queue.
+ */
 struct queue {
-	struct queueItem* head;
-	struct queueItem* tail;
+	/** The number of the first process, -1 if the queue is empty */
+	int head;
+	/** The number of the last process, -1 if the queue is empty */
+	int tail;
+	/** The number of processes in the queue */
 	int n;
 };
 
 
-void enqueue(struct queue *q, struct processControlBlock *pcb);
-void print_queue(struct queue *q);
-struct queueItem* dequeue(struct queue *q);
+void queue_init(struct queue *q);
+void enqueue(struct processTable *t, struct queue *q, int process);
+int dequeue(struct processTable *t, struct queue *q);
+void queue_remove(struct processTable *t, struct queue *q, int process);
+void print_queue(struct processTable *t, struct queue *q);
 
 #endif
@@ -0,0 +1,491 @@
+/**
+ * @file realtime.c
+ */
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "loader.h"
+#include "manager.h"
+#include "procsched.h"
+#include "queue.h"
+#include "realtime.h"
+#include "simulator.h"
+#include "table.h"
+
+/**
+ * The timing of a periodic process, as the schedulability tests see it.
+ */
+struct task {
+  /** The name of the process */
+  const char *name;
+  /** The number of instructions of one job */
+  long long cost;
+  /** The period */
+  long long period;
+  /** The relative deadline */
+  long long deadline;
+  /** The release jitter */
+  long long jitter;
+};
+
+static long long jitter_of(int p, long long job, int jitter);
+static void start_job(struct simulator *sim, int p);
+static void sleep_until_release(struct processTable *t, int p);
+static long long gcd(long long a, long long b);
+static int collect_tasks(const struct simulator *sim, struct task **tasks);
+static int compare_periods(const void *a, const void *b);
+static long long response_time(const struct task *tasks, int n, int i);
+static int analyze_rm(struct task *tasks, int n, double utilization,
+                      FILE *out);
+static int analyze_edf(const struct task *tasks, int n, double utilization,
+                       FILE *out);
+
+/**
+ * @brief Returns the current time in ticks.
+ *
+ * Between time slices that is the number of completed instructions plus
+ * the ticks the scheduler was idle.
+ *
+ * @param sim The simulator.
+ *
+ * @return The time.
+ */
+long long realtime_now(const struct simulator *sim) {
+  return sim->instructionsExecuted + sim->idle;
+}
+
+/**
+ * @brief Returns the default horizon of the periodic processes.
+ *
+ * After one hyperperiod, the least common multiple of the periods, the
+ * arrivals repeat, so it is long enough to see every combination of jobs.
+ * It is capped at 1000 times the longest period so that processes with
+ * periods that share no factors still terminate in reasonable time.
+ *
+ * @param sim The simulator holding the processes.
+ *
+ * @return The horizon, 0 if no process is periodic.
+ */
+long long realtime_horizon(const struct simulator *sim) {
+  const struct processTable *t = &sim->table;
+  long long hyperperiod = 1;
+  long long longest = 0;
+  long long cap;
+  long long period;
+  int p;
+
+  for (p = 0; p < t->count; p++) {
+    if (t->pcb[p] != NULL && t->pcb[p]->pagePtr->period > longest) {
+      longest = t->pcb[p]->pagePtr->period;
+    }
+  }
+  if (longest == 0) {
+    return 0;
+  }
+  cap = 1000 * longest;
+  for (p = 0; p < t->count && hyperperiod < cap; p++) {
+    if (t->pcb[p] == NULL || (period = t->pcb[p]->pagePtr->period) == 0) {
+      continue;
+    }
+    hyperperiod /= gcd(hyperperiod, period);
+    hyperperiod = hyperperiod > cap / period ? cap : hyperperiod * period;
+  }
+  return hyperperiod < cap ? hyperperiod : cap;
+}
+
+/**
+ * @brief Releases the first job of every periodic process.
+ *
+ * table_reset left every process ready with no job. A first job without
+ * release jitter starts right away, and the process of any other sleeps
+ * until its release. The horizon defaults to realtime_horizon.
+ *
+ * @param sim The simulator, whose processes were just reset.
+ */
+void realtime_reset(struct simulator *sim) {
+  struct processTable *t = &sim->table;
+  struct page *page;
+  int p;
+
+  if (!t->timed) {
+    return;
+  }
+  if (sim->horizon == 0) {
+    sim->horizon = realtime_horizon(sim);
+  }
+  for (p = 0; p < t->count; p++) {
+    page = t->pcb[p]->pagePtr;
+    if (page->period == 0) {
+      continue;
+    }
+    t->release[p] = jitter_of(p, 0, page->jitter);
+    if (t->release[p] == 0) {
+      t->pcb[p]->stats.jobs = 1;
+      t->deadline[p] = page->deadline;
+      continue;
+    }
+    queue_remove(t, &t->readyQueue, p);
+    sleep_until_release(t, p);
+  }
+  if (t->prioritized) {
+    table_prioritize(t, t->prioritized);
+  }
+}
+
+/**
+ * @brief Lets time pass until the next release when no process is ready.
+ *
+ * The scheduler is idle then, which moves the clock but completes no
+ * instruction.
+ *
+ * @param sim The simulator holding the processes.
+ */
+void realtime_idle(struct simulator *sim) {
+  struct processTable *t = &sim->table;
+  long long now = realtime_now(sim);
+
+  if (t->readyQueue.head == -1 && t->timerCount > 0 &&
+      t->release[t->timers[0]] > now) {
+    sim->idle += t->release[t->timers[0]] - now;
+  }
+}
+
+/**
+ * @brief Starts the jobs that are released by a given time.
+ *
+ * Jobs released at the same time start in order of the number of their
+ * process.
+ *
+ * @param sim The simulator holding the processes.
+ * @param now The time.
+ */
+void realtime_release(struct simulator *sim, long long now) {
+  struct processTable *t = &sim->table;
+
+  while (t->timerCount > 0 && t->release[t->timers[0]] <= now) {
+    start_job(sim, table_timer_pop(t));
+  }
+}
+
+/**
+ * @brief Completes the job of a periodic process.
+ *
+ * Records the response time of the job and whether it missed its deadline,
+ * and traces both. Unless the next job arrives at or after the horizon, the
+ * process goes back to the start of its program, where it starts the next
+ * job if it is released already and sleeps until it is otherwise. The
+ * caller moves the next op of the process to the start of its program.
+ *
+ * @param sim The simulator holding the process.
+ * @param p The periodic process, which just reached its END_V op.
+ * @param now The time.
+ *
+ * @return 1 if the process has another job, 0 if it terminates.
+ */
+int realtime_complete(struct simulator *sim, int p, long long now) {
+  struct processTable *t = &sim->table;
+  struct processStats *stats = &t->pcb[p]->stats;
+  struct page *page = t->pcb[p]->pagePtr;
+  long long arrival = (stats->jobs - 1) * page->period;
+
+  if (now - arrival > stats->worstResponse) {
+    stats->worstResponse = now - arrival;
+  }
+  if (now > t->deadline[p]) {
+    ++stats->missed;
+  }
+  if (sim->trace != NULL) {
+    if (now > t->deadline[p]) {
+      fprintf(sim->trace,
+              "%s job %lld: completed at %lld; missed deadline %lld\n",
+              page->name, stats->jobs - 1, now, t->deadline[p]);
+    } else {
+      fprintf(sim->trace, "%s job %lld: completed at %lld\n", page->name,
+              stats->jobs - 1, now);
+    }
+  }
+
+  arrival += page->period;
+  if (arrival >= sim->horizon) {
+    return 0;
+  }
+  t->resume[p] = 0;
+  t->release[p] = arrival + jitter_of(p, stats->jobs, page->jitter);
+  if (t->release[p] <= now) {
+    start_job(sim, p);
+  } else {
+    sleep_until_release(t, p);
+  }
+  return 1;
+}
+
+/**
+ * @brief Tests whether the periodic processes meet their deadlines.
+ *
+ * Each process is a task that needs the instructions of one job, its cost,
+ * every period. Rate monotonic scheduling gets the Liu and Layland
+ * utilization bound, which is sufficient, and a response time analysis,
+ * which is exact when the jobs never wait for each other. Earliest deadline
+ * first is exact with a utilization of at most 1 when every deadline is the
+ * period and no job has jitter, and otherwise gets the density test, which
+ * is sufficient. Both ignore the time jobs wait for resources, mailboxes
+ * and barriers and the processes that are not periodic, which only run
+ * when no job is ready.
+ *
+ * @param sim The simulator holding the processes.
+ * @param schedule_alg PROCSCHED_EDF or PROCSCHED_RM.
+ * @param out The stream the test is written to.
+ *
+ * @return 1 if the processes are schedulable, 0 if they may miss a
+ * deadline, -1 for any other algorithm or if memory ran out.
+ */
+int realtime_analyze(const struct simulator *sim, int schedule_alg,
+                     FILE *out) {
+  struct task *tasks;
+  double utilization = 0;
+  int schedulable;
+  int n;
+  int i;
+
+  if (schedule_alg != PROCSCHED_EDF && schedule_alg != PROCSCHED_RM) {
+    return -1;
+  }
+  if ((n = collect_tasks(sim, &tasks)) < 0) {
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    utilization += (double)tasks[i].cost / tasks[i].period;
+  }
+  if (schedule_alg == PROCSCHED_RM) {
+    schedulable = analyze_rm(tasks, n, utilization, out);
+  } else {
+    schedulable = analyze_edf(tasks, n, utilization, out);
+  }
+  fprintf(out, "%s\n", schedulable ? "Schedulable" : "May miss deadlines");
+
+  free(tasks);
+  return schedulable;
+}
+
+/**
+ * @brief Returns the release jitter of a job.
+ *
+ * The jitter is a hash of the process and the job, so it looks random but
+ * is the same in every run, after a reset and after a restore.
+ *
+ * @param p The number of the process.
+ * @param job The number of the job.
+ * @param jitter The longest jitter of the process.
+ *
+ * @return The jitter, from 0 to jitter.
+ */
+static long long jitter_of(int p, long long job, int jitter) {
+  uint64_t z = (uint64_t)p * 0x9e3779b97f4a7c15ULL + (uint64_t)job;
+
+  if (jitter == 0) {
+    return 0;
+  }
+  /* splitmix64 */
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return (long long)(z % ((uint64_t)jitter + 1));
+}
+
+/**
+ * @brief Makes the next job of a periodic process ready.
+ */
+static void start_job(struct simulator *sim, int p) {
+  struct processTable *t = &sim->table;
+  struct page *page = t->pcb[p]->pagePtr;
+
+  t->deadline[p] = t->pcb[p]->stats.jobs++ * page->period + page->deadline;
+  process_to_readyq(t, p);
+}
+
+/**
+ * @brief Puts a periodic process to sleep until its release time.
+ */
+static void sleep_until_release(struct processTable *t, int p) {
+  t->state[p] = SLEEPING;
+  if (t->prioritized) {
+    t->blockedOn[p] = -1;
+  }
+  table_timer_push(t, p);
+}
+
+/**
+ * @brief Returns the greatest common divisor of two positive numbers.
+ */
+static long long gcd(long long a, long long b) {
+  long long r;
+
+  while (b != 0) {
+    r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/**
+ * @brief Collects the periodic processes as tasks in order of their number.
+ *
+ * @return The number of tasks, -1 if memory ran out.
+ */
+static int collect_tasks(const struct simulator *sim, struct task **tasks) {
+  const struct processTable *t = &sim->table;
+  const struct page *page;
+  int n = 0;
+  int p;
+
+  *tasks = malloc(sizeof(struct task) * (t->count > 0 ? t->count : 1));
+  if (*tasks == NULL) {
+    return -1;
+  }
+  for (p = 0; p < t->count; p++) {
+    if (t->pcb[p] == NULL || (page = t->pcb[p]->pagePtr)->period == 0) {
+      continue;
+    }
+    (*tasks)[n].name = page->name;
+    (*tasks)[n].cost = page->cost;
+    (*tasks)[n].period = page->period;
+    (*tasks)[n].deadline = page->deadline;
+    (*tasks)[n].jitter = page->jitter;
+    ++n;
+  }
+  return n;
+}
+
+/**
+ * @brief Orders tasks by period, the shortest first.
+ */
+static int compare_periods(const void *a, const void *b) {
+  const struct task *x = a;
+  const struct task *y = b;
+
+  return (x->period > y->period) - (x->period < y->period);
+}
+
+/**
+ * @brief Returns the worst response time of a task under rate monotonic
+ * scheduling.
+ *
+ * The job of task i is delayed by every job of a task with the same or a
+ * shorter period released before it completes, so its busy window w is the
+ * smallest solution of w = C_i + sum ceil((w + J_j) / T_j) C_j, and its
+ * response time w + J_i. The iteration stops early once the response time
+ * exceeds the deadline.
+ *
+ * @param tasks The tasks in order of period.
+ * @param n The number of tasks.
+ * @param i The task.
+ *
+ * @return The response time, more than the deadline if the task may miss
+ * it.
+ */
+static long long response_time(const struct task *tasks, int n, int i) {
+  long long window = tasks[i].cost;
+  long long next;
+  long long jobs;
+  int j;
+
+  while (window <= tasks[i].deadline - tasks[i].jitter) {
+    next = tasks[i].cost;
+    for (j = 0; j < n && tasks[j].period <= tasks[i].period; j++) {
+      if (j == i) {
+        continue;
+      }
+      jobs = (window + tasks[j].jitter + tasks[j].period - 1) / tasks[j].period;
+      if (tasks[j].cost > 0 &&
+          jobs > (LLONG_MAX - next) / tasks[j].cost) {
+        return LLONG_MAX;
+      }
+      next += jobs * tasks[j].cost;
+    }
+    if (next == window) {
+      break;
+    }
+    window = next;
+  }
+  return window > LLONG_MAX - tasks[i].jitter ? LLONG_MAX
+                                              : window + tasks[i].jitter;
+}
+
+/**
+ * @brief Writes the rate monotonic tests of the tasks.
+ *
+ * @return 1 if every task meets its deadline, otherwise 0.
+ */
+static int analyze_rm(struct task *tasks, int n, double utilization,
+                      FILE *out) {
+  double bound = n > 0 ? n * (pow(2.0, 1.0 / n) - 1) : 1;
+  long long response;
+  int schedulable = 1;
+  int i;
+
+  qsort(tasks, n, sizeof(struct task), compare_periods);
+  fprintf(out,
+          "Rate monotonic: %d periodic processes, utilization %.3f, "
+          "bound %.3f\n",
+          n, utilization, bound);
+  for (i = 0; i < n; i++) {
+    response = response_time(tasks, n, i);
+    fprintf(out, "  %s: cost %lld, period %lld, deadline %lld, jitter %lld, ",
+            tasks[i].name, tasks[i].cost, tasks[i].period, tasks[i].deadline,
+            tasks[i].jitter);
+    if (response > tasks[i].deadline) {
+      fprintf(out, "may miss its deadline\n");
+      schedulable = 0;
+    } else {
+      fprintf(out, "response time %lld\n", response);
+    }
+  }
+  return schedulable;
+}
+
+/**
+ * @brief Writes the earliest deadline first tests of the tasks.
+ *
+ * @return 1 if every task meets its deadline, otherwise 0.
+ */
+static int analyze_edf(const struct task *tasks, int n, double utilization,
+                       FILE *out) {
+  double density = 0;
+  int implicit = 1;
+  int i;
+
+  fprintf(out, "Earliest deadline first: %d periodic processes, "
+               "utilization %.3f\n",
+          n, utilization);
+  for (i = 0; i < n; i++) {
+    fprintf(out, "  %s: cost %lld, period %lld, deadline %lld, jitter %lld\n",
+            tasks[i].name, tasks[i].cost, tasks[i].period, tasks[i].deadline,
+            tasks[i].jitter);
+    implicit = implicit && tasks[i].deadline == tasks[i].period &&
+               tasks[i].jitter == 0;
+    /* A job released at its deadline has no time left at all */
+    if (tasks[i].deadline > tasks[i].jitter) {
+      density +=
+          (double)tasks[i].cost / (tasks[i].deadline - tasks[i].jitter);
+    } else if (tasks[i].cost > 0) {
+      density = HUGE_VAL;
+    }
+  }
+  if (utilization > 1) {
+    fprintf(out, "Utilization above 1\n");
+    return 0;
+  }
+  if (implicit) {
+    return 1;
+  }
+  fprintf(out, "Density %.3f\n", density);
+  if (density > 1) {
+    fprintf(out, "Density above 1, which is not exact\n");
+  }
+  return density <= 1;
+}
@@ -0,0 +1,68 @@
+/**
+  * @file realtime.h
+  * @description A definition of periodic processes, which run their program
+  *              once per job, and of the tests that tell whether their jobs
+  *              can all meet their deadlines.
+  *
+  * The scheduler keeps time in ticks, one per executed instruction, plus the
+  * ticks it spends idle when every process that is not terminated sleeps or
+  * waits for a sleeping one. Job k of a process with period T, deadline D
+  * and jitter J arrives at k * T and must complete by k * T + D. It is
+  * released at its arrival plus a delay from 0 to J, which is the same in
+  * every run. A job that completes makes the process sleep until the
+  * release of its next job, and the process terminates after its last job
+  * that arrives before the horizon.
+  */
+
+#ifndef _REALTIME_H
+#define _REALTIME_H
+
+#include <stdio.h>
+
+struct simulator;
+
+/*
+ * Returns the current time in ticks.
+ */
+long long realtime_now(const struct simulator *sim);
+
+/*
+ * Returns the default horizon: the hyperperiod of the periodic processes,
+ * at most 1000 of their longest periods.
+ */
+long long realtime_horizon(const struct simulator *sim);
+
+/*
+ * Starts the first job of every periodic process that is released at time
+ * 0 and puts the others to sleep until their release. Called whenever the
+ * processes were put back in the ready queue by table_reset.
+ */
+void realtime_reset(struct simulator *sim);
+
+/*
+ * Moves the clock to the next release if no process is ready.
+ */
+void realtime_idle(struct simulator *sim);
+
+/*
+ * Starts the jobs released by time now.
+ */
+void realtime_release(struct simulator *sim, long long now);
+
+/*
+ * Completes the job of periodic process p at time now. Returns 1 if the
+ * process has another job and starts or sleeps at the start of its program,
+ * 0 if it terminates.
+ */
+int realtime_complete(struct simulator *sim, int p, long long now);
+
+/*
+ * Writes a schedulability test of the periodic processes under
+ * PROCSCHED_EDF or PROCSCHED_RM to out and returns 1 if every job meets
+ * its deadline, 0 if some may not and -1 for any other algorithm.
+ * Waiting for resources, mailboxes and barriers is not taken into account.
+ */
+int realtime_analyze(const struct simulator *sim, int schedule_alg,
+                     FILE *out);
+
+#endif
@@ -0,0 +1,407 @@
+/**
+ * @file replay.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "loader.h"
+#include "manager.h"
+#include "procsched.h"
+#include "replay.h"
+#include "simulator.h"
+#include "table.h"
+
+static void handle_event(struct simulator *sim, int type, int p,
+                         int executed);
+static int write_snapshot(struct simulator *sim);
+static int read_event(FILE *fptr, int *type, uint32_t *p, uint32_t *executed);
+static void print_event(struct simulator *sim, int type, int p, int executed);
+static struct recording *recording_create(FILE *file);
+
+/**
+ * @brief Starts recording the scheduling decisions of the next run.
+ *
+ * The recording starts with a snapshot of the current state, so a run that
+ * continues a restored checkpoint can be replayed too.
+ *
+ * @param sim A simulator with loaded processes.
+ * @param filename The path of the recording.
+ * @param snapshot_every The number of instructions between snapshots, 0 for
+ * none after the first.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int recording_start(struct simulator *sim, const char *filename,
+                    long long snapshot_every) {
+  struct recordingHeader header;
+  struct recording *r;
+  FILE *file;
+
+  if (!sim->compiled || sim->recording != NULL) {
+    return -1;
+  }
+
+  file = fopen(filename, "wb+");
+  if (file == NULL) {
+    return -1;
+  }
+  r = recording_create(file);
+  if (r == NULL) {
+    fclose(file);
+    return -1;
+  }
+  r->snapshotEvery = snapshot_every > 0 ? snapshot_every : 0;
+  r->nextSnapshot = sim->instructionsExecuted + r->snapshotEvery;
+
+  /* The algorithm is filled in when the run ends */
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+  header.version = RECORDING_VERSION;
+  header.fingerprint = checkpoint_fingerprint(sim);
+  header.snapshotEvery = r->snapshotEvery;
+  fwrite(&header, sizeof(header), 1, file);
+
+  sim->recording = r;
+  if (write_snapshot(sim) != 0) {
+    recording_stop(sim);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Ends the recording or replay attached to a simulator.
+ *
+ * A recording gets the algorithm and time slice of the run in its header and
+ * is closed.
+ *
+ * @param sim The simulator.
+ */
+void recording_stop(struct simulator *sim) {
+  struct recording *r = sim->recording;
+  struct recordingHeader header;
+
+  if (r == NULL) {
+    return;
+  }
+
+  if (!r->replaying && fseek(r->file, 0, SEEK_SET) == 0 &&
+      fread(&header, sizeof(header), 1, r->file) == 1) {
+    header.scheduleAlg = sim->scheduleAlg;
+    header.quantum = sim->quantum;
+    fseek(r->file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, r->file);
+  }
+  fclose(r->file);
+  free(r);
+  sim->recording = NULL;
+}
+
+/**
+ * @brief Replays a recording from a chosen event on.
+ *
+ * The recording is searched for the target event: the event with index n,
+ * the first time slice of the named process or the n-th deadlock. The state
+ * is restored from the last snapshot before the target and the run
+ * continues from there with the trace off until the target is reached.
+ * From the target on the trace and a line per event are written to trace.
+ * Every event of the replay is checked against the recording.
+ *
+ * @param sim A simulator holding the recorded workload.
+ * @param filename The path of the recording.
+ * @param seek PROCSCHED_SEEK_EVENT, PROCSCHED_SEEK_PROCESS or
+ * PROCSCHED_SEEK_DEADLOCK.
+ * @param n The event index, counting from 0, or the deadlock, counting from
+ * 1.
+ * @param process The name of the process to seek to.
+ * @param trace The stream to trace to from the target on.
+ *
+ * @return 0 on success, -1 if the recording does not belong to the workload,
+ * does not contain the target or the replay diverged from it.
+ */
+int recording_replay(struct simulator *sim, const char *filename, int seek,
+                     long long n, const char *process, FILE *trace) {
+  struct recordingHeader header;
+  struct recording *r;
+  FILE *file;
+  uint64_t snapshot[2];
+  uint32_t p;
+  uint32_t executed;
+  long snapshotOffset = -1;
+  long long snapshotEvents = 0;
+  long long events = 0;
+  long long deadlocks = 0;
+  long long target = -1;
+  int number = -1;
+  int schedule_alg;
+  int quantum;
+  int type;
+  int status;
+
+  if (!sim->compiled || sim->recording != NULL) {
+    return -1;
+  }
+
+  if (seek == PROCSCHED_SEEK_PROCESS) {
+    for (number = 0; number < sim->table.count; number++) {
+      if (strcmp(sim->table.pcb[number]->pagePtr->name, process) == 0) {
+        break;
+      }
+    }
+    if (number == sim->table.count) {
+      return -1;
+    }
+  }
+
+  file = fopen(filename, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != RECORDING_VERSION ||
+      header.fingerprint != checkpoint_fingerprint(sim)) {
+    fclose(file);
+    return -1;
+  }
+
+  /* Find the target and the last snapshot before it */
+  while (target == -1 && (type = fgetc(file)) != EOF) {
+    if (type == EVENT_SNAPSHOT) {
+      if (fread(snapshot, sizeof(snapshot), 1, file) != 1) {
+        break;
+      }
+      snapshotEvents = snapshot[0];
+      snapshotOffset = ftell(file);
+      fseek(file, snapshot[1], SEEK_CUR);
+      continue;
+    }
+    ungetc(type, file);
+    if (!read_event(file, &type, &p, &executed)) {
+      break;
+    }
+    if ((seek == PROCSCHED_SEEK_EVENT && events == n) ||
+        (seek == PROCSCHED_SEEK_PROCESS && type == EVENT_SLICE &&
+         p == (uint32_t)number) ||
+        (seek == PROCSCHED_SEEK_DEADLOCK && type == EVENT_DEADLOCK &&
+         ++deadlocks == n)) {
+      target = events;
+    }
+    ++events;
+  }
+
+  if (target == -1 || snapshotOffset == -1 ||
+      fseek(file, snapshotOffset, SEEK_SET) != 0 ||
+      checkpoint_load(sim, file, &schedule_alg, &quantum) != 0 ||
+      (r = recording_create(file)) == NULL) {
+    fclose(file);
+    return -1;
+  }
+
+  r->replaying = 1;
+  r->events = snapshotEvents;
+  r->target = target;
+  r->trace = trace;
+  sim->recording = r;
+  sim->trace = r->events == target ? trace : NULL;
+  sim->scheduleAlg = header.scheduleAlg;
+  sim->quantum = header.quantum;
+
+  schedule_processes(sim, header.scheduleAlg, header.quantum);
+  sim->finished = 1;
+  sim->trace = trace;
+
+  /* A replay that ends early has diverged as well */
+  if (r->diverged == -1 && read_event(file, &type, &p, &executed)) {
+    r->diverged = r->events;
+  }
+  status = r->diverged == -1 ? 0 : -1;
+  if (status != 0) {
+    fprintf(stderr, "Replay diverged from the recording at event %lld\n",
+            r->diverged);
+  }
+  recording_stop(sim);
+
+  return status;
+}
+
+/**
+ * @brief Records or checks a time slice.
+ *
+ * @param sim The running simulator.
+ * @param p The process that ran.
+ * @param executed The number of ops it executed.
+ */
+void recording_slice(struct simulator *sim, int p, int executed) {
+  handle_event(sim, EVENT_SLICE, p, executed);
+}
+
+/**
+ * @brief Records or checks a deadlock or one of its victims.
+ *
+ * @param sim The running simulator.
+ * @param type EVENT_DEADLOCK or EVENT_VICTIM.
+ * @param p The victim, 0 for a deadlock.
+ */
+void recording_event(struct simulator *sim, int type, int p) {
+  handle_event(sim, type, p, 0);
+}
+
+/**
+ * @brief Writes a snapshot if one is due.
+ *
+ * @param sim The running simulator.
+ */
+void recording_poll(struct simulator *sim) {
+  struct recording *r = sim->recording;
+
+  if (r->replaying || r->snapshotEvery == 0 ||
+      sim->instructionsExecuted < r->nextSnapshot) {
+    return;
+  }
+  write_snapshot(sim);
+  r->nextSnapshot = sim->instructionsExecuted + r->snapshotEvery;
+}
+
+/**
+ * @brief Records an event, or checks it against the recording and traces it
+ * once the target is reached.
+ */
+static void handle_event(struct simulator *sim, int type, int p,
+                         int executed) {
+  struct recording *r = sim->recording;
+  uint32_t record[2];
+  uint32_t recordedP;
+  uint32_t recordedExecuted;
+  int recordedType;
+
+  if (!r->replaying) {
+    record[0] = p;
+    record[1] = executed;
+    fputc(type, r->file);
+    fwrite(record, sizeof(record), 1, r->file);
+    ++r->events;
+    return;
+  }
+
+  if (r->diverged == -1 &&
+      (!read_event(r->file, &recordedType, &recordedP, &recordedExecuted) ||
+       recordedType != type || recordedP != (uint32_t)p ||
+       recordedExecuted != (uint32_t)executed)) {
+    r->diverged = r->events;
+  }
+  if (r->events >= r->target && r->trace != NULL) {
+    print_event(sim, type, p, executed);
+  }
+  if (++r->events == r->target) {
+    sim->trace = r->trace;
+  }
+}
+
+/**
+ * @brief Appends a snapshot of the current state to the recording.
+ *
+ * The size of the checkpoint is written after it, once it is known, so the
+ * replayer can skip over it.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int write_snapshot(struct simulator *sim) {
+  struct recording *r = sim->recording;
+  uint64_t snapshot[2];
+  long start;
+  long end;
+
+  snapshot[0] = r->events;
+  snapshot[1] = 0;
+  fputc(EVENT_SNAPSHOT, r->file);
+  fwrite(snapshot, sizeof(snapshot), 1, r->file);
+  start = ftell(r->file);
+  if (start < 0 || checkpoint_save(sim, r->file) != 0 ||
+      (end = ftell(r->file)) < 0) {
+    return -1;
+  }
+
+  snapshot[1] = end - start;
+  fseek(r->file, start - (long)sizeof(snapshot), SEEK_SET);
+  fwrite(snapshot, sizeof(snapshot), 1, r->file);
+  fseek(r->file, end, SEEK_SET);
+
+  return ferror(r->file) ? -1 : 0;
+}
+
+/**
+ * @brief Reads the next event of a recording, skipping snapshots.
+ *
+ * @return 1 on success, 0 at the end of the recording.
+ */
+static int read_event(FILE *fptr, int *type, uint32_t *p, uint32_t *executed) {
+  uint64_t snapshot[2];
+  uint32_t record[2];
+
+  while ((*type = fgetc(fptr)) == EVENT_SNAPSHOT) {
+    if (fread(snapshot, sizeof(snapshot), 1, fptr) != 1 ||
+        fseek(fptr, snapshot[1], SEEK_CUR) != 0) {
+      return 0;
+    }
+  }
+  if (*type == EOF || fread(record, sizeof(record), 1, fptr) != 1) {
+    return 0;
+  }
+  *p = record[0];
+  *executed = record[1];
+
+  return 1;
+}
+
+/**
+ * @brief Writes a line describing an event to the trace.
+ */
+static void print_event(struct simulator *sim, int type, int p,
+                        int executed) {
+  struct processTable *t = &sim->table;
+  struct recording *r = sim->recording;
+
+  switch (type) {
+  case EVENT_SLICE:
+    fprintf(r->trace, "event %lld: %s ran %d ops, %s\n", r->events,
+            t->pcb[p]->pagePtr->name, executed,
+            t->state[p] == TERMINATED ? "terminated"
+            : t->state[p] == WAITING  ? "waiting"
+            : t->state[p] == SLEEPING ? "sleeping"
+                                      : "preempted");
+    break;
+  case EVENT_DEADLOCK:
+    fprintf(r->trace, "event %lld: deadlock, %d processes waiting\n",
+            r->events, t->waiting);
+    break;
+  case EVENT_VICTIM:
+    fprintf(r->trace, "event %lld: %s terminated to recover\n", r->events,
+            t->pcb[p]->pagePtr->name);
+    break;
+  }
+}
+
+/**
+ * @brief Allocates a recording on an open file.
+ *
+ * @return The recording or NULL.
+ */
+static struct recording *recording_create(FILE *file) {
+  struct recording *r = malloc(sizeof(struct recording));
+
+  if (r != NULL) {
+    r->file = file;
+    r->replaying = 0;
+    r->events = 0;
+    r->target = -1;
+    r->trace = NULL;
+    r->snapshotEvery = 0;
+    r->nextSnapshot = 0;
+    r->diverged = -1;
+  }
+  return r;
+}
@@ -0,0 +1,112 @@
+/**
+  * @file replay.h
+  * @description A definition of recordings, which log the scheduling
+  *              decisions of a run so that it can be replayed and searched
+  *              for the moment a problem starts.
+  */
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct simulator;
+
+/** The first bytes of every recording */
+#define RECORDING_MAGIC "PSCHDREC"
+/** The version of the layout below, bumped on every incompatible change */
+#define RECORDING_VERSION 1
+
+/** A time slice: the process and the number of ops it executed */
+#define EVENT_SLICE 0
+/** The scheduler found every remaining process waiting */
+#define EVENT_DEADLOCK 1
+/** A process was terminated to recover from a deadlock */
+#define EVENT_VICTIM 2
+/** Not an event: a checkpoint of the state before the next event */
+#define EVENT_SNAPSHOT 3
+
+/**
+ * The header at the start of a recording. It is followed by one record per
+ * event, a uint8_t event type followed by two uint32_t: the process (0 for a
+ * deadlock) and the number of ops executed (0 unless a slice). Snapshot
+ * records interrupt them: the type is followed by the number of events
+ * before the snapshot and the size of the checkpoint (two uint64_t) and the
+ * checkpoint itself.
+ */
+struct recordingHeader {
+  /** RECORDING_MAGIC without the terminating 0 */
+  char magic[8];
+  /** RECORDING_VERSION */
+  uint32_t version;
+  /** The scheduling algorithm of the run */
+  int32_t scheduleAlg;
+  /** The time slice of the run */
+  int32_t quantum;
+  /** Unused, 0 */
+  uint32_t reserved;
+  /** The fingerprint of the compiled workload, see checkpoint.h */
+  uint64_t fingerprint;
+  /** The number of instructions between snapshots, 0 for none */
+  int64_t snapshotEvery;
+};
+
+/**
+ * The recorder or replayer attached to a running simulator.
+ */
+struct recording {
+  /** The recording file */
+  FILE *file;
+  /** Set when replaying, the events are checked against the file */
+  int replaying;
+  /** The number of events so far, the index of the next event */
+  long long events;
+  /** Replay: the event from which on the run is traced */
+  long long target;
+  /** Replay: the stream the trace and the events go to after the target */
+  FILE *trace;
+  /** Record: the number of instructions between snapshots, 0 for none */
+  long long snapshotEvery;
+  /** Record: the number of instructions after which a snapshot is due */
+  long long nextSnapshot;
+  /** Replay: the first event that differs from the recording, -1 if none */
+  long long diverged;
+};
+
+/*
+ * Starts recording the next run of sim to filename, with a snapshot every
+ * snapshot_every instructions. Returns 0 on success or -1 on failure.
+ */
+int recording_start(struct simulator *sim, const char *filename,
+                    long long snapshot_every);
+
+/*
+ * Ends the recording or replay attached to sim.
+ */
+void recording_stop(struct simulator *sim);
+
+/*
+ * Replays the recording in filename on sim from the event target on with
+ * the trace written to trace. Returns 0 on success or -1 on failure.
+ */
+int recording_replay(struct simulator *sim, const char *filename, int seek,
+                     long long n, const char *process, FILE *trace);
+
+/*
+ * Records or checks the time slice in which process p executed ops.
+ */
+void recording_slice(struct simulator *sim, int p, int executed);
+
+/*
+ * Records or checks a deadlock, or the victim p of a deadlock.
+ */
+void recording_event(struct simulator *sim, int type, int p);
+
+/*
+ * Writes a snapshot if one is due. Called by the scheduler between time
+ * slices.
+ */
+void recording_poll(struct simulator *sim);
+
+#endif
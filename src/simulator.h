@@ -0,0 +1,160 @@
+/**
+  * @file simulator.h
+  * @description A definition of the simulator, which holds all the state of
+  *              one simulation: the loaded processes, resources and
+  *              mailboxes, the compiled tables and the process table.
+  */
+
+#ifndef _SIMULATOR_H
+#define _SIMULATOR_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "loader.h"
+#include "table.h"
+
+struct monitor;
+struct nameTable;
+struct pager;
+struct recording;
+
+/**
+ * One simulation. Every function of the loader, compiler and scheduler works
+ * on a simulator instead of global state, so any number of simulations can
+ * exist at the same time and run on different threads.
+ *
+ * A view is a simulator created from a loaded one, the image. Scheduling
+ * never changes the pages, the compiled ops or the names, so a view shares
+ * them with its image and only has its own copy of the state a run changes:
+ * the process control blocks, the resource and mailbox lists and the
+ * process table.
+ *
+ * A simulator loaded from a binary image (image.h) keeps the image mapped:
+ * its ops, names and messages live in the mapping and its processes,
+ * resources and mailboxes in one array each. Under a memory budget the ops
+ * are paged in from the mapping instead, see pager.h.
+ */
+struct simulator {
+  /** The first loaded process */
+  struct processControlBlock *firstPCB;
+  /** The process loaded or given instructions last */
+  struct processControlBlock *currentPCB;
+  /** The resources available to the system, in load order */
+  struct resourceList *firstResource;
+  /** The last loaded resource */
+  struct resourceList *currentResource;
+  /** The mailboxes available to the system, in load order */
+  struct mailbox *firstMailbox;
+  /** The last loaded mailbox */
+  struct mailbox *currentMailbox;
+  /** The last loaded instruction of the current process */
+  struct instruction *currentInstruction;
+  /** The name of the process that was given an instruction last */
+  char *currentProcessName;
+  /** The number of instructions the parser could not load, the load fails
+   * if there are any */
+  int loadErrors;
+  /** The loaded subroutines, the last loaded first, until the processes
+   * are compiled */
+  struct subroutine *firstSubroutine;
+  /** The scheduling state of every process */
+  struct processTable table;
+  /** The resources indexed by the operand of REQ_V and REL_V ops */
+  struct resourceList **resourceTable;
+  /** The mailboxes indexed by the operand of SEND_V and RECV_V ops */
+  struct mailbox **mailboxTable;
+  /** The resource sets indexed by the operand of REQSET_V ops, shared
+   * with the image by a view */
+  struct resourceSet *resourceSets;
+  /** Maps the key of each resource set to its number, NULL until a set is
+   * compiled */
+  struct nameTable *resourceSetNames;
+  /** The number of resource sets */
+  int resourceSetCount;
+  /** The number of resource sets there is room for */
+  int resourceSetCapacity;
+  /** The barriers indexed by the operand of SYNC_V ops, shared with the
+   * image by a view */
+  struct barrier *barriers;
+  /** Maps the name of each barrier to its number, NULL until a barrier is
+   * compiled */
+  struct nameTable *barrierNames;
+  /** The number of barriers */
+  int barrierCount;
+  /** The number of barriers there is room for */
+  int barrierCapacity;
+  /** The number of resources */
+  int resourceCount;
+  /** The number of mailboxes */
+  int mailboxCount;
+  /** The number of mailboxes that are topics */
+  int topicCount;
+  /** The simulator whose pages, ops and names this view shares, NULL if the
+   * simulator loaded them itself */
+  const struct simulator *image;
+  /** The mapped binary image the programs and names live in, NULL if the
+   * simulator was not loaded from an image */
+  void *mapping;
+  /** The size of the mapping in bytes */
+  size_t mappingSize;
+  /** Page the programs of an image in with at most this many bytes of
+   * frames, 0 to map them whole */
+  size_t memoryBudget;
+  /** The pager of a paged image, NULL if the programs are in memory */
+  struct pager *pager;
+  /** The stream the trace is written to, NULL to suppress it */
+  FILE *trace;
+  /** The number of completed instructions */
+  long long instructionsExecuted;
+  /** The ticks no process was ready while a periodic one slept, see
+   * realtime.h */
+  long long idle;
+  /** No job of a periodic process arrives at or after this time, 0 for the
+   * default, see realtime_reset */
+  long long horizon;
+  /** The number of processes terminated to recover from a deadlock */
+  int deadlockVictims;
+  /** The number of deadlocks detected, not saved in checkpoints */
+  long long deadlocks;
+  /** The algorithm the processes are scheduled with, saved in checkpoints */
+  int scheduleAlg;
+  /** The time slice the processes are scheduled with */
+  int quantum;
+  /** How shared and exclusive requests of a resource take turns,
+   * PROCSCHED_WRITER_PREFERRING or PROCSCHED_FAIR, saved in checkpoints */
+  int rwPolicy;
+  /** The checkpoint written while running, NULL for none */
+  const char *checkpointFile;
+  /** Write a checkpoint every this many instructions, 0 for never */
+  long long checkpointEvery;
+  /** The number of instructions after which the next checkpoint is due */
+  long long nextCheckpoint;
+  /** Write a checkpoint as soon as this flag is set, e.g. by a signal
+   * handler, NULL for none. It is cleared when the checkpoint is written */
+  volatile sig_atomic_t *checkpointRequest;
+  /** The recording or replay of the run, NULL for none, see replay.h */
+  struct recording *recording;
+  /** The shared memory segment the counters are published to, NULL for
+   * none, see monitor.h */
+  struct monitor *monitor;
+  /** Identifies the compiled programs in checkpoints, 0 until computed */
+  uint64_t fingerprint;
+  /** Set once the processes are compiled and can be scheduled */
+  int compiled;
+  /** Set once the processes have been scheduled */
+  int finished;
+};
+
+/*
+ * Initialises an empty simulator that writes its trace to stdout.
+ */
+void simulator_init(struct simulator *sim);
+
+/*
+ * Frees everything loaded into the simulator and empties it again.
+ */
+void simulator_free(struct simulator *sim);
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * @file sweep.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pool.h"
+#include "procsched.h"
+#include "sweep.h"
+
+/**
+ * The views of one sweep_run, one per worker thread.
+ */
+struct sweepRun {
+  struct sweep *sweep;
+  struct simulator **views;
+};
+
+static void add_point(struct sweep *s, int schedule_alg, int quantum);
+static void run_point(int i, int worker, void *arg);
+
+/**
+ * @brief Initialises an empty sweep.
+ *
+ * @param s The sweep.
+ * @param image The loaded simulator to sweep over.
+ */
+void sweep_init(struct sweep *s, const struct simulator *image) {
+  s->image = image;
+  s->points = NULL;
+  s->count = 0;
+  s->capacity = 0;
+}
+
+/**
+ * @brief Adds the configurations described by spec.
+ *
+ * FCFS ignores the quantum, so "0" adds one configuration whatever range
+ * follows it. Priority, EDF and RM accept a quantum of 0, no time slicing,
+ * which is also their default as in a single run; round robin needs 1 or
+ * more and defaults to 1.
+ *
+ * @param s The sweep.
+ * @param spec "alg", "alg:quantum", "alg:first-last" or
+ * "alg:first-last:step".
+ *
+ * @return The number of configurations added or -1 if spec is malformed.
+ */
+int sweep_add(struct sweep *s, const char *spec) {
+  int schedule_alg;
+  int first = -1;
+  int last;
+  int step = 1;
+  int quantum;
+  int consumed = 0;
+  int added = 0;
+
+  if (sscanf(spec, "%d%n", &schedule_alg, &consumed) != 1) {
+    return -1;
+  }
+  spec += consumed;
+  if (*spec == ':') {
+    if (sscanf(spec, ":%d%n", &first, &consumed) != 1 || first < 0) {
+      return -1;
+    }
+    spec += consumed;
+  }
+  if (first == -1) {
+    first = schedule_alg >= PROCSCHED_PRIORITY ? 0 : 1;
+  }
+  last = first;
+  if (*spec == '-') {
+    if (sscanf(spec, "-%d%n", &last, &consumed) != 1) {
+      return -1;
+    }
+    spec += consumed;
+  }
+  if (*spec == ':') {
+    if (sscanf(spec, ":%d%n", &step, &consumed) != 1) {
+      return -1;
+    }
+    spec += consumed;
+  }
+  if (*spec != '\0' || step < 1 ||
+      first < (schedule_alg >= PROCSCHED_PRIORITY ? 0 : 1) || last < first ||
+      schedule_alg < PROCSCHED_FCFS || schedule_alg > PROCSCHED_RM) {
+    return -1;
+  }
+
+  if (schedule_alg == PROCSCHED_FCFS) {
+    add_point(s, schedule_alg, 0);
+    return 1;
+  }
+  for (quantum = first; quantum <= last; quantum += step) {
+    add_point(s, schedule_alg, quantum);
+    ++added;
+  }
+  return added;
+}
+
+/**
+ * @brief Runs every configuration.
+ *
+ * Each worker thread creates one view of the image for its first
+ * configuration and resets it for every further one, so the workload is
+ * never parsed again and a configuration costs one reset and one
+ * scheduling pass.
+ *
+ * @param s The sweep.
+ * @param threads The number of threads.
+ */
+void sweep_run(struct sweep *s, int threads) {
+  struct sweepRun run;
+  int i;
+
+  if (threads < 1) {
+    threads = 1;
+  }
+  run.sweep = s;
+  run.views = calloc(threads, sizeof(struct simulator *));
+
+  pool_run(s->count, threads, run_point, &run);
+
+  for (i = 0; i < threads; i++) {
+    procsched_destroy(run.views[i]);
+  }
+  free(run.views);
+}
+
+/**
+ * @brief Writes the results as a CSV table with a header line.
+ *
+ * @param out The stream to write to.
+ * @param s The sweep.
+ */
+void sweep_print(FILE *out, struct sweep *s) {
+  struct sweepPoint *p;
+  int i;
+
+  fprintf(out, "algorithm,quantum,processes,terminated,deadlock_victims,"
+               "instructions,waits,slices,schedule_s,jobs,deadline_misses\n");
+  for (i = 0; i < s->count; i++) {
+    p = &s->points[i];
+    fprintf(out, "%s,%d,%d,%d,%d,%lld,%lld,%lld,%.6f,%lld,%lld\n",
+            p->scheduleAlg == PROCSCHED_FCFS       ? "fcfs"
+            : p->scheduleAlg == PROCSCHED_RR       ? "rr"
+            : p->scheduleAlg == PROCSCHED_PRIORITY ? "priority"
+            : p->scheduleAlg == PROCSCHED_EDF      ? "edf"
+                                                   : "rm",
+            p->quantum,
+            p->stats.processes, p->stats.terminated, p->stats.deadlockVictims,
+            p->stats.instructions, p->stats.waits, p->stats.slices,
+            p->seconds, p->stats.jobs, p->stats.deadlineMisses);
+  }
+}
+
+/**
+ * @brief Frees the configurations and leaves the sweep empty.
+ *
+ * @param s The sweep.
+ */
+void sweep_free(struct sweep *s) {
+  free(s->points);
+  sweep_init(s, s->image);
+}
+
+/**
+ * @brief Appends one configuration.
+ */
+static void add_point(struct sweep *s, int schedule_alg, int quantum) {
+  struct sweepPoint *p;
+
+  if (s->count == s->capacity) {
+    s->capacity = s->capacity == 0 ? 64 : 2 * s->capacity;
+    s->points = realloc(s->points, sizeof(struct sweepPoint) * s->capacity);
+  }
+
+  p = &s->points[s->count++];
+  p->scheduleAlg = schedule_alg;
+  p->quantum = quantum;
+  memset(&p->stats, 0, sizeof(p->stats));
+  p->seconds = 0;
+}
+
+/**
+ * @brief Runs the i-th configuration on the view of the worker.
+ *
+ * @param i The number of the configuration.
+ * @param worker The thread running the job.
+ * @param arg The sweepRun.
+ */
+static void run_point(int i, int worker, void *arg) {
+  struct sweepRun *run = arg;
+  struct sweepPoint *p = &run->sweep->points[i];
+  struct simulator *view = run->views[worker];
+  struct timespec start, end;
+
+  if (view == NULL) {
+    view = run->views[worker] = procsched_view(run->sweep->image);
+    if (view == NULL) {
+      return;
+    }
+  } else {
+    procsched_reset(view);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  procsched_run(view, p->scheduleAlg, p->quantum);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  procsched_get_stats(view, &p->stats);
+  p->seconds =
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
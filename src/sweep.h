@@ -0,0 +1,71 @@
+/**
+  * @file sweep.h
+  * @description A definition of the sweep mode, which schedules one loaded
+  *              workload under many configurations in parallel.
+  */
+
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include <stdio.h>
+
+#include "procsched.h"
+
+/**
+ * One configuration of a sweep and its result.
+ */
+struct sweepPoint {
+  /** PROCSCHED_FCFS, PROCSCHED_RR, PROCSCHED_PRIORITY, PROCSCHED_EDF or
+   * PROCSCHED_RM */
+  int scheduleAlg;
+  /** The round robin time slice, 0 for FCFS */
+  int quantum;
+  /** The statistics of the simulation */
+  struct procschedStats stats;
+  /** The wall time spent scheduling */
+  double seconds;
+};
+
+/**
+ * The configurations of a sweep over one image.
+ */
+struct sweep {
+  /** The loaded simulator every configuration runs a view of */
+  const struct simulator *image;
+  /** The configurations, in the order they were added */
+  struct sweepPoint *points;
+  /** The number of configurations */
+  int count;
+  /** The number of configurations there is room for */
+  int capacity;
+};
+
+/*
+ * Initialises an empty sweep over image.
+ */
+void sweep_init(struct sweep *s, const struct simulator *image);
+
+/*
+ * Adds the configurations in spec: "alg", "alg:quantum",
+ * "alg:first-last" or "alg:first-last:step", the quantum 0 (no time
+ * slicing) by default for priority, EDF and RM and 1 for round robin.
+ * Returns the number added or -1 if spec is malformed.
+ */
+int sweep_add(struct sweep *s, const char *spec);
+
+/*
+ * Runs every configuration on threads threads.
+ */
+void sweep_run(struct sweep *s, int threads);
+
+/*
+ * Writes the results as a CSV table, one row per configuration.
+ */
+void sweep_print(FILE *out, struct sweep *s);
+
+/*
+ * Frees the sweep, but not the image.
+ */
+void sweep_free(struct sweep *s);
+
+#endif
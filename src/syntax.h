@@ -8,11 +8,30 @@
 #define RESOURCES "Resources"
 #define MAILBOXES "Mailboxes"
 #define PROCESS "Process"
+#define SUBROUTINE "Subroutine"
 #define REQ "req"
+#define REQS "reqs"
+#define REQX "reqx"
 #define REL "rel"
 #define SEND "send"
 #define RECV "recv"
+#define DRAIN "drain"
+#define SUBSCRIBE "subscribe"
+#define UNSUBSCRIBE "unsubscribe"
 #define SYNC "sync"
+#define REPEAT "repeat"
+#define CALL "call"
+#define BLOCKSTART "{"
+#define BLOCKEND "}"
+
+/* The overflow policies of a topic, e.g. T1:64:drop-oldest */
+#define BLOCK "block"
+#define DROP_OLDEST "drop-oldest"
+#define DISCONNECT "disconnect"
+
+/* The priority inversion protocols of a resource, e.g. R1:2:inherit */
+#define INHERIT "inherit"
+#define CEILING "ceiling"
 
 #define LEFTBRACKET 40
 #define RIGHTBRACKET 41
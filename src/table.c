@@ -0,0 +1,669 @@
+/**
+ * @file table.c
+ */
+#include <limits.h>
+#include <stdlib.h>
+
+#include "loader.h"
+#include "table.h"
+
+static void table_grow(struct processTable *t);
+static void resize_heap(struct processTable *t, int capacity);
+static int more_urgent(const struct processTable *t, int a, int b);
+static void sift_up(struct processTable *t, int i);
+static void sift_down(struct processTable *t, int i);
+static void resize_timers(struct processTable *t, int capacity);
+static long long rank_of(const struct processTable *t, int p);
+static int released_first(const struct processTable *t, int a, int b);
+
+/**
+ * @brief Initialises an empty process table.
+ *
+ * @param t The table to initialise.
+ * @param capacity The number of processes to make room for.
+ */
+void table_init(struct processTable *t, int capacity) {
+  t->count = 0;
+  t->freeSlot = -1;
+  t->capacity = 0;
+  t->state = NULL;
+  t->nextOp = NULL;
+  t->resume = NULL;
+  t->priority = NULL;
+  t->next = NULL;
+  t->prev = NULL;
+  t->waitSet = NULL;
+  t->released = NULL;
+  t->pcb = NULL;
+  t->waitQueues = NULL;
+  t->readQueues = NULL;
+  t->setQueue = NULL;
+  t->sendQueues = NULL;
+  t->recvQueues = NULL;
+  t->waitQueueCount = 0;
+  t->syncQueues = NULL;
+  t->generations = NULL;
+  t->barrierCount = 0;
+  t->availableBits = NULL;
+  t->waiting = 0;
+  t->prioritized = 0;
+  t->heap = NULL;
+  t->heapCount = 0;
+  t->heapIndex = NULL;
+  t->readySeq = NULL;
+  t->readyCount = 0;
+  t->rank = NULL;
+  t->blockedOn = NULL;
+  t->timed = 0;
+  t->release = NULL;
+  t->deadline = NULL;
+  t->timers = NULL;
+  t->timerCount = 0;
+  t->loops = NULL;
+  t->loopCounters = NULL;
+  queue_init(&t->readyQueue);
+  queue_init(&t->terminatedQueue);
+
+  while (t->capacity < capacity) {
+    table_grow(t);
+  }
+}
+
+/**
+ * @brief Adds a process to the table.
+ *
+ * The process is NEW, has no ops and is not in a queue. It takes the slot
+ * freed last by table_remove if there is one.
+ *
+ * @param t The process table.
+ * @param pcb The process control block with the cold data of the process.
+ *
+ * @return The number of the process, its index in the arrays.
+ */
+int table_add(struct processTable *t, struct processControlBlock *pcb) {
+  int number;
+
+  if (t->freeSlot != -1) {
+    number = t->freeSlot;
+    t->freeSlot = t->next[number];
+  } else {
+    if (t->count == t->capacity) {
+      table_grow(t);
+    }
+    number = t->count++;
+  }
+
+  t->state[number] = NEW;
+  t->nextOp[number] = NULL;
+  t->resume[number] = 0;
+  t->priority[number] = 0;
+  t->next[number] = -1;
+  t->prev[number] = -1;
+  t->released[number] = 0;
+  t->pcb[number] = pcb;
+  if (t->prioritized) {
+    t->heapIndex[number] = -1;
+    t->blockedOn[number] = -1;
+    t->rank[number] = 0;
+  }
+  if (t->timed) {
+    t->deadline[number] = LLONG_MAX;
+  }
+
+  return number;
+}
+
+/**
+ * @brief Removes a process from the table.
+ *
+ * The slot of the process becomes free and is reused by the next call of
+ * table_add, so a table whose processes come and go does not grow. The
+ * loop stack the process got from table_add_loop_stack is freed.
+ *
+ * @param t The process table.
+ * @param p The process, which must not be in a queue.
+ */
+void table_remove(struct processTable *t, int p) {
+  t->state[p] = TERMINATED;
+  t->nextOp[p] = NULL;
+  t->released[p] = 0;
+  t->pcb[p] = NULL;
+  t->prev[p] = -1;
+  t->next[p] = t->freeSlot;
+  t->freeSlot = p;
+  if (t->loops != NULL) {
+    free(t->loops[p].counters);
+    t->loops[p].counters = NULL;
+    t->loops[p].depth = 0;
+  }
+}
+
+/**
+ * @brief Creates two empty wait queues per resource and per mailbox.
+ *
+ * The queues of the exclusive requests come first, then the readQueues of
+ * the shared requests, the setQueue of the requests of resource sets and
+ * the sendQueues and recvQueues of the mailboxes. One more queue follows
+ * them for requests of a resource that does not exist. The availability
+ * bitset is cleared, the scheduler fills it in with refresh_available_bits.
+ *
+ * @param t The process table.
+ * @param resources The number of resources.
+ * @param mailboxes The number of mailboxes.
+ */
+void table_init_wait_queues(struct processTable *t, int resources,
+                            int mailboxes) {
+  int count = 2 * resources + 2 * mailboxes + 1;
+  int i;
+
+  free(t->waitQueues);
+  t->waitQueues = malloc(sizeof(struct queue) * (count + 1));
+  for (i = 0; i <= count; i++) {
+    queue_init(&t->waitQueues[i]);
+  }
+  t->readQueues = t->waitQueues + resources;
+  t->setQueue = t->waitQueues + 2 * resources;
+  t->sendQueues = t->setQueue + 1;
+  t->recvQueues = t->sendQueues + mailboxes;
+  t->waitQueueCount = count;
+  t->waiting = 0;
+
+  free(t->availableBits);
+  t->availableBits =
+      calloc((resources + 63) / 64 + 1, sizeof(unsigned long long));
+}
+
+/**
+ * @brief Gives the barriers compiled since the last call a wait queue.
+ *
+ * A daemon compiles the barriers of a process when it is admitted, so the
+ * queues of the barriers compiled before, and the processes waiting in them,
+ * are kept.
+ *
+ * @param t The process table.
+ * @param barriers The number of barriers.
+ */
+void table_init_barriers(struct processTable *t, int barriers) {
+  int b;
+
+  if (barriers <= t->barrierCount) {
+    return;
+  }
+  t->syncQueues = realloc(t->syncQueues, sizeof(struct queue) * barriers);
+  t->generations = realloc(t->generations, sizeof(long long) * barriers);
+  for (b = t->barrierCount; b < barriers; b++) {
+    queue_init(&t->syncQueues[b]);
+    t->generations[b] = 0;
+  }
+  t->barrierCount = barriers;
+}
+
+/**
+ * @brief Creates an empty loop stack per process.
+ *
+ * The counters of all processes share one array, each stack has room for
+ * the loop nesting of the program of its process.
+ *
+ * @param t The process table.
+ */
+void table_init_loops(struct processTable *t) {
+  size_t total = 0;
+  int p;
+
+  for (p = 0; p < t->count; p++) {
+    total += t->pcb[p]->pagePtr->loopNesting;
+  }
+  free(t->loops);
+  free(t->loopCounters);
+  t->loops = malloc(sizeof(struct loopStack) *
+                    (t->capacity > t->count ? t->capacity : t->count + 1));
+  t->loopCounters = malloc(sizeof(int) * (total + 1));
+
+  total = 0;
+  for (p = 0; p < t->count; p++) {
+    t->loops[p].counters = t->loopCounters + total;
+    t->loops[p].depth = 0;
+    total += t->pcb[p]->pagePtr->loopNesting;
+  }
+}
+
+/**
+ * @brief Gives a process added after table_init_loops a loop stack.
+ *
+ * @param t The process table.
+ * @param p The process.
+ * @param nesting The loop nesting of its program.
+ */
+void table_add_loop_stack(struct processTable *t, int p, int nesting) {
+  t->loops[p].counters = malloc(sizeof(int) * (nesting + 1));
+  t->loops[p].depth = 0;
+}
+
+/**
+ * @brief Creates the release times, deadlines and timer heap of the
+ * periodic processes.
+ *
+ * Nothing is kept unless the page of a process has a period, so the
+ * scheduler only keeps the time for workloads that need it.
+ *
+ * @param t The process table.
+ */
+void table_init_timers(struct processTable *t) {
+  int p;
+
+  t->timed = 0;
+  for (p = 0; p < t->count; p++) {
+    if (t->pcb[p] != NULL && t->pcb[p]->pagePtr->period > 0) {
+      t->timed = 1;
+      break;
+    }
+  }
+  t->timerCount = 0;
+  resize_timers(t, t->timed ? t->capacity : 0);
+  for (p = 0; t->timed && p < t->count; p++) {
+    t->release[p] = 0;
+    t->deadline[p] = LLONG_MAX;
+  }
+}
+
+/**
+ * @brief Returns every process to the state it had after loading.
+ *
+ * All queues are emptied, every barrier starts its first phase again and every
+ * process is READY at the first op of its compiled program outside of every
+ * loop, in the ready queue in order of its number.
+ *
+ * @param t The process table.
+ */
+void table_reset(struct processTable *t) {
+  int p;
+
+  queue_init(&t->readyQueue);
+  queue_init(&t->terminatedQueue);
+  for (p = 0; t->waitQueues != NULL && p <= t->waitQueueCount; p++) {
+    queue_init(&t->waitQueues[p]);
+  }
+  for (p = 0; p < t->barrierCount; p++) {
+    queue_init(&t->syncQueues[p]);
+    t->generations[p] = 0;
+  }
+  t->waiting = 0;
+  t->timerCount = 0;
+
+  for (p = 0; p < t->count; p++) {
+    t->state[p] = READY;
+    t->nextOp[p] = t->pcb[p]->pagePtr->program;
+    t->resume[p] = 0;
+    t->priority[p] = t->pcb[p]->pagePtr->priority;
+    t->released[p] = 0;
+    if (t->loops != NULL) {
+      t->loops[p].depth = 0;
+    }
+    if (t->timed) {
+      t->release[p] = 0;
+      t->deadline[p] = LLONG_MAX;
+    }
+    enqueue(t, &t->readyQueue, p);
+  }
+  if (t->prioritized) {
+    table_prioritize(t, t->prioritized);
+  }
+}
+
+/**
+ * @brief Switches between taking the ready processes in order of urgency
+ * and in order of the readyQueue.
+ *
+ * The ready heap is built from the readyQueue, so processes of equal
+ * urgency keep their order, and what each waiting process waits for is
+ * read from the wait queues of the resources. Both only depend on the
+ * queues, deadlines and priorities, so a table restored from a checkpoint
+ * is prioritized like the table it was saved from. Switching it off frees
+ * the heap.
+ *
+ * @param t The process table.
+ * @param prioritized TABLE_BY_PRIORITY, TABLE_BY_DEADLINE or
+ * TABLE_BY_PERIOD to take the ready processes in that order, 0 to take them
+ * in order of the readyQueue.
+ */
+void table_prioritize(struct processTable *t, int prioritized) {
+  int resources = t->waitQueues != NULL ? t->readQueues - t->waitQueues : 0;
+  int r;
+  int p;
+
+  t->prioritized = 0;
+  t->heapCount = 0;
+  t->readyCount = 0;
+  resize_heap(t, prioritized ? t->capacity : 0);
+  if (!prioritized) {
+    return;
+  }
+  t->prioritized = prioritized;
+
+  for (p = 0; p < t->count; p++) {
+    t->heapIndex[p] = -1;
+    t->blockedOn[p] = -1;
+    t->rank[p] = t->pcb[p] != NULL ? rank_of(t, p) : 0;
+  }
+  for (r = 0; r < resources; r++) {
+    for (p = t->waitQueues[r].head; p != -1; p = t->next[p]) {
+      t->blockedOn[p] = r;
+    }
+    for (p = t->readQueues[r].head; p != -1; p = t->next[p]) {
+      t->blockedOn[p] = r;
+    }
+  }
+  for (p = t->setQueue != NULL ? t->setQueue->head : -1; p != -1;
+       p = t->next[p]) {
+    t->blockedOn[p] = TABLE_BLOCKED_ON_SET;
+  }
+  for (p = t->readyQueue.head; p != -1; p = t->next[p]) {
+    table_ready_push(t, p);
+  }
+}
+
+/**
+ * @brief Adds a process to the ready heap.
+ *
+ * The process goes behind every ready process of its priority.
+ *
+ * @param t The prioritized process table.
+ * @param p The process, which just joined the readyQueue.
+ */
+void table_ready_push(struct processTable *t, int p) {
+  t->rank[p] = rank_of(t, p);
+  t->readySeq[p] = t->readyCount++;
+  t->heap[t->heapCount] = p;
+  t->heapIndex[p] = t->heapCount++;
+  sift_up(t, t->heapIndex[p]);
+}
+
+/**
+ * @brief Removes the most urgent process from the ready heap.
+ *
+ * The caller takes it out of the readyQueue as well.
+ *
+ * @param t The prioritized process table.
+ *
+ * @return The process, -1 if no process is ready.
+ */
+int table_ready_pop(struct processTable *t) {
+  int p;
+
+  if (t->heapCount == 0) {
+    return -1;
+  }
+  p = t->heap[0];
+  t->heapIndex[p] = -1;
+  if (--t->heapCount > 0) {
+    t->heap[0] = t->heap[t->heapCount];
+    t->heapIndex[t->heap[0]] = 0;
+    sift_down(t, 0);
+  }
+  return p;
+}
+
+/**
+ * @brief Changes the effective priority of a process.
+ *
+ * A ready process moves up or down the ready heap, which takes O(log n)
+ * time; the priority of any other process is only stored.
+ *
+ * @param t The process table.
+ * @param p The process.
+ * @param priority The new effective priority.
+ */
+void table_set_priority(struct processTable *t, int p, int priority) {
+  int raised = priority > t->priority[p];
+
+  t->priority[p] = priority;
+  if (!t->prioritized || t->heapIndex[p] < 0) {
+    return;
+  }
+  if (raised) {
+    sift_up(t, t->heapIndex[p]);
+  } else {
+    sift_down(t, t->heapIndex[p]);
+  }
+}
+
+/**
+ * @brief Checks if a process is more urgent than another.
+ *
+ * The rank decides, and the effective priority between processes of equal
+ * rank. Processes of equal rank and priority are equally urgent.
+ *
+ * @param t The prioritized process table.
+ * @param a A process.
+ * @param b Another process.
+ *
+ * @return 1 if a is more urgent than b, otherwise 0.
+ */
+int table_more_urgent(const struct processTable *t, int a, int b) {
+  if (t->rank[a] != t->rank[b]) {
+    return t->rank[a] < t->rank[b];
+  }
+  return t->priority[a] > t->priority[b];
+}
+
+/**
+ * @brief Adds a sleeping process to the timer heap.
+ *
+ * Processes released at the same time are taken in order of their number.
+ *
+ * @param t The timed process table.
+ * @param p The process, whose release time is set.
+ */
+void table_timer_push(struct processTable *t, int p) {
+  int i = t->timerCount++;
+  int parent;
+
+  while (i > 0 && released_first(t, p, t->timers[parent = (i - 1) / 2])) {
+    t->timers[i] = t->timers[parent];
+    i = parent;
+  }
+  t->timers[i] = p;
+}
+
+/**
+ * @brief Removes the process released first from the timer heap.
+ *
+ * @param t The timed process table.
+ *
+ * @return The process, -1 if no process sleeps.
+ */
+int table_timer_pop(struct processTable *t) {
+  int p;
+  int last;
+  int child;
+  int i = 0;
+
+  if (t->timerCount == 0) {
+    return -1;
+  }
+  p = t->timers[0];
+  last = t->timers[--t->timerCount];
+  while ((child = 2 * i + 1) < t->timerCount) {
+    if (child + 1 < t->timerCount &&
+        released_first(t, t->timers[child + 1], t->timers[child])) {
+      ++child;
+    }
+    if (!released_first(t, t->timers[child], last)) {
+      break;
+    }
+    t->timers[i] = t->timers[child];
+    i = child;
+  }
+  t->timers[i] = last;
+  return p;
+}
+
+/**
+ * @brief Frees the arrays of the table and leaves it empty.
+ *
+ * The process control blocks are freed by dealloc_processes.
+ *
+ * @param t The table to free.
+ */
+void table_free(struct processTable *t) {
+  free(t->state);
+  free(t->nextOp);
+  free(t->resume);
+  free(t->priority);
+  free(t->next);
+  free(t->prev);
+  free(t->waitSet);
+  free(t->released);
+  free(t->pcb);
+  free(t->waitQueues);
+  free(t->syncQueues);
+  free(t->generations);
+  free(t->availableBits);
+  resize_heap(t, 0);
+  resize_timers(t, 0);
+  free(t->loops);
+  free(t->loopCounters);
+  table_init(t, 0);
+}
+
+/**
+ * @brief Doubles the capacity of every array of the table.
+ */
+static void table_grow(struct processTable *t) {
+  int capacity = t->capacity == 0 ? 64 : 2 * t->capacity;
+
+  t->state = realloc(t->state, sizeof(unsigned char) * capacity);
+  t->nextOp = realloc(t->nextOp, sizeof(struct op *) * capacity);
+  t->resume = realloc(t->resume, sizeof(int) * capacity);
+  t->priority = realloc(t->priority, sizeof(int) * capacity);
+  t->next = realloc(t->next, sizeof(int) * capacity);
+  t->prev = realloc(t->prev, sizeof(int) * capacity);
+  t->waitSet = realloc(t->waitSet, sizeof(int) * capacity);
+  t->released = realloc(t->released, sizeof(unsigned char) * capacity);
+  t->pcb = realloc(t->pcb, sizeof(struct processControlBlock *) * capacity);
+  if (t->loops != NULL) {
+    t->loops = realloc(t->loops, sizeof(struct loopStack) * capacity);
+  }
+  if (t->prioritized) {
+    resize_heap(t, capacity);
+  }
+  if (t->timed) {
+    resize_timers(t, capacity);
+  }
+  t->capacity = capacity;
+}
+
+/**
+ * @brief Gives the arrays of the ready heap room for capacity processes,
+ * freeing them for a capacity of 0.
+ */
+static void resize_heap(struct processTable *t, int capacity) {
+  if (capacity == 0) {
+    free(t->heap);
+    free(t->heapIndex);
+    free(t->readySeq);
+    free(t->rank);
+    free(t->blockedOn);
+    t->heap = t->heapIndex = t->blockedOn = NULL;
+    t->readySeq = t->rank = NULL;
+    return;
+  }
+  t->heap = realloc(t->heap, sizeof(int) * capacity);
+  t->heapIndex = realloc(t->heapIndex, sizeof(int) * capacity);
+  t->readySeq = realloc(t->readySeq, sizeof(long long) * capacity);
+  t->rank = realloc(t->rank, sizeof(long long) * capacity);
+  t->blockedOn = realloc(t->blockedOn, sizeof(int) * capacity);
+}
+
+/**
+ * @brief Gives the release times, deadlines and timer heap room for
+ * capacity processes, freeing them for a capacity of 0.
+ */
+static void resize_timers(struct processTable *t, int capacity) {
+  if (capacity == 0) {
+    free(t->release);
+    free(t->deadline);
+    free(t->timers);
+    t->release = t->deadline = NULL;
+    t->timers = NULL;
+    return;
+  }
+  t->release = realloc(t->release, sizeof(long long) * capacity);
+  t->deadline = realloc(t->deadline, sizeof(long long) * capacity);
+  t->timers = realloc(t->timers, sizeof(int) * capacity);
+}
+
+/**
+ * @brief Returns the rank of a process in the order of the ready heap.
+ */
+static long long rank_of(const struct processTable *t, int p) {
+  int period;
+
+  switch (t->prioritized) {
+  case TABLE_BY_DEADLINE:
+    return t->timed ? t->deadline[p] : LLONG_MAX;
+  case TABLE_BY_PERIOD:
+    period = t->pcb[p]->pagePtr->period;
+    return period > 0 ? period : LLONG_MAX;
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks if process a goes before process b in the ready heap.
+ */
+static int more_urgent(const struct processTable *t, int a, int b) {
+  if (t->rank[a] != t->rank[b] || t->priority[a] != t->priority[b]) {
+    return table_more_urgent(t, a, b);
+  }
+  return t->readySeq[a] < t->readySeq[b];
+}
+
+/**
+ * @brief Checks if process a goes before process b in the timer heap.
+ */
+static int released_first(const struct processTable *t, int a, int b) {
+  return t->release[a] != t->release[b] ? t->release[a] < t->release[b]
+                                        : a < b;
+}
+
+/**
+ * @brief Moves the process at index i of the ready heap towards the root
+ * until its parent is more urgent.
+ */
+static void sift_up(struct processTable *t, int i) {
+  int p = t->heap[i];
+  int parent;
+
+  while (i > 0 && more_urgent(t, p, t->heap[parent = (i - 1) / 2])) {
+    t->heap[i] = t->heap[parent];
+    t->heapIndex[t->heap[i]] = i;
+    i = parent;
+  }
+  t->heap[i] = p;
+  t->heapIndex[p] = i;
+}
+
+/**
+ * @brief Moves the process at index i of the ready heap towards the leaves
+ * until it is more urgent than its children.
+ */
+static void sift_down(struct processTable *t, int i) {
+  int p = t->heap[i];
+  int child;
+
+  while ((child = 2 * i + 1) < t->heapCount) {
+    if (child + 1 < t->heapCount &&
+        more_urgent(t, t->heap[child + 1], t->heap[child])) {
+      ++child;
+    }
+    if (!more_urgent(t, t->heap[child], p)) {
+      break;
+    }
+    t->heap[i] = t->heap[child];
+    t->heapIndex[t->heap[i]] = i;
+    i = child;
+  }
+  t->heap[i] = p;
+  t->heapIndex[p] = i;
+}
@@ -0,0 +1,259 @@
+/**
+  * @file table.h
+  * @description A definition of the process table, which stores the
+  *              scheduling state of every process in parallel arrays.
+  */
+
+#ifndef _TABLE_H
+#define _TABLE_H
+
+#include "queue.h"
+
+struct op;
+struct processControlBlock;
+
+/** The blockedOn entry of a process waiting on a request of a resource
+ * set */
+#define TABLE_BLOCKED_ON_SET -2
+
+/** Take the ready processes in order of priority */
+#define TABLE_BY_PRIORITY 1
+/** Take the ready processes in order of the deadline of their job, then
+ * of priority */
+#define TABLE_BY_DEADLINE 2
+/** Take the ready processes in order of their period, then of priority */
+#define TABLE_BY_PERIOD 3
+
+/**
+ * The counters of the loops a process is inside of, innermost last.
+ */
+struct loopStack {
+  /** The iterations left of each loop, room for the nesting of the program */
+  int *counters;
+  /** The number of loops the process is inside of */
+  int depth;
+};
+
+/**
+ * The process table. The fields the scheduler touches on every time slice
+ * are kept in dense arrays indexed by the process number, so scheduling a
+ * process does not chase pointers through its process control block. The
+ * process control block keeps the cold data: the name, the acquired
+ * resources and the statistics.
+ */
+struct processTable {
+  /** The number of processes in the table, including free slots */
+  int count;
+  /** The first slot freed by table_remove, -1 if none. Free slots are
+   * TERMINATED, have no process control block and are linked through next */
+  int freeSlot;
+  /** The number of processes the arrays have room for */
+  int capacity;
+  /** The state of each process, NEW to SLEEPING */
+  unsigned char *state;
+  /** The next op each process executes */
+  struct op **nextOp;
+  /** Paged: the index of the next op of each process while its block is
+   * not in memory. It is kept here rather than in the page, which views
+   * of an image share between threads */
+  int *resume;
+  /** The effective priority of each process, a larger number being more
+   * urgent. It is the base priority of its page unless the process was
+   * raised by a resource it holds, see process_request */
+  int *priority;
+  /** The next process in the queue the process is in, -1 at the tail */
+  int *next;
+  /** The previous process in the queue the process is in, -1 at the head */
+  int *prev;
+  /** The resource set each process in the setQueue waits for, so waking
+   * it does not page its next op in while another process runs */
+  int *waitSet;
+  /** Set for each process released from a barrier that has not run its
+   * sync op again, which lets it pass instead of arriving again */
+  unsigned char *released;
+  /** The process control block holding the cold data of each process */
+  struct processControlBlock **pcb;
+  /** The processes ready to run */
+  struct queue readyQueue;
+  /** The processes that have terminated, in order of termination */
+  struct queue terminatedQueue;
+  /** One queue of waiting processes per resource, indexed by the operand of
+   * the exclusive request the processes wait on, followed by the readQueues,
+   * the setQueue, the sendQueues, the recvQueues and the queue of requests
+   * for unknown resources */
+  struct queue *waitQueues;
+  /** One queue per resource of the processes waiting on a shared request,
+   * part of waitQueues */
+  struct queue *readQueues;
+  /** The queue of the processes waiting on a request of a resource set,
+   * part of waitQueues */
+  struct queue *setQueue;
+  /** One queue per mailbox of the processes waiting to send to it while it
+   * is full, part of waitQueues */
+  struct queue *sendQueues;
+  /** One queue per mailbox of the processes waiting to receive from it
+   * while it is empty, part of waitQueues */
+  struct queue *recvQueues;
+  /** The index of the last wait queue, for unknown resources */
+  int waitQueueCount;
+  /** One queue per barrier of the processes that arrived at it in the
+   * current phase, in order of arrival */
+  struct queue *syncQueues;
+  /** The number of phases each barrier has completed */
+  long long *generations;
+  /** The number of barriers with a queue */
+  int barrierCount;
+  /** One bit per resource, set while an instance is free for an exclusive
+   * request, so a resource set is checked a word at a time */
+  unsigned long long *availableBits;
+  /** The number of processes in the wait queues */
+  int waiting;
+  /** TABLE_BY_PRIORITY, TABLE_BY_DEADLINE or TABLE_BY_PERIOD while the
+   * ready processes are taken from the ready heap in that order, 0 while
+   * they are taken from the head of the readyQueue */
+  int prioritized;
+  /** The ready processes as a binary heap, the most urgent first, and
+   * among equal ranks and priorities the one that became ready first. The
+   * processes are in the readyQueue as well, which keeps their order for
+   * checkpoints */
+  int *heap;
+  /** The number of processes in the heap */
+  int heapCount;
+  /** The index of each process in the heap, -1 if it is not in it */
+  int *heapIndex;
+  /** The number of times any process became ready before each process
+   * last did, which orders processes of equal priority */
+  long long *readySeq;
+  /** The number of times a process became ready */
+  long long readyCount;
+  /** What orders each process before its priority, the smaller first, set
+   * whenever it becomes ready: the deadline of its job by deadline, its
+   * period by period, LLONG_MAX for a process that is not periodic by
+   * either, and 0 by priority */
+  long long *rank;
+  /** The resource each process waiting on an exclusive or shared request
+   * waits for, TABLE_BLOCKED_ON_SET for a request of a resource set,
+   * whose set is in waitSet, and -1 for any other process. Only kept while
+   * prioritized */
+  int *blockedOn;
+  /** Set if a process is periodic, which makes the scheduler keep the
+   * time and release its jobs from the timer heap */
+  int timed;
+  /** The time the current job of each periodic process was released at,
+   * or its next job is released at while it sleeps */
+  long long *release;
+  /** The time the current job of each periodic process must complete by,
+   * LLONG_MAX for any other process */
+  long long *deadline;
+  /** The SLEEPING processes as a binary heap, the one released first at
+   * the root */
+  int *timers;
+  /** The number of processes in the timer heap */
+  int timerCount;
+  /** The loop stack of each process */
+  struct loopStack *loops;
+  /** The counters of every loop stack in one array */
+  int *loopCounters;
+};
+
+/*
+ * Initialises an empty process table with room for capacity processes.
+ */
+void table_init(struct processTable *t, int capacity);
+
+/*
+ * Adds a process to the table and returns its number.
+ */
+int table_add(struct processTable *t, struct processControlBlock *pcb);
+
+/*
+ * Removes process p, which is in no queue, from the table. Its number is
+ * given to the next process added.
+ */
+void table_remove(struct processTable *t, int p);
+
+/*
+ * Creates two empty wait queues per resource, one for exclusive and one for
+ * shared requests, the queue of requests of resource sets, two per mailbox,
+ * one for senders and one for receivers, and a cleared availability bitset.
+ */
+void table_init_wait_queues(struct processTable *t, int resources,
+                            int mailboxes);
+
+/*
+ * Gives every barrier up to the given number an empty queue and generation
+ * 0, keeping the queues of the barriers that have one.
+ */
+void table_init_barriers(struct processTable *t, int barriers);
+
+/*
+ * Creates an empty loop stack per process with room for the loop nesting of
+ * its program.
+ */
+void table_init_loops(struct processTable *t);
+
+/*
+ * Gives process p, added after table_init_loops, a loop stack of its own
+ * with room for nesting loops. It is freed by table_remove.
+ */
+void table_add_loop_stack(struct processTable *t, int p, int nesting);
+
+/*
+ * Keeps release times, deadlines and a timer heap if a process is periodic,
+ * otherwise frees them.
+ */
+void table_init_timers(struct processTable *t);
+
+/*
+ * Puts every process back in the ready queue at the first op of its program.
+ */
+void table_reset(struct processTable *t);
+
+/*
+ * Takes the ready processes in the given order from now on, TABLE_BY_*,
+ * building the ready heap from the readyQueue, or from the head of the
+ * readyQueue for 0.
+ */
+void table_prioritize(struct processTable *t, int prioritized);
+
+/*
+ * Returns 1 if process a is more urgent than process b, by rank and then by
+ * priority, otherwise 0.
+ */
+int table_more_urgent(const struct processTable *t, int a, int b);
+
+/*
+ * Adds process p, which just joined the readyQueue, to the ready heap.
+ */
+void table_ready_push(struct processTable *t, int p);
+
+/*
+ * Removes the most urgent process from the ready heap and returns it, -1 if
+ * the heap is empty. It stays in the readyQueue.
+ */
+int table_ready_pop(struct processTable *t);
+
+/*
+ * Sets the effective priority of process p, moving it in the ready heap if
+ * it is in it.
+ */
+void table_set_priority(struct processTable *t, int p, int priority);
+
+/*
+ * Adds process p, which is SLEEPING until its release time, to the timer
+ * heap.
+ */
+void table_timer_push(struct processTable *t, int p);
+
+/*
+ * Removes the process released first from the timer heap and returns it, -1
+ * if the heap is empty.
+ */
+int table_timer_pop(struct processTable *t);
+
+/*
+ * Frees the arrays of the table.
+ */
+void table_free(struct processTable *t);
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file topic.c
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "loader.h"
+#include "topic.h"
+
+static int drop_received(struct mailbox *mail);
+
+/**
+ * @brief Makes a mailbox a topic.
+ *
+ * Nothing but the topic itself is allocated until the first subscriber.
+ *
+ * @param mail An empty mailbox.
+ * @param policy TOPIC_BLOCK, TOPIC_DROP_OLDEST or TOPIC_DISCONNECT.
+ */
+void topic_init(struct mailbox *mail, int policy) {
+  struct topic *topic = malloc(sizeof(struct topic));
+
+  topic->policy = policy;
+  topic->published = 0;
+  topic->pending = NULL;
+  topic->subscribers = NULL;
+  topic->count = 0;
+  topic->capacity = 0;
+  topic->subscriberOf = NULL;
+  topic->processes = 0;
+  mail->topic = topic;
+}
+
+/**
+ * @brief Frees the subscribers of a topic.
+ *
+ * The mailbox is a plain mailbox afterwards, its messages are left alone.
+ *
+ * @param mail The mailbox, which may not be a topic.
+ */
+void topic_free(struct mailbox *mail) {
+  struct topic *topic = mail->topic;
+
+  if (topic == NULL) {
+    return;
+  }
+  free(topic->pending);
+  free(topic->subscribers);
+  free(topic->subscriberOf);
+  free(topic);
+  mail->topic = NULL;
+}
+
+/**
+ * @brief Empties a topic and removes all its subscribers.
+ *
+ * The arrays are kept for the next run.
+ *
+ * @param mail The topic.
+ */
+void topic_reset(struct mailbox *mail) {
+  struct topic *topic = mail->topic;
+  int s;
+
+  mailbox_drop(mail, mail->count);
+  for (s = 0; s < topic->count; s++) {
+    topic->subscriberOf[topic->subscribers[s].process] = -1;
+  }
+  topic->count = 0;
+  topic->published = 0;
+}
+
+/**
+ * @brief Finds the subscriber of a process.
+ *
+ * @param mail The topic.
+ * @param p The number of the process.
+ *
+ * @return The index of the subscriber, -1 if the process is not subscribed.
+ */
+int topic_subscriber(const struct mailbox *mail, int p) {
+  return p < mail->topic->processes ? mail->topic->subscriberOf[p] : -1;
+}
+
+/**
+ * @brief Subscribes a process to a topic.
+ *
+ * The process receives the messages sent from now on, so its cursor starts
+ * at the next sequence number.
+ *
+ * @param mail The topic.
+ * @param p The number of the process.
+ *
+ * @return The index of the subscriber, -1 if it is subscribed already.
+ */
+int topic_subscribe(struct mailbox *mail, int p) {
+  struct topic *topic = mail->topic;
+  int processes;
+  int i;
+
+  if (topic_subscriber(mail, p) >= 0) {
+    return -1;
+  }
+  if (p >= topic->processes) {
+    processes = topic->processes > 0 ? 2 * topic->processes : 64;
+    processes = processes > p ? processes : p + 1;
+    topic->subscriberOf =
+        realloc(topic->subscriberOf, sizeof(int) * processes);
+    for (i = topic->processes; i < processes; i++) {
+      topic->subscriberOf[i] = -1;
+    }
+    topic->processes = processes;
+  }
+  if (topic->count == topic->capacity) {
+    topic->capacity = topic->capacity > 0 ? 2 * topic->capacity : 8;
+    topic->subscribers = realloc(
+        topic->subscribers, sizeof(struct subscriber) * topic->capacity);
+  }
+  topic->subscribers[topic->count].process = p;
+  topic->subscribers[topic->count].cursor = topic->published;
+  topic->subscriberOf[p] = topic->count;
+  return topic->count++;
+}
+
+/**
+ * @brief Removes a subscriber from a topic.
+ *
+ * The messages it has not received are released as if it had, and the last
+ * subscriber is moved to its index.
+ *
+ * @param mail The topic.
+ * @param s The index of the subscriber.
+ *
+ * @return The number of slots freed.
+ */
+int topic_unsubscribe(struct mailbox *mail, int s) {
+  struct topic *topic = mail->topic;
+  int freed = topic_receive(mail, s, topic_unread(mail, s));
+
+  topic->subscriberOf[topic->subscribers[s].process] = -1;
+  if (s != --topic->count) {
+    topic->subscribers[s] = topic->subscribers[topic->count];
+    topic->subscriberOf[topic->subscribers[s].process] = s;
+  }
+  return freed;
+}
+
+/**
+ * @brief Sends a message to every subscriber of a topic.
+ *
+ * The message is stored once and its slot counts the subscribers that have
+ * yet to receive it. The pending counts are grown and moved exactly as
+ * mailbox_put grows the ring, so both stay indexed by the same slots.
+ *
+ * @param mail A topic with fewer than capacity messages.
+ * @param msg The message.
+ */
+void topic_publish(struct mailbox *mail, struct message *msg) {
+  struct topic *topic = mail->topic;
+  int slots;
+
+  ++topic->published;
+  if (topic->count == 0) {
+    return;
+  }
+  if (mail->count == mail->slots) {
+    slots = mail->slots > 0 ? 2 * mail->slots : 8;
+    topic->pending = realloc(topic->pending, sizeof(int) * slots);
+    memcpy(topic->pending + mail->slots, topic->pending,
+           sizeof(int) * mail->head);
+  }
+  mailbox_put(mail, msg);
+  topic->pending[(mail->head + mail->count - 1) & (mail->slots - 1)] =
+      topic->count;
+}
+
+/**
+ * @brief Returns the number of messages a subscriber has not received.
+ *
+ * @param mail The topic.
+ * @param s The index of the subscriber.
+ */
+int topic_unread(const struct mailbox *mail, int s) {
+  return mail->topic->published - mail->topic->subscribers[s].cursor;
+}
+
+/**
+ * @brief Returns a message a subscriber has not received.
+ *
+ * @param mail The topic.
+ * @param s The index of the subscriber.
+ * @param i The position of the message, 0 for the oldest it has not
+ * received.
+ *
+ * @return The message.
+ */
+struct message *topic_message(const struct mailbox *mail, int s, int i) {
+  const struct topic *topic = mail->topic;
+
+  return mailbox_message(mail, topic->subscribers[s].cursor + i -
+                                   (topic->published - mail->count));
+}
+
+/**
+ * @brief Moves a subscriber past its oldest messages.
+ *
+ * Messages no subscriber still has to receive are dropped from the front of
+ * the ring.
+ *
+ * @param mail The topic.
+ * @param s The index of the subscriber.
+ * @param n The number of messages, at most the number it has not received.
+ *
+ * @return The number of slots freed.
+ */
+int topic_receive(struct mailbox *mail, int s, int n) {
+  struct topic *topic = mail->topic;
+  int first = topic->subscribers[s].cursor - (topic->published - mail->count);
+  int i;
+
+  for (i = first; i < first + n; i++) {
+    --topic->pending[(mail->head + i) & (mail->slots - 1)];
+  }
+  topic->subscribers[s].cursor += n;
+  return first == 0 && n > 0 ? drop_received(mail) : 0;
+}
+
+/**
+ * @brief Drops the messages at the front of the ring that every subscriber
+ * has received.
+ *
+ * @return The number of messages dropped.
+ */
+static int drop_received(struct mailbox *mail) {
+  int n = 0;
+
+  while (n < mail->count &&
+         mail->topic->pending[(mail->head + n) & (mail->slots - 1)] == 0) {
+    ++n;
+  }
+  mailbox_drop(mail, n);
+  return n;
+}
@@ -0,0 +1,117 @@
+/**
+  * @file topic.h
+  * @description A definition of topic mailboxes, which deliver every message
+  *              sent to them to each of their subscribers.
+  */
+
+#ifndef _TOPIC_H
+#define _TOPIC_H
+
+struct mailbox;
+struct message;
+
+/** A full topic makes the sender wait for its slowest subscriber */
+#define TOPIC_BLOCK 1
+/** A full topic drops the oldest message of its slowest subscribers */
+#define TOPIC_DROP_OLDEST 2
+/** A full topic unsubscribes its slowest subscribers */
+#define TOPIC_DISCONNECT 3
+
+/**
+ * A subscriber of a topic.
+ */
+struct subscriber {
+  /** The number of the process */
+  int process;
+  /** The sequence number of the next message the process receives */
+  long long cursor;
+};
+
+/**
+ * The subscribers of a topic mailbox. The messages are kept once, in the
+ * ring of the mailbox, from the oldest message a subscriber has not
+ * received to the newest, and every subscriber has a cursor into the ring,
+ * as in a disruptor. A message stays in the ring until each subscriber
+ * that was subscribed when it was sent has received it, which the pending
+ * count of its slot tracks, so a receive takes constant time whatever the
+ * number of subscribers.
+ */
+struct topic {
+  /** TOPIC_BLOCK, TOPIC_DROP_OLDEST or TOPIC_DISCONNECT */
+  int policy;
+  /** The number of messages sent to the topic, the sequence number of the
+   * next one */
+  long long published;
+  /** The number of subscribers still to receive the message of each slot
+   * of the ring of the mailbox */
+  int *pending;
+  /** The subscribers in no particular order */
+  struct subscriber *subscribers;
+  /** The number of subscribers */
+  int count;
+  /** The number of subscribers there is room for */
+  int capacity;
+  /** The index of each process in subscribers, -1 if it is not
+   * subscribed, indexed by process number */
+  int *subscriberOf;
+  /** The number of processes subscriberOf has room for */
+  int processes;
+};
+
+/*
+ * Makes a mailbox a topic with the given overflow policy.
+ */
+void topic_init(struct mailbox *mail, int policy);
+
+/*
+ * Frees the subscribers of a topic, but not the mailbox.
+ */
+void topic_free(struct mailbox *mail);
+
+/*
+ * Empties a topic and removes all its subscribers.
+ */
+void topic_reset(struct mailbox *mail);
+
+/*
+ * Returns the index of process p among the subscribers, -1 if it is not
+ * subscribed.
+ */
+int topic_subscriber(const struct mailbox *mail, int p);
+
+/*
+ * Subscribes process p to the messages sent from now on and returns its
+ * index. Returns -1 if it is subscribed already.
+ */
+int topic_subscribe(struct mailbox *mail, int p);
+
+/*
+ * Removes subscriber s, as if it received its messages, and returns the
+ * number of slots this freed. The last subscriber takes index s.
+ */
+int topic_unsubscribe(struct mailbox *mail, int s);
+
+/*
+ * Appends a message for every subscriber to a topic that is not full. A
+ * topic without subscribers drops the message.
+ */
+void topic_publish(struct mailbox *mail, struct message *msg);
+
+/*
+ * Returns the number of messages subscriber s has not received.
+ */
+int topic_unread(const struct mailbox *mail, int s);
+
+/*
+ * Returns message i of those subscriber s has not received, 0 being the
+ * oldest.
+ */
+struct message *topic_message(const struct mailbox *mail, int s, int i);
+
+/*
+ * Moves subscriber s past its n oldest messages and returns the number of
+ * slots this freed.
+ */
+int topic_receive(struct mailbox *mail, int s, int n);
+
+#endif
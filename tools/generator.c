@@ -0,0 +1,384 @@
+/**
+ * @file generator.c
+ * @description Generates synthetic process.list workloads for stress and
+ *              scaling tests.
+ *
+ * The output follows the syntax read by src/parser.c: a Processes line, a
+ * Resources line, an optional Mailboxes line and one Process section per
+ * process made of req, rel, send and recv instructions. Every process runs
+ * critical sections that request distinct resources, at most all of them,
+ * and release them again in reverse order, as many as its instructions
+ * need, and optionally sends or receives messages in its first one.
+ *
+ * Usage: tools/procsched-gen [options] > workload.list
+ *
+ *  -n processes     number of processes (100)
+ *  -i instructions  instructions per process (4)
+ *  -r resources     number of resources (8)
+ *  -m mailboxes     number of mailboxes (0)
+ *  -x mix           fraction of instructions that are send/recv (0)
+ *  -z skew          Zipf exponent of the resource choice, 0 is uniform (0)
+ *  -d               request resources in increasing order and pair every
+ *                   send with a recv after the critical sections (deadlock
+ *                   free)
+ *  -s seed          random seed (1)
+ *  -o file          output file (stdout)
+ *
+ * The output is a pure function of the options, and it is streamed through a
+ * large buffer so multi-GB workloads are written in seconds.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE (1 << 20)
+
+/**
+ * The generator options.
+ */
+struct options {
+  long processes;
+  long instructions;
+  long resources;
+  long mailboxes;
+  double mix;
+  double skew;
+  int ordered;
+  unsigned long long seed;
+};
+
+static FILE *out;
+static char buffer[BUFFER_SIZE];
+static size_t used = 0;
+static unsigned long long state;
+
+/**
+ * @brief Writes the buffered output.
+ */
+static void flush_output() {
+  if (used > 0 && fwrite(buffer, 1, used, out) != used) {
+    perror("procsched-gen");
+    exit(EXIT_FAILURE);
+  }
+  used = 0;
+}
+
+/**
+ * @brief Appends a string to the output buffer.
+ */
+static void put_string(const char *s) {
+  size_t length = strlen(s);
+
+  if (used + length > BUFFER_SIZE) {
+    flush_output();
+  }
+  memcpy(buffer + used, s, length);
+  used += length;
+}
+
+/**
+ * @brief Appends a prefix directly followed by a decimal number, e.g. "R12".
+ */
+static void put_name(const char *prefix, unsigned long number) {
+  char digits[24];
+  int n = 0;
+
+  put_string(prefix);
+  do {
+    digits[n++] = '0' + number % 10;
+    number /= 10;
+  } while (number > 0);
+
+  if (used + n > BUFFER_SIZE) {
+    flush_output();
+  }
+  while (n > 0) {
+    buffer[used++] = digits[--n];
+  }
+}
+
+/**
+ * @brief Returns the next 64 bit random number (splitmix64).
+ */
+static unsigned long long next_random() {
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Returns a uniform random number in [0, 1).
+ */
+static double next_uniform() {
+  return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Builds the cumulative distribution of a Zipf law over n items.
+ *
+ * Item k (0 based) has a weight of 1 / (k + 1)^skew, so a skew of 0 gives a
+ * uniform choice and larger values concentrate requests on the first
+ * resources.
+ */
+static double *zipf_table(long n, double skew) {
+  double *cdf = malloc(sizeof(double) * n);
+  double total = 0;
+  long k;
+
+  for (k = 0; k < n; k++) {
+    total += pow(k + 1, -skew);
+    cdf[k] = total;
+  }
+  for (k = 0; k < n; k++) {
+    cdf[k] /= total;
+  }
+  return cdf;
+}
+
+/**
+ * @brief Draws one of the first n items of the Zipf table by binary search.
+ *
+ * The search is branch free so that the random comparisons do not cost a
+ * misprediction each. Without a table the choice is uniform.
+ */
+static long zipf_draw(double *cdf, long n) {
+  double u;
+  long base = 0, half;
+
+  if (cdf == NULL) {
+    return next_random() % n;
+  }
+
+  u = next_uniform() * cdf[n - 1];
+  while (n > 1) {
+    half = n / 2;
+    base = cdf[base + half - 1] < u ? base + half : base;
+    n -= half;
+  }
+  return base;
+}
+
+/**
+ * @brief Draws n distinct resources into held by a partial Fisher-Yates
+ * shuffle of ids, the resources in Zipf order.
+ *
+ * Draw i picks a position among the first resources - i of ids by the Zipf
+ * law and swaps it with the last of them, so every draw takes one step
+ * however skewed the law is. The swaps are undone afterwards, which keeps
+ * ids in Zipf order for the next section.
+ */
+static void draw_distinct(struct options *o, double *cdf, long *ids,
+                          long *held, long n) {
+  long *position = held + n;
+  long last, swap, i;
+
+  for (i = 0; i < n; i++) {
+    last = o->resources - 1 - i;
+    position[i] = zipf_draw(cdf, last + 1);
+    held[i] = ids[position[i]];
+    ids[position[i]] = ids[last];
+    ids[last] = held[i];
+  }
+  for (i = n - 1; i >= 0; i--) {
+    last = o->resources - 1 - i;
+    swap = ids[last];
+    ids[last] = ids[position[i]];
+    ids[position[i]] = swap;
+  }
+}
+
+static int compare_long(const void *a, const void *b) {
+  long x = *(const long *)a, y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Writes the send and recv instructions of a process.
+ *
+ * With -d every send is followed by a recv from the same mailbox, so a
+ * receiver always finds the message it or another process sent and a
+ * sender waiting for a full mailbox is freed by the recv that follows the
+ * send that filled it; an unpaired instruction is left out.
+ */
+static void write_messages(struct options *o, long number, long count) {
+  unsigned long mailbox;
+  long i;
+
+  for (i = 0; i < (o->ordered ? count / 2 : count); i++) {
+    mailbox = next_random() % o->mailboxes + 1;
+    if (o->ordered) {
+      put_name("send (M", mailbox);
+      put_name(", message ", number);
+      put_name(")\nrecv (M", mailbox);
+      put_string(", message)\n");
+    } else if (next_random() & 1) {
+      put_name("send (M", mailbox);
+      put_name(", message ", number);
+      put_string(")\n");
+    } else {
+      put_name("recv (M", mailbox);
+      put_string(", message)\n");
+    }
+  }
+}
+
+/**
+ * @brief Writes the instructions of one process.
+ *
+ * The req/rel pairs are split into critical sections of at most all the
+ * resources, each requesting distinct resources and releasing them in
+ * reverse order. The send and recv instructions run while the first section
+ * holds its resources, or after the last section with -d, so that only
+ * resources ordered by -d are ever waited for while holding others.
+ * Without mailboxes an odd instruction count is rounded down to whole
+ * req/rel pairs, with -d to whole send/recv pairs.
+ */
+static void write_process(struct options *o, long number, double *cdf,
+                          long *ids, long *held) {
+  long requests, section, c, i;
+  long count = 0;
+  int first = 1;
+
+  for (i = 0; i < o->instructions; i++) {
+    count += o->mailboxes > 0 && next_uniform() < o->mix;
+  }
+  requests = (o->instructions - count) / 2;
+  /* Any instruction that does not fit a req/rel pair becomes a message. */
+  c = o->mailboxes > 0 ? o->instructions - 2 * requests : 0;
+
+  put_name("\nProcess P", number);
+  put_string("\n");
+
+  for (; requests > 0; requests -= section) {
+    section = requests < o->resources ? requests : o->resources;
+    draw_distinct(o, cdf, ids, held, section);
+    if (o->ordered) {
+      qsort(held, section, sizeof(long), compare_long);
+    }
+
+    for (i = 0; i < section; i++) {
+      put_name("req R", held[i] + 1);
+      put_string("\n");
+    }
+    if (first && !o->ordered) {
+      write_messages(o, number, c);
+    }
+    first = 0;
+    for (i = section - 1; i >= 0; i--) {
+      put_name("rel R", held[i] + 1);
+      put_string("\n");
+    }
+  }
+  if (first || o->ordered) {
+    write_messages(o, number, c);
+  }
+}
+
+static void usage(char *name) {
+  fprintf(stderr,
+          "usage: %s [-n processes] [-i instructions] [-r resources] "
+          "[-m mailboxes] [-x mix] [-z skew] [-d] [-s seed] [-o file]\n",
+          name);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  struct options o = {100, 4, 8, 0, 0.0, 0.0, 0, 1};
+  double *cdf;
+  long *ids, *held;
+  long i;
+  int opt;
+
+  out = stdout;
+
+  while ((opt = getopt(argc, argv, "n:i:r:m:x:z:ds:o:")) != -1) {
+    switch (opt) {
+    case 'n':
+      o.processes = atol(optarg);
+      break;
+    case 'i':
+      o.instructions = atol(optarg);
+      break;
+    case 'r':
+      o.resources = atol(optarg);
+      break;
+    case 'm':
+      o.mailboxes = atol(optarg);
+      break;
+    case 'x':
+      o.mix = atof(optarg);
+      break;
+    case 'z':
+      o.skew = atof(optarg);
+      break;
+    case 'd':
+      o.ordered = 1;
+      break;
+    case 's':
+      o.seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'o':
+      out = fopen(optarg, "w");
+      if (out == NULL) {
+        perror(optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (o.processes < 1 || o.instructions < 1 || o.resources < 1 ||
+      o.mailboxes < 0) {
+    usage(argv[0]);
+  }
+
+  state = o.seed;
+  cdf = o.skew > 0 ? zipf_table(o.resources, o.skew) : NULL;
+  ids = malloc(sizeof(long) * o.resources);
+  /* A section's resources, then the positions they were drawn from */
+  held = malloc(sizeof(long) * 2 * o.resources);
+  if (ids == NULL || held == NULL) {
+    perror("procsched-gen");
+    return EXIT_FAILURE;
+  }
+  for (i = 0; i < o.resources; i++) {
+    ids[i] = i;
+  }
+
+  put_string("Processes");
+  for (i = 1; i <= o.processes; i++) {
+    put_name(" P", i);
+  }
+  put_string("\nResources");
+  for (i = 1; i <= o.resources; i++) {
+    put_name(" R", i);
+  }
+  put_string("\n");
+  if (o.mailboxes > 0) {
+    put_string("Mailboxes");
+    for (i = 1; i <= o.mailboxes; i++) {
+      put_name(" M", i);
+    }
+    put_string("\n");
+  }
+
+  for (i = 1; i <= o.processes; i++) {
+    write_process(&o, i, cdf, ids, held);
+  }
+
+  flush_output();
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  free(cdf);
+  free(ids);
+  free(held);
+  return EXIT_SUCCESS;
+}
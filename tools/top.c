@@ -0,0 +1,246 @@
+/**
+ * @file top.c
+ * @description Displays the live counters a running simulation publishes to
+ *              a shared memory segment with -M, see src/monitor.h.
+ *
+ * Usage: tools/procsched-top [options] name
+ *
+ *  -i interval  milliseconds between two refreshes (1000)
+ *  -n count     number of refreshes, 0 until the run ends (0)
+ *
+ * The segment is mapped read-only and read with the seqlock of its header,
+ * so watching a run never slows it down. Each refresh redraws the screen
+ * when stdout is a terminal and appends a block otherwise. A writer that
+ * stops in the middle of publishing, e.g. a run stopped by a debugger, is
+ * reported as stale with the last counters read.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/monitor.h"
+
+/** The reads of a snapshot retried without pausing */
+#define SNAPSHOT_SPINS 64
+/** The reads retried 1 ms apart after those, before the writer is taken
+ * to have stopped while publishing */
+#define SNAPSHOT_PAUSES 100
+
+/**
+ * A consistent copy of the segment.
+ */
+struct snapshot {
+  struct monitorHeader header;
+  struct monitorResource resources[MONITOR_RESOURCES];
+};
+
+/**
+ * @brief Copies the segment, retrying while the writer is publishing.
+ *
+ * @return 0 on success, -1 if the writer was still publishing after
+ * SNAPSHOT_PAUSES ms, which leaves s torn.
+ */
+static int read_snapshot(const struct monitorHeader *h,
+                         struct snapshot *s) {
+  const struct monitorResource *records =
+      (const struct monitorResource *)(h + 1);
+  struct timespec pause = {0, 1000000};
+  uint32_t before;
+  uint32_t after;
+  uint32_t i;
+  int j;
+  int tries;
+
+  for (tries = 0; tries < SNAPSHOT_SPINS + SNAPSHOT_PAUSES; tries++) {
+    if (tries >= SNAPSHOT_SPINS) {
+      nanosleep(&pause, NULL);
+    }
+    before = __atomic_load_n(&h->sequence, __ATOMIC_ACQUIRE);
+    if (before & 1) {
+      continue;
+    }
+    s->header.timeNs = __atomic_load_n(&h->timeNs, __ATOMIC_RELAXED);
+    s->header.startNs = __atomic_load_n(&h->startNs, __ATOMIC_RELAXED);
+    s->header.instructions = __atomic_load_n(&h->instructions,
+                                             __ATOMIC_RELAXED);
+    __atomic_load(&h->instructionsPerSecond, &s->header.instructionsPerSecond,
+                  __ATOMIC_RELAXED);
+    s->header.deadlocks = __atomic_load_n(&h->deadlocks, __ATOMIC_RELAXED);
+    s->header.deadlockVictims =
+        __atomic_load_n(&h->deadlockVictims, __ATOMIC_RELAXED);
+    s->header.processes = __atomic_load_n(&h->processes, __ATOMIC_RELAXED);
+    s->header.ready = __atomic_load_n(&h->ready, __ATOMIC_RELAXED);
+    s->header.waiting = __atomic_load_n(&h->waiting, __ATOMIC_RELAXED);
+    s->header.terminated = __atomic_load_n(&h->terminated, __ATOMIC_RELAXED);
+    s->header.finished = __atomic_load_n(&h->finished, __ATOMIC_RELAXED);
+    for (i = 0; i < s->header.resources; i++) {
+      s->resources[i].holders =
+          __atomic_load_n(&records[i].holders, __ATOMIC_RELAXED);
+      for (j = 0; j < MONITOR_HOLDERS; j++) {
+        s->resources[i].holder[j] =
+            __atomic_load_n(&records[i].holder[j], __ATOMIC_RELAXED);
+      }
+      s->resources[i].available =
+          __atomic_load_n(&records[i].available, __ATOMIC_RELAXED);
+      s->resources[i].readers =
+          __atomic_load_n(&records[i].readers, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&h->sequence, __ATOMIC_RELAXED);
+    if (before == after) {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Prints a snapshot, stale if the writer stopped while publishing
+ * and the counters are from an earlier refresh.
+ */
+static void print_snapshot(const struct snapshot *s, int running,
+                           int stale) {
+  const struct monitorHeader *h = &s->header;
+  const char *state = "running";
+  uint32_t shown;
+  uint32_t i;
+  uint32_t j;
+
+  if (h->finished) {
+    state = "finished";
+  } else if (!running) {
+    state = "exited";
+  } else if (stale) {
+    state = "stale, the writer stopped while publishing";
+  }
+  printf("pid %lld  %s  %.1f s\n", (long long)h->pid, state,
+         h->startNs > 0 ? (h->timeNs - h->startNs) / 1e9 : 0.0);
+  printf("instructions %lld  instr/s %.1f  deadlocks %lld  victims %lld\n",
+         (long long)h->instructions, h->instructionsPerSecond,
+         (long long)h->deadlocks, (long long)h->deadlockVictims);
+  printf("processes %u  ready %u  waiting %u  terminated %u\n", h->processes,
+         h->ready, h->waiting, h->terminated);
+  printf("%-*s %10s %10s %10s holders\n", MONITOR_NAME_SIZE, "resource",
+         "available", "capacity", "readers");
+  for (i = 0; i < h->resources; i++) {
+    printf("%-*s %10u %10u %10u ", MONITOR_NAME_SIZE, s->resources[i].name,
+           s->resources[i].available, s->resources[i].capacity,
+           s->resources[i].readers);
+    if (s->resources[i].holders == 0) {
+      printf("-\n");
+      continue;
+    }
+    shown = s->resources[i].holders < MONITOR_HOLDERS
+                ? s->resources[i].holders
+                : MONITOR_HOLDERS;
+    for (j = 0; j < shown; j++) {
+      printf("%s%d", j > 0 ? "," : "", s->resources[i].holder[j]);
+    }
+    if (s->resources[i].holders > shown) {
+      printf(" (%u more)", s->resources[i].holders - shown);
+    }
+    printf("\n");
+  }
+  if (h->resourceCount > h->resources) {
+    printf("(%u more resources)\n", h->resourceCount - h->resources);
+  }
+}
+
+int main(int argc, char **argv) {
+  struct monitorHeader *h;
+  struct snapshot *s;
+  struct snapshot *fresh;
+  struct snapshot *swap;
+  struct stat info;
+  struct timespec interval;
+  long milliseconds = 1000;
+  long count = 0;
+  long n;
+  int clear = isatty(STDOUT_FILENO);
+  int running;
+  int stale;
+  int opt;
+  int fd;
+
+  while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+    switch (opt) {
+    case 'i':
+      milliseconds = atol(optarg);
+      break;
+    case 'n':
+      count = atol(optarg);
+      break;
+    default:
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: procsched-top [-i interval] [-n count] name\n");
+    return EXIT_FAILURE;
+  }
+
+  fd = shm_open(argv[optind], O_RDONLY, 0);
+  if (fd == -1 || fstat(fd, &info) != 0 ||
+      (size_t)info.st_size < sizeof(struct monitorHeader)) {
+    fprintf(stderr, "procsched-top: cannot open %s\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+  h = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (h == MAP_FAILED || memcmp(h->magic, MONITOR_MAGIC, 8) != 0 ||
+      h->version != MONITOR_VERSION ||
+      h->resources > MONITOR_RESOURCES ||
+      (size_t)info.st_size < sizeof(struct monitorHeader) +
+                                 h->resources *
+                                     sizeof(struct monitorResource)) {
+    fprintf(stderr, "procsched-top: %s is not a monitor segment\n",
+            argv[optind]);
+    return EXIT_FAILURE;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  /* The parts that never change, in both copies: a snapshot is read into
+   * fresh and only replaces s once it is consistent */
+  s = malloc(sizeof(struct snapshot));
+  fresh = malloc(sizeof(struct snapshot));
+  memcpy(&s->header, h, sizeof(struct monitorHeader));
+  memcpy(s->resources, h + 1, h->resources * sizeof(struct monitorResource));
+  memcpy(fresh, s, sizeof(struct snapshot));
+
+  interval.tv_sec = milliseconds / 1000;
+  interval.tv_nsec = milliseconds % 1000 * 1000000;
+  for (n = 0; count == 0 || n < count; n++) {
+    if (n > 0) {
+      nanosleep(&interval, NULL);
+    }
+    stale = read_snapshot(h, fresh) != 0;
+    if (!stale) {
+      swap = s;
+      s = fresh;
+      fresh = swap;
+    }
+    running = kill(h->pid, 0) == 0 || errno != ESRCH;
+    if (clear) {
+      printf("\033[H\033[2J");
+    } else if (n > 0) {
+      printf("\n");
+    }
+    print_snapshot(s, running, stale);
+    fflush(stdout);
+    if (s->header.finished || !running) {
+      break;
+    }
+  }
+
+  free(s);
+  free(fresh);
+  munmap(h, info.st_size);
+  return EXIT_SUCCESS;
+}